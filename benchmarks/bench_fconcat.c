@@ -0,0 +1,689 @@
+// fconcat benchmark harness
+//
+// Builds synthetic input trees in a temporary directory, times the hot
+// paths of the core against them and prints the results as one JSON
+// document on stdout (progress goes to stderr):
+//
+//   ./bench_fconcat [iterations] [file_size]
+//
+// iterations scales the number of timed runs, file_size (K/M/G suffixes
+// accepted) is the size of each file in the "huge" tree.
+
+#define _GNU_SOURCE
+#include "../src/fconcat.h"
+#include "../src/core/context.h"
+#include "../src/core/pipeline.h"
+#include "../src/core/tree.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BENCH_MAX_PATTERNS 40
+#define BENCH_MAX_RESULTS 64
+
+// One generated input tree and the options it is processed with
+typedef struct
+{
+    const char *name;
+    char root[MAX_PATH];
+    char **paths; // Relative paths of every generated file
+    size_t path_count;
+    size_t path_capacity;
+    size_t bytes;
+    const char *options[BENCH_MAX_PATTERNS + 4];
+    int option_count;
+} BenchTree;
+
+typedef struct
+{
+    char benchmark[48];
+    char subject[48];
+    int runs;
+    uint64_t min_ns;
+    uint64_t median_ns;
+    uint64_t items; // Work done by one run
+    const char *unit;
+} BenchResult;
+
+// Everything a run of fconcat needs, set up the way main.c does it
+typedef struct
+{
+    ConfigManager *config_manager;
+    ResolvedConfig *config;
+    FormatEngine *format_engine;
+    FilterEngine *filter_engine;
+    MemoryManager *memory_manager;
+    ErrorManager *error_manager;
+    PluginManager *plugin_manager;
+    FILE *output;
+    ProcessingStats stats;
+    FconcatContext *ctx;
+} BenchSession;
+
+static BenchResult g_results[BENCH_MAX_RESULTS];
+static int g_result_count = 0;
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_record(const char *benchmark, const char *subject, uint64_t *samples, int runs,
+                         uint64_t items, const char *unit)
+{
+    if (g_result_count >= BENCH_MAX_RESULTS || runs <= 0)
+        return;
+
+    qsort(samples, (size_t)runs, sizeof(uint64_t), compare_u64);
+
+    BenchResult *result = &g_results[g_result_count++];
+    snprintf(result->benchmark, sizeof(result->benchmark), "%s", benchmark);
+    snprintf(result->subject, sizeof(result->subject), "%s", subject);
+    result->runs = runs;
+    result->min_ns = samples[0];
+    result->median_ns = samples[runs / 2];
+    result->items = items;
+    result->unit = unit;
+
+    fprintf(stderr, "  %-22s %-10s median %10.3f ms\n", benchmark, subject, result->median_ns / 1e6);
+}
+
+// Accepts plain byte counts and K/M/G suffixes
+static size_t parse_size(const char *text)
+{
+    char *end = NULL;
+    unsigned long long value = strtoull(text, &end, 10);
+    switch (end && *end ? *end : 0)
+    {
+    case 'g':
+    case 'G':
+        value *= 1024;
+        // fall through
+    case 'm':
+    case 'M':
+        value *= 1024;
+        // fall through
+    case 'k':
+    case 'K':
+        value *= 1024;
+        break;
+    default:
+        break;
+    }
+    return (size_t)value;
+}
+
+/* ==== Synthetic trees ==== */
+
+static int tree_add_path(BenchTree *tree, const char *relative)
+{
+    if (tree->path_count == tree->path_capacity)
+    {
+        size_t capacity = tree->path_capacity ? tree->path_capacity * 2 : 256;
+        char **paths = realloc(tree->paths, capacity * sizeof(char *));
+        if (!paths)
+            return -1;
+        tree->paths = paths;
+        tree->path_capacity = capacity;
+    }
+    tree->paths[tree->path_count] = strdup(relative);
+    return tree->paths[tree->path_count++] ? 0 : -1;
+}
+
+static int tree_mkdir(BenchTree *tree, const char *relative)
+{
+    char full[MAX_PATH];
+    snprintf(full, sizeof(full), "%s/%s", tree->root, relative);
+    return mkdir(full, 0755) == 0 || errno == EEXIST ? 0 : -1;
+}
+
+// Writes size bytes of lowercase text lines, or of random binary data
+static int tree_write_file(BenchTree *tree, const char *relative, size_t size, bool binary)
+{
+    char full[MAX_PATH];
+    snprintf(full, sizeof(full), "%s/%s", tree->root, relative);
+
+    int fd = open(full, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    static char block[64 * 1024];
+    static int block_kind = -1; // Which of the two contents block holds
+    if (block_kind != (int)binary)
+    {
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = 0; i < sizeof(block); i++)
+        {
+            state = state * 1664525u + 1013904223u;
+            if (binary)
+                block[i] = (char)(state >> 24);
+            else
+                block[i] = (i % 64 == 63) ? '\n' : (char)('a' + (state >> 24) % 26);
+        }
+        block[0] = binary ? 0 : 'a'; // NUL up front so binary detection trips at once
+        block_kind = (int)binary;
+    }
+
+    size_t remaining = size;
+    while (remaining > 0)
+    {
+        size_t chunk = remaining < sizeof(block) ? remaining : sizeof(block);
+        ssize_t written = write(fd, block, chunk);
+        if (written <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        remaining -= (size_t)written;
+    }
+    close(fd);
+
+    tree->bytes += size;
+    return tree_add_path(tree, relative);
+}
+
+// Many tiny source files spread over a few directories
+static int build_tiny_tree(BenchTree *tree)
+{
+    char path[MAX_PATH];
+    for (int d = 0; d < 20; d++)
+    {
+        snprintf(path, sizeof(path), "dir%02d", d);
+        if (tree_mkdir(tree, path) != 0)
+            return -1;
+        for (int f = 0; f < 250; f++)
+        {
+            snprintf(path, sizeof(path), "dir%02d/file%03d.c", d, f);
+            if (tree_write_file(tree, path, 64 + (size_t)(f % 16) * 32, false) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// A handful of files of file_size bytes each
+static int build_huge_tree(BenchTree *tree, size_t file_size)
+{
+    char path[MAX_PATH];
+    for (int f = 0; f < 4; f++)
+    {
+        snprintf(path, sizeof(path), "huge%d.log", f);
+        if (tree_write_file(tree, path, file_size, false) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// One chain of nested directories with a few files on every level
+static int build_deep_tree(BenchTree *tree)
+{
+    char path[MAX_PATH] = "";
+    size_t len = 0;
+    for (int level = 0; level < 96; level++)
+    {
+        int n = snprintf(path + len, sizeof(path) - len, "%sd%d", len ? "/" : "", level);
+        if (n < 0 || (size_t)n >= sizeof(path) - len - 16)
+            break;
+        len += (size_t)n;
+        if (tree_mkdir(tree, path) != 0)
+            return -1;
+
+        char file[MAX_PATH];
+        for (int f = 0; f < 4; f++)
+        {
+            snprintf(file, sizeof(file), "%s/f%d.txt", path, f);
+            if (tree_write_file(tree, file, 512, false) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+// Mostly binary files that the default binary handling skips
+static int build_binary_tree(BenchTree *tree)
+{
+    char path[MAX_PATH];
+    for (int f = 0; f < 400; f++)
+    {
+        bool binary = f % 8 != 0;
+        snprintf(path, sizeof(path), binary ? "blob%03d.bin" : "note%03d.txt", f);
+        if (tree_write_file(tree, path, 16 * 1024, binary) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Mixed extensions processed with a long list of exclude patterns
+static int build_pattern_tree(BenchTree *tree)
+{
+    static const char *extensions[] = {"c", "h", "o", "log", "tmp", "md", "py", "pyc", "json", "bak"};
+    static const char *dirs[] = {"src", "build", "cache", "docs", "tests", "vendor", "node_modules", "out"};
+    static const char *patterns[] = {"*.o", "*.log", "*.tmp", "*.pyc", "*.bak", "*.swp", "*.class", "*.so",
+                                     "*.a", "*.dll", "*.exe", "*.obj", "*.lock", "*.cache", "*~", "build/*",
+                                     "cache/*", "node_modules/*", "vendor/*", "out/*", "*.min.js", "*.map",
+                                     "tmp?", "core.*", "*.gcda", "*.gcno", "*.orig", "*.rej", ".DS_Store",
+                                     "Thumbs.db", "*.pid", "*.seed"};
+
+    tree->options[tree->option_count++] = "--exclude";
+    for (size_t i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++)
+        tree->options[tree->option_count++] = patterns[i];
+
+    char path[MAX_PATH];
+    for (size_t d = 0; d < sizeof(dirs) / sizeof(dirs[0]); d++)
+    {
+        if (tree_mkdir(tree, dirs[d]) != 0)
+            return -1;
+        for (int f = 0; f < 150; f++)
+        {
+            snprintf(path, sizeof(path), "%s/item%03d.%s", dirs[d], f,
+                     extensions[(size_t)f % (sizeof(extensions) / sizeof(extensions[0]))]);
+            if (tree_write_file(tree, path, 256, false) != 0)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+    (void)st;
+    (void)type;
+    (void)ftw;
+    return remove(path);
+}
+
+static void tree_release(BenchTree *tree)
+{
+    if (tree->root[0])
+        nftw(tree->root, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    for (size_t i = 0; i < tree->path_count; i++)
+        free(tree->paths[i]);
+    free(tree->paths);
+    tree->paths = NULL;
+    tree->path_count = 0;
+}
+
+/* ==== Session setup ==== */
+
+static void session_close(BenchSession *session)
+{
+    if (session->plugin_manager)
+        plugin_manager_destroy(session->plugin_manager, session->ctx);
+    if (session->ctx)
+        destroy_fconcat_context(session->ctx);
+    if (session->output)
+        fclose(session->output);
+    if (session->format_engine)
+        format_engine_destroy(session->format_engine);
+    if (session->filter_engine)
+        filter_engine_destroy(session->filter_engine);
+    if (session->config_manager)
+        config_manager_destroy(session->config_manager);
+    if (session->memory_manager)
+        memory_manager_destroy(session->memory_manager);
+    if (session->error_manager)
+        error_manager_destroy(session->error_manager);
+    memset(session, 0, sizeof(*session));
+}
+
+// Output goes to /dev/null so the numbers reflect fconcat, not the disk
+static int session_open(BenchSession *session, const BenchTree *tree)
+{
+    memset(session, 0, sizeof(*session));
+
+    char *argv[BENCH_MAX_PATTERNS + 8];
+    int argc = 0;
+    argv[argc++] = (char *)"bench_fconcat";
+    argv[argc++] = (char *)tree->root;
+    argv[argc++] = (char *)"/dev/null";
+    argv[argc++] = (char *)"--log-level";
+    argv[argc++] = (char *)"error";
+    for (int i = 0; i < tree->option_count; i++)
+        argv[argc++] = (char *)tree->options[i];
+
+    session->error_manager = error_manager_create();
+    session->memory_manager = memory_manager_create();
+    session->plugin_manager = plugin_manager_create();
+    session->config_manager = config_manager_create();
+    if (!session->error_manager || !session->memory_manager || !session->plugin_manager ||
+        !session->config_manager)
+        goto fail;
+
+    if (config_load_defaults(session->config_manager) != 0 ||
+        config_load_cli(session->config_manager, argc, argv) != 0)
+        goto fail;
+    session->config = config_resolve(session->config_manager);
+    if (!session->config)
+        goto fail;
+
+    session->format_engine = format_engine_create();
+    session->filter_engine = filter_engine_create();
+    session->output = fopen("/dev/null", "wb");
+    if (!session->format_engine || !session->filter_engine || !session->output)
+        goto fail;
+
+    if (format_engine_configure(session->format_engine, session->config, session->output) != 0 ||
+        filter_engine_configure(session->filter_engine, session->config) != 0 ||
+        plugin_manager_configure(session->plugin_manager, session->config, session->format_engine,
+                                 session->filter_engine) != 0)
+        goto fail;
+
+    session->ctx = create_fconcat_context(session->config, session->output, &session->stats,
+                                          session->error_manager, session->memory_manager,
+                                          session->plugin_manager, session->format_engine,
+                                          session->filter_engine);
+    if (!session->ctx)
+        goto fail;
+
+    plugin_manager_initialize_plugins(session->plugin_manager, session->ctx);
+    filter_engine_seal(session->filter_engine);
+    return 0;
+
+fail:
+    session_close(session);
+    return -1;
+}
+
+/* ==== Benchmarks ==== */
+
+typedef struct
+{
+    size_t files;
+    size_t directories;
+} CountingState;
+
+static int count_entry(FconcatContext *ctx, const char *path, EntryType type, FileInfo *info, int level,
+                       void *user_data)
+{
+    (void)ctx;
+    (void)path;
+    (void)info;
+    (void)level;
+    CountingState *state = (CountingState *)user_data;
+    if (type == ENTRY_TYPE_FILE)
+        state->files++;
+    else
+        state->directories++;
+    return 0;
+}
+
+static void bench_traverse(BenchSession *session, const BenchTree *tree, int runs)
+{
+    uint64_t samples[runs];
+    CountingState state = {0};
+    for (int r = 0; r < runs; r++)
+    {
+        state = (CountingState){0};
+        DirectoryCallback callback = {count_entry, &state};
+        uint64_t start = bench_now_ns();
+        traverse_directory(session->ctx, tree->root, "", 0, &callback);
+        samples[r] = bench_now_ns() - start;
+    }
+    bench_record("traverse_directory", tree->name, samples, runs, state.files + state.directories, "entries");
+}
+
+static void bench_filter_paths(BenchSession *session, const BenchTree *tree, int runs)
+{
+    uint64_t samples[runs];
+    FileInfo info = {0};
+    volatile size_t included = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        uint64_t start = bench_now_ns();
+        for (size_t i = 0; i < tree->path_count; i++)
+        {
+            info.path = tree->paths[i];
+            included += (size_t)filter_engine_should_include_path(session->filter_engine, session->ctx,
+                                                                  tree->paths[i], &info);
+        }
+        samples[r] = bench_now_ns() - start;
+    }
+    bench_record("filter_should_include", tree->name, samples, runs, tree->path_count, "paths");
+}
+
+// The per-file content pass (the old content_callback) over a cached tree
+static void bench_content(BenchSession *session, const BenchTree *tree, FileTree *cache, int runs)
+{
+    uint64_t samples[runs];
+    for (int r = 0; r < runs; r++)
+    {
+        uint64_t start = bench_now_ns();
+        for (size_t i = 0; i < cache->count; i++)
+        {
+            TreeEntry *entry = &cache->entries[i];
+            if (entry->type != ENTRY_TYPE_FILE)
+                continue;
+            session->ctx->current_file_path = entry->path;
+            session->ctx->current_file_info = &entry->info;
+            session->ctx->current_directory_level = entry->level;
+            pipeline_process_file(session->ctx, entry->path, &entry->info, NULL);
+        }
+        context_flush_output(session->ctx);
+        samples[r] = bench_now_ns() - start;
+    }
+    bench_record("content_pass", tree->name, samples, runs, tree->bytes, "bytes");
+}
+
+// Scan, both output passes and the final flush, as main.c runs them
+static int run_end_to_end(BenchSession *session)
+{
+    FconcatContext *ctx = session->ctx;
+    FileTree *tree = file_tree_create();
+    if (!tree)
+        return -1;
+
+    int result = file_tree_build(ctx, tree, session->config->input_directory, "", 0);
+    if (result == 0)
+        result = format_engine_begin_document(session->format_engine, ctx);
+    if (result == 0)
+        result = format_engine_begin_structure(session->format_engine, ctx);
+    if (result == 0)
+        result = process_tree_structure(ctx, tree);
+    if (result == 0)
+        result = format_engine_end_structure(session->format_engine, ctx);
+    if (result == 0)
+        result = format_engine_begin_content(session->format_engine, ctx);
+    if (result == 0)
+        result = process_tree_content(ctx, tree);
+    if (result == 0)
+        result = format_engine_end_content(session->format_engine, ctx);
+    if (result == 0)
+        result = format_engine_end_document(session->format_engine, ctx);
+    if (result == 0)
+        result = context_flush_output(ctx);
+
+    file_tree_destroy(tree);
+    return result;
+}
+
+static void bench_end_to_end(BenchSession *session, const BenchTree *tree, int runs)
+{
+    uint64_t samples[runs];
+    int done = 0;
+    for (int r = 0; r < runs; r++)
+    {
+        uint64_t start = bench_now_ns();
+        if (run_end_to_end(session) != 0)
+            break;
+        samples[done++] = bench_now_ns() - start;
+    }
+    bench_record("end_to_end", tree->name, samples, done, tree->bytes, "bytes");
+}
+
+static void bench_buffer_pool(MemoryManager *manager, int runs, int iterations)
+{
+    static const size_t sizes[] = {256, 4096, 65536, 1048576, 4 * 1048576};
+    enum
+    {
+        HELD = 8
+    };
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint64_t samples[runs];
+        for (int r = 0; r < runs; r++)
+        {
+            char *held[HELD];
+            uint64_t start = bench_now_ns();
+            for (int i = 0; i < iterations; i++)
+            {
+                // A few buffers in flight at once, as the pipeline holds them
+                for (int h = 0; h < HELD; h++)
+                {
+                    held[h] = buffer_pool_get(manager->buffer_pool, sizes[s]);
+                    if (held[h])
+                        held[h][0] = (char)h;
+                }
+                for (int h = HELD - 1; h >= 0; h--)
+                    buffer_pool_release(manager->buffer_pool, held[h]);
+            }
+            samples[r] = bench_now_ns() - start;
+        }
+
+        char subject[32];
+        snprintf(subject, sizeof(subject), "%zu", sizes[s]);
+        bench_record("buffer_pool_get", subject, samples, runs, (uint64_t)iterations * HELD, "buffers");
+    }
+}
+
+/* ==== Report ==== */
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            putchar('\\');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+static void print_report(const BenchTree *trees, int tree_count, int iterations, size_t file_size)
+{
+    printf("{\n  \"version\": ");
+    print_json_string(FCONCAT_VERSION);
+    printf(",\n  \"iterations\": %d,\n  \"file_size\": %zu,\n  \"trees\": [\n", iterations, file_size);
+    for (int t = 0; t < tree_count; t++)
+    {
+        printf("    {\"name\": ");
+        print_json_string(trees[t].name);
+        printf(", \"files\": %zu, \"bytes\": %zu}%s\n", trees[t].path_count, trees[t].bytes,
+               t + 1 < tree_count ? "," : "");
+    }
+    printf("  ],\n  \"results\": [\n");
+    for (int i = 0; i < g_result_count; i++)
+    {
+        const BenchResult *result = &g_results[i];
+        double per_sec = result->median_ns ? (double)result->items * 1e9 / (double)result->median_ns : 0.0;
+        printf("    {\"benchmark\": ");
+        print_json_string(result->benchmark);
+        printf(", \"subject\": ");
+        print_json_string(result->subject);
+        printf(", \"runs\": %d, \"min_ns\": %llu, \"median_ns\": %llu, \"items\": %llu, \"unit\": ", result->runs,
+               (unsigned long long)result->min_ns, (unsigned long long)result->median_ns,
+               (unsigned long long)result->items);
+        print_json_string(result->unit);
+        printf(", \"per_sec\": %.1f}%s\n", per_sec, i + 1 < g_result_count ? "," : "");
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    size_t file_size = argc > 2 ? parse_size(argv[2]) : 10 * 1024 * 1024;
+    if (iterations <= 0 || file_size == 0)
+    {
+        fprintf(stderr, "Usage: %s [iterations] [file_size[K|M|G]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Whole-tree runs are far slower than the micro benchmarks
+    int tree_runs = iterations / 200 < 3 ? 3 : iterations / 200;
+    if (tree_runs > 50)
+        tree_runs = 50;
+
+    char base[] = "/tmp/fconcat_bench_XXXXXX";
+    if (!mkdtemp(base))
+    {
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+
+    BenchTree trees[] = {{.name = "tiny"}, {.name = "huge"}, {.name = "deep"}, {.name = "binary"}, {.name = "patterns"}};
+    int tree_count = (int)(sizeof(trees) / sizeof(trees[0]));
+    int status = EXIT_SUCCESS;
+
+    fprintf(stderr, "📊 Generating benchmark trees in %s\n", base);
+    for (int t = 0; t < tree_count && status == EXIT_SUCCESS; t++)
+    {
+        BenchTree *tree = &trees[t];
+        snprintf(tree->root, sizeof(tree->root), "%s/%s", base, tree->name);
+        int result = mkdir(tree->root, 0755);
+        if (result == 0)
+        {
+            switch (t)
+            {
+            case 0: result = build_tiny_tree(tree); break;
+            case 1: result = build_huge_tree(tree, file_size); break;
+            case 2: result = build_deep_tree(tree); break;
+            case 3: result = build_binary_tree(tree); break;
+            default: result = build_pattern_tree(tree); break;
+            }
+        }
+        if (result != 0)
+        {
+            fprintf(stderr, "Failed to generate tree %s: %s\n", tree->name, strerror(errno));
+            status = EXIT_FAILURE;
+        }
+    }
+
+    for (int t = 0; t < tree_count && status == EXIT_SUCCESS; t++)
+    {
+        BenchTree *tree = &trees[t];
+        BenchSession session;
+        if (session_open(&session, tree) != 0)
+        {
+            fprintf(stderr, "Failed to set up a run over %s\n", tree->root);
+            status = EXIT_FAILURE;
+            break;
+        }
+
+        fprintf(stderr, "📁 %s: %zu files, %zu bytes\n", tree->name, tree->path_count, tree->bytes);
+        bench_traverse(&session, tree, tree_runs);
+        bench_filter_paths(&session, tree, tree_runs * 10);
+
+        FileTree *cache = file_tree_create();
+        if (cache && file_tree_build(session.ctx, cache, tree->root, "", 0) == 0)
+            bench_content(&session, tree, cache, tree_runs);
+        file_tree_destroy(cache);
+
+        bench_end_to_end(&session, tree, tree_runs);
+
+        if (t == 0)
+            bench_buffer_pool(session.memory_manager, tree_runs, iterations);
+        session_close(&session);
+    }
+
+    if (status == EXIT_SUCCESS)
+        print_report(trees, tree_count, iterations, file_size);
+
+    for (int t = 0; t < tree_count; t++)
+        tree_release(&trees[t]);
+    rmdir(base);
+    return status;
+}
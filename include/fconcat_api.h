@@ -34,7 +34,39 @@ extern "C"
         LOG_TRACE = 4
     } LogLevel;
 
-    // Progress callback
+    // One piece of a gathered write (see write_outputv)
+    typedef struct
+    {
+        const char *data;
+        size_t size;
+    } FconcatOutputSpan;
+
+    // The run's settings, resolved once when the context is created. A
+    // plugin or formatter may keep the pointer from init until cleanup and
+    // read fields directly instead of calling get_config_* per entry.
+    // Fields are only ever added at the end; size is the host's
+    // sizeof(FconcatSettings), so a field is present when its offset is
+    // below it.
+    typedef struct
+    {
+        size_t size;
+        LogLevel log_level;
+        bool show_size;
+        bool verbose;
+        bool interactive;
+        bool direct_io;
+        bool drop_cache;
+        int binary_handling;  // Same value as get_config_int("binary_handling")
+        int symlink_handling; // Same value as get_config_int("symlink_handling")
+        const char *output_format;
+        const char *input_directory;
+        const char *output_file;
+    } FconcatSettings;
+
+    // Progress callback. While content is processed it runs on a reporter
+    // thread a few times a second, with operation "content" and bytes done
+    // out of the total; reports made through progress() then are queued
+    // for that thread, the latest per interval.
     typedef void (*ProgressCallback)(const char *operation, size_t current, size_t total, void *user_data);
 
     struct FconcatContext
@@ -60,7 +92,7 @@ extern "C"
         void *(*realloc)(FconcatContext *ctx, void *ptr, size_t size);
         void (*free)(FconcatContext *ctx, void *ptr);
 
-        // Output writing
+        // Output writing. write_output writes size bytes of data; 0 writes nothing.
         int (*write_output)(FconcatContext *ctx, const char *data, size_t size);
         int (*write_output_fmt)(FconcatContext *ctx, const char *format, ...);
 
@@ -96,7 +128,8 @@ extern "C"
         int (*set_plugin_data)(FconcatContext *ctx, const char *plugin_name, void *data, size_t size);
         int (*call_plugin_method)(FconcatContext *ctx, const char *plugin_name, const char *method, void *args);
 
-        // Stream utilities
+        // Stream utilities: appends never move earlier data, and
+        // stream_flush writes what is held to the output and empties the buffer
         void *(*create_stream_buffer)(FconcatContext *ctx, size_t initial_size);
         int (*stream_write)(FconcatContext *ctx, void *buffer, const char *data, size_t size);
         int (*stream_flush)(FconcatContext *ctx, void *buffer);
@@ -115,8 +148,38 @@ extern "C"
 
         // Internal state (opaque)
         void *internal_state;
+
+        /**
+         * Scratch memory for the file being processed
+         *
+         * Allocation is a pointer bump and nothing is freed individually:
+         * memory returned while a chunk is handled (e.g. by transform_content)
+         * is reclaimed once that chunk has been written, and everything else
+         * once the file is finished. Never pass it to free() or ctx->free;
+         * use ctx->alloc for data kept across chunks or files.
+         */
+        void *(*arena_alloc)(FconcatContext *ctx, size_t size);
+        void *arena; // Opaque, owned by the processing thread
+
+        // Batched output: several pieces in one call, and runs of spaces
+        // for indentation, both without a write per token
+        int (*write_outputv)(FconcatContext *ctx, const FconcatOutputSpan *spans, int count);
+        int (*write_indent)(FconcatContext *ctx, size_t spaces);
+
+        // Resolved settings (see FconcatSettings); get_config_* still answer
+        // by key name
+        const FconcatSettings *settings;
     };
 
+    // is_log_enabled without a call: a load and a compare, for log calls
+    // on every entry
+    static inline bool fconcat_log_enabled(const FconcatContext *ctx, LogLevel level)
+    {
+        if (ctx && ctx->settings)
+            return (int)level <= (int)ctx->settings->log_level;
+        return (int)level <= (int)LOG_INFO;
+    }
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,6 +21,23 @@ extern "C"
     } PluginCapabilities;
 
     // Content plugin interface
+    //
+    // Content plugins run in load order over the contents of every file that
+    // passed the filters, after the filter transforms.
+    //
+    // file_start may return NULL to leave a file alone; plugins without
+    // file_start see every file with a NULL file_ctx. Binary files are only
+    // handed to plugins with PLUGIN_CAP_BINARY_SUPPORT.
+    //
+    // process_chunk leaves *output NULL (or pointing at input) to pass the
+    // input on unchanged without a copy. Otherwise *output comes from
+    // ctx->arena_alloc or ctx->alloc and is released by fconcat. A non-zero
+    // return also passes the input on unchanged.
+    //
+    // With PLUGIN_CAP_STREAMING, process_chunk is called once per chunk as
+    // the file is read, then once more with input_size 0 so that output held
+    // back (a token split across chunks) can be flushed. Without it, the
+    // whole file is collected first and passed in a single call.
     typedef struct
     {
         const char *name;
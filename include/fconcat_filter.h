@@ -42,6 +42,70 @@ extern "C"
 
     } FilterPlugin;
 
+    // Batched filter interface (v2)
+    //
+    // A library exporting get_filter_plugin_v2() is loaded through it in
+    // preference to get_filter_plugin(). With FILTER_CAP_BATCH_CHUNKS,
+    // filter_chunks replaces should_include_content and transform_content
+    // (which are then ignored): it is handed a batch of chunks in one call
+    // instead of two indirect calls per chunk. Plugins that only export
+    // get_filter_plugin() keep working unchanged; the engine calls their
+    // per-chunk callbacks for them.
+    //
+    // A chunk is the concatenation of its segments, which point into
+    // fconcat's buffers and are only valid during the call. A file read in
+    // one piece arrives as a single chunk flagged FILTER_CHUNK_FIRST |
+    // FILTER_CHUNK_LAST. filter_chunks runs where transform_content would,
+    // after the transform rules and the plugins before it, and sees their
+    // output. For each chunk it may set exclude to leave out the rest of
+    // the file, or output/output_size to a replacement from ctx->arena_alloc
+    // or ctx->alloc that fconcat releases. A non-zero return leaves the
+    // whole batch unchanged; outputs already set are released.
+#define FILTER_PLUGIN_ABI_V2 2
+
+    typedef enum
+    {
+        FILTER_CAP_BATCH_CHUNKS = 1 << 0
+    } FilterCapabilities;
+
+    typedef enum
+    {
+        FILTER_CHUNK_FIRST = 1 << 0, // Starts at offset 0 of the file
+        FILTER_CHUNK_LAST = 1 << 1   // Nothing of the file follows (when known)
+    } FilterChunkFlags;
+
+    typedef struct
+    {
+        const char *data;
+        size_t size;
+    } FilterSegment;
+
+    typedef struct
+    {
+        const char *path;
+        const FilterSegment *segments;
+        size_t segment_count;
+        size_t size;     // Sum of the segment sizes
+        size_t offset;   // Of the chunk within its file
+        unsigned flags;  // FilterChunkFlags
+
+        // Set by the plugin; exclude is false and output NULL on entry
+        bool exclude;
+        char *output;
+        size_t output_size;
+    } FilterChunk;
+
+    // base comes first, so a FilterPluginV2 * is also a FilterPlugin *
+    typedef struct
+    {
+        FilterPlugin base; // Name, priority, lifecycle and path filtering
+        size_t size;       // sizeof(FilterPluginV2) the plugin was built with
+        int abi_version;   // FILTER_PLUGIN_ABI_V2
+        unsigned capabilities; // FilterCapabilities
+
+        int (*filter_chunks)(FconcatContext *ctx, FilterChunk *chunks, size_t count);
+    } FilterPluginV2;
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,73 @@
+// File: include/fconcat_library.h
+#ifndef FCONCAT_LIBRARY_H
+#define FCONCAT_LIBRARY_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Embedding API of libfconcat (libfconcat.a, libfconcat.so).
+    //
+    // A handle is configured once from the options of the fconcat command
+    // and then renders any number of input directories, each to a write
+    // callback or into a buffer in memory. The filter, format and plugin
+    // engines are set up when the handle is created and shared by all of
+    // its runs, so plugins are loaded and initialised once.
+    //
+    // Runs on a handle are serial; separate handles may run at the same
+    // time from different threads. Formatter plugins loaded with --plugin
+    // have to allow that themselves, the built-in formatters do.
+    typedef struct FconcatLibrary FconcatLibrary;
+
+    // Receives the output in order, one block per call. Returns 0, or
+    // non-zero to fail the run.
+    typedef int (*FconcatWriteFn)(const void *data, size_t size, void *user_data);
+
+    // Output collected in memory. data may start out NULL or as a buffer
+    // from malloc() of capacity bytes; it grows with realloc() and is kept
+    // across runs, each of which starts over at size 0. Release data with
+    // free(). It is not NUL-terminated.
+    typedef struct
+    {
+        char *data;
+        size_t size;
+        size_t capacity;
+    } FconcatBuffer;
+
+    typedef struct
+    {
+        size_t files;         // Files written
+        size_t bytes;         // Input bytes read
+        size_t skipped_files; // Files the filters left out
+        size_t output_bytes;  // Bytes handed to the output, after compression
+    } FconcatRunStats;
+
+    // options holds what follows the input and output on the command line,
+    // e.g. {"--include", "*.c", "*.h", "--format", "ndjson"}; argc may be
+    // 0. --watch, --incremental, --shard-size and --shards need an output
+    // file and are rejected, --interactive is ignored. Returns NULL on
+    // failure, after printing the reason to stderr.
+    FconcatLibrary *fconcat_library_create(int argc, const char *const *options);
+    void fconcat_library_destroy(FconcatLibrary *library);
+
+    // Render input_directory as one complete document to write. Returns 0,
+    // or -1 when input_directory is not a directory or the run or a write
+    // failed; stats, when not NULL, is filled in either way.
+    int fconcat_library_run(FconcatLibrary *library, const char *input_directory, FconcatWriteFn write,
+                            void *user_data, FconcatRunStats *stats);
+    // Same, with the document left in buffer
+    int fconcat_library_run_buffer(FconcatLibrary *library, const char *input_directory, FconcatBuffer *buffer,
+                                   FconcatRunStats *stats);
+
+    // Message of the last error the handle reported, or NULL. Valid until
+    // the handle is destroyed.
+    const char *fconcat_library_error(const FconcatLibrary *library);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FCONCAT_LIBRARY_H */
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
 
 // FIXED: Removed fragile allocation pattern, using stack allocation
 static int config_layer_init(ConfigLayer *layer, ConfigSource source, int priority)
@@ -122,6 +123,13 @@ void config_manager_destroy(ConfigManager *manager)
         free(manager->resolved->output_format);
         free(manager->resolved->input_directory);
         free(manager->resolved->output_file);
+        free(manager->resolved->incremental_cache);
+        free(manager->resolved->files_from);
+        for (int i = 0; i < manager->resolved->sample_count; i++)
+        {
+            free(manager->resolved->samples[i].pattern);
+        }
+        free(manager->resolved->samples);
         for (int i = 0; i < manager->resolved->exclude_count; i++)
         {
             free(manager->resolved->exclude_patterns[i]);
@@ -187,6 +195,21 @@ int config_load_defaults(ConfigManager *manager)
         {"interactive", CONFIG_TYPE_BOOL, {.bool_val = false}},
         {"output_format", CONFIG_TYPE_STRING, {.str_val = "text"}},
         {"log_level", CONFIG_TYPE_INT, {.int_val = (int)LOG_INFO}},
+        {"jobs", CONFIG_TYPE_INT, {.int_val = 1}},
+        {"direct_io", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"drop_cache", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"io_engine", CONFIG_TYPE_INT, {.int_val = IO_ENGINE_SYNC}},
+        {"io_depth", CONFIG_TYPE_INT, {.int_val = 0}},
+        {"dedup", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"stats_report", CONFIG_TYPE_INT, {.int_val = STATS_REPORT_NONE}},
+        {"compression", CONFIG_TYPE_INT, {.int_val = OUTPUT_COMPRESS_NONE}},
+        {"compress_level", CONFIG_TYPE_INT, {.int_val = -1}},
+        {"watch", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"gitignore", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"unique_inodes", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"log_async", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"progress", CONFIG_TYPE_BOOL, {.bool_val = false}},
+        {"shards", CONFIG_TYPE_INT, {.int_val = 0}},
     };
 
     for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
@@ -225,6 +248,158 @@ int config_load_defaults(ConfigManager *manager)
     return 0;
 }
 
+// Add-or-set helpers for single-valued CLI options
+static int config_layer_put_int(ConfigLayer *layer, const char *key, int value)
+{
+    ConfigValue *val = config_layer_get_value(layer, key);
+    if (!val)
+    {
+        if (config_layer_add_value(layer, key, CONFIG_TYPE_INT) != 0)
+            return -1;
+        val = config_layer_get_value(layer, key);
+    }
+    config_value_set_int(val, value);
+    return 0;
+}
+
+static int config_layer_put_bool(ConfigLayer *layer, const char *key, bool value)
+{
+    ConfigValue *val = config_layer_get_value(layer, key);
+    if (!val)
+    {
+        if (config_layer_add_value(layer, key, CONFIG_TYPE_BOOL) != 0)
+            return -1;
+        val = config_layer_get_value(layer, key);
+    }
+    config_value_set_bool(val, value);
+    return 0;
+}
+
+static int config_layer_put_string(ConfigLayer *layer, const char *key, const char *value)
+{
+    ConfigValue *val = config_layer_get_value(layer, key);
+    if (!val)
+    {
+        if (config_layer_add_value(layer, key, CONFIG_TYPE_STRING) != 0)
+            return -1;
+        val = config_layer_get_value(layer, key);
+    }
+    config_value_set_string(val, value);
+    return 0;
+}
+
+// Parse a non-negative integer option argument
+static int config_parse_count(const char *option, const char *arg, int *out)
+{
+    char *end = NULL;
+    long value = strtol(arg, &end, 10);
+    if (!end || end == arg || *end != '\0' || value < 0 || value > 1000000)
+    {
+        fprintf(stderr, "Invalid value for %s: %s\n", option, arg);
+        return -1;
+    }
+    *out = (int)value;
+    return 0;
+}
+
+// Parse a --shard-size value: <n>[K|M|G] bytes, or <n>[K|M]tokens
+static int config_parse_shard_size(const char *arg, uint64_t *size, ShardUnit *unit)
+{
+    char *end = NULL;
+    errno = 0;
+    unsigned long long value = strtoull(arg, &end, 10);
+    if (!end || end == arg || errno != 0 || arg[0] == '-')
+        return -1;
+
+    uint64_t scale = 1;
+    if (*end == 'K' || *end == 'k')
+        scale = 1024ULL;
+    else if (*end == 'M' || *end == 'm')
+        scale = 1024ULL * 1024;
+    else if (*end == 'G' || *end == 'g')
+        scale = 1024ULL * 1024 * 1024;
+    if (scale != 1)
+        end++;
+
+    *unit = SHARD_UNIT_BYTES;
+    if (strcmp(end, "tokens") == 0)
+        *unit = SHARD_UNIT_TOKENS;
+    else if (*end != '\0')
+        return -1;
+
+    if (value == 0 || value > UINT64_MAX / scale)
+        return -1;
+    *size = (uint64_t)value * scale;
+    return 0;
+}
+
+// Parse one side of a --sample rule: <n>[K|M|G] bytes, or <n>lines
+static int config_parse_sample_part(const char *arg, size_t length, size_t *value, bool *lines)
+{
+    char number[32];
+    if (length == 0 || length >= sizeof(number) || arg[0] == '-')
+        return -1;
+    memcpy(number, arg, length);
+    number[length] = '\0';
+
+    char *end = NULL;
+    errno = 0;
+    unsigned long long parsed = strtoull(number, &end, 10);
+    if (!end || end == number || errno != 0)
+        return -1;
+
+    unsigned long long scale = 1;
+    *lines = false;
+    if (strcmp(end, "lines") == 0)
+        *lines = true;
+    else if (strcmp(end, "K") == 0 || strcmp(end, "k") == 0)
+        scale = 1024ULL;
+    else if (strcmp(end, "M") == 0 || strcmp(end, "m") == 0)
+        scale = 1024ULL * 1024;
+    else if (strcmp(end, "G") == 0 || strcmp(end, "g") == 0)
+        scale = 1024ULL * 1024 * 1024;
+    else if (*end != '\0')
+        return -1;
+
+    if (parsed > SIZE_MAX / scale)
+        return -1;
+    *value = (size_t)(parsed * scale);
+    return 0;
+}
+
+// Parse a --sample rule: [<pattern>=]<head>[,<tail>]. *pattern is NULL
+// when the rule covers every file, otherwise a copy the caller frees.
+static int config_parse_sample(const char *arg, char **pattern, SamplePolicy *policy)
+{
+    const char *sizes = arg;
+    const char *equals = strrchr(arg, '=');
+    if (equals)
+    {
+        if (equals == arg)
+            return -1;
+        sizes = equals + 1;
+    }
+
+    memset(policy, 0, sizeof(*policy));
+    const char *comma = strchr(sizes, ',');
+    size_t head_length = comma ? (size_t)(comma - sizes) : strlen(sizes);
+    if (config_parse_sample_part(sizes, head_length, &policy->head, &policy->head_lines) != 0)
+        return -1;
+    if (comma && config_parse_sample_part(comma + 1, strlen(comma + 1), &policy->tail, &policy->tail_lines) != 0)
+        return -1;
+    if (policy->head == 0 && policy->tail == 0)
+        return -1;
+
+    *pattern = NULL;
+    if (equals)
+    {
+        *pattern = strndup(arg, (size_t)(equals - arg));
+        if (!*pattern)
+            return -1;
+    }
+    return 0;
+}
+
 int config_load_cli(ConfigManager *manager, int argc, char *argv[])
 {
     if (!manager || argc < 3)
@@ -239,6 +414,8 @@ int config_load_cli(ConfigManager *manager, int argc, char *argv[])
         return -1;
     }
 
+    int sample_count = 0; // --sample may be given more than once
+
     // Parse basic arguments
     if (config_layer_add_value(layer, "input_directory", CONFIG_TYPE_STRING) != 0)
     {
@@ -622,6 +799,234 @@ int config_load_cli(ConfigManager *manager, int argc, char *argv[])
 
             free(plugin_spec);
         }
+        else if ((strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc)
+        {
+            int jobs = 0;
+            if (config_parse_count(argv[i], argv[i + 1], &jobs) != 0 ||
+                config_layer_put_int(layer, "jobs", jobs) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--direct-io") == 0 || strcmp(argv[i], "--drop-cache") == 0)
+        {
+            const char *key = strcmp(argv[i], "--direct-io") == 0 ? "direct_io" : "drop_cache";
+            if (config_layer_put_bool(layer, key, true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--io-engine") == 0 && i + 1 < argc)
+        {
+            static const struct
+            {
+                const char *name;
+                IoEngineKind kind;
+            } engines[] = {
+                {"sync", IO_ENGINE_SYNC},
+                {"auto", IO_ENGINE_AUTO},
+                {"uring", IO_ENGINE_URING},
+                {"io_uring", IO_ENGINE_URING},
+                {"threads", IO_ENGINE_THREADS},
+            };
+
+            i++;
+            size_t e = 0;
+            while (e < sizeof(engines) / sizeof(engines[0]) && strcmp(argv[i], engines[e].name) != 0)
+                e++;
+            if (e == sizeof(engines) / sizeof(engines[0]))
+            {
+                fprintf(stderr, "Invalid value for --io-engine: %s\n", argv[i]);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            if (config_layer_put_int(layer, "io_engine", (int)engines[e].kind) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--io-depth") == 0 && i + 1 < argc)
+        {
+            int depth = 0;
+            if (config_parse_count(argv[i], argv[i + 1], &depth) != 0 ||
+                config_layer_put_int(layer, "io_depth", depth) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--dedup") == 0)
+        {
+            if (config_layer_put_bool(layer, "dedup", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--watch") == 0)
+        {
+            if (config_layer_put_bool(layer, "watch", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--gitignore") == 0)
+        {
+            if (config_layer_put_bool(layer, "gitignore", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--unique-inodes") == 0)
+        {
+            if (config_layer_put_bool(layer, "unique_inodes", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--log-async") == 0)
+        {
+            if (config_layer_put_bool(layer, "log_async", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--progress") == 0)
+        {
+            if (config_layer_put_bool(layer, "progress", true) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--shard-size") == 0 && i + 1 < argc)
+        {
+            // Kept as written; config_resolve turns it into a budget
+            uint64_t size = 0;
+            ShardUnit unit;
+            if (config_parse_shard_size(argv[i + 1], &size, &unit) != 0)
+            {
+                fprintf(stderr, "Invalid value for --shard-size: %s (e.g. 8M, 100Ktokens)\n", argv[i + 1]);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            if (config_layer_put_string(layer, "shard_size", argv[++i]) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc)
+        {
+            int shards = 0;
+            if (config_parse_count(argv[i], argv[i + 1], &shards) != 0 ||
+                config_layer_put_int(layer, "shards", shards) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            i++;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            // The report format is optional; anything else is the next option
+            StatsReport report = STATS_REPORT_TABLE;
+            if (i + 1 < argc && strcmp(argv[i + 1], "json") == 0)
+            {
+                report = STATS_REPORT_JSON;
+                i++;
+            }
+            else if (i + 1 < argc && strcmp(argv[i + 1], "table") == 0)
+            {
+                i++;
+            }
+            if (config_layer_put_int(layer, "stats_report", (int)report) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc)
+        {
+            // codec[:level]
+            const char *spec = argv[++i];
+            const char *colon = strchr(spec, ':');
+            size_t name_len = colon ? (size_t)(colon - spec) : strlen(spec);
+            OutputCompression compression;
+            if ((name_len == 4 && strncmp(spec, "gzip", 4) == 0) || (name_len == 2 && strncmp(spec, "gz", 2) == 0))
+                compression = OUTPUT_COMPRESS_GZIP;
+            else if (name_len == 4 && strncmp(spec, "none", 4) == 0)
+                compression = OUTPUT_COMPRESS_NONE;
+            else
+            {
+                fprintf(stderr, "Invalid value for --compress: %s (available: gzip, none)\n", spec);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+
+            int level = -1;
+            if (colon && (config_parse_count("--compress level", colon + 1, &level) != 0 || level > 9))
+            {
+                if (level > 9)
+                    fprintf(stderr, "Invalid value for --compress level: %s\n", colon + 1);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+
+            if (config_layer_put_int(layer, "compression", (int)compression) != 0 ||
+                config_layer_put_int(layer, "compress_level", level) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--files-from") == 0 && i + 1 < argc)
+        {
+            if (config_layer_put_string(layer, "files_from", argv[++i]) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc)
+        {
+            // Kept as written; config_resolve parses each rule again
+            char *pattern = NULL;
+            SamplePolicy policy;
+            if (config_parse_sample(argv[i + 1], &pattern, &policy) != 0)
+            {
+                fprintf(stderr, "Invalid value for --sample: %s (e.g. '*.log=64K,16K', 200lines)\n", argv[i + 1]);
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+            free(pattern);
+
+            char rule_key[64];
+            snprintf(rule_key, sizeof(rule_key), "sample_rule_%d", sample_count);
+            if (config_layer_put_string(layer, rule_key, argv[++i]) != 0 ||
+                config_layer_put_int(layer, "sample_count", ++sample_count) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--incremental") == 0 && i + 1 < argc)
+        {
+            if (config_layer_put_string(layer, "incremental_cache", argv[++i]) != 0)
+            {
+                pthread_mutex_unlock(&manager->mutex);
+                return -1;
+            }
+        }
         // Add more options as needed
     }
 
@@ -646,6 +1051,27 @@ ResolvedConfig *config_resolve(ConfigManager *manager)
     config->verbose = config_get_bool(manager, "verbose");
     config->interactive = config_get_bool(manager, "interactive");
     config->log_level = config_get_int(manager, "log_level");
+    config->jobs = config_get_int(manager, "jobs");
+    config->direct_io = config_get_bool(manager, "direct_io");
+    config->drop_cache = config_get_bool(manager, "drop_cache");
+    config->io_engine = (IoEngineKind)config_get_int(manager, "io_engine");
+    config->io_depth = config_get_int(manager, "io_depth");
+    config->dedup = config_get_bool(manager, "dedup");
+    config->stats_report = (StatsReport)config_get_int(manager, "stats_report");
+    config->compression = (OutputCompression)config_get_int(manager, "compression");
+    config->compress_level = config_get_int(manager, "compress_level");
+    config->watch = config_get_bool(manager, "watch");
+    config->gitignore = config_get_bool(manager, "gitignore");
+    config->unique_inodes = config_get_bool(manager, "unique_inodes");
+    config->log_async = config_get_bool(manager, "log_async");
+    config->progress = config_get_bool(manager, "progress");
+    config->shards = config_get_int(manager, "shards");
+
+    const char *shard_size = config_get_string(manager, "shard_size");
+    config->shard_size = 0;
+    config->shard_unit = SHARD_UNIT_BYTES;
+    if (shard_size && config_parse_shard_size(shard_size, &config->shard_size, &config->shard_unit) != 0)
+        config->shard_size = 0;
 
     const char *format = config_get_string(manager, "output_format");
     if (format)
@@ -680,6 +1106,56 @@ ResolvedConfig *config_resolve(ConfigManager *manager)
         }
     }
 
+    const char *incremental_cache = config_get_string(manager, "incremental_cache");
+    if (incremental_cache)
+    {
+        free(config->incremental_cache);
+        config->incremental_cache = strdup(incremental_cache);
+        if (!config->incremental_cache) {
+            pthread_mutex_unlock(&manager->mutex);
+            return NULL;  // Allocation failed - caller should use config_manager_destroy()
+        }
+    }
+
+    const char *files_from = config_get_string(manager, "files_from");
+    if (files_from)
+    {
+        free(config->files_from);
+        config->files_from = strdup(files_from);
+        if (!config->files_from) {
+            pthread_mutex_unlock(&manager->mutex);
+            return NULL;  // Allocation failed - caller should use config_manager_destroy()
+        }
+    }
+
+    // Resolve --sample rules, dropping any that no longer parse
+    for (int i = 0; i < config->sample_count; i++)
+    {
+        free(config->samples[i].pattern);
+    }
+    free(config->samples);
+    config->samples = NULL;
+    config->sample_count = 0;
+
+    int sample_count = config_get_int(manager, "sample_count");
+    if (sample_count > 0)
+    {
+        config->samples = calloc((size_t)sample_count, sizeof(SampleRule));
+        if (!config->samples) {
+            pthread_mutex_unlock(&manager->mutex);
+            return NULL;  // Allocation failed - caller should use config_manager_destroy()
+        }
+        for (int i = 0; i < sample_count; i++)
+        {
+            char rule_key[64];
+            snprintf(rule_key, sizeof(rule_key), "sample_rule_%d", i);
+            const char *rule = config_get_string(manager, rule_key);
+            SampleRule *sample = &config->samples[config->sample_count];
+            if (rule && config_parse_sample(rule, &sample->pattern, &sample->policy) == 0)
+                config->sample_count++;
+        }
+    }
+
     // Resolve exclude patterns
     int exclude_count = config_get_int(manager, "exclude_count");
     if (exclude_count > 0)
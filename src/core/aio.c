@@ -0,0 +1,657 @@
+#include "aio.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define AIO_HAVE_URING 1
+#endif
+#endif
+
+// Reader threads of the fallback backend
+#define AIO_MAX_THREADS 16
+// Largest single read request; longer files take several
+#define AIO_MAX_READ (1u << 30)
+
+// Where a request is in its open/read/close sequence
+enum
+{
+    STAGE_OPEN,
+    STAGE_READ,
+    STAGE_CLOSE,
+    STAGE_DONE
+};
+
+#ifdef AIO_HAVE_URING
+typedef struct
+{
+    int fd;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_entries;
+    struct io_uring_sqe *sqes;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+    unsigned unsubmitted; // Queued SQEs the kernel has not been told about
+    unsigned active;      // Requests with an operation in the kernel
+} Uring;
+#endif
+
+struct IoEngine
+{
+    IoEngineKind kind;
+    unsigned depth;
+    unsigned in_flight; // Submitted and not yet reaped
+    IoRequest *done_head;
+    IoRequest *done_tail;
+
+#ifdef AIO_HAVE_URING
+    Uring ring;
+#endif
+
+    // Thread backend; done list and in_flight are guarded by mutex
+    pthread_t threads[AIO_MAX_THREADS];
+    int thread_count;
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    IoRequest *queue_head;
+    IoRequest *queue_tail;
+    bool stopping;
+};
+
+static void request_list_push(IoRequest **head, IoRequest **tail, IoRequest *request)
+{
+    request->next = NULL;
+    if (*tail)
+        (*tail)->next = request;
+    else
+        *head = request;
+    *tail = request;
+}
+
+static IoRequest *request_list_pop(IoRequest **head, IoRequest **tail)
+{
+    IoRequest *request = *head;
+    if (request)
+    {
+        *head = request->next;
+        if (!*head)
+            *tail = NULL;
+        request->next = NULL;
+    }
+    return request;
+}
+
+static void request_reset(IoRequest *request)
+{
+    request->size = 0;
+    request->error = 0;
+    request->truncated = false;
+    request->fd = -1;
+    request->stage = STAGE_OPEN;
+    request->next = NULL;
+}
+
+// ============================================================================
+// IO_URING BACKEND
+// ============================================================================
+
+#ifdef AIO_HAVE_URING
+
+static int uring_enter(Uring *ring, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+// The kernel may lack the opcodes even when io_uring itself works (< 5.6)
+static bool uring_supports_ops(int fd)
+{
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, size);
+    if (!probe)
+        return false;
+
+    bool supported = false;
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0)
+    {
+        const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE};
+        supported = true;
+        for (size_t i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+                supported = false;
+        }
+    }
+
+    free(probe);
+    return supported;
+}
+
+static void uring_teardown(Uring *ring)
+{
+    if (ring->sqes && ring->sqes != MAP_FAILED)
+        munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_map && ring->cq_map != MAP_FAILED && ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_size);
+    if (ring->sq_map && ring->sq_map != MAP_FAILED)
+        munmap(ring->sq_map, ring->sq_map_size);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int uring_setup(Uring *ring, unsigned entries)
+{
+    memset(ring, 0, sizeof(*ring));
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0)
+        return -1;
+
+    if (!uring_supports_ops(ring->fd))
+    {
+        uring_teardown(ring);
+        return -1;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map)
+    {
+        if (ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED)
+    {
+        uring_teardown(ring);
+        return -1;
+    }
+
+    ring->cq_map = single_map ? ring->sq_map
+                              : mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                     ring->fd, IORING_OFF_CQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->cq_map == MAP_FAILED || ring->sqes == MAP_FAILED)
+    {
+        uring_teardown(ring);
+        return -1;
+    }
+
+    char *sq = (char *)ring->sq_map;
+    char *cq = (char *)ring->cq_map;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+}
+
+// Hand queued SQEs to the kernel, optionally waiting for a completion
+static int uring_submit(Uring *ring, bool wait)
+{
+    for (;;)
+    {
+        unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+        int submitted = uring_enter(ring, ring->unsubmitted, wait ? 1 : 0, flags);
+        if (submitted < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        ring->unsubmitted -= (unsigned)submitted < ring->unsubmitted ? (unsigned)submitted : ring->unsubmitted;
+        return 0;
+    }
+}
+
+static struct io_uring_sqe *uring_get_sqe(Uring *ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring->sq_tail;
+
+    if (tail - head >= ring->sq_entries)
+    {
+        // Ring full of unsubmitted entries: push them out and look again
+        if (uring_submit(ring, false) != 0)
+            return NULL;
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (tail - head >= ring->sq_entries)
+            return NULL;
+    }
+
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    return sqe;
+}
+
+static void uring_commit_sqe(Uring *ring)
+{
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + 1, __ATOMIC_RELEASE);
+    ring->unsubmitted++;
+}
+
+// Queue the next operation of a request
+static int uring_queue_stage(Uring *ring, IoRequest *request)
+{
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (!sqe)
+        return -1;
+
+    switch (request->stage)
+    {
+    case STAGE_OPEN:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t)(uintptr_t)request->path;
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        break;
+    case STAGE_READ:
+    {
+        size_t remaining = request->capacity - request->size;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = request->fd;
+        sqe->addr = (uint64_t)(uintptr_t)(request->buffer + request->size);
+        sqe->len = remaining > AIO_MAX_READ ? AIO_MAX_READ : (unsigned)remaining;
+        sqe->off = request->size;
+        break;
+    }
+    default:
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = request->fd;
+        break;
+    }
+
+    sqe->user_data = (uint64_t)(uintptr_t)request;
+    uring_commit_sqe(ring);
+    return 0;
+}
+
+static void engine_complete(IoEngine *engine, IoRequest *request)
+{
+    request->stage = STAGE_DONE;
+    request_list_push(&engine->done_head, &engine->done_tail, request);
+}
+
+// Advance a request by one completed operation
+static void uring_handle_cqe(IoEngine *engine, IoRequest *request, int res)
+{
+    Uring *ring = &engine->ring;
+
+    switch (request->stage)
+    {
+    case STAGE_OPEN:
+        if (res < 0)
+        {
+            request->error = -res;
+            break;
+        }
+        request->fd = res;
+        request->stage = request->capacity > 0 ? STAGE_READ : STAGE_CLOSE;
+        if (request->capacity == 0)
+            request->truncated = true;
+        if (uring_queue_stage(ring, request) == 0)
+            return;
+        request->error = EAGAIN;
+        close(request->fd);
+        request->fd = -1;
+        break;
+
+    case STAGE_READ:
+        if (res == -EINTR || res == -EAGAIN)
+        {
+            // Retry the same read
+        }
+        else if (res < 0)
+        {
+            request->error = -res;
+            request->stage = STAGE_CLOSE;
+        }
+        else if (res == 0)
+        {
+            request->stage = STAGE_CLOSE;
+        }
+        else
+        {
+            request->size += (size_t)res;
+            if (request->size == request->capacity)
+            {
+                request->truncated = true;
+                request->stage = STAGE_CLOSE;
+            }
+        }
+        if (uring_queue_stage(ring, request) == 0)
+            return;
+        // No room to queue anything: finish the request synchronously
+        close(request->fd);
+        request->fd = -1;
+        if (request->stage == STAGE_READ && !request->error)
+            request->error = EAGAIN;
+        break;
+
+    default:
+        request->fd = -1;
+        break;
+    }
+
+    ring->active--;
+    engine_complete(engine, request);
+}
+
+static void uring_drain_cq(IoEngine *engine)
+{
+    Uring *ring = &engine->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        IoRequest *request = (IoRequest *)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        uring_handle_cqe(engine, request, res);
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+static IoRequest *uring_reap(IoEngine *engine, bool wait)
+{
+    Uring *ring = &engine->ring;
+
+    for (;;)
+    {
+        uring_drain_cq(engine);
+        if (engine->done_head || ring->active == 0)
+            break;
+
+        if (uring_submit(ring, wait) != 0 || !wait)
+        {
+            uring_drain_cq(engine);
+            break;
+        }
+    }
+
+    return request_list_pop(&engine->done_head, &engine->done_tail);
+}
+
+#endif /* AIO_HAVE_URING */
+
+// ============================================================================
+// THREAD BACKEND
+// ============================================================================
+
+static void read_whole_file(IoRequest *request)
+{
+    int fd = open(request->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        request->error = errno;
+        return;
+    }
+
+    while (request->size < request->capacity)
+    {
+        ssize_t n = read(fd, request->buffer + request->size, request->capacity - request->size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            request->error = errno;
+            break;
+        }
+        if (n == 0)
+            break;
+        request->size += (size_t)n;
+    }
+
+    if (!request->error && request->size == request->capacity)
+        request->truncated = true;
+    close(fd);
+}
+
+static void *reader_thread(void *arg)
+{
+    IoEngine *engine = (IoEngine *)arg;
+
+    pthread_mutex_lock(&engine->mutex);
+    for (;;)
+    {
+        while (!engine->stopping && !engine->queue_head)
+            pthread_cond_wait(&engine->work_ready, &engine->mutex);
+
+        IoRequest *request = request_list_pop(&engine->queue_head, &engine->queue_tail);
+        if (!request)
+            break; // Stopping with nothing left to read
+
+        pthread_mutex_unlock(&engine->mutex);
+        read_whole_file(request);
+        pthread_mutex_lock(&engine->mutex);
+
+        request->stage = STAGE_DONE;
+        request_list_push(&engine->done_head, &engine->done_tail, request);
+        pthread_cond_signal(&engine->work_done);
+    }
+    pthread_mutex_unlock(&engine->mutex);
+
+    return NULL;
+}
+
+static int threads_start(IoEngine *engine)
+{
+    pthread_mutex_init(&engine->mutex, NULL);
+    pthread_cond_init(&engine->work_ready, NULL);
+    pthread_cond_init(&engine->work_done, NULL);
+
+    int wanted = engine->depth < AIO_MAX_THREADS ? (int)engine->depth : AIO_MAX_THREADS;
+    for (int i = 0; i < wanted; i++)
+    {
+        if (pthread_create(&engine->threads[i], NULL, reader_thread, engine) != 0)
+            break;
+        engine->thread_count++;
+    }
+
+    if (engine->thread_count == 0)
+    {
+        pthread_cond_destroy(&engine->work_done);
+        pthread_cond_destroy(&engine->work_ready);
+        pthread_mutex_destroy(&engine->mutex);
+        return -1;
+    }
+    return 0;
+}
+
+// ============================================================================
+// PUBLIC INTERFACE
+// ============================================================================
+
+IoEngine *io_engine_create(IoEngineKind kind, unsigned depth)
+{
+    if (kind == IO_ENGINE_SYNC)
+        return NULL;
+
+    IoEngine *engine = calloc(1, sizeof(IoEngine));
+    if (!engine)
+        return NULL;
+
+    if (depth == 0)
+        depth = IO_ENGINE_DEFAULT_DEPTH;
+    engine->depth = depth > IO_ENGINE_MAX_DEPTH ? IO_ENGINE_MAX_DEPTH : depth;
+
+#ifdef AIO_HAVE_URING
+    engine->ring.fd = -1;
+    if (kind == IO_ENGINE_AUTO || kind == IO_ENGINE_URING)
+    {
+        if (uring_setup(&engine->ring, engine->depth) == 0)
+        {
+            // Each request has one operation queued at a time
+            if (engine->depth > engine->ring.sq_entries)
+                engine->depth = engine->ring.sq_entries;
+            engine->kind = IO_ENGINE_URING;
+            return engine;
+        }
+    }
+#endif
+
+    if (threads_start(engine) != 0)
+    {
+        free(engine);
+        return NULL;
+    }
+    engine->kind = IO_ENGINE_THREADS;
+    return engine;
+}
+
+void io_engine_destroy(IoEngine *engine)
+{
+    if (!engine)
+        return;
+
+    // Requests still in flight own descriptors and the caller's buffers
+    while (io_engine_reap(engine, true))
+        ;
+
+#ifdef AIO_HAVE_URING
+    if (engine->kind == IO_ENGINE_URING)
+    {
+        uring_teardown(&engine->ring);
+        free(engine);
+        return;
+    }
+#endif
+
+    pthread_mutex_lock(&engine->mutex);
+    engine->stopping = true;
+    pthread_cond_broadcast(&engine->work_ready);
+    pthread_mutex_unlock(&engine->mutex);
+
+    for (int i = 0; i < engine->thread_count; i++)
+        pthread_join(engine->threads[i], NULL);
+
+    pthread_cond_destroy(&engine->work_done);
+    pthread_cond_destroy(&engine->work_ready);
+    pthread_mutex_destroy(&engine->mutex);
+    free(engine);
+}
+
+IoEngineKind io_engine_kind(const IoEngine *engine)
+{
+    return engine ? engine->kind : IO_ENGINE_SYNC;
+}
+
+const char *io_engine_name(IoEngineKind kind)
+{
+    switch (kind)
+    {
+    case IO_ENGINE_AUTO:
+        return "auto";
+    case IO_ENGINE_URING:
+        return "io_uring";
+    case IO_ENGINE_THREADS:
+        return "threads";
+    default:
+        return "sync";
+    }
+}
+
+int io_engine_submit(IoEngine *engine, IoRequest *request)
+{
+    if (!engine || !request || !request->path || (!request->buffer && request->capacity))
+        return -1;
+
+    request_reset(request);
+
+#ifdef AIO_HAVE_URING
+    if (engine->kind == IO_ENGINE_URING)
+    {
+        if (engine->in_flight >= engine->depth || uring_queue_stage(&engine->ring, request) != 0)
+            return -1;
+        engine->ring.active++;
+        engine->in_flight++;
+        // Let the kernel start on it while the caller keeps working
+        uring_submit(&engine->ring, false);
+        return 0;
+    }
+#endif
+
+    pthread_mutex_lock(&engine->mutex);
+    if (engine->in_flight >= engine->depth)
+    {
+        pthread_mutex_unlock(&engine->mutex);
+        return -1;
+    }
+    engine->in_flight++;
+    request_list_push(&engine->queue_head, &engine->queue_tail, request);
+    pthread_cond_signal(&engine->work_ready);
+    pthread_mutex_unlock(&engine->mutex);
+    return 0;
+}
+
+IoRequest *io_engine_reap(IoEngine *engine, bool wait)
+{
+    if (!engine)
+        return NULL;
+
+#ifdef AIO_HAVE_URING
+    if (engine->kind == IO_ENGINE_URING)
+    {
+        if (engine->in_flight == 0)
+            return NULL;
+        IoRequest *request = uring_reap(engine, wait);
+        if (request)
+            engine->in_flight--;
+        return request;
+    }
+#endif
+
+    pthread_mutex_lock(&engine->mutex);
+    while (wait && !engine->done_head && engine->in_flight > 0)
+        pthread_cond_wait(&engine->work_done, &engine->mutex);
+
+    IoRequest *request = request_list_pop(&engine->done_head, &engine->done_tail);
+    if (request)
+        engine->in_flight--;
+    pthread_mutex_unlock(&engine->mutex);
+    return request;
+}
+
+unsigned io_engine_in_flight(const IoEngine *engine)
+{
+    return engine ? engine->in_flight : 0;
+}
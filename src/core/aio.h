@@ -0,0 +1,64 @@
+#ifndef CORE_AIO_H
+#define CORE_AIO_H
+
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Whole-file reads kept in flight while the content pass works on
+    // earlier files. Each request goes through open, one or more reads
+    // and close, issued through io_uring where the kernel allows it or
+    // through a small pool of blocking reader threads otherwise.
+    typedef struct IoEngine IoEngine;
+
+#define IO_ENGINE_DEFAULT_DEPTH 128
+#define IO_ENGINE_MAX_DEPTH 4096
+
+    typedef struct IoRequest
+    {
+        // Set by the caller; path and buffer must stay valid until completion
+        const char *path;
+        char *buffer;
+        size_t capacity;
+        void *user_data;
+
+        // Results
+        size_t size;    // Bytes read
+        int error;      // errno of a failed open or read, 0 on success
+        bool truncated; // The file holds more than capacity bytes
+
+        // Engine state
+        int fd;
+        int stage;
+        struct IoRequest *next;
+    } IoRequest;
+
+    // IO_ENGINE_AUTO picks io_uring when available, else threads. Asking
+    // for io_uring where it cannot be set up also falls back to threads.
+    // Returns NULL for IO_ENGINE_SYNC or on allocation failure.
+    IoEngine *io_engine_create(IoEngineKind kind, unsigned depth);
+    // Waits for requests still in flight
+    void io_engine_destroy(IoEngine *engine);
+
+    // The backend actually in use
+    IoEngineKind io_engine_kind(const IoEngine *engine);
+    const char *io_engine_name(IoEngineKind kind);
+
+    // Queue a request. Fails with -1 when depth requests are in flight.
+    int io_engine_submit(IoEngine *engine, IoRequest *request);
+    // A completed request in any order, or NULL when none is ready (wait ==
+    // false) or nothing is in flight
+    IoRequest *io_engine_reap(IoEngine *engine, bool wait);
+
+    unsigned io_engine_in_flight(const IoEngine *engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_AIO_H */
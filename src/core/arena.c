@@ -0,0 +1,196 @@
+#include "arena.h"
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Past this many blocks a reset returns the extras to the system, so one
+// oversized file does not pin its memory for the rest of the run
+#define ARENA_RETAIN_BLOCKS 4
+
+typedef struct ArenaBlock
+{
+    struct ArenaBlock *next;
+    size_t size; // Usable bytes in data
+    size_t used;
+    alignas(max_align_t) unsigned char data[];
+} ArenaBlock;
+
+struct Arena
+{
+    ArenaBlock *first; // Never freed before arena_destroy
+    ArenaBlock *current;
+    size_t block_size;
+    size_t block_count;
+    size_t reserved_bytes;
+    size_t handed_out; // Bytes allocated since the last reset
+    size_t peak_bytes;
+};
+
+static size_t align_up(size_t size)
+{
+    const size_t align = alignof(max_align_t);
+    return (size + align - 1) & ~(align - 1);
+}
+
+static ArenaBlock *arena_block_create(size_t size)
+{
+    if (size > SIZE_MAX - sizeof(ArenaBlock))
+        return NULL;
+
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + size);
+    if (!block)
+        return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+Arena *arena_create(size_t block_size)
+{
+    Arena *arena = calloc(1, sizeof(Arena));
+    if (!arena)
+        return NULL;
+
+    arena->block_size = align_up(block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE);
+    arena->first = arena_block_create(arena->block_size);
+    if (!arena->first)
+    {
+        free(arena);
+        return NULL;
+    }
+
+    arena->current = arena->first;
+    arena->block_count = 1;
+    arena->reserved_bytes = arena->block_size;
+    return arena;
+}
+
+static void arena_free_blocks(ArenaBlock *block)
+{
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void arena_destroy(Arena *arena)
+{
+    if (!arena)
+        return;
+
+    arena_free_blocks(arena->first);
+    free(arena);
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    if (!arena || size > SIZE_MAX / 2)
+        return NULL;
+
+    size_t need = align_up(size ? size : 1);
+    ArenaBlock *block = arena->current;
+
+    if (block->size - block->used < need)
+    {
+        // Blocks after the current one are free; reuse the first that fits
+        while (block->next && block->next->size < need)
+            block = block->next;
+
+        if (block->next)
+        {
+            block = block->next;
+        }
+        else
+        {
+            ArenaBlock *fresh = arena_block_create(need > arena->block_size ? need : arena->block_size);
+            if (!fresh)
+                return NULL;
+            block->next = fresh;
+            block = fresh;
+            arena->block_count++;
+            arena->reserved_bytes += fresh->size;
+        }
+
+        block->used = 0;
+        arena->current = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += need;
+
+    arena->handed_out += need;
+    if (arena->handed_out > arena->peak_bytes)
+        arena->peak_bytes = arena->handed_out;
+
+    return ptr;
+}
+
+void arena_reset(Arena *arena)
+{
+    if (!arena)
+        return;
+
+    if (arena->block_count > ARENA_RETAIN_BLOCKS)
+    {
+        arena_free_blocks(arena->first->next);
+        arena->first->next = NULL;
+        arena->block_count = 1;
+        arena->reserved_bytes = arena->first->size;
+    }
+
+    arena->first->used = 0;
+    arena->current = arena->first;
+    arena->handed_out = 0;
+}
+
+ArenaMark arena_mark(const Arena *arena)
+{
+    ArenaMark mark = {NULL, 0};
+    if (arena)
+    {
+        mark.block = arena->current;
+        mark.used = arena->current->used;
+    }
+    return mark;
+}
+
+void arena_rewind(Arena *arena, ArenaMark mark)
+{
+    if (!arena || !mark.block)
+        return;
+
+    ArenaBlock *block = (ArenaBlock *)mark.block;
+    block->used = mark.used;
+    arena->current = block;
+}
+
+bool arena_owns(const Arena *arena, const void *ptr)
+{
+    if (!arena || !ptr)
+        return false;
+
+    const unsigned char *p = (const unsigned char *)ptr;
+    for (const ArenaBlock *block = arena->first; block; block = block->next)
+    {
+        if (p >= block->data && p < block->data + block->size)
+            return true;
+    }
+    return false;
+}
+
+ArenaStats arena_get_stats(const Arena *arena)
+{
+    ArenaStats stats = {0, 0, 0};
+    if (arena)
+    {
+        stats.block_count = arena->block_count;
+        stats.reserved_bytes = arena->reserved_bytes;
+        stats.peak_bytes = arena->peak_bytes;
+    }
+    return stats;
+}
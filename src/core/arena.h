@@ -0,0 +1,60 @@
+#ifndef CORE_ARENA_H
+#define CORE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Bump allocator for memory that lives no longer than the file being
+    // processed. Allocation is a pointer increment; nothing is freed
+    // individually. Blocks are kept across resets so steady-state
+    // processing does not touch the system allocator. Not thread safe:
+    // each processing thread owns its own arena.
+    typedef struct Arena Arena;
+
+    // Position to rewind to, taken with arena_mark()
+    typedef struct
+    {
+        void *block;
+        size_t used;
+    } ArenaMark;
+
+    // Usage counters for tests and debug logs
+    typedef struct
+    {
+        size_t block_count;    // Blocks currently held
+        size_t reserved_bytes; // Bytes held across all blocks
+        size_t peak_bytes;     // Most bytes handed out between two resets
+    } ArenaStats;
+
+#define ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+    // block_size of 0 selects ARENA_DEFAULT_BLOCK_SIZE
+    Arena *arena_create(size_t block_size);
+    void arena_destroy(Arena *arena);
+
+    // Returns size bytes aligned for any type, or NULL when out of memory
+    void *arena_alloc(Arena *arena, size_t size);
+
+    // Forget every allocation. O(1) unless more than a few blocks piled up,
+    // in which case all but the first are returned to the system.
+    void arena_reset(Arena *arena);
+
+    // Free everything allocated after mark was taken
+    ArenaMark arena_mark(const Arena *arena);
+    void arena_rewind(Arena *arena, ArenaMark mark);
+
+    // True if ptr was handed out by this arena (since its last trim)
+    bool arena_owns(const Arena *arena, const void *ptr);
+
+    ArenaStats arena_get_stats(const Arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_ARENA_H */
@@ -0,0 +1,398 @@
+#include "compress.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+bool compress_available(OutputCompression kind)
+{
+#ifdef HAVE_ZLIB
+    return kind == OUTPUT_COMPRESS_GZIP;
+#else
+    return false;
+#endif
+}
+
+const char *compress_name(OutputCompression kind)
+{
+    switch (kind)
+    {
+    case OUTPUT_COMPRESS_NONE:
+        return "none";
+    case OUTPUT_COMPRESS_GZIP:
+        return "gzip";
+    }
+    return "unknown";
+}
+
+#ifdef HAVE_ZLIB
+
+typedef enum
+{
+    FRAME_FREE,   // Being filled by the caller, or unused
+    FRAME_QUEUED, // Waiting for a worker
+    FRAME_BUSY,   // Being compressed
+    FRAME_DONE,   // Member ready to be written
+    FRAME_FAILED  // The codec failed; the stream is lost
+} FrameState;
+
+typedef struct
+{
+    FrameState state;
+    char *input;
+    size_t input_size;
+    unsigned char *output;
+    size_t output_capacity;
+    size_t output_size;
+} CompressFrame;
+
+// Frames are numbered in stream order. Frame n lives in slot n % slot_count;
+// the caller fills frame `filled`, workers take frames from `taken` up to
+// `filled`, and the caller writes them out from `written` on.
+struct Compressor
+{
+    int level;
+    CompressWriteFn write;
+    void *opaque;
+    Metrics *metrics;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t work_cond; // A frame was queued, or the workers must stop
+    pthread_cond_t done_cond; // A worker finished a frame
+
+    CompressFrame *frames;
+    size_t slot_count;
+    size_t filled;
+    size_t taken;
+    size_t written;
+    bool stopping;
+
+    int error;    // Sticky errno of the first failure
+    bool emitted; // At least one member went out
+    size_t bytes_in;
+    size_t bytes_out;
+
+    pthread_t threads[COMPRESS_MAX_THREADS];
+    int thread_count;
+};
+
+static int compressor_fail(Compressor *compressor, int err)
+{
+    if (!compressor->error)
+        compressor->error = err ? err : EIO;
+    errno = compressor->error;
+    return -1;
+}
+
+// One frame into one complete gzip member
+static int compress_frame(z_stream *stream, CompressFrame *frame)
+{
+    if (deflateReset(stream) != Z_OK)
+        return -1;
+
+    size_t bound = deflateBound(stream, (uLong)frame->input_size);
+    if (frame->output_capacity < bound)
+    {
+        unsigned char *output = realloc(frame->output, bound);
+        if (!output)
+            return -1;
+        frame->output = output;
+        frame->output_capacity = bound;
+    }
+
+    stream->next_in = (Bytef *)frame->input;
+    stream->avail_in = (uInt)frame->input_size;
+    stream->next_out = frame->output;
+    stream->avail_out = (uInt)frame->output_capacity;
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END)
+        return -1;
+
+    frame->output_size = frame->output_capacity - stream->avail_out;
+    return 0;
+}
+
+static void *compress_worker(void *arg)
+{
+    Compressor *compressor = (Compressor *)arg;
+
+    // windowBits 15 + 16 asks for the gzip wrapper
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    bool ready = deflateInit2(&stream, compressor->level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+    pthread_mutex_lock(&compressor->mutex);
+    for (;;)
+    {
+        while (!compressor->stopping && compressor->taken == compressor->filled)
+            pthread_cond_wait(&compressor->work_cond, &compressor->mutex);
+        if (compressor->stopping)
+            break;
+
+        CompressFrame *frame = &compressor->frames[compressor->taken++ % compressor->slot_count];
+        frame->state = FRAME_BUSY;
+        pthread_mutex_unlock(&compressor->mutex);
+
+        uint64_t start = metrics_begin(compressor->metrics);
+        int result = ready ? compress_frame(&stream, frame) : -1;
+        metrics_end(compressor->metrics, METRICS_COMPRESS, start, frame->input_size);
+
+        pthread_mutex_lock(&compressor->mutex);
+        frame->state = result == 0 ? FRAME_DONE : FRAME_FAILED;
+        pthread_cond_broadcast(&compressor->done_cond);
+    }
+    pthread_mutex_unlock(&compressor->mutex);
+
+    if (ready)
+        deflateEnd(&stream);
+    return NULL;
+}
+
+Compressor *compressor_create(OutputCompression kind, int level, int threads, CompressWriteFn write,
+                              void *opaque, Metrics *metrics)
+{
+    if (!compress_available(kind) || !write)
+    {
+        errno = ENOTSUP;
+        return NULL;
+    }
+    if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (threads < 1)
+        threads = 1;
+    if (threads > COMPRESS_MAX_THREADS)
+        threads = COMPRESS_MAX_THREADS;
+
+    Compressor *compressor = calloc(1, sizeof(Compressor));
+    if (!compressor)
+        return NULL;
+
+    // One frame per worker, one being filled and one being written
+    compressor->slot_count = (size_t)threads + 2;
+    compressor->frames = calloc(compressor->slot_count, sizeof(CompressFrame));
+    if (!compressor->frames)
+    {
+        free(compressor);
+        return NULL;
+    }
+
+    compressor->level = level;
+    compressor->write = write;
+    compressor->opaque = opaque;
+    compressor->metrics = metrics;
+    pthread_mutex_init(&compressor->mutex, NULL);
+    pthread_cond_init(&compressor->work_cond, NULL);
+    pthread_cond_init(&compressor->done_cond, NULL);
+
+    for (int i = 0; i < threads; i++)
+    {
+        if (pthread_create(&compressor->threads[i], NULL, compress_worker, compressor) != 0)
+            break;
+        compressor->thread_count++;
+    }
+    if (compressor->thread_count == 0)
+    {
+        compressor_destroy(compressor);
+        errno = EAGAIN;
+        return NULL;
+    }
+
+    return compressor;
+}
+
+void compressor_destroy(Compressor *compressor)
+{
+    if (!compressor)
+        return;
+
+    pthread_mutex_lock(&compressor->mutex);
+    compressor->stopping = true;
+    pthread_cond_broadcast(&compressor->work_cond);
+    pthread_mutex_unlock(&compressor->mutex);
+    for (int i = 0; i < compressor->thread_count; i++)
+        pthread_join(compressor->threads[i], NULL);
+
+    for (size_t i = 0; i < compressor->slot_count; i++)
+    {
+        free(compressor->frames[i].input);
+        free(compressor->frames[i].output);
+    }
+    free(compressor->frames);
+    pthread_mutex_destroy(&compressor->mutex);
+    pthread_cond_destroy(&compressor->work_cond);
+    pthread_cond_destroy(&compressor->done_cond);
+    free(compressor);
+}
+
+// Write finished members in order. Waits for the oldest frame when all
+// is set, or when its slot is the one the caller needs to fill next.
+static int compressor_drain(Compressor *compressor, bool all)
+{
+    for (;;)
+    {
+        pthread_mutex_lock(&compressor->mutex);
+        if (compressor->written == compressor->filled)
+        {
+            pthread_mutex_unlock(&compressor->mutex);
+            return 0;
+        }
+
+        CompressFrame *frame = &compressor->frames[compressor->written % compressor->slot_count];
+        bool blocked = compressor->filled - compressor->written >= compressor->slot_count;
+        if (frame->state != FRAME_DONE && frame->state != FRAME_FAILED && !all && !blocked)
+        {
+            pthread_mutex_unlock(&compressor->mutex);
+            return 0;
+        }
+        while (frame->state != FRAME_DONE && frame->state != FRAME_FAILED)
+            pthread_cond_wait(&compressor->done_cond, &compressor->mutex);
+        FrameState state = frame->state;
+        pthread_mutex_unlock(&compressor->mutex);
+
+        if (state == FRAME_FAILED)
+            return compressor_fail(compressor, ENOMEM);
+        if (compressor->write(compressor->opaque, frame->output, frame->output_size) != 0)
+            return compressor_fail(compressor, errno);
+        compressor->bytes_out += frame->output_size;
+        compressor->emitted = true;
+
+        pthread_mutex_lock(&compressor->mutex);
+        frame->state = FRAME_FREE;
+        frame->input_size = 0;
+        compressor->written++;
+        pthread_mutex_unlock(&compressor->mutex);
+    }
+}
+
+// Hand the frame being filled to the workers
+static int compressor_submit(Compressor *compressor)
+{
+    pthread_mutex_lock(&compressor->mutex);
+    compressor->frames[compressor->filled % compressor->slot_count].state = FRAME_QUEUED;
+    compressor->filled++;
+    pthread_cond_signal(&compressor->work_cond);
+    pthread_mutex_unlock(&compressor->mutex);
+
+    return compressor_drain(compressor, false);
+}
+
+int compressor_write(Compressor *compressor, const void *data, size_t size)
+{
+    if (!compressor || (!data && size))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const char *bytes = (const char *)data;
+    while (size > 0)
+    {
+        if (compressor->error)
+            return compressor_fail(compressor, compressor->error);
+
+        // Only the caller touches a free slot, so no lock is needed here
+        CompressFrame *frame = &compressor->frames[compressor->filled % compressor->slot_count];
+        if (!frame->input)
+        {
+            frame->input = malloc(COMPRESS_FRAME_SIZE);
+            if (!frame->input)
+                return compressor_fail(compressor, ENOMEM);
+        }
+
+        size_t room = COMPRESS_FRAME_SIZE - frame->input_size;
+        size_t n = size < room ? size : room;
+        memcpy(frame->input + frame->input_size, bytes, n);
+        frame->input_size += n;
+        compressor->bytes_in += n;
+        bytes += n;
+        size -= n;
+
+        if (frame->input_size == COMPRESS_FRAME_SIZE && compressor_submit(compressor) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int compressor_flush(Compressor *compressor)
+{
+    if (!compressor)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (compressor->error)
+        return compressor_fail(compressor, compressor->error);
+
+    CompressFrame *frame = &compressor->frames[compressor->filled % compressor->slot_count];
+    bool nothing_yet = !compressor->emitted && compressor->filled == compressor->written;
+    if ((frame->input_size > 0 || nothing_yet) && compressor_submit(compressor) != 0)
+        return -1;
+
+    return compressor_drain(compressor, true);
+}
+
+size_t compressor_bytes_in(const Compressor *compressor)
+{
+    return compressor ? compressor->bytes_in : 0;
+}
+
+size_t compressor_bytes_out(const Compressor *compressor)
+{
+    return compressor ? compressor->bytes_out : 0;
+}
+
+#else
+
+Compressor *compressor_create(OutputCompression kind, int level, int threads, CompressWriteFn write,
+                              void *opaque, Metrics *metrics)
+{
+    (void)kind;
+    (void)level;
+    (void)threads;
+    (void)write;
+    (void)opaque;
+    (void)metrics;
+    errno = ENOTSUP;
+    return NULL;
+}
+
+void compressor_destroy(Compressor *compressor)
+{
+    (void)compressor;
+}
+
+int compressor_write(Compressor *compressor, const void *data, size_t size)
+{
+    (void)compressor;
+    (void)data;
+    (void)size;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int compressor_flush(Compressor *compressor)
+{
+    (void)compressor;
+    errno = ENOTSUP;
+    return -1;
+}
+
+size_t compressor_bytes_in(const Compressor *compressor)
+{
+    (void)compressor;
+    return 0;
+}
+
+size_t compressor_bytes_out(const Compressor *compressor)
+{
+    (void)compressor;
+    return 0;
+}
+
+#endif /* HAVE_ZLIB */
@@ -0,0 +1,56 @@
+#ifndef CORE_COMPRESS_H
+#define CORE_COMPRESS_H
+
+#include "metrics.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Parallel compression stage behind --compress. The stream is cut
+    // into frames of COMPRESS_FRAME_SIZE that worker threads compress
+    // independently while the caller keeps writing, each into a complete
+    // gzip member. Members leave in stream order through the write
+    // callback, on the calling thread only. Concatenated members form one
+    // valid gzip file (RFC 1952, section 2.2), so gzip -d and zcat read it
+    // back in a single pass.
+    typedef struct Compressor Compressor;
+
+#define COMPRESS_FRAME_SIZE (1024 * 1024)
+    // Upper bound for the worker threads of one compressor
+#define COMPRESS_MAX_THREADS 64
+
+    // Receives each compressed member in order; returns 0, or -1 with errno set
+    typedef int (*CompressWriteFn)(void *opaque, const void *data, size_t size);
+
+    // Whether this build can produce kind
+    bool compress_available(OutputCompression kind);
+    const char *compress_name(OutputCompression kind);
+
+    // level -1 selects the codec default. metrics, when set, times the
+    // workers under METRICS_COMPRESS.
+    Compressor *compressor_create(OutputCompression kind, int level, int threads, CompressWriteFn write,
+                                  void *opaque, Metrics *metrics);
+    // Discards anything not yet flushed
+    void compressor_destroy(Compressor *compressor);
+
+    // Both return 0, or -1 with errno set. A failure is sticky.
+    int compressor_write(Compressor *compressor, const void *data, size_t size);
+    // Compress the partial frame and hand every member to the callback.
+    // A stream that has produced nothing yet gets an empty member, so the
+    // output is always a readable gzip file.
+    int compressor_flush(Compressor *compressor);
+
+    // Uncompressed and compressed bytes so far
+    size_t compressor_bytes_in(const Compressor *compressor);
+    size_t compressor_bytes_out(const Compressor *compressor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_COMPRESS_H */
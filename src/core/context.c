@@ -1,59 +1,50 @@
 #include "context.h"
+#include "arena.h"
+#include "dedup.h"
+#include "inode_set.h"
+#include "log_ring.h"
+#include "metrics.h"
+#include "tree.h"
+#include "pipeline.h"
+#include "progress.h"
 #include "version.h"
+#include "zerocopy.h"
 #include "../plugins/plugin.h"
 #include "../filter/filter.h"
+#include "../filter/filter_ignore.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
 
-// Maximum depth for symlink cycle detection
-#define MAX_VISITED_DIRS 256
-
-// Visited directory tracking for circular symlink detection
-typedef struct {
-    dev_t dev;
-    ino_t ino;
-} VisitedInode;
-
+// Inodes the walk has reached: the directories on the open path, for
+// cycle detection, and with --unique-inodes everything it has emitted
 typedef struct {
-    VisitedInode inodes[MAX_VISITED_DIRS];
-    int count;
+    InodeSet *ancestors;
+    InodeSet *seen; // NULL unless --unique-inodes
 } VisitedSet;
 
-// Check if an inode has been visited (returns 1 if already visited)
-static int visited_set_contains(VisitedSet *set, dev_t dev, ino_t ino)
+static void visited_set_destroy(VisitedSet *set)
 {
-    if (!set) return 0;
-    for (int i = 0; i < set->count; i++) {
-        if (set->inodes[i].dev == dev && set->inodes[i].ino == ino) {
-            return 1;
-        }
-    }
-    return 0;
+    inode_set_destroy(set->ancestors);
+    inode_set_destroy(set->seen);
 }
 
-// Add an inode to the visited set (returns 0 on success, -1 if full)
-static int visited_set_add(VisitedSet *set, dev_t dev, ino_t ino)
+static int visited_set_init(VisitedSet *set, const ResolvedConfig *config)
 {
-    if (!set || set->count >= MAX_VISITED_DIRS) return -1;
-    set->inodes[set->count].dev = dev;
-    set->inodes[set->count].ino = ino;
-    set->count++;
-    return 0;
-}
-
-// Remove the last inode from the visited set (for backtracking)
-static void visited_set_pop(VisitedSet *set)
-{
-    if (set && set->count > 0) {
-        set->count--;
+    set->ancestors = inode_set_create();
+    set->seen = config && config->unique_inodes ? inode_set_create() : NULL;
+    if (!set->ancestors || (config && config->unique_inodes && !set->seen)) {
+        visited_set_destroy(set);
+        return -1;
     }
+    return 0;
 }
 
 // ============================================================================
@@ -63,18 +54,25 @@ static void visited_set_pop(VisitedSet *set)
 #define DIR_STACK_INITIAL_CAPACITY 256
 
 typedef struct {
-    char path[MAX_PATH];           // Full path to directory
-    char relative_path[MAX_PATH];  // Relative path from base
     DIR *dir;                      // Open directory handle
+    size_t path_len;               // Length of the directory's path in DirStack.path
     int level;                     // Current depth level
-    ino_t inode;                   // For visited set cleanup on pop
-    dev_t dev;                     // Device ID for visited set
+    ino_t inode;                   // Removed from the ancestor set on pop
+    dev_t dev;                     // Device ID for the ancestor set
+    IgnoreLayer *ignore;           // Rules of the directory's own ignore files
+    const IgnoreLayer *ignore_scope; // Rules in scope for its entries
 } DirStackEntry;
 
+// Every open directory's path is a prefix of the one above it, so the
+// walk keeps a single path buffer: an entry's name is appended at its
+// directory's path_len, and the relative path is the tail of the buffer
+// from rel_start on.
 typedef struct {
     DirStackEntry *entries;
     int size;
     int capacity;
+    char path[MAX_PATH];
+    size_t rel_start;
 } DirStack;
 
 static DirStack *dir_stack_create(void)
@@ -100,23 +98,24 @@ static void dir_stack_destroy(DirStack *stack)
         if (stack->entries[i].dir) {
             closedir(stack->entries[i].dir);
         }
+        ignore_layer_destroy(stack->entries[i].ignore);
     }
     free(stack->entries);
     free(stack);
 }
 
-static int dir_stack_push(DirStack *stack, const char *path, const char *rel_path, 
-                          DIR *dir, int level, dev_t dev, ino_t inode)
+static int dir_stack_push(DirStack *stack, size_t path_len, DIR *dir, int level, dev_t dev, ino_t inode)
 {
     if (!stack || stack->size >= stack->capacity) return -1;
     
     DirStackEntry *entry = &stack->entries[stack->size];
-    snprintf(entry->path, MAX_PATH, "%s", path);
-    snprintf(entry->relative_path, MAX_PATH, "%s", rel_path);
+    entry->path_len = path_len;
     entry->dir = dir;
     entry->level = level;
     entry->dev = dev;
     entry->inode = inode;
+    entry->ignore = NULL;
+    entry->ignore_scope = NULL;
     stack->size++;
     return 0;
 }
@@ -157,38 +156,128 @@ static int build_full_path(char *full_path, size_t max_len, const char *base_pat
     }
 }
 
-// Helper function to build relative path
-static int build_relative_path(char *rel_path, size_t max_len, const char *current_rel, const char *name)
+// Examine one entry of a walked directory
+int context_stat_entry(FconcatContext *ctx, int dir_fd, const char *name, const char *full_path,
+                       const char *relative_path, FileInfo *info)
 {
-    if (!rel_path || !current_rel || !name)
+    if (context_stat_entry_quiet(ctx, dir_fd, name, full_path, relative_path, info) != 0) {
+        if (errno == EACCES) {
+            ctx->warning(ctx, "Permission denied accessing: %s", full_path);
+        } else if (errno == ENOENT) {
+            ctx->warning(ctx, "File disappeared during processing: %s", full_path);
+        } else {
+            ctx->warning(ctx, "Cannot stat: %s - %s", full_path, strerror(errno));
+        }
         return -1;
-
-    if (strlen(current_rel) == 0)
-    {
-        int ret = snprintf(rel_path, max_len, "%s", name);
-        return (ret < 0 || ret >= (int)max_len) ? -1 : 0;
     }
-    else
-    {
-        int ret = snprintf(rel_path, max_len, "%s/%s", current_rel, name);
-        return (ret < 0 || ret >= (int)max_len) ? -1 : 0;
+    return 0;
+}
+
+int context_stat_entry_quiet(FconcatContext *ctx, int dir_fd, const char *name, const char *full_path,
+                             const char *relative_path, FileInfo *info)
+{
+    Metrics *metrics = context_metrics(ctx);
+    struct stat st;
+    uint64_t start = metrics_begin(metrics);
+    int stat_result = fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW);
+    metrics_end(metrics, METRICS_STAT, start, 0);
+    if (stat_result != 0)
+        return -1;
+
+    // Create FileInfo structure
+    FileInfo file_info = {0};
+    file_info.path = (char *)relative_path;
+    file_info.size = st.st_size;
+    file_info.modified_time = st.st_mtime;
+    file_info.is_directory = S_ISDIR(st.st_mode);
+    file_info.is_symlink = S_ISLNK(st.st_mode);
+    file_info.is_binary = false;
+    file_info.permissions = st.st_mode;
+    file_info.device = (uint64_t)st.st_dev;
+    file_info.inode = (uint64_t)st.st_ino;
+    file_info.modified_nsec = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    file_info.changed_nsec = (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+
+    // Followed symlinks take on their target, resolved from the same
+    // directory fd without building its path
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    if (file_info.is_symlink && config->symlink_handling == SYMLINK_FOLLOW) {
+        struct stat resolved_st;
+        start = metrics_begin(metrics);
+        stat_result = fstatat(dir_fd, name, &resolved_st, 0);
+        metrics_end(metrics, METRICS_STAT, start, 0);
+        if (stat_result == 0) {
+            file_info.is_directory = S_ISDIR(resolved_st.st_mode);
+            file_info.size = resolved_st.st_size;
+            file_info.device = (uint64_t)resolved_st.st_dev;
+            file_info.inode = (uint64_t)resolved_st.st_ino;
+            file_info.modified_nsec = (int64_t)resolved_st.st_mtim.tv_sec * 1000000000 +
+                                      resolved_st.st_mtim.tv_nsec;
+            file_info.changed_nsec = (int64_t)resolved_st.st_ctim.tv_sec * 1000000000 +
+                                     resolved_st.st_ctim.tv_nsec;
+        } else {
+            ctx->warning(ctx, "Cannot resolve symlink: %s - %s", full_path, strerror(errno));
+        }
     }
+
+    *info = file_info;
+    return 0;
 }
 
-// FIXED: Enhanced symlink resolution with proper error handling
-static char *resolve_symlink_safely(FconcatContext *ctx, const char *path, SymlinkHandling handling)
+int context_filter_entry_type(FconcatContext *ctx, const char *relative_path, unsigned char d_type)
 {
-    if (!path || handling != SYMLINK_FOLLOW)
-        return NULL;
+    if (d_type != DT_REG && d_type != DT_DIR && d_type != DT_LNK)
+        return -1;
 
-    char *resolved = realpath(path, NULL);
-    if (!resolved)
-    {
-        ctx->warning(ctx, "Cannot resolve symlink: %s - %s", path, strerror(errno));
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    if (d_type == DT_LNK && config->symlink_handling == SYMLINK_FOLLOW)
+        return -1;
+
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (filter_engine_path_needs_stat(internal->filter_engine))
+        return -1;
+
+    FileInfo probe = {0};
+    probe.path = (char *)relative_path;
+    probe.is_directory = d_type == DT_DIR;
+    probe.is_symlink = d_type == DT_LNK;
+    return filter_engine_should_include_path(internal->filter_engine, ctx, relative_path, &probe) ? 1 : 0;
+}
+
+const IgnoreLayer *context_enter_ignore_scope(FconcatContext *ctx, int dir_fd, const char *full_path,
+                                              const char *relative_path, size_t relative_len,
+                                              const IgnoreLayer *parent, IgnoreLayer **owned)
+{
+    *owned = NULL;
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    if (!config->gitignore)
         return NULL;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    int loaded = ignore_layer_load(dir_fd, relative_path, relative_len, parent, owned);
+    metrics_end(metrics, METRICS_PATH_FILTER, start, 0);
+    if (loaded != 0) {
+        ctx->warning(ctx, "Cannot read ignore files in: %s - %s", full_path, strerror(errno));
+        return parent;
     }
+    return *owned ? *owned : parent;
+}
 
-    return resolved;
+// Open a subdirectory relative to its parent's fd
+static DIR *open_subdirectory(int dir_fd, const char *name)
+{
+    int fd = openat(dir_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    DIR *dir = fdopendir(fd);
+    if (!dir) {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+    }
+    return dir;
 }
 
 // Internal traverse function with ITERATIVE stack-based traversal
@@ -207,24 +296,32 @@ static int traverse_directory_internal(FconcatContext *ctx, const char *base_pat
     }
 
     int result = 0;
-    char initial_full_path[MAX_PATH];
+    char *initial_full_path = stack->path;
+    Metrics *metrics = context_metrics(ctx);
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
     
-    if (build_full_path(initial_full_path, sizeof(initial_full_path), base_path, relative_path) != 0) {
+    if (build_full_path(initial_full_path, sizeof(stack->path), base_path, relative_path) != 0) {
         ctx->error(ctx, "Path too long: %s/%s", base_path, relative_path);
         dir_stack_destroy(stack);
         return -1;
     }
+    stack->rel_start = strlen(base_path) + 1;
 
     // Get initial directory inode
     struct stat initial_st;
-    if (stat(initial_full_path, &initial_st) != 0) {
+    uint64_t start = metrics_begin(metrics);
+    int stat_result = stat(initial_full_path, &initial_st);
+    metrics_end(metrics, METRICS_STAT, start, 0);
+    if (stat_result != 0) {
         ctx->warning(ctx, "Cannot stat directory: %s - %s", initial_full_path, strerror(errno));
         dir_stack_destroy(stack);
         return 0;
     }
 
     // Open initial directory
+    start = metrics_begin(metrics);
     DIR *initial_dir = opendir(initial_full_path);
+    metrics_end(metrics, METRICS_READDIR, start, 0);
     if (!initial_dir) {
         if (errno == EACCES) {
             ctx->warning(ctx, "Permission denied accessing directory: %s", initial_full_path);
@@ -236,26 +333,42 @@ static int traverse_directory_internal(FconcatContext *ctx, const char *base_pat
     }
 
     // Add initial directory to visited set
-    visited_set_add(visited, initial_st.st_dev, initial_st.st_ino);
+    if (inode_set_insert(visited->ancestors, initial_st.st_dev, initial_st.st_ino) < 0 ||
+        (visited->seen && inode_set_insert(visited->seen, initial_st.st_dev, initial_st.st_ino) < 0)) {
+        ctx->error(ctx, "Failed to allocate directory stack");
+        closedir(initial_dir);
+        dir_stack_destroy(stack);
+        return -1;
+    }
 
     // Push initial directory onto stack
-    if (dir_stack_push(stack, initial_full_path, relative_path, initial_dir, level, 
+    size_t initial_len = strlen(initial_full_path);
+    if (dir_stack_push(stack, initial_len, initial_dir, level, 
                        initial_st.st_dev, initial_st.st_ino) != 0) {
         closedir(initial_dir);
         dir_stack_destroy(stack);
         return -1;
     }
+    DirStackEntry *root = dir_stack_peek(stack);
+    root->ignore_scope = context_enter_ignore_scope(ctx, dirfd(initial_dir), initial_full_path,
+                                                    relative_path, strlen(relative_path), NULL, &root->ignore);
 
     // Iterative traversal loop
     while (!dir_stack_is_empty(stack)) {
         DirStackEntry *current = dir_stack_peek(stack);
+        start = metrics_begin(metrics);
         struct dirent *entry = readdir(current->dir);
+        metrics_end(metrics, METRICS_READDIR, start, 0);
 
         if (!entry) {
             // Directory exhausted - pop and continue
+            start = metrics_begin(metrics);
             closedir(current->dir);
+            metrics_end(metrics, METRICS_READDIR, start, 0);
             current->dir = NULL;
-            visited_set_pop(visited);
+            ignore_layer_destroy(current->ignore);
+            current->ignore = NULL;
+            inode_set_remove(visited->ancestors, current->dev, current->inode);
             dir_stack_pop(stack);
             continue;
         }
@@ -271,69 +384,70 @@ static int traverse_directory_internal(FconcatContext *ctx, const char *base_pat
             continue;
         }
 
-        char entry_full_path[MAX_PATH];
-        char entry_rel_path[MAX_PATH];
-
-        if (build_full_path(entry_full_path, sizeof(entry_full_path), current->path, entry->d_name) != 0) {
+        // Append the name to the directory's path; the relative path is
+        // shorter and fits whenever the full one does
+        size_t name_len = strlen(entry->d_name);
+        if (current->path_len + 1 + name_len >= sizeof(stack->path)) {
             ctx->warning(ctx, "Path too long, skipping: %s", entry->d_name);
             continue;
         }
-
-        if (build_relative_path(entry_rel_path, sizeof(entry_rel_path), current->relative_path, entry->d_name) != 0) {
-            ctx->warning(ctx, "Relative path too long, skipping: %s", entry->d_name);
+        stack->path[current->path_len] = '/';
+        memcpy(stack->path + current->path_len + 1, entry->d_name, name_len + 1);
+        const char *entry_full_path = stack->path;
+        char *entry_rel_path = stack->path + stack->rel_start;
+
+        // Ignored entries, and directories above all, go before any stat
+        const IgnoreLayer *scope = current->ignore_scope;
+        int ignore_directory = scope ? ignore_entry_is_directory(entry->d_type) : 0;
+        if (scope && ignore_directory >= 0 && ignore_layer_match(scope, entry_rel_path, ignore_directory)) {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Ignoring path: %s", entry_rel_path);
             continue;
         }
 
-        struct stat st;
-        if (lstat(entry_full_path, &st) != 0) {
-            if (errno == EACCES) {
-                ctx->warning(ctx, "Permission denied accessing: %s", entry_full_path);
-            } else if (errno == ENOENT) {
-                ctx->warning(ctx, "File disappeared during processing: %s", entry_full_path);
-            } else {
-                ctx->warning(ctx, "Cannot stat: %s - %s", entry_full_path, strerror(errno));
-            }
+        // Entries the path rules reject by name and type are never stat'd
+        int type_verdict = context_filter_entry_type(ctx, entry_rel_path, entry->d_type);
+        if (type_verdict == 0) {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", entry_rel_path);
             continue;
         }
 
-        // Create FileInfo structure
-        FileInfo file_info = {0};
-        file_info.path = entry_rel_path;
-        file_info.size = st.st_size;
-        file_info.modified_time = st.st_mtime;
-        file_info.is_directory = S_ISDIR(st.st_mode);
-        file_info.is_symlink = S_ISLNK(st.st_mode);
-        file_info.is_binary = false;
-        file_info.permissions = st.st_mode;
-
-        // Handle symlinks
-        char *resolved_path = NULL;
-        if (file_info.is_symlink) {
-            const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
-            if (config->symlink_handling == SYMLINK_FOLLOW) {
-                resolved_path = resolve_symlink_safely(ctx, entry_full_path, config->symlink_handling);
-                if (resolved_path) {
-                    struct stat resolved_st;
-                    if (stat(resolved_path, &resolved_st) == 0) {
-                        file_info.is_directory = S_ISDIR(resolved_st.st_mode);
-                        file_info.size = resolved_st.st_size;
-                    } else {
-                        ctx->warning(ctx, "Cannot stat symlink target: %s", resolved_path);
-                        free(resolved_path);
-                        resolved_path = NULL;
-                    }
-                }
-            }
+        int dir_fd = dirfd(current->dir);
+        FileInfo file_info;
+        if (context_stat_entry(ctx, dir_fd, entry->d_name, entry_full_path, entry_rel_path, &file_info) != 0)
+            continue;
+        if (scope && ignore_directory < 0 &&
+            ignore_layer_match(scope, entry_rel_path, file_info.is_directory && !file_info.is_symlink)) {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Ignoring path: %s", entry_rel_path);
+            continue;
         }
 
         // Check filters
-        InternalContextState *internal = (InternalContextState *)ctx->internal_state;
-        if (!filter_engine_should_include_path(internal->filter_engine, ctx, entry_rel_path, &file_info)) {
-            ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", entry_rel_path);
-            if (resolved_path) free(resolved_path);
+        if (type_verdict < 0 &&
+            !filter_engine_should_include_path(internal->filter_engine, ctx, entry_rel_path, &file_info)) {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", entry_rel_path);
             continue;
         }
 
+        // With --unique-inodes a hardlink, or a directory reached again
+        // through a symlink, only counts the first time
+        if (visited->seen) {
+            int added = inode_set_insert(visited->seen, file_info.device, file_info.inode);
+            if (added < 0) {
+                ctx->error(ctx, "Out of memory while walking: %s", entry_full_path);
+                result = -1;
+                break;
+            }
+            if (added == 0) {
+                if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                    ctx->log(ctx, LOG_DEBUG, "Already reached through another path: %s", entry_rel_path);
+                continue;
+            }
+        }
+
         // Update context
         ctx->current_file_path = entry_rel_path;
         ctx->current_file_info = &file_info;
@@ -341,10 +455,8 @@ static int traverse_directory_internal(FconcatContext *ctx, const char *base_pat
 
         EntryType entry_type = file_info.is_directory ? ENTRY_TYPE_DIRECTORY : ENTRY_TYPE_FILE;
 
-        // Check binary
-        if (entry_type == ENTRY_TYPE_FILE && !file_info.is_symlink) {
-            file_info.is_binary = (filter_is_binary_file(entry_full_path) == 1);
-        }
+        // Binary classification is deferred to the first read of the file
+        // (see pipeline_classify_file), so the walk never opens files
 
         // Callback
         int callback_result = callback->handle_entry(ctx, entry_rel_path, entry_type, &file_info, 
@@ -353,50 +465,54 @@ static int traverse_directory_internal(FconcatContext *ctx, const char *base_pat
 
         if (callback_result != 0) {
             result = callback_result;
-            if (resolved_path) free(resolved_path);
             break;
         }
 
-        // Handle subdirectories - push onto stack instead of recursing
+        // Handle subdirectories - push onto stack instead of recursing.
+        // file_info already carries the directory's (or followed target's)
+        // device and inode, so it takes no further stat.
         if (entry_type == ENTRY_TYPE_DIRECTORY) {
-            const char *subdir_path = resolved_path ? resolved_path : entry_full_path;
-            
-            struct stat subdir_st;
-            if (stat(subdir_path, &subdir_st) != 0) {
-                ctx->warning(ctx, "Cannot stat subdirectory: %s", subdir_path);
-                if (resolved_path) free(resolved_path);
-                continue;
-            }
+            dev_t subdir_dev = (dev_t)file_info.device;
+            ino_t subdir_ino = (ino_t)file_info.inode;
 
             // Check for cycles
-            if (visited_set_contains(visited, subdir_st.st_dev, subdir_st.st_ino)) {
-                ctx->warning(ctx, "Circular symlink detected, skipping: %s", subdir_path);
-                if (resolved_path) free(resolved_path);
+            if (inode_set_contains(visited->ancestors, subdir_dev, subdir_ino)) {
+                ctx->warning(ctx, "Circular symlink detected, skipping: %s", entry_full_path);
                 continue;
             }
 
-            DIR *subdir = opendir(subdir_path);
+            start = metrics_begin(metrics);
+            DIR *subdir = open_subdirectory(dir_fd, entry->d_name);
+            metrics_end(metrics, METRICS_READDIR, start, 0);
             if (!subdir) {
                 if (errno == EACCES) {
-                    ctx->warning(ctx, "Permission denied accessing directory: %s", subdir_path);
+                    ctx->warning(ctx, "Permission denied accessing directory: %s", entry_full_path);
                 } else {
-                    ctx->warning(ctx, "Cannot open directory: %s - %s", subdir_path, strerror(errno));
+                    ctx->warning(ctx, "Cannot open directory: %s - %s", entry_full_path, strerror(errno));
                 }
-                if (resolved_path) free(resolved_path);
                 continue;
             }
 
-            visited_set_add(visited, subdir_st.st_dev, subdir_st.st_ino);
+            if (inode_set_insert(visited->ancestors, subdir_dev, subdir_ino) < 0) {
+                closedir(subdir);
+                ctx->error(ctx, "Failed to allocate directory stack");
+                result = -1;
+                break;
+            }
 
-            if (dir_stack_push(stack, subdir_path, entry_rel_path, subdir, current->level + 1,
-                               subdir_st.st_dev, subdir_st.st_ino) != 0) {
+            if (dir_stack_push(stack, current->path_len + 1 + name_len, subdir, current->level + 1,
+                               subdir_dev, subdir_ino) != 0) {
                 closedir(subdir);
-                visited_set_pop(visited);
-                ctx->warning(ctx, "Directory stack full, skipping: %s", subdir_path);
+                inode_set_remove(visited->ancestors, subdir_dev, subdir_ino);
+                ctx->warning(ctx, "Directory stack full, skipping: %s", entry_full_path);
+                continue;
             }
-        }
 
-        if (resolved_path) free(resolved_path);
+            // current may have moved with the push; scope is still the parent's
+            DirStackEntry *pushed = dir_stack_peek(stack);
+            pushed->ignore_scope = context_enter_ignore_scope(ctx, dirfd(subdir), entry_full_path, entry_rel_path,
+                                                              strlen(entry_rel_path), scope, &pushed->ignore);
+        }
     }
 
     dir_stack_destroy(stack);
@@ -408,7 +524,14 @@ int traverse_directory(FconcatContext *ctx, const char *base_path, const char *r
                        int level, DirectoryCallback *callback)
 {
     VisitedSet visited = {0};
-    return traverse_directory_internal(ctx, base_path, relative_path, level, callback, &visited);
+    if (!ctx || visited_set_init(&visited, (const ResolvedConfig *)ctx->config) != 0) {
+        if (ctx)
+            ctx->error(ctx, "Failed to allocate directory stack");
+        return -1;
+    }
+    int result = traverse_directory_internal(ctx, base_path, relative_path, level, callback, &visited);
+    visited_set_destroy(&visited);
+    return result;
 }
 
 // Structure processing callback
@@ -432,6 +555,11 @@ static int structure_callback(FconcatContext *ctx, const char *path, EntryType t
         // Write file entry
         if (internal->format_engine)
         {
+            // Built-in formatters ignore is_binary, so only third-party
+            // formatters pay for classifying files during this pass
+            if (!info->binary_checked && !format_engine_active_is_builtin(internal->format_engine))
+                pipeline_classify_file(ctx, path, info);
+
             return format_engine_write_file_entry(internal->format_engine, ctx, path, info);
         }
     }
@@ -439,7 +567,7 @@ static int structure_callback(FconcatContext *ctx, const char *path, EntryType t
     return 0;
 }
 
-// Content processing callback - FIXED: Removed unused parameters
+// Content processing callback - the per-file work lives in pipeline.c
 static int content_callback(FconcatContext *ctx, const char *path, EntryType type,
                             FileInfo *info, int level, void *user_data)
 {
@@ -451,181 +579,127 @@ static int content_callback(FconcatContext *ctx, const char *path, EntryType typ
         return 0; // Skip directories in content processing
     }
 
-    // Get internal state to access engines
-    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
-
-    // Process file content
-    ctx->log(ctx, LOG_DEBUG, "Processing file: %s", path);
+    return pipeline_process_file(ctx, path, info, NULL);
+}
 
-    // Update file count in stats
-    ProcessingStats *stats = (ProcessingStats *)ctx->stats;
-    if (stats)
-    {
-        stats->processed_files++;
-        stats->total_files++;
-    }
+int process_directory_structure(FconcatContext *ctx, const char *base_path, const char *relative_path, int level)
+{
+    DirectoryCallback callback = {
+        .handle_entry = structure_callback,
+        .user_data = NULL};
 
-    // Write file header
-    if (internal->format_engine)
-    {
-        int result = format_engine_write_file_header(internal->format_engine, ctx, path);
-        if (result != 0)
-            return result;
-    }
+    return traverse_directory(ctx, base_path, relative_path, level, &callback);
+}
 
-    // Build full path for file access
-    char full_path[MAX_PATH];
-    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
-    if (build_full_path(full_path, sizeof(full_path), config->input_directory, path) != 0)
-    {
-        ctx->error(ctx, "Path too long: %s", path);
-        return -1;
-    }
+int process_directory_content(FconcatContext *ctx, const char *base_path, const char *relative_path, int level)
+{
+    DirectoryCallback callback = {
+        .handle_entry = content_callback,
+        .user_data = NULL};
 
-    // SAFETY: Check file size limit to prevent resource exhaustion
-    if (info->size > MAX_FILE_SIZE)
-    {
-        ctx->warning(ctx, "File too large, skipping (limit %lluMB): %s (%zu bytes)",
-                     (unsigned long long)(MAX_FILE_SIZE / (1024 * 1024)), path, info->size);
-        if (stats)
-        {
-            stats->skipped_files++;
-        }
-        return 0; // Continue with other files
-    }
+    return traverse_directory(ctx, base_path, relative_path, level, &callback);
+}
 
-    // FIXED: Graceful file opening with permission handling
-    FILE *file = fopen(full_path, "rb");
-    if (!file)
-    {
-        if (errno == EACCES)
-        {
-            ctx->warning(ctx, "Permission denied opening file: %s", full_path);
-        }
-        else if (errno == ENOENT)
-        {
-            ctx->warning(ctx, "File disappeared during processing: %s", full_path);
-        }
-        else
-        {
-            ctx->warning(ctx, "Cannot open file: %s - %s", full_path, strerror(errno));
-        }
-        return 0; // Continue processing other files
-    }
+int process_tree_structure(FconcatContext *ctx, FileTree *tree)
+{
+    DirectoryCallback callback = {
+        .handle_entry = structure_callback,
+        .user_data = NULL};
 
-    // Determine optimal buffer size based on file size
-    size_t buffer_size;
-    if (info->size > 0 && info->size < 4096)
-    {
-        // Small file - use file size as buffer size
-        buffer_size = info->size;
-    }
-    else if (info->size < 16384)
-    {
-        // Medium file - use 4KB buffer
-        buffer_size = 4096;
-    }
-    else
-    {
-        // Large file - use 16KB buffer
-        buffer_size = 16384;
-    }
+    return file_tree_replay(ctx, tree, &callback);
+}
 
-    // Get buffer from pool
-    char *buffer = memory_get_buffer(internal->memory_manager, buffer_size);
-    if (!buffer)
-    {
-        ctx->error(ctx, "Failed to allocate buffer for file: %s", full_path);
-        fclose(file);
+int process_tree_content(FconcatContext *ctx, FileTree *tree)
+{
+    if (!ctx || !tree)
         return -1;
-    }
 
-    // Read file content in chunks
-    size_t bytes_read;
-    bool content_excluded = false;
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    int jobs = config ? pipeline_resolve_jobs(config->jobs) : 1;
 
-    while ((bytes_read = fread(buffer, 1, buffer_size, file)) > 0)
-    {
-        // Check if content should be included
-        if (!filter_engine_should_include_content(internal->filter_engine, ctx, path, buffer, bytes_read))
-        {
-            ctx->log(ctx, LOG_DEBUG, "Excluding content for: %s", path);
-            // Still count as processed but mark as skipped
-            if (stats)
-            {
-                stats->skipped_files++;
-                stats->processed_files--; // Subtract from processed count
-            }
-            content_excluded = true;
-            break;
-        }
+    return pipeline_run_content(ctx, tree, jobs);
+}
+
+// Everything that belongs to one run over one output: counters, the sink
+// and the dedup index. The output is output_file, or write when it is set.
+static int context_open_run_state(InternalContextState *internal_state, FILE *output_file,
+                                  OutputSinkWriteFn write, void *write_opaque)
+{
+    const ResolvedConfig *config = internal_state->config;
+    internal_state->output_file = output_file;
 
-        // Transform content through filter engine
-        char *transformed_data = NULL;
-        size_t transformed_size = 0;
+    // A run without counters is only slower to diagnose
+    if (config && config->stats_report != STATS_REPORT_NONE)
+        internal_state->metrics = metrics_create();
 
-        if (filter_engine_transform_content(internal->filter_engine, ctx, path,
-                                            buffer, bytes_read, &transformed_data, &transformed_size) == 0)
+    // Formatters write many small tokens; they are gathered in the sink and
+    // the stdio stream is left unused from here on
+    if (write || (output_file && fflush(output_file) == 0))
+    {
+        OutputSinkOptions options = {0};
+        options.direct_io = config && config->direct_io;
+        options.drop_cache = config && config->drop_cache;
+        options.metrics = internal_state->metrics;
+        if (config && config->compression != OUTPUT_COMPRESS_NONE)
         {
-            // Use transformed data
-            if (internal->format_engine)
-            {
-                format_engine_write_file_chunk(internal->format_engine, ctx, transformed_data, transformed_size);
-            }
-            if (stats)
-            {
-                stats->filtered_bytes += transformed_size;
-            }
-
-            // Release transformed data buffer back to pool
-            memory_release_buffer(internal->memory_manager, transformed_data);
+            // Compression keeps up with the producer only on every core
+            options.compression = config->compression;
+            options.compress_level = config->compress_level;
+            options.compress_threads = pipeline_resolve_jobs(0);
         }
-        else
+        internal_state->output_sink = write ? output_sink_create_writer(write, write_opaque, &options)
+                                            : output_sink_create(fileno(output_file), &options);
+
+        // Falling back to stdio would silently write the stream uncompressed,
+        // and a writer has no stream to fall back to
+        if (!internal_state->output_sink && (write || options.compression != OUTPUT_COMPRESS_NONE))
         {
-            // Use original data
-            if (internal->format_engine)
-            {
-                format_engine_write_file_chunk(internal->format_engine, ctx, buffer, bytes_read);
-            }
-            if (stats)
-            {
-                stats->processed_bytes += bytes_read;
-            }
+            metrics_destroy(internal_state->metrics);
+            internal_state->metrics = NULL;
+            return -1;
         }
-
-        // Update progress
-        update_context_progress(ctx, bytes_read);
-    }
-
-    // Release buffer back to pool
-    memory_release_buffer(internal->memory_manager, buffer);
-    fclose(file);
-
-    // Write file footer (only if content wasn't excluded)
-    if (!content_excluded && internal->format_engine)
-    {
-        format_engine_write_file_footer(internal->format_engine, ctx);
     }
 
+    // Without an index every file is written in full, so a failure here
+    // only costs output size
+    if (config && config->dedup)
+        internal_state->dedup = dedup_index_create(config->input_directory);
     return 0;
 }
 
-int process_directory_structure(FconcatContext *ctx, const char *base_path, const char *relative_path, int level)
+// Flushes the sink; returns the flush result
+static int context_close_run_state(InternalContextState *state)
 {
-    DirectoryCallback callback = {
-        .handle_entry = structure_callback,
-        .user_data = NULL};
-
-    return traverse_directory(ctx, base_path, relative_path, level, &callback);
+    int result = output_sink_destroy(state->output_sink);
+    dedup_index_destroy(state->dedup);
+    metrics_destroy(state->metrics);
+    state->output_sink = NULL;
+    state->dedup = NULL;
+    state->metrics = NULL;
+    state->output_file = NULL;
+    return result;
 }
 
-int process_directory_content(FconcatContext *ctx, const char *base_path, const char *relative_path, int level)
+// The fields plugins read per entry, copied out of the config once
+static void context_resolve_settings(FconcatSettings *settings, const ResolvedConfig *config)
 {
-    DirectoryCallback callback = {
-        .handle_entry = content_callback,
-        .user_data = NULL};
+    memset(settings, 0, sizeof(*settings));
+    settings->size = sizeof(*settings);
+    settings->log_level = LOG_INFO;
+    if (!config)
+        return;
 
-    return traverse_directory(ctx, base_path, relative_path, level, &callback);
+    settings->log_level = (LogLevel)config->log_level;
+    settings->show_size = config->show_size;
+    settings->verbose = config->verbose;
+    settings->interactive = config->interactive;
+    settings->direct_io = config->direct_io;
+    settings->drop_cache = config->drop_cache;
+    settings->binary_handling = config->binary_handling;
+    settings->symlink_handling = config->symlink_handling;
+    settings->output_format = config->output_format;
+    settings->input_directory = config->input_directory;
+    settings->output_file = config->output_file;
 }
 
 FconcatContext *create_fconcat_context(const ResolvedConfig *config,
@@ -660,9 +734,23 @@ FconcatContext *create_fconcat_context(const ResolvedConfig *config,
     internal_state->filter_engine = filter_engine;
     internal_state->progress_callback = NULL;
     internal_state->progress_user_data = NULL;
+    context_resolve_settings(&internal_state->settings, config);
+
+    if (context_open_run_state(internal_state, output_file, NULL, NULL) != 0)
+    {
+        free(internal_state);
+        free(ctx);
+        return NULL;
+    }
+
+    // Spans restarts under --watch; without the thread logging stays synchronous
+    if (config && config->log_async)
+        internal_state->log_ring = log_ring_create(STDERR_FILENO, LOG_RING_DEFAULT_SLOTS);
+    internal_state->progress = progress_reporter_create(); // Without it progress goes unreported
 
     // Initialize context with function pointers
     ctx->config = (const void *)config;
+    ctx->settings = &internal_state->settings;
     ctx->get_config_string = context_get_config_string;
     ctx->get_config_int = context_get_config_int;
     ctx->get_config_bool = context_get_config_bool;
@@ -681,6 +769,8 @@ FconcatContext *create_fconcat_context(const ResolvedConfig *config,
 
     ctx->write_output = context_write_output;
     ctx->write_output_fmt = context_write_output_fmt;
+    ctx->write_outputv = context_write_outputv;
+    ctx->write_indent = context_write_indent;
 
     ctx->error = context_error;
     ctx->warning = context_warning;
@@ -716,6 +806,9 @@ FconcatContext *create_fconcat_context(const ResolvedConfig *config,
 
     ctx->internal_state = internal_state;
 
+    ctx->arena_alloc = context_arena_alloc;
+    ctx->arena = arena_create(0); // Scratch falls back to pool buffers without it
+
     return ctx;
 }
 
@@ -724,10 +817,54 @@ void destroy_fconcat_context(FconcatContext *ctx)
     if (!ctx)
         return;
 
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state)
+    {
+        context_close_run_state(state);
+        log_ring_destroy(state->log_ring);
+        progress_reporter_destroy(state->progress);
+        if (state->format_state)
+            state->format_state_destroy(state->format_state);
+    }
+
+    arena_destroy((Arena *)ctx->arena);
     free(ctx->internal_state);
     free(ctx);
 }
 
+static int context_restart_output(FconcatContext *ctx, FILE *output_file, OutputSinkWriteFn write, void *opaque)
+{
+    if (!ctx || !ctx->internal_state)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    int result = context_close_run_state(state);
+    if (context_open_run_state(state, output_file, write, opaque) != 0)
+        return -1;
+
+    // The input directory may have changed between runs
+    context_resolve_settings(&state->settings, state->config);
+
+    ctx->current_file_path = NULL;
+    ctx->current_file_info = NULL;
+    ctx->current_file_processed_bytes = 0;
+    ctx->current_directory_level = 0;
+    ctx->processing_start_time = time(NULL);
+    return result;
+}
+
+int context_restart(FconcatContext *ctx, FILE *output_file)
+{
+    return context_restart_output(ctx, output_file, NULL, NULL);
+}
+
+int context_restart_writer(FconcatContext *ctx, OutputSinkWriteFn write, void *opaque)
+{
+    if (!write)
+        return -1;
+    return context_restart_output(ctx, NULL, write, opaque);
+}
+
 void update_context_for_file(FconcatContext *ctx, const char *filepath, const FileInfo *info)
 {
     if (!ctx)
@@ -753,10 +890,11 @@ void update_context_progress(FconcatContext *ctx, size_t bytes_processed)
 
     ProcessingStats *stats = (ProcessingStats *)ctx->stats;
     if (stats)
-    {
         stats->processed_bytes += bytes_processed;
-        stats->current_time = time(NULL);
-    }
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state)
+        progress_reporter_add(state->progress, bytes_processed, 0);
 }
 
 const char *context_get_config_string(FconcatContext *ctx, const char *key)
@@ -824,6 +962,14 @@ bool context_get_config_bool(FconcatContext *ctx, const char *key)
     {
         return config->interactive;
     }
+    else if (strcmp(key, "direct_io") == 0)
+    {
+        return config->direct_io;
+    }
+    else if (strcmp(key, "drop_cache") == 0)
+    {
+        return config->drop_cache;
+    }
 
     return false;
 }
@@ -872,7 +1018,7 @@ const char *context_get_plugin_parameter_by_index(FconcatContext *ctx, const cha
 
 void context_log(FconcatContext *ctx, LogLevel level, const char *format, ...)
 {
-    if (!ctx || !format)
+    if (!ctx || !format || !context_is_log_enabled(ctx, level))
         return;
 
     va_list args;
@@ -910,15 +1056,32 @@ void context_vlog(FconcatContext *ctx, LogLevel level, const char *format, va_li
         break;
     }
 
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->log_ring)
+    {
+        char prefix[16];
+        snprintf(prefix, sizeof(prefix), "[%s] ", level_str);
+        log_ring_vpush(state->log_ring, prefix, format, args);
+        // Errors go out before whatever the caller prints next
+        if (level == LOG_ERROR)
+            log_ring_flush(state->log_ring);
+        return;
+    }
+
+    // Keep each message on one line when content workers log concurrently
+    flockfile(stderr);
     fprintf(stderr, "[%s] ", level_str);
     vfprintf(stderr, format, args);
     fprintf(stderr, "\n");
+    funlockfile(stderr);
 }
 
 bool context_is_log_enabled(FconcatContext *ctx, LogLevel level)
 {
     if (!ctx)
         return false;
+    if (ctx->settings)
+        return fconcat_log_enabled(ctx, level);
 
     const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
     if (config)
@@ -976,22 +1139,186 @@ void context_free(FconcatContext *ctx, void *ptr)
     }
 }
 
+void *context_arena_alloc(FconcatContext *ctx, size_t size)
+{
+    if (!ctx)
+        return malloc(size);
+
+    if (ctx->arena)
+    {
+        void *ptr = arena_alloc((Arena *)ctx->arena, size);
+        if (ptr)
+            return ptr;
+    }
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    return memory_get_buffer(state ? state->memory_manager : NULL, size);
+}
+
+void context_scratch_release(FconcatContext *ctx, void *ptr)
+{
+    if (!ptr)
+        return;
+
+    if (!ctx)
+    {
+        free(ptr);
+        return;
+    }
+
+    // Arena memory goes away with the next rewind or reset
+    if (arena_owns((const Arena *)ctx->arena, ptr))
+        return;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    memory_release_buffer(state ? state->memory_manager : NULL, ptr);
+}
+
 int context_write_output(FconcatContext *ctx, const char *data, size_t size)
 {
     if (!ctx || !data)
         return -1;
 
+    // Nothing to write; data need not be terminated, so no strlen either
+    if (size == 0)
+        return 0;
+
     InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->output_sink)
+        return output_sink_write(state->output_sink, data, size);
     if (state && state->output_file)
-    {
-        if (size == 0)
-            size = strlen(data);
         return fwrite(data, 1, size, state->output_file) == size ? 0 : -1;
+
+    return -1;
+}
+
+int context_write_outputv(FconcatContext *ctx, const FconcatOutputSpan *spans, int count)
+{
+    if (!ctx || (!spans && count > 0) || count < 0)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->output_sink && count <= 16)
+    {
+        struct iovec iov[16];
+        for (int i = 0; i < count; i++)
+        {
+            iov[i].iov_base = (void *)spans[i].data;
+            iov[i].iov_len = spans[i].size;
+        }
+        return output_sink_writev(state->output_sink, iov, count);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (spans[i].size > 0 && context_write_output(ctx, spans[i].data, spans[i].size) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int context_write_indent(FconcatContext *ctx, size_t spaces)
+{
+    if (!ctx)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->output_sink)
+        return output_sink_write_repeat(state->output_sink, ' ', spaces);
+
+    static const char blanks[] = "                                ";
+    while (spaces > 0)
+    {
+        size_t n = spaces < sizeof(blanks) - 1 ? spaces : sizeof(blanks) - 1;
+        if (context_write_output(ctx, blanks, n) != 0)
+            return -1;
+        spaces -= n;
     }
+    return 0;
+}
+
+int context_flush_output(FconcatContext *ctx)
+{
+    if (!ctx)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->output_sink)
+        return output_sink_flush(state->output_sink);
+    if (state && state->output_file)
+        return fflush(state->output_file) == 0 ? 0 : -1;
 
     return -1;
 }
 
+int context_write_output_fd(FconcatContext *ctx, int fd, off_t offset, size_t length, size_t *written)
+{
+    if (written)
+        *written = 0;
+    if (!ctx || fd < 0)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (!state || (!state->output_sink && !state->output_file))
+        return -1;
+
+    ZeroCopyMethod method = ZEROCOPY_NONE;
+    ssize_t copied;
+    if (state->output_sink)
+    {
+        size_t sink_copied = 0;
+        if (output_sink_copy_fd(state->output_sink, fd, offset, length, &sink_copied, &method) != 0)
+            return -1;
+        copied = (ssize_t)sink_copied;
+    }
+    else
+    {
+        // Everything already buffered by stdio must land before the raw bytes
+        if (fflush(state->output_file) != 0)
+            return -1;
+
+        copied = zerocopy_fd_range(fileno(state->output_file), fd, offset, length, &method);
+        if (copied < 0)
+            return -1;
+    }
+
+    if (fconcat_log_enabled(ctx, LOG_DEBUG))
+        ctx->log(ctx, LOG_DEBUG, "Copied %zd bytes via %s", copied, zerocopy_method_name(method));
+    if (written)
+        *written = (size_t)copied;
+    return 0;
+}
+
+void *context_format_state(FconcatContext *ctx, size_t size, void (*destroy)(void *state))
+{
+    if (!ctx || !ctx->internal_state || !destroy)
+        return NULL;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state->format_state && state->format_state_destroy == destroy)
+        return state->format_state;
+
+    // Another formatter's state is of no use to this one
+    if (state->format_state)
+        state->format_state_destroy(state->format_state);
+    state->format_state = calloc(1, size ? size : 1);
+    state->format_state_destroy = state->format_state ? destroy : NULL;
+    return state->format_state;
+}
+
+off_t context_output_offset(FconcatContext *ctx)
+{
+    if (!ctx)
+        return -1;
+
+    InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (!state)
+        return -1;
+    if (state->output_sink)
+        return output_sink_tell(state->output_sink);
+    return state->output_file ? ftello(state->output_file) : -1;
+}
+
 int context_write_output_fmt(FconcatContext *ctx, const char *format, ...)
 {
     if (!ctx || !format)
@@ -1001,6 +1328,32 @@ int context_write_output_fmt(FconcatContext *ctx, const char *format, ...)
     va_start(args, format);
 
     InternalContextState *state = (InternalContextState *)ctx->internal_state;
+    if (state && state->output_sink)
+    {
+        // Format on the stack in the common case; returns the length like vfprintf
+        char stack_buf[1024];
+        va_list copy;
+        va_copy(copy, args);
+        int length = vsnprintf(stack_buf, sizeof(stack_buf), format, copy);
+        va_end(copy);
+
+        char *text = stack_buf;
+        if (length >= (int)sizeof(stack_buf))
+        {
+            text = malloc((size_t)length + 1);
+            if (text)
+                vsnprintf(text, (size_t)length + 1, format, args);
+        }
+        va_end(args);
+
+        if (length < 0 || !text)
+            return -1;
+
+        int result = output_sink_write(state->output_sink, text, (size_t)length) == 0 ? length : -1;
+        if (text != stack_buf)
+            free(text);
+        return result;
+    }
     if (state && state->output_file)
     {
         int result = vfprintf(state->output_file, format, args);
@@ -1066,10 +1419,13 @@ void context_progress(FconcatContext *ctx, const char *operation, size_t current
         return;
 
     InternalContextState *state = (InternalContextState *)ctx->internal_state;
-    if (state && state->progress_callback)
-    {
-        state->progress_callback(operation, current, total, state->progress_user_data);
-    }
+    if (!state || !state->progress_callback)
+        return;
+
+    // During a content pass only the reporter thread calls the callback
+    if (progress_reporter_post(state->progress, operation, current, total) == 0)
+        return;
+    state->progress_callback(operation, current, total, state->progress_user_data);
 }
 
 void context_set_progress_callback(FconcatContext *ctx, ProgressCallback callback, void *user_data)
@@ -1147,9 +1503,29 @@ int context_stream_write(FconcatContext *ctx, void *buffer, const char *data, si
     return stream_buffer_write((StreamBuffer *)buffer, data, size);
 }
 
+static int stream_drain_to_sink(void *target, const struct iovec *iov, int count)
+{
+    return output_sink_writev((OutputSink *)target, iov, count);
+}
+
+static int stream_drain_to_file(void *target, const struct iovec *iov, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (fwrite(iov[i].iov_base, 1, iov[i].iov_len, (FILE *)target) != iov[i].iov_len)
+            return -1;
+    }
+    return 0;
+}
+
+// The segments go to the output as they are, without being joined first
 int context_stream_flush(FconcatContext *ctx, void *buffer)
 {
-    (void)ctx;
+    InternalContextState *state = ctx ? (InternalContextState *)ctx->internal_state : NULL;
+    if (state && state->output_sink)
+        return stream_buffer_drain((StreamBuffer *)buffer, stream_drain_to_sink, state->output_sink);
+    if (state && state->output_file)
+        return stream_buffer_drain((StreamBuffer *)buffer, stream_drain_to_file, state->output_file);
     return stream_buffer_flush((StreamBuffer *)buffer);
 }
 
@@ -1205,6 +1581,10 @@ int context_get_file_info(FconcatContext *ctx, const char *path, void *info)
     file_info->is_symlink = S_ISLNK(st.st_mode);
     file_info->is_binary = false; // Would need binary detection
     file_info->permissions = st.st_mode;
+    file_info->device = (uint64_t)st.st_dev;
+    file_info->inode = (uint64_t)st.st_ino;
+    file_info->modified_nsec = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    file_info->changed_nsec = (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
 
     return 0;
 }
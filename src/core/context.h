@@ -4,6 +4,7 @@
 #include "../core/types.h"
 #include "../core/error.h"
 #include "../core/memory.h"
+#include "../core/output.h"
 #include "../../include/fconcat_api.h"
 
 #ifdef __cplusplus
@@ -15,6 +16,11 @@ extern "C"
     struct PluginManager;
     struct FormatEngine;
     struct FilterEngine;
+    struct FileTree;
+    struct Incremental;
+    struct DedupIndex;
+    struct Metrics;
+    struct ProgressReporter;
 
     // Directory entry callback type
     typedef enum
@@ -34,6 +40,12 @@ extern "C"
     typedef struct
     {
         FILE *output_file;
+        OutputSink *output_sink; // Buffers everything written to output_file
+        struct Incremental *incremental; // Blocks reused from the previous run, or NULL
+        struct DedupIndex *dedup;        // Bodies already written, for --dedup, or NULL
+        struct Metrics *metrics;         // Per-stage counters for --stats, or NULL
+        struct LogRing *log_ring;        // Queue drained by a writer thread for --log-async, or NULL
+        struct ProgressReporter *progress; // Per-thread counters reported while a content pass runs
         const ResolvedConfig *config;
         ProcessingStats *stats;
         ErrorManager *error_manager;
@@ -43,6 +55,9 @@ extern "C"
         struct FilterEngine *filter_engine;
         ProgressCallback progress_callback;
         void *progress_user_data;
+        FconcatSettings settings; // What ctx->settings points to
+        void *format_state;       // Per-document state of the built-in formatter, or NULL
+        void (*format_state_destroy)(void *state);
     } InternalContextState;
 
     // Context creation and management
@@ -56,14 +71,68 @@ extern "C"
                                            struct FilterEngine *filter_engine);
 
     void destroy_fconcat_context(FconcatContext *ctx);
+    // Start another run on the same context (--watch): flush and drop the
+    // previous output's sink, counters and dedup index and set them up
+    // again for output_file. Engines, plugins and their data stay. The
+    // caller resets stats and the incremental state.
+    int context_restart(FconcatContext *ctx, FILE *output_file);
+    // Like context_restart, but the next run goes to write instead of a
+    // FILE (the embedding API). There is no stdio fallback: fails when the
+    // sink cannot be set up.
+    int context_restart_writer(FconcatContext *ctx, OutputSinkWriteFn write, void *opaque);
     void update_context_for_file(FconcatContext *ctx, const char *filepath, const FileInfo *info);
     void update_context_progress(FconcatContext *ctx, size_t bytes_processed);
 
     int traverse_directory(FconcatContext *ctx, const char *base_path, const char *relative_path,
                            int level, DirectoryCallback *callback);
+    // Examine one entry of a walked directory: lstat name relative to
+    // dir_fd, follow it when symlinks are followed, and fill info. Returns
+    // -1, after a warning naming full_path, when the entry cannot be
+    // examined.
+    int context_stat_entry(FconcatContext *ctx, int dir_fd, const char *name, const char *full_path,
+                           const char *relative_path, FileInfo *info);
+    // Same, leaving the warning to the caller: -1 with errno set
+    int context_stat_entry_quiet(FconcatContext *ctx, int dir_fd, const char *name, const char *full_path,
+                                 const char *relative_path, FileInfo *info);
+    // Path filter verdict from the dirent type alone: 1 include, 0 exclude,
+    // -1 when it takes a stat first (rules or plugins that read more of
+    // FileInfo, DT_UNKNOWN and other types, or a symlink being followed)
+    int context_filter_entry_type(FconcatContext *ctx, const char *relative_path, unsigned char d_type);
+    // Ignore rules in scope inside a directory being entered (--gitignore).
+    // Its .gitignore/.ignore are loaded into *owned, which the caller frees
+    // on leaving the directory; returns *owned, or parent when it has no
+    // rules, or NULL when --gitignore is off.
+    const struct IgnoreLayer *context_enter_ignore_scope(FconcatContext *ctx, int dir_fd, const char *full_path,
+                                                         const char *relative_path, size_t relative_len,
+                                                         const struct IgnoreLayer *parent,
+                                                         struct IgnoreLayer **owned);
     int process_directory_structure(FconcatContext *ctx, const char *base_path, const char *relative_path, int level);
     int process_directory_content(FconcatContext *ctx, const char *base_path, const char *relative_path, int level);
 
+    // Replay a cached tree (see tree.h) through the structure/content passes
+    int process_tree_structure(FconcatContext *ctx, struct FileTree *tree);
+    int process_tree_content(FconcatContext *ctx, struct FileTree *tree);
+
+    // Counters the subsystems record into; NULL unless --stats is on
+    static inline struct Metrics *context_metrics(const FconcatContext *ctx)
+    {
+        return ctx && ctx->internal_state ? ((const InternalContextState *)ctx->internal_state)->metrics : NULL;
+    }
+
+    // Buffered writer behind write_output, for built-in formatters that
+    // write into its buffer directly; NULL when output goes to a FILE
+    static inline OutputSink *context_output_sink(const FconcatContext *ctx)
+    {
+        return ctx && ctx->internal_state ? ((const InternalContextState *)ctx->internal_state)->output_sink : NULL;
+    }
+
+    // Per-document state of a built-in formatter. It belongs to the context,
+    // so documents rendered through different contexts at the same time
+    // never share it. Allocated zeroed on first use with size and released
+    // through destroy (required) with the context; NULL when allocation
+    // fails.
+    void *context_format_state(FconcatContext *ctx, size_t size, void (*destroy)(void *state));
+
     // Context service implementations (now take FconcatContext* as first parameter)
     const char *context_get_config_string(FconcatContext *ctx, const char *key);
     int context_get_config_int(FconcatContext *ctx, const char *key);
@@ -80,8 +149,22 @@ extern "C"
     void *context_alloc(FconcatContext *ctx, size_t size);
     void *context_realloc(FconcatContext *ctx, void *ptr, size_t size);
     void context_free(FconcatContext *ctx, void *ptr);
+    // Per-file scratch memory (see arena.h). Without an arena this falls
+    // back to pool buffers, so callers always release through
+    // context_scratch_release(), which leaves arena memory alone.
+    void *context_arena_alloc(FconcatContext *ctx, size_t size);
+    void context_scratch_release(FconcatContext *ctx, void *ptr);
     int context_write_output(FconcatContext *ctx, const char *data, size_t size);
     int context_write_output_fmt(FconcatContext *ctx, const char *format, ...);
+    int context_write_outputv(FconcatContext *ctx, const FconcatOutputSpan *spans, int count);
+    int context_write_indent(FconcatContext *ctx, size_t spaces);
+    // Push buffered output to the file; call once the document is complete
+    int context_flush_output(FconcatContext *ctx);
+    // Copy a byte range of fd straight to the output file without staging it
+    // in userspace (see zerocopy.h); pending stdio output is flushed first
+    int context_write_output_fd(FconcatContext *ctx, int fd, off_t offset, size_t length, size_t *written);
+    // Offset in the output file the next write lands at
+    off_t context_output_offset(FconcatContext *ctx);
     void context_error(FconcatContext *ctx, const char *format, ...);
     void context_warning(FconcatContext *ctx, const char *format, ...);
     int context_get_error_count(FconcatContext *ctx);
@@ -0,0 +1,282 @@
+#include "dedup.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define DEDUP_INITIAL_BUCKETS 256
+#define DEDUP_READ_SIZE (256 * 1024)
+
+typedef struct DedupEntry
+{
+    uint64_t size;
+    uint64_t hash;
+    int64_t changed_nsec; // Change time of the file when its body was written
+    bool hashed;          // hash is valid
+    bool stale;           // The file no longer holds that body
+    struct DedupEntry *next;
+    char path[]; // Relative to the index base directory
+} DedupEntry;
+
+struct DedupIndex
+{
+    DedupEntry **buckets; // Chained by size, so one chain holds every candidate
+    size_t bucket_count;  // Power of two
+    char *base_dir;
+    DedupStats stats;
+};
+
+// Sizes are often multiples of a block, so spread the low bits
+static size_t bucket_for(uint64_t size, size_t bucket_count)
+{
+    return (size_t)((size * 0x9E3779B97F4A7C15ULL) >> 32) & (bucket_count - 1);
+}
+
+DedupIndex *dedup_index_create(const char *base_dir)
+{
+    DedupIndex *index = calloc(1, sizeof(DedupIndex));
+    if (!index)
+        return NULL;
+
+    index->bucket_count = DEDUP_INITIAL_BUCKETS;
+    index->buckets = calloc(index->bucket_count, sizeof(DedupEntry *));
+    index->base_dir = strdup(base_dir ? base_dir : ".");
+    if (!index->buckets || !index->base_dir)
+    {
+        dedup_index_destroy(index);
+        return NULL;
+    }
+    return index;
+}
+
+void dedup_index_destroy(DedupIndex *index)
+{
+    if (!index)
+        return;
+
+    if (index->buckets)
+    {
+        for (size_t i = 0; i < index->bucket_count; i++)
+        {
+            DedupEntry *entry = index->buckets[i];
+            while (entry)
+            {
+                DedupEntry *next = entry->next;
+                free(entry);
+                entry = next;
+            }
+        }
+    }
+    free(index->buckets);
+    free(index->base_dir);
+    free(index);
+}
+
+static void dedup_index_grow(DedupIndex *index)
+{
+    size_t new_count = index->bucket_count * 2;
+    DedupEntry **new_buckets = calloc(new_count, sizeof(DedupEntry *));
+    if (!new_buckets)
+        return; // Longer chains, still correct
+
+    for (size_t i = 0; i < index->bucket_count; i++)
+    {
+        DedupEntry *entry = index->buckets[i];
+        while (entry)
+        {
+            DedupEntry *next = entry->next;
+            size_t bucket = bucket_for(entry->size, new_count);
+            entry->next = new_buckets[bucket];
+            new_buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(index->buckets);
+    index->buckets = new_buckets;
+    index->bucket_count = new_count;
+}
+
+bool dedup_index_has_size(const DedupIndex *index, uint64_t size)
+{
+    if (!index)
+        return false;
+
+    for (const DedupEntry *entry = index->buckets[bucket_for(size, index->bucket_count)]; entry; entry = entry->next)
+    {
+        if (entry->size == size)
+            return true;
+    }
+    return false;
+}
+
+ssize_t dedup_hash_range(int fd, off_t offset, uint64_t length, Xxh64State *state)
+{
+    size_t buffer_size = length < DEDUP_READ_SIZE ? (size_t)length : DEDUP_READ_SIZE;
+    char *buffer = malloc(buffer_size ? buffer_size : 1);
+    if (!buffer)
+        return -1;
+
+    uint64_t done = 0;
+    while (done < length)
+    {
+        uint64_t left = length - done;
+        ssize_t n = pread(fd, buffer, left < buffer_size ? (size_t)left : buffer_size, offset + (off_t)done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            free(buffer);
+            return -1;
+        }
+        if (n == 0)
+            break;
+
+        xxh64_update(state, buffer, (size_t)n);
+        done += (uint64_t)n;
+    }
+
+    free(buffer);
+    return (ssize_t)done;
+}
+
+// Open the file of an entry if it still holds the body that was written:
+// same size and change time. Otherwise the entry is marked stale, so it is
+// not opened again, and -1 is returned.
+static int dedup_entry_open(const DedupIndex *index, DedupEntry *entry)
+{
+    char full_path[MAX_PATH];
+    int len = snprintf(full_path, sizeof(full_path), "%s/%s", index->base_dir, entry->path);
+    int fd = len < 0 || len >= (int)sizeof(full_path) ? -1 : open(full_path, O_RDONLY | O_CLOEXEC);
+
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (uint64_t)st.st_size == entry->size &&
+        (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec == entry->changed_nsec)
+        return fd;
+
+    if (fd >= 0)
+        close(fd);
+    entry->stale = true;
+    return -1;
+}
+
+// Hash an entry whose body was never seen in userspace
+static bool dedup_entry_hash(DedupEntry *entry, int fd)
+{
+    Xxh64State state;
+    xxh64_reset(&state, 0);
+    ssize_t n = dedup_hash_range(fd, 0, entry->size, &state);
+    if (n < 0 || (uint64_t)n != entry->size)
+        return false;
+
+    entry->hash = xxh64_digest(&state);
+    entry->hashed = true;
+    return true;
+}
+
+// Read exactly length bytes at offset, or fail
+static bool dedup_read_full(int fd, char *buffer, size_t length, off_t offset)
+{
+    size_t done = 0;
+    while (done < length)
+    {
+        ssize_t n = pread(fd, buffer + done, length - done, offset + (off_t)done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        done += (size_t)n;
+    }
+    return true;
+}
+
+// Whether the first size bytes of fd are those of body
+static bool dedup_body_equal(int fd, const DedupBody *body, uint64_t size)
+{
+    size_t block = size < DEDUP_READ_SIZE ? (size_t)size : DEDUP_READ_SIZE;
+    char *buffer = malloc(body->data ? block : block * 2);
+    if (!buffer)
+        return false;
+
+    bool equal = true;
+    for (uint64_t offset = 0; equal && offset < size; offset += block)
+    {
+        size_t n = size - offset < block ? (size_t)(size - offset) : block;
+        const char *expected = body->data ? body->data + offset : buffer + block;
+        equal = dedup_read_full(fd, buffer, n, (off_t)offset) &&
+                (body->data || dedup_read_full(body->fd, buffer + block, n, (off_t)offset)) &&
+                memcmp(buffer, expected, n) == 0;
+    }
+
+    free(buffer);
+    return equal;
+}
+
+const char *dedup_index_find(DedupIndex *index, uint64_t size, uint64_t hash, const DedupBody *body)
+{
+    if (!index || !body)
+        return NULL;
+
+    for (DedupEntry *entry = index->buckets[bucket_for(size, index->bucket_count)]; entry; entry = entry->next)
+    {
+        if (entry->size != size || entry->stale || (entry->hashed && entry->hash != hash))
+            continue;
+
+        int fd = dedup_entry_open(index, entry);
+        if (fd < 0)
+            continue;
+        bool same = (entry->hashed || dedup_entry_hash(entry, fd)) && entry->hash == hash &&
+                    dedup_body_equal(fd, body, size);
+        close(fd);
+        if (same)
+            return entry->path;
+    }
+    return NULL;
+}
+
+int dedup_index_add(DedupIndex *index, const char *path, const FileInfo *info, uint64_t hash, bool hashed)
+{
+    if (!index || !path || !info)
+        return -1;
+
+    size_t path_len = strlen(path);
+    DedupEntry *entry = malloc(sizeof(DedupEntry) + path_len + 1);
+    if (!entry)
+        return -1;
+
+    entry->size = info->size;
+    entry->hash = hash;
+    entry->changed_nsec = info->changed_nsec;
+    entry->hashed = hashed;
+    entry->stale = false;
+    memcpy(entry->path, path, path_len + 1);
+
+    if (index->stats.files >= index->bucket_count)
+        dedup_index_grow(index);
+
+    // A body is only added when no indexed one matched it, so the order
+    // within a chain does not matter
+    size_t bucket = bucket_for(entry->size, index->bucket_count);
+    entry->next = index->buckets[bucket];
+    index->buckets[bucket] = entry;
+    index->stats.files++;
+    return 0;
+}
+
+void dedup_index_note_duplicate(DedupIndex *index, uint64_t size)
+{
+    if (!index)
+        return;
+    index->stats.duplicates++;
+    index->stats.bytes_saved += size;
+}
+
+DedupStats dedup_index_stats(const DedupIndex *index)
+{
+    DedupStats stats = {0, 0, 0};
+    if (index)
+        stats = index->stats;
+    return stats;
+}
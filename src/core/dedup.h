@@ -0,0 +1,78 @@
+#ifndef CORE_DEDUP_H
+#define CORE_DEDUP_H
+
+#include "hash.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Bodies of the files already written to the output, keyed by size and
+    // content hash, so a later byte-identical file can refer back to the
+    // first copy instead of repeating it. Only touched by the thread that
+    // writes the output.
+    //
+    // A file whose body went out without passing through userspace (a
+    // kernel copy) is added unhashed and hashed from disk the first time a
+    // file of the same size turns up; most sizes never repeat.
+    //
+    // A hash match alone is never trusted: the earlier file is reopened,
+    // has to carry the change time it had when it was written, and is
+    // compared byte for byte with the new body.
+    typedef struct DedupIndex DedupIndex;
+
+    // Smaller files cost less to repeat than to look up and refer to
+#define DEDUP_MIN_SIZE 128
+
+    typedef struct
+    {
+        size_t files;        // Bodies in the index
+        size_t duplicates;   // Files written as a reference
+        uint64_t bytes_saved; // Content bytes those files did not repeat
+    } DedupStats;
+
+    // base_dir resolves the relative paths of unhashed entries
+    DedupIndex *dedup_index_create(const char *base_dir);
+    void dedup_index_destroy(DedupIndex *index);
+
+    // Whether some indexed body has this size; a file that returns false
+    // cannot be a duplicate and need not be hashed up front
+    bool dedup_index_has_size(const DedupIndex *index, uint64_t size);
+
+    // The body being looked up: data when it is in memory, else read from
+    // fd at offset 0 without moving the file offset
+    typedef struct
+    {
+        const char *data;
+        int fd;
+    } DedupBody;
+
+    // Path of the first indexed body with this size and hash whose file is
+    // unchanged since it was written and holds the same bytes as body, or NULL
+    const char *dedup_index_find(DedupIndex *index, uint64_t size, uint64_t hash, const DedupBody *body);
+
+    // Index a body of info->size bytes written in full. path is copied;
+    // info->changed_nsec tells later lookups whether the file still holds it.
+    int dedup_index_add(DedupIndex *index, const char *path, const FileInfo *info, uint64_t hash, bool hashed);
+
+    // Count a file written as a reference to an earlier one
+    void dedup_index_note_duplicate(DedupIndex *index, uint64_t size);
+
+    DedupStats dedup_index_stats(const DedupIndex *index);
+
+    // Feed length bytes of fd starting at offset into state without moving
+    // the file offset. Returns the number of bytes hashed, which is short
+    // when the file ends early, or -1 on a read error.
+    ssize_t dedup_hash_range(int fd, off_t offset, uint64_t length, Xxh64State *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_DEDUP_H */
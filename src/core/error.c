@@ -155,6 +155,16 @@ int error_get_count(ErrorManager *manager)
     return count;
 }
 
+const char *error_get_last_message(ErrorManager *manager)
+{
+    if (!manager)
+        return NULL;
+    pthread_mutex_lock(&manager->mutex);
+    const char *message = manager->error_count > 0 ? manager->errors[manager->error_count - 1].message : NULL;
+    pthread_mutex_unlock(&manager->mutex);
+    return message;
+}
+
 int warning_get_count(ErrorManager *manager)
 {
     if (!manager)
@@ -32,6 +32,8 @@ void error_report(ErrorManager *manager, FconcatErrorCode code, const char *form
 void error_report_context(ErrorManager *manager, FconcatErrorCode code, const char *file, int line, const char *function, const char *format, ...);
 void warning_report(ErrorManager *manager, const char *format, ...);
 int error_get_count(ErrorManager *manager);
+// Message of the most recent error, or NULL; valid until the manager is destroyed
+const char *error_get_last_message(ErrorManager *manager);
 int warning_get_count(ErrorManager *manager);
 void error_clear(ErrorManager *manager);
 
@@ -0,0 +1,166 @@
+#include "hash.h"
+#include <string.h>
+
+#define XXH_PRIME64_1 11400714785074694791ULL
+#define XXH_PRIME64_2 14029467366897019727ULL
+#define XXH_PRIME64_3 1609587929392839161ULL
+#define XXH_PRIME64_4 9650029242287828579ULL
+#define XXH_PRIME64_5 2870177450012600261ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Little-endian loads regardless of alignment; compilers turn these into
+// single moves on x86 and ARM
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t value)
+{
+    acc ^= xxh_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+// Consume whole 32-byte stripes; returns the bytes used
+static size_t xxh_stripes(uint64_t v[4], const unsigned char *p, size_t size)
+{
+    const unsigned char *start = p;
+    const unsigned char *limit = p + (size & ~(size_t)31);
+    uint64_t v1 = v[0], v2 = v[1], v3 = v[2], v4 = v[3];
+
+    while (p < limit)
+    {
+        v1 = xxh_round(v1, read64(p));
+        v2 = xxh_round(v2, read64(p + 8));
+        v3 = xxh_round(v3, read64(p + 16));
+        v4 = xxh_round(v4, read64(p + 24));
+        p += 32;
+    }
+
+    v[0] = v1, v[1] = v2, v[2] = v3, v[3] = v4;
+    return (size_t)(p - start);
+}
+
+void xxh64_reset(Xxh64State *state, uint64_t seed)
+{
+    memset(state, 0, sizeof(*state));
+    state->v[0] = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    state->v[1] = seed + XXH_PRIME64_2;
+    state->v[2] = seed;
+    state->v[3] = seed - XXH_PRIME64_1;
+}
+
+void xxh64_update(Xxh64State *state, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    if (!p || size == 0)
+        return;
+
+    state->total_length += size;
+
+    if (state->buffered + size < sizeof(state->buffer))
+    {
+        memcpy(state->buffer + state->buffered, p, size);
+        state->buffered += size;
+        return;
+    }
+
+    if (state->buffered)
+    {
+        size_t fill = sizeof(state->buffer) - state->buffered;
+        memcpy(state->buffer + state->buffered, p, fill);
+        xxh_stripes(state->v, state->buffer, sizeof(state->buffer));
+        p += fill;
+        size -= fill;
+        state->buffered = 0;
+    }
+
+    size_t used = xxh_stripes(state->v, p, size);
+    memcpy(state->buffer, p + used, size - used);
+    state->buffered = size - used;
+}
+
+uint64_t xxh64_digest(const Xxh64State *state)
+{
+    uint64_t h;
+    if (state->total_length >= 32)
+    {
+        const uint64_t *v = state->v;
+        h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+        h = xxh_merge(h, v[0]);
+        h = xxh_merge(h, v[1]);
+        h = xxh_merge(h, v[2]);
+        h = xxh_merge(h, v[3]);
+    }
+    else
+    {
+        h = state->v[2] + XXH_PRIME64_5; // v[2] holds the seed until a stripe is consumed
+    }
+
+    h += state->total_length;
+
+    const unsigned char *p = state->buffer;
+    size_t left = state->buffered;
+    while (left >= 8)
+    {
+        h ^= xxh_round(0, read64(p));
+        h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+        left -= 8;
+    }
+    if (left >= 4)
+    {
+        h ^= (uint64_t)read32(p) * XXH_PRIME64_1;
+        h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+        left -= 4;
+    }
+    while (left > 0)
+    {
+        h ^= (uint64_t)(*p) * XXH_PRIME64_5;
+        h = rotl64(h, 11) * XXH_PRIME64_1;
+        p++;
+        left--;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxh64(const void *data, size_t size, uint64_t seed)
+{
+    Xxh64State state;
+    xxh64_reset(&state, seed);
+    xxh64_update(&state, data, size);
+    return xxh64_digest(&state);
+}
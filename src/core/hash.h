@@ -0,0 +1,32 @@
+#ifndef CORE_HASH_H
+#define CORE_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // XXH64: fast non-cryptographic 64-bit hash, bit-compatible with the
+    // reference implementation. Content can be fed in pieces of any size.
+    typedef struct
+    {
+        uint64_t total_length;
+        uint64_t v[4];
+        unsigned char buffer[32]; // Input not yet consumed as a full stripe
+        size_t buffered;
+    } Xxh64State;
+
+    void xxh64_reset(Xxh64State *state, uint64_t seed);
+    void xxh64_update(Xxh64State *state, const void *data, size_t size);
+    uint64_t xxh64_digest(const Xxh64State *state);
+
+    uint64_t xxh64(const void *data, size_t size, uint64_t seed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_HASH_H */
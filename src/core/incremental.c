@@ -0,0 +1,563 @@
+#include "incremental.h"
+#include "progress.h"
+#include "tree.h"
+#include "version.h"
+#include "../format/format.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MANIFEST_MAGIC "FCMANIF"
+#define MANIFEST_VERSION 1
+// Larger files are not manifests this build wrote
+#define MANIFEST_MAX_SIZE (1024ULL * 1024 * 1024)
+
+// On-disk layout, native byte order: the header, then one record per file
+// followed by its path and a NUL
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t fingerprint;   // Options that change how a block is rendered
+    int64_t started_nsec;   // Wall clock when the run that wrote it started
+    uint64_t output_device; // The output the blocks were written to
+    uint64_t output_inode;
+    uint64_t output_size;
+    int64_t output_modified_nsec;
+    uint64_t entry_count;
+} ManifestHeader;
+
+typedef struct
+{
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t modified_nsec;
+    int64_t changed_nsec;
+    uint64_t offset;
+    uint64_t length;
+    uint32_t flags;
+    uint32_t path_length;
+} ManifestRecord;
+
+struct Incremental
+{
+    char *cache_path;
+    char *output_path;
+    char *cache_temp;  // Manifest being written, renamed over cache_path
+    char *output_temp; // Output being written, renamed over output_path
+    FILE *manifest;
+    uint64_t fingerprint;
+    int64_t started_nsec;
+    bool write_error;
+
+    // Previous run
+    const char *unusable; // Why nothing can be reused, or NULL
+    char *blob;           // Manifest contents; entry paths point into it
+    ManifestEntry *entries;
+    size_t entry_count;
+    size_t *index; // Open addressing over entries, SIZE_MAX = empty
+    size_t index_mask;
+    int64_t previous_started_nsec;
+    uint64_t previous_output_size;
+    int previous_fd;
+    mode_t output_mode;
+
+    // This run
+    const ManifestEntry **plan; // Per tree entry: block to reuse, or NULL
+    size_t plan_count;
+    uint64_t pending_offset; // Reused blocks not copied yet
+    uint64_t pending_length;
+    size_t recorded;
+    size_t reused;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL; // FNV-1a
+    }
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, const char *str)
+{
+    // The terminator keeps ("ab", "c") apart from ("a", "bc")
+    return hash_bytes(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+// Everything a rendered block depends on besides the file itself
+static uint64_t config_fingerprint(const ResolvedConfig *config)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    int32_t modes[] = {(int32_t)config->binary_handling, (int32_t)config->symlink_handling, (int32_t)config->dedup};
+
+    hash = hash_string(hash, FCONCAT_VERSION);
+    hash = hash_string(hash, config->output_format);
+    hash = hash_string(hash, config->input_directory);
+    for (int i = 0; i < config->sample_count; i++)
+    {
+        const SampleRule *rule = &config->samples[i];
+        uint64_t sides[] = {rule->policy.head, rule->policy.tail, rule->policy.head_lines, rule->policy.tail_lines};
+        hash = hash_string(hash, rule->pattern);
+        hash = hash_bytes(hash, sides, sizeof(sides));
+    }
+    return hash_bytes(hash, modes, sizeof(modes));
+}
+
+static int64_t timespec_nsec(struct timespec ts)
+{
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static char *path_with_suffix(const char *path, const char *suffix)
+{
+    size_t len = strlen(path);
+    size_t suffix_len = strlen(suffix);
+    char *result = malloc(len + suffix_len + 1);
+    if (result)
+    {
+        memcpy(result, path, len);
+        memcpy(result + len, suffix, suffix_len + 1);
+    }
+    return result;
+}
+
+// A temporary file in the same directory as path, so rename() can replace it
+static int create_temp_beside(const char *path, char **temp_path, mode_t mode)
+{
+    *temp_path = path_with_suffix(path, ".XXXXXX");
+    if (!*temp_path)
+        return -1;
+
+    int fd = mkstemp(*temp_path);
+    if (fd < 0)
+    {
+        free(*temp_path);
+        *temp_path = NULL;
+        return -1;
+    }
+    fchmod(fd, mode);
+    return fd;
+}
+
+static size_t index_slot(const Incremental *inc, const char *path)
+{
+    return (size_t)hash_string(14695981039346656037ULL, path) & inc->index_mask;
+}
+
+static const ManifestEntry *manifest_find(const Incremental *inc, const char *path)
+{
+    if (!inc->index)
+        return NULL;
+
+    for (size_t i = index_slot(inc, path);; i = (i + 1) & inc->index_mask)
+    {
+        size_t e = inc->index[i];
+        if (e == SIZE_MAX)
+            return NULL;
+        if (strcmp(inc->entries[e].path, path) == 0)
+            return &inc->entries[e];
+    }
+}
+
+// Parse the previous manifest; NULL or the reason it cannot be used
+static const char *manifest_load(Incremental *inc)
+{
+    FILE *file = fopen(inc->cache_path, "rb");
+    if (!file)
+        return errno == ENOENT ? "no manifest yet" : "manifest unreadable";
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode) ||
+        (uint64_t)st.st_size < sizeof(ManifestHeader) || (uint64_t)st.st_size > MANIFEST_MAX_SIZE)
+    {
+        fclose(file);
+        return "manifest unreadable";
+    }
+
+    size_t size = (size_t)st.st_size;
+    inc->blob = malloc(size);
+    size_t got = inc->blob ? fread(inc->blob, 1, size, file) : 0;
+    fclose(file);
+    if (got != size)
+        return "manifest unreadable";
+
+    ManifestHeader header;
+    memcpy(&header, inc->blob, sizeof(header));
+    if (memcmp(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) != 0 || header.version != MANIFEST_VERSION)
+        return "not a manifest of this version";
+    if (header.fingerprint != inc->fingerprint)
+        return "options or fconcat build changed";
+    if (header.entry_count > (size - sizeof(header)) / sizeof(ManifestRecord))
+        return "manifest truncated";
+
+    // The blocks are only where the manifest says if the output is untouched
+    int fd = open(inc->output_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+        (uint64_t)st.st_dev != header.output_device || (uint64_t)st.st_ino != header.output_inode ||
+        (uint64_t)st.st_size != header.output_size || timespec_nsec(st.st_mtim) != header.output_modified_nsec)
+    {
+        if (fd >= 0)
+            close(fd);
+        return "output changed since the last run";
+    }
+    inc->previous_fd = fd;
+    inc->previous_output_size = header.output_size;
+    inc->previous_started_nsec = header.started_nsec;
+
+    size_t count = (size_t)header.entry_count;
+    inc->entries = calloc(count ? count : 1, sizeof(ManifestEntry));
+    size_t index_size = 16;
+    while (index_size < count * 2)
+        index_size *= 2;
+    inc->index = malloc(index_size * sizeof(size_t));
+    if (!inc->entries || !inc->index)
+        return "out of memory";
+    memset(inc->index, 0xFF, index_size * sizeof(size_t));
+    inc->index_mask = index_size - 1;
+
+    size_t pos = sizeof(header);
+    for (size_t i = 0; i < count; i++)
+    {
+        ManifestRecord record;
+        if (size - pos < sizeof(record))
+            return "manifest truncated";
+        memcpy(&record, inc->blob + pos, sizeof(record));
+        pos += sizeof(record);
+
+        if (size - pos <= record.path_length || inc->blob[pos + record.path_length] != '\0')
+            return "manifest truncated";
+
+        ManifestEntry *entry = &inc->entries[inc->entry_count];
+        entry->path = inc->blob + pos;
+        entry->device = record.device;
+        entry->inode = record.inode;
+        entry->size = record.size;
+        entry->modified_nsec = record.modified_nsec;
+        entry->changed_nsec = record.changed_nsec;
+        entry->offset = record.offset;
+        entry->length = record.length;
+        entry->flags = record.flags;
+        pos += (size_t)record.path_length + 1;
+
+        size_t slot = index_slot(inc, entry->path);
+        while (inc->index[slot] != SIZE_MAX)
+            slot = (slot + 1) & inc->index_mask;
+        inc->index[slot] = inc->entry_count++;
+    }
+
+    return NULL;
+}
+
+Incremental *incremental_open(const ResolvedConfig *config, const char *cache_path, const char *output_path)
+{
+    if (!config || !cache_path || !output_path)
+        return NULL;
+
+    Incremental *inc = calloc(1, sizeof(Incremental));
+    if (!inc)
+        return NULL;
+
+    inc->previous_fd = -1;
+    inc->cache_path = strdup(cache_path);
+    inc->output_path = strdup(output_path);
+    if (!inc->cache_path || !inc->output_path)
+    {
+        incremental_close(inc);
+        return NULL;
+    }
+
+    inc->fingerprint = config_fingerprint(config);
+
+    // The replacement output keeps the permissions of the one it replaces
+    mode_t mask = umask(0);
+    umask(mask);
+    inc->output_mode = 0666 & ~mask;
+    struct stat st;
+    if (stat(output_path, &st) == 0 && S_ISREG(st.st_mode))
+        inc->output_mode = st.st_mode & 07777;
+
+    inc->unusable = manifest_load(inc);
+
+    int fd = create_temp_beside(cache_path, &inc->cache_temp, 0666 & ~mask);
+    inc->manifest = fd >= 0 ? fdopen(fd, "wb") : NULL;
+    if (!inc->manifest)
+    {
+        if (fd >= 0)
+            close(fd);
+        incremental_close(inc);
+        return NULL;
+    }
+
+    // Stamped by the same clock as the input files: anything changed after
+    // this point has a modification time at or past it
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    inc->started_nsec = fstat(fd, &st) == 0 ? timespec_nsec(st.st_mtim) : timespec_nsec(now);
+
+    // Room for the header, filled in on commit
+    ManifestHeader header = {0};
+    if (fwrite(&header, sizeof(header), 1, inc->manifest) != 1)
+        inc->write_error = true;
+
+    return inc;
+}
+
+void incremental_close(Incremental *inc)
+{
+    if (!inc)
+        return;
+
+    if (inc->manifest)
+        fclose(inc->manifest);
+    if (inc->cache_temp)
+        unlink(inc->cache_temp);
+    if (inc->output_temp)
+        unlink(inc->output_temp);
+    if (inc->previous_fd >= 0)
+        close(inc->previous_fd);
+
+    free(inc->plan);
+    free(inc->index);
+    free(inc->entries);
+    free(inc->blob);
+    free(inc->cache_temp);
+    free(inc->output_temp);
+    free(inc->cache_path);
+    free(inc->output_path);
+    free(inc);
+}
+
+FILE *incremental_create_output(Incremental *inc)
+{
+    if (!inc || inc->output_temp)
+        return NULL;
+
+    int fd = create_temp_beside(inc->output_path, &inc->output_temp, inc->output_mode);
+    if (fd < 0)
+        return NULL;
+
+    FILE *file = fdopen(fd, "wb");
+    if (!file)
+        close(fd);
+    return file;
+}
+
+static bool entry_unchanged(const Incremental *inc, const ManifestEntry *m, const FileInfo *info)
+{
+    if (m->device != info->device || m->inode != info->inode || m->size != (uint64_t)info->size ||
+        m->modified_nsec != info->modified_nsec || m->changed_nsec != info->changed_nsec)
+        return false;
+
+    // A file changed within the timestamp granularity of the previous run
+    // could look unchanged; only trust files that were settled before it
+    if (info->modified_nsec >= inc->previous_started_nsec || info->changed_nsec >= inc->previous_started_nsec)
+        return false;
+
+    return m->offset <= inc->previous_output_size && m->length <= inc->previous_output_size - m->offset;
+}
+
+int incremental_plan(Incremental *inc, FconcatContext *ctx, FileTree *tree)
+{
+    if (!inc || !ctx || !tree)
+        return -1;
+
+    free(inc->plan);
+    inc->plan = calloc(tree->count ? tree->count : 1, sizeof(ManifestEntry *));
+    if (!inc->plan)
+        return -1;
+    inc->plan_count = tree->count;
+
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    if (!inc->unusable && !(format_engine_active_capabilities(internal->format_engine) & FORMAT_CAP_SELF_CONTAINED_FILES))
+        inc->unusable = "the output format does not render files independently";
+    if (!inc->unusable && config->plugin_count > 0)
+        inc->unusable = "plugins are loaded";
+    if (!inc->unusable && config->dedup)
+        inc->unusable = "deduplicated files refer to other files";
+
+    if (inc->unusable)
+    {
+        ctx->log(ctx, LOG_DEBUG, "Incremental: rendering every file (%s)", inc->unusable);
+        return 0;
+    }
+
+    size_t reusable = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        TreeEntry *entry = &tree->entries[i];
+        if (entry->type == ENTRY_TYPE_DIRECTORY)
+            continue;
+
+        const ManifestEntry *m = manifest_find(inc, entry->path);
+        if (!m || !entry_unchanged(inc, m, &entry->info))
+            continue;
+
+        inc->plan[i] = m;
+        reusable++;
+        if (m->flags & MANIFEST_BINARY_CHECKED)
+        {
+            entry->info.binary_checked = true;
+            entry->info.is_binary = (m->flags & MANIFEST_BINARY) != 0;
+        }
+    }
+
+    ctx->log(ctx, LOG_DEBUG, "Incremental: %zu of %zu files unchanged", reusable, tree->file_count);
+    return 0;
+}
+
+bool incremental_reusable(const Incremental *inc, size_t entry_index)
+{
+    return inc && inc->plan && entry_index < inc->plan_count && inc->plan[entry_index] != NULL;
+}
+
+static int write_record(Incremental *inc, const char *path, const FileInfo *info, uint64_t offset, uint64_t length)
+{
+    ManifestRecord record = {0};
+    size_t path_length = strlen(path);
+    record.device = info->device;
+    record.inode = info->inode;
+    record.size = (uint64_t)info->size;
+    record.modified_nsec = info->modified_nsec;
+    record.changed_nsec = info->changed_nsec;
+    record.offset = offset;
+    record.length = length;
+    record.flags = (info->binary_checked ? MANIFEST_BINARY_CHECKED : 0) | (info->is_binary ? MANIFEST_BINARY : 0);
+    record.path_length = (uint32_t)path_length;
+
+    if (fwrite(&record, sizeof(record), 1, inc->manifest) != 1 ||
+        fwrite(path, 1, path_length + 1, inc->manifest) != path_length + 1)
+    {
+        inc->write_error = true;
+        return -1;
+    }
+    inc->recorded++;
+    return 0;
+}
+
+int incremental_flush(Incremental *inc, FconcatContext *ctx)
+{
+    if (!inc || inc->pending_length == 0)
+        return 0;
+
+    size_t length = (size_t)inc->pending_length;
+    size_t copied = 0;
+    int result = context_write_output_fd(ctx, inc->previous_fd, (off_t)inc->pending_offset, length, &copied);
+    inc->pending_length = 0;
+
+    if (result != 0 || copied != length)
+    {
+        ctx->error(ctx, "Cannot copy unchanged files from the previous output: %s",
+                   result != 0 ? strerror(errno) : "file was truncated");
+        return -1;
+    }
+    return 0;
+}
+
+int incremental_reuse(Incremental *inc, FconcatContext *ctx, FileTree *tree, size_t entry_index)
+{
+    if (!incremental_reusable(inc, entry_index) || !ctx || !tree || entry_index >= tree->count)
+        return -1;
+
+    const ManifestEntry *m = inc->plan[entry_index];
+    TreeEntry *entry = &tree->entries[entry_index];
+
+    if (inc->pending_length && inc->pending_offset + inc->pending_length != m->offset)
+    {
+        if (incremental_flush(inc, ctx) != 0)
+            return -1;
+    }
+
+    off_t offset = context_output_offset(ctx);
+    if (offset < 0)
+        return -1;
+    offset += (off_t)inc->pending_length;
+
+    if (inc->pending_length == 0)
+        inc->pending_offset = m->offset;
+    inc->pending_length += m->length;
+    inc->reused++;
+
+    ProcessingStats *stats = (ProcessingStats *)ctx->stats;
+    if (stats)
+    {
+        stats->total_files++;
+        stats->processed_files++;
+    }
+    ctx->current_file_path = entry->path;
+    ctx->current_file_processed_bytes = 0;
+    update_context_progress(ctx, entry->info.size);
+    progress_reporter_add(((InternalContextState *)ctx->internal_state)->progress, 0, 1);
+
+    write_record(inc, entry->path, &entry->info, (uint64_t)offset, m->length);
+    return 0;
+}
+
+int incremental_record(Incremental *inc, const char *path, const FileInfo *info, off_t offset, off_t length)
+{
+    if (!inc || !path || !info || offset < 0 || length < 0)
+        return -1;
+    return write_record(inc, path, info, (uint64_t)offset, (uint64_t)length);
+}
+
+int incremental_commit(Incremental *inc, FILE *output_file)
+{
+    if (!inc || !output_file || !inc->output_temp)
+        return -1;
+    if (inc->write_error)
+    {
+        errno = EIO;
+        return -1;
+    }
+
+    struct stat st;
+    if (fflush(output_file) != 0 || fstat(fileno(output_file), &st) != 0)
+        return -1;
+
+    ManifestHeader header = {0};
+    memcpy(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    header.version = MANIFEST_VERSION;
+    header.fingerprint = inc->fingerprint;
+    header.started_nsec = inc->started_nsec;
+    header.output_device = (uint64_t)st.st_dev;
+    header.output_inode = (uint64_t)st.st_ino;
+    header.output_size = (uint64_t)st.st_size;
+    header.output_modified_nsec = timespec_nsec(st.st_mtim);
+    header.entry_count = inc->recorded;
+
+    int result = 0;
+    if (fseek(inc->manifest, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, inc->manifest) != 1)
+        result = -1;
+    if (fclose(inc->manifest) != 0)
+        result = -1;
+    inc->manifest = NULL;
+    if (result != 0)
+        return -1;
+
+    // Output first: a manifest naming the old output is simply not trusted
+    if (rename(inc->output_temp, inc->output_path) != 0)
+        return -1;
+    free(inc->output_temp);
+    inc->output_temp = NULL;
+
+    if (rename(inc->cache_temp, inc->cache_path) != 0)
+        return -1;
+    free(inc->cache_temp);
+    inc->cache_temp = NULL;
+    return 0;
+}
+
+size_t incremental_reused_count(const Incremental *inc)
+{
+    return inc ? inc->reused : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef CORE_INCREMENTAL_H
+#define CORE_INCREMENTAL_H
+
+#include "context.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Incremental runs. The manifest written next to each output records,
+    // per file, what the file looked like (device, inode, size, mtime, ctime),
+    // its binary verdict and where its rendered block (header to footer)
+    // sits in the output. The next run copies the blocks of unchanged files
+    // from the previous output in the kernel and renders only the rest.
+    //
+    // The new output is written to a temporary file beside the old one and
+    // renamed over it on success, so the old output stays readable for the
+    // whole run and survives a failed one.
+    typedef struct Incremental Incremental;
+
+    // One file of a manifest
+    typedef struct
+    {
+        const char *path;
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        int64_t modified_nsec;
+        int64_t changed_nsec;
+        uint64_t offset; // Rendered block in the output
+        uint64_t length;
+        uint32_t flags;  // MANIFEST_*
+    } ManifestEntry;
+
+#define MANIFEST_BINARY_CHECKED 0x1u
+#define MANIFEST_BINARY 0x2u
+
+    // Load the manifest at cache_path. It is only trusted if it was made by
+    // this build with the same rendering options and output_path is still
+    // the file it describes; otherwise every file is rendered. A missing
+    // cache is not an error.
+    Incremental *incremental_open(const ResolvedConfig *config, const char *cache_path, const char *output_path);
+    // Drops temporary files that were not committed
+    void incremental_close(Incremental *inc);
+
+    // Create the file the new output is written to
+    FILE *incremental_create_output(Incremental *inc);
+
+    // Decide which entries of the tree can be reused and restore their
+    // binary verdicts. Reuse is off when the formatter or filter plugins
+    // could make a block depend on more than the file itself.
+    int incremental_plan(Incremental *inc, FconcatContext *ctx, struct FileTree *tree);
+    bool incremental_reusable(const Incremental *inc, size_t entry_index);
+
+    // Emit the block of a reusable entry. Adjacent blocks are merged and
+    // copied together, so call incremental_flush() before other output.
+    int incremental_reuse(Incremental *inc, FconcatContext *ctx, struct FileTree *tree, size_t entry_index);
+    int incremental_flush(Incremental *inc, FconcatContext *ctx);
+
+    // Record a block rendered in this run
+    int incremental_record(Incremental *inc, const char *path, const FileInfo *info, off_t offset, off_t length);
+
+    // After the output is complete and flushed: write the manifest and move
+    // both files into place
+    int incremental_commit(Incremental *inc, FILE *output_file);
+
+    size_t incremental_reused_count(const Incremental *inc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_INCREMENTAL_H */
@@ -0,0 +1,151 @@
+#include "inode_set.h"
+#include <stdlib.h>
+
+#define INODE_SET_INITIAL_CAPACITY 64
+
+typedef struct
+{
+    uint64_t device;
+    uint64_t inode;
+    bool used;
+} InodeSlot;
+
+struct InodeSet
+{
+    InodeSlot *slots;
+    size_t capacity; // Power of two, kept at most 3/4 full
+    size_t count;
+};
+
+// Inodes are mostly small and sequential; mix them so neighbours spread
+static size_t inode_slot_for(uint64_t device, uint64_t inode, size_t capacity)
+{
+    uint64_t x = inode ^ (device * 0x9E3779B97F4A7C15ULL);
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ULL;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return (size_t)x & (capacity - 1);
+}
+
+InodeSet *inode_set_create(void)
+{
+    InodeSet *set = calloc(1, sizeof(InodeSet));
+    if (!set)
+        return NULL;
+
+    set->slots = calloc(INODE_SET_INITIAL_CAPACITY, sizeof(InodeSlot));
+    if (!set->slots)
+    {
+        free(set);
+        return NULL;
+    }
+    set->capacity = INODE_SET_INITIAL_CAPACITY;
+    return set;
+}
+
+void inode_set_destroy(InodeSet *set)
+{
+    if (!set)
+        return;
+    free(set->slots);
+    free(set);
+}
+
+// Slot holding the pair, or the empty slot where it would go
+static size_t inode_set_find(const InodeSet *set, uint64_t device, uint64_t inode)
+{
+    size_t mask = set->capacity - 1;
+    size_t i = inode_slot_for(device, inode, set->capacity);
+    while (set->slots[i].used && (set->slots[i].device != device || set->slots[i].inode != inode))
+        i = (i + 1) & mask;
+    return i;
+}
+
+static int inode_set_grow(InodeSet *set)
+{
+    size_t capacity = set->capacity * 2;
+    InodeSlot *slots = calloc(capacity, sizeof(InodeSlot));
+    if (!slots)
+        return -1;
+
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        const InodeSlot *slot = &set->slots[i];
+        if (!slot->used)
+            continue;
+        size_t j = inode_slot_for(slot->device, slot->inode, capacity);
+        while (slots[j].used)
+            j = (j + 1) & (capacity - 1);
+        slots[j] = *slot;
+    }
+    free(set->slots);
+    set->slots = slots;
+    set->capacity = capacity;
+    return 0;
+}
+
+int inode_set_insert(InodeSet *set, uint64_t device, uint64_t inode)
+{
+    if (!set)
+        return -1;
+
+    size_t i = inode_set_find(set, device, inode);
+    if (set->slots[i].used)
+        return 0;
+
+    if ((set->count + 1) * 4 > set->capacity * 3)
+    {
+        if (inode_set_grow(set) != 0)
+            return -1;
+        i = inode_set_find(set, device, inode);
+    }
+
+    set->slots[i] = (InodeSlot){device, inode, true};
+    set->count++;
+    return 1;
+}
+
+bool inode_set_contains(const InodeSet *set, uint64_t device, uint64_t inode)
+{
+    return set && set->slots[inode_set_find(set, device, inode)].used;
+}
+
+void inode_set_remove(InodeSet *set, uint64_t device, uint64_t inode)
+{
+    if (!set)
+        return;
+
+    size_t mask = set->capacity - 1;
+    size_t hole = inode_set_find(set, device, inode);
+    if (!set->slots[hole].used)
+        return;
+    set->count--;
+
+    // Shift later members of the probe run back so lookups never stop
+    // early at the hole; no tombstones are left behind
+    size_t i = hole;
+    for (;;)
+    {
+        set->slots[hole].used = false;
+        for (;;)
+        {
+            i = (i + 1) & mask;
+            if (!set->slots[i].used)
+                return;
+            size_t home = inode_slot_for(set->slots[i].device, set->slots[i].inode, set->capacity);
+            // Movable unless its home lies cyclically in (hole, i]
+            bool stays = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!stays)
+                break;
+        }
+        set->slots[hole] = set->slots[i];
+        hole = i;
+    }
+}
+
+size_t inode_set_count(const InodeSet *set)
+{
+    return set ? set->count : 0;
+}
@@ -0,0 +1,34 @@
+#ifndef CORE_INODE_SET_H
+#define CORE_INODE_SET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // (device, inode) pairs in an open-addressing table with linear
+    // probing: inserts, lookups and removals cost O(1) on average however
+    // many entries the walk has seen. Not thread safe.
+    typedef struct InodeSet InodeSet;
+
+    InodeSet *inode_set_create(void);
+    void inode_set_destroy(InodeSet *set);
+
+    // 1 when the pair was added, 0 when it was already there, -1 when the
+    // table could not grow
+    int inode_set_insert(InodeSet *set, uint64_t device, uint64_t inode);
+    bool inode_set_contains(const InodeSet *set, uint64_t device, uint64_t inode);
+    // Removing a pair that is not there does nothing
+    void inode_set_remove(InodeSet *set, uint64_t device, uint64_t inode);
+
+    size_t inode_set_count(const InodeSet *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_INODE_SET_H */
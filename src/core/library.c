@@ -0,0 +1,325 @@
+#include "../../include/fconcat_library.h"
+#include "context.h"
+#include "compress.h"
+#include "error.h"
+#include "memory.h"
+#include "tree.h"
+#include "../config/config.h"
+#include "../filter/filter.h"
+#include "../format/format.h"
+#include "../plugins/plugin.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// Everything main() sets up once per process lives in the handle instead:
+// the managers, the resolved config, the engines, one context whose output
+// is pointed at the caller's writer for the length of each run, and the
+// tree every run is walked into.
+struct FconcatLibrary
+{
+    ErrorManager *error_manager;
+    MemoryManager *memory_manager;
+    PluginManager *plugin_manager;
+    ConfigManager *config_manager;
+    ResolvedConfig *config;
+    FormatEngine *format_engine;
+    FilterEngine *filter_engine;
+    FconcatContext *ctx;
+    FileTree *tree;
+    ProcessingStats stats;
+
+    // The run in progress
+    FconcatWriteFn write;
+    void *user_data;
+    size_t output_bytes;
+};
+
+static int library_write(void *opaque, const void *data, size_t size)
+{
+    FconcatLibrary *library = opaque;
+    if (library->write(data, size, library->user_data) != 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    library->output_bytes += size;
+    return 0;
+}
+
+static int library_append(const void *data, size_t size, void *user_data)
+{
+    FconcatBuffer *buffer = user_data;
+    if (size > SIZE_MAX - buffer->size)
+        return -1;
+
+    if (buffer->size + size > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 64 * 1024;
+        while (capacity < buffer->size + size)
+            capacity = capacity > SIZE_MAX / 2 ? buffer->size + size : capacity * 2;
+        char *data_grown = realloc(buffer->data, capacity);
+        if (!data_grown)
+            return -1;
+        buffer->data = data_grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+    return 0;
+}
+
+// The command line minus the interactive parts: no signal handling, no
+// shutdown checks and nothing printed
+static int library_render(FconcatContext *ctx, FileTree *tree)
+{
+    FormatEngine *engine = ((InternalContextState *)ctx->internal_state)->format_engine;
+
+    if (format_engine_begin_document(engine, ctx) != 0 || format_engine_begin_structure(engine, ctx) != 0 ||
+        process_tree_structure(ctx, tree) != 0 || format_engine_end_structure(engine, ctx) != 0 ||
+        format_engine_begin_content(engine, ctx) != 0 || process_tree_content(ctx, tree) != 0 ||
+        format_engine_end_content(engine, ctx) != 0 || format_engine_end_document(engine, ctx) != 0)
+        return -1;
+
+    return context_flush_output(ctx);
+}
+
+static int library_build_tree(FconcatLibrary *library)
+{
+    const ResolvedConfig *config = library->config;
+    if (!config->files_from)
+        return file_tree_build(library->ctx, library->tree, config->input_directory, "", 0);
+
+    size_t size = 0;
+    char *list = file_tree_read_list(config->files_from, &size);
+    if (!list)
+    {
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot read file list %s: %s",
+                     config->files_from, strerror(errno));
+        return -1;
+    }
+    int result = file_tree_build_from_list(library->ctx, library->tree, config->input_directory, list, size);
+    free(list);
+    return result;
+}
+
+// Options the command line accepts that only make sense with an output
+// file, checked once the parser has told option values from options
+static const char *library_rejected_option(const ResolvedConfig *config)
+{
+    if (config->watch)
+        return "--watch";
+    if (config->incremental_cache)
+        return "--incremental";
+    if (config->shard_size > 0)
+        return "--shard-size";
+    if (config->shards > 0)
+        return "--shards";
+    return NULL;
+}
+
+static int library_configure(FconcatLibrary *library, int argc, const char *const *options)
+{
+    // The parser expects the program name, the input and the output first;
+    // the input is set for each run and there is no output file
+    char **argv = calloc((size_t)argc + 4, sizeof(char *));
+    if (!argv)
+        return -1;
+    argv[0] = "fconcat";
+    argv[1] = ".";
+    argv[2] = "";
+    for (int i = 0; i < argc; i++)
+        argv[i + 3] = (char *)options[i];
+
+    library->config_manager = config_manager_create();
+    int result = -1;
+    if (!library->config_manager || config_load_defaults(library->config_manager) != 0 ||
+        config_load_cli(library->config_manager, argc + 3, argv) != 0 ||
+        !(library->config = config_resolve(library->config_manager)))
+    {
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_CONFIG_INVALID, "Failed to load the options");
+        goto done;
+    }
+
+    const char *rejected = library_rejected_option(library->config);
+    if (rejected)
+    {
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_INVALID_ARGS, "%s cannot be used through the library",
+                     rejected);
+        goto done;
+    }
+
+    free(library->config->output_file);
+    library->config->output_file = NULL;
+    library->config->interactive = false;
+
+    if (library->config->compression != OUTPUT_COMPRESS_NONE && !compress_available(library->config->compression))
+    {
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_CONFIG_INVALID, "This build has no %s support",
+                     compress_name(library->config->compression));
+        goto done;
+    }
+    result = 0;
+
+done:
+    free(argv);
+    return result;
+}
+
+FconcatLibrary *fconcat_library_create(int argc, const char *const *options)
+{
+    if (argc < 0 || (argc > 0 && !options))
+        return NULL;
+
+    FconcatLibrary *library = calloc(1, sizeof(FconcatLibrary));
+    if (!library)
+        return NULL;
+
+    library->error_manager = error_manager_create();
+    library->memory_manager = memory_manager_create();
+    library->plugin_manager = plugin_manager_create();
+    if (!library->error_manager || !library->memory_manager || !library->plugin_manager)
+        goto fail;
+
+    if (library_configure(library, argc, options) != 0)
+        goto fail;
+
+    ErrorManager *errors = library->error_manager;
+    library->format_engine = format_engine_create();
+    library->filter_engine = filter_engine_create();
+    if (!library->format_engine || !library->filter_engine)
+    {
+        ERROR_REPORT(errors, FCONCAT_ERROR_OUT_OF_MEMORY, "Failed to create the engines");
+        goto fail;
+    }
+
+    if (format_engine_configure(library->format_engine, library->config, NULL) != 0 ||
+        filter_engine_configure(library->filter_engine, library->config) != 0 ||
+        plugin_manager_configure(library->plugin_manager, library->config, library->format_engine,
+                                 library->filter_engine) != 0)
+    {
+        ERROR_REPORT(errors, FCONCAT_ERROR_CONFIG_INVALID, "Failed to configure the engines");
+        goto fail;
+    }
+
+    // Without an output the context has no sink until a run gives it one
+    library->ctx = create_fconcat_context(library->config, NULL, &library->stats, errors, library->memory_manager,
+                                          library->plugin_manager, library->format_engine, library->filter_engine);
+    library->tree = file_tree_create();
+    if (!library->ctx || !library->tree)
+    {
+        ERROR_REPORT(errors, FCONCAT_ERROR_OUT_OF_MEMORY, "Failed to create the processing context");
+        goto fail;
+    }
+
+    plugin_manager_initialize_plugins(library->plugin_manager, library->ctx);
+    filter_engine_seal(library->filter_engine);
+    return library;
+
+fail:
+    fconcat_library_destroy(library);
+    return NULL;
+}
+
+void fconcat_library_destroy(FconcatLibrary *library)
+{
+    if (!library)
+        return;
+
+    // Same order as the command line: plugins still see the context
+    if (library->plugin_manager)
+        plugin_manager_destroy(library->plugin_manager, library->ctx);
+    file_tree_destroy(library->tree);
+    destroy_fconcat_context(library->ctx);
+    if (library->format_engine)
+        format_engine_destroy(library->format_engine);
+    if (library->filter_engine)
+        filter_engine_destroy(library->filter_engine);
+    if (library->config_manager)
+        config_manager_destroy(library->config_manager);
+    memory_manager_destroy(library->memory_manager);
+    error_manager_destroy(library->error_manager);
+    free(library);
+}
+
+int fconcat_library_run(FconcatLibrary *library, const char *input_directory, FconcatWriteFn write,
+                        void *user_data, FconcatRunStats *stats)
+{
+    if (stats)
+        memset(stats, 0, sizeof(*stats));
+    if (!library || !input_directory || !write)
+        return -1;
+
+    // The walk only warns about an unreadable root and yields an empty
+    // document, which a caller could not tell from an empty directory
+    struct stat st;
+    int found = stat(input_directory, &st);
+    if (found != 0 || !S_ISDIR(st.st_mode))
+    {
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot read %s: %s", input_directory,
+                     found != 0 ? strerror(errno) : "Not a directory");
+        return -1;
+    }
+
+    char *directory = strdup(input_directory);
+    if (!directory)
+        return -1;
+    free(library->config->input_directory);
+    library->config->input_directory = directory;
+
+    library->write = write;
+    library->user_data = user_data;
+    library->output_bytes = 0;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    memset(&library->stats, 0, sizeof(library->stats));
+    library->stats.start_time = (double)start.tv_sec + start.tv_nsec / 1000000000.0;
+    file_tree_clear(library->tree);
+
+    int result = -1;
+    if (context_restart_writer(library->ctx, library_write, library) != 0)
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_OUT_OF_MEMORY, "Failed to set up the output");
+    else if (library_build_tree(library) != 0)
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot read %s", input_directory);
+    else if (library_render(library->ctx, library->tree) != 0)
+        ERROR_REPORT(library->error_manager, FCONCAT_ERROR_IO_ERROR, "Failed to render %s", input_directory);
+    else
+        result = 0;
+
+    // Let go of the writer so nothing reaches it once the run has returned
+    if (context_restart(library->ctx, NULL) != 0)
+        result = -1;
+
+    if (stats)
+    {
+        stats->files = library->stats.processed_files;
+        stats->bytes = library->stats.processed_bytes;
+        stats->skipped_files = library->stats.skipped_files;
+        stats->output_bytes = library->output_bytes;
+    }
+    library->write = NULL;
+    library->user_data = NULL;
+    return result;
+}
+
+int fconcat_library_run_buffer(FconcatLibrary *library, const char *input_directory, FconcatBuffer *buffer,
+                               FconcatRunStats *stats)
+{
+    if (!buffer)
+    {
+        if (stats)
+            memset(stats, 0, sizeof(*stats));
+        return -1;
+    }
+    buffer->size = 0;
+    return fconcat_library_run(library, input_directory, library_append, buffer, stats);
+}
+
+const char *fconcat_library_error(const FconcatLibrary *library)
+{
+    return library ? error_get_last_message(library->error_manager) : NULL;
+}
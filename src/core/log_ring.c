@@ -0,0 +1,281 @@
+#include "log_ring.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Lines gathered before one write()
+#define LOG_RING_BATCH_SIZE (64 * 1024)
+// How long the drain thread sleeps when the ring is empty
+#define LOG_RING_IDLE_NS (5 * 1000 * 1000)
+
+typedef struct
+{
+    // Equal to the position when free for that lap, position + 1 once the
+    // line at that position is published
+    atomic_size_t sequence;
+    unsigned short length;
+    char text[LOG_RING_LINE_MAX];
+} LogSlot;
+
+struct LogRing
+{
+    LogSlot *slots;
+    size_t mask;
+    int fd;
+
+    _Alignas(64) atomic_size_t enqueue_pos; // Next position a producer claims
+    _Alignas(64) atomic_size_t written;     // Positions below this are out
+    atomic_size_t dropped;
+    atomic_bool stopping;
+
+    size_t dequeue_pos; // Drain thread only
+    char *batch;
+    size_t batch_used;
+
+    pthread_t thread;
+    pthread_mutex_t mutex; // Only for sleeping and waking, never on the push path
+    pthread_cond_t wake;
+    pthread_cond_t drained;
+};
+
+static void write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return; // Nowhere to report a failing log descriptor
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+static void flush_batch(LogRing *ring)
+{
+    write_all(ring->fd, ring->batch, ring->batch_used);
+    ring->batch_used = 0;
+}
+
+// Move published lines into the batch, stopping at the first slot still
+// being written; returns how many were taken
+static size_t drain_published(LogRing *ring)
+{
+    size_t taken = 0;
+    for (;;)
+    {
+        LogSlot *slot = &ring->slots[ring->dequeue_pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence != ring->dequeue_pos + 1)
+            break;
+
+        if (ring->batch_used + slot->length > LOG_RING_BATCH_SIZE)
+            flush_batch(ring);
+        memcpy(ring->batch + ring->batch_used, slot->text, slot->length);
+        ring->batch_used += slot->length;
+
+        // Free for the producer one lap ahead
+        atomic_store_explicit(&slot->sequence, ring->dequeue_pos + ring->mask + 1, memory_order_release);
+        ring->dequeue_pos++;
+        taken++;
+    }
+
+    if (ring->batch_used > 0)
+        flush_batch(ring);
+    if (taken > 0)
+        atomic_store_explicit(&ring->written, ring->dequeue_pos, memory_order_release);
+    return taken;
+}
+
+static void *drain_thread(void *arg)
+{
+    LogRing *ring = arg;
+    for (;;)
+    {
+        bool stopping = atomic_load_explicit(&ring->stopping, memory_order_acquire);
+        size_t taken = drain_published(ring);
+
+        pthread_mutex_lock(&ring->mutex);
+        if (taken > 0)
+            pthread_cond_broadcast(&ring->drained);
+        // Every producer finished before stopping was set, so the pass
+        // above emptied the ring
+        if (stopping)
+        {
+            pthread_mutex_unlock(&ring->mutex);
+            return NULL;
+        }
+        if (taken == 0)
+        {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_RING_IDLE_NS;
+            if (deadline.tv_nsec >= 1000000000L)
+            {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&ring->wake, &ring->mutex, &deadline);
+        }
+        pthread_mutex_unlock(&ring->mutex);
+    }
+}
+
+LogRing *log_ring_create(int fd, size_t slots)
+{
+    if (fd < 0)
+        return NULL;
+
+    size_t capacity = 2;
+    while (capacity < slots && capacity < ((size_t)1 << 20))
+        capacity *= 2;
+
+    LogRing *ring = calloc(1, sizeof(LogRing));
+    if (!ring)
+        return NULL;
+    ring->slots = malloc(capacity * sizeof(LogSlot));
+    ring->batch = malloc(LOG_RING_BATCH_SIZE);
+    if (!ring->slots || !ring->batch)
+    {
+        free(ring->slots);
+        free(ring->batch);
+        free(ring);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < capacity; i++)
+        atomic_init(&ring->slots[i].sequence, i);
+    ring->mask = capacity - 1;
+    ring->fd = fd;
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->written, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->stopping, false);
+
+    pthread_mutex_init(&ring->mutex, NULL);
+    pthread_cond_init(&ring->wake, NULL);
+    pthread_cond_init(&ring->drained, NULL);
+    if (pthread_create(&ring->thread, NULL, drain_thread, ring) != 0)
+    {
+        pthread_cond_destroy(&ring->drained);
+        pthread_cond_destroy(&ring->wake);
+        pthread_mutex_destroy(&ring->mutex);
+        free(ring->slots);
+        free(ring->batch);
+        free(ring);
+        return NULL;
+    }
+    return ring;
+}
+
+void log_ring_destroy(LogRing *ring)
+{
+    if (!ring)
+        return;
+
+    pthread_mutex_lock(&ring->mutex);
+    atomic_store_explicit(&ring->stopping, true, memory_order_release);
+    pthread_cond_signal(&ring->wake);
+    pthread_mutex_unlock(&ring->mutex);
+    pthread_join(ring->thread, NULL);
+
+    size_t dropped = atomic_load(&ring->dropped);
+    if (dropped > 0)
+    {
+        char line[96];
+        int length = snprintf(line, sizeof(line), "[WARNING] %zu log messages dropped (--log-async ring full)\n",
+                              dropped);
+        if (length > 0)
+            write_all(ring->fd, line, (size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1);
+    }
+
+    pthread_cond_destroy(&ring->drained);
+    pthread_cond_destroy(&ring->wake);
+    pthread_mutex_destroy(&ring->mutex);
+    free(ring->slots);
+    free(ring->batch);
+    free(ring);
+}
+
+int log_ring_vpush(LogRing *ring, const char *prefix, const char *format, va_list args)
+{
+    if (!ring || !format)
+        return -1;
+
+    // Claim a position whose slot the drain thread has already freed
+    LogSlot *slot;
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    for (;;)
+    {
+        slot = &ring->slots[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return -1;
+        }
+        else
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    }
+
+    // The arguments may point at buffers the caller reuses as soon as it
+    // returns, so the line is formatted here rather than by the drain thread
+    size_t room = sizeof(slot->text) - 1; // Keeps space for the newline
+    size_t length = 0;
+    if (prefix)
+    {
+        size_t prefix_len = strlen(prefix);
+        length = prefix_len < room ? prefix_len : room;
+        memcpy(slot->text, prefix, length);
+    }
+    int formatted = vsnprintf(slot->text + length, room - length + 1, format, args);
+    if (formatted > 0)
+    {
+        if ((size_t)formatted > room - length)
+        {
+            length = room;
+            memcpy(slot->text + length - 3, "...", 3);
+        }
+        else
+            length += (size_t)formatted;
+    }
+    slot->text[length++] = '\n';
+    slot->length = (unsigned short)length;
+
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return 0;
+}
+
+void log_ring_flush(LogRing *ring)
+{
+    if (!ring)
+        return;
+
+    size_t target = atomic_load_explicit(&ring->enqueue_pos, memory_order_acquire);
+    pthread_mutex_lock(&ring->mutex);
+    while (atomic_load_explicit(&ring->written, memory_order_acquire) < target)
+    {
+        pthread_cond_signal(&ring->wake);
+        pthread_cond_wait(&ring->drained, &ring->mutex);
+    }
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+size_t log_ring_dropped(const LogRing *ring)
+{
+    return ring ? atomic_load(&ring->dropped) : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef CORE_LOG_RING_H
+#define CORE_LOG_RING_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Bounded queue of formatted log lines behind --log-async. Any thread
+    // claims a slot with one compare-and-swap, formats straight into it and
+    // publishes it; a drain thread concatenates published lines and writes
+    // them to the descriptor in batches. Nothing on the logging side takes
+    // a lock or touches stdio. When every slot is taken the line is dropped
+    // and counted instead of waiting for the drain thread.
+    typedef struct LogRing LogRing;
+
+    // Longer lines are cut short, ending in "..."
+#define LOG_RING_LINE_MAX 512
+#define LOG_RING_DEFAULT_SLOTS 4096
+
+    // slots is rounded up to a power of two; NULL when the drain thread
+    // cannot be started
+    LogRing *log_ring_create(int fd, size_t slots);
+
+    // Writes what is queued, stops the drain thread and reports the number
+    // of dropped lines, if any, as a last line
+    void log_ring_destroy(LogRing *ring);
+
+    // Queue "<prefix><formatted>\n"; 0 when queued, -1 when dropped
+    int log_ring_vpush(LogRing *ring, const char *prefix, const char *format, va_list args);
+
+    // Block until every line queued before the call has been written
+    void log_ring_flush(LogRing *ring);
+
+    size_t log_ring_dropped(const LogRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_LOG_RING_H */
@@ -4,10 +4,12 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
 #include <pthread.h>
+#include <sys/mman.h>
 
 // Allocation header for accurate memory tracking
 // Magic values are randomized at startup to prevent predictable exploitation
@@ -98,120 +100,315 @@ static inline int verify_tail_canary(AllocationHeader *header) {
     return (*canary == g_memory_canary);
 }
 
-#define SMALL_BUFFER_SIZE 4096   // 4KB
-#define MEDIUM_BUFFER_SIZE 16384 // 16KB
-#define LARGE_BUFFER_SIZE 65536  // 64KB
+// ============================================================================
+// SIZE-CLASSED BUFFER POOL
+// ============================================================================
 
-#define SMALL_BUFFER_COUNT 20  // 20 small buffers
-#define MEDIUM_BUFFER_COUNT 10 // 10 medium buffers
-#define LARGE_BUFFER_COUNT 5   // 5 large buffers
+#define POOL_CLASS_COUNT 5
+#define POOL_SLAB_SIZE (2 * 1024 * 1024) // Slabs are aligned to their size
+#define POOL_MAX_SLABS 4096              // 8GB of buffers before malloc fallback
+#define POOL_REGISTRY_SIZE (POOL_MAX_SLABS * 2)
+#define POOL_CACHE_SLOTS 8               // Buffers kept per class per thread
 
-#define TOTAL_POOL_SIZE (SMALL_BUFFER_COUNT + MEDIUM_BUFFER_COUNT + LARGE_BUFFER_COUNT)
+static const size_t g_pool_class_sizes[POOL_CLASS_COUNT] = {
+    4096, 16384, 65536, 262144, 1048576};
 
-BufferPool *buffer_pool_create(void)
+typedef struct
 {
-    BufferPool *pool = calloc(1, sizeof(BufferPool));
-    if (!pool)
-        return NULL;
+    char *base;
+    int size_class;
+} PoolSlab;
+
+// Free lists are Treiber stacks. A head packs a change counter (high 32
+// bits, defeats ABA) with the encoded block id (low 32 bits, 0 = empty);
+// a free block stores the encoded id of the next one in its first bytes.
+// Block id = slab index << 16 | block index within the slab.
+struct BufferPool
+{
+    uint64_t id;
+    _Atomic uint64_t free_heads[POOL_CLASS_COUNT];
+
+    PoolSlab *slabs;
+    atomic_int slab_count;
+    pthread_mutex_t grow_mutex; // Serialises slab creation only
+
+    // Open-addressed slab base -> slab index map, insert-only, read lock-free
+    _Atomic uintptr_t *registry_keys;
+    int *registry_values;
 
-    pool->pool_size = TOTAL_POOL_SIZE;
-    pool->small_buffer_count = SMALL_BUFFER_COUNT;
-    pool->medium_buffer_count = MEDIUM_BUFFER_COUNT;
-    pool->large_buffer_count = LARGE_BUFFER_COUNT;
+    atomic_size_t cache_hits;
+    atomic_size_t shared_hits;
+    atomic_size_t grow_count;
+    atomic_size_t oversize_count;
+    atomic_size_t fallback_count;
 
-    // Allocate arrays
-    pool->buffers = malloc(pool->pool_size * sizeof(char *));
-    pool->buffer_sizes = malloc(pool->pool_size * sizeof(size_t));
-    pool->in_use = calloc(pool->pool_size, sizeof(bool));
+    struct BufferPool *next_live;
+};
 
-    if (!pool->buffers || !pool->buffer_sizes || !pool->in_use)
+// Per-thread cache, bound to one pool at a time
+typedef struct
+{
+    BufferPool *pool;
+    uint64_t pool_id;
+    int count[POOL_CLASS_COUNT];
+    char *blocks[POOL_CLASS_COUNT][POOL_CACHE_SLOTS];
+} PoolThreadCache;
+
+static _Thread_local PoolThreadCache t_pool_cache;
+
+// Live pools, so a cache flushed at thread exit never touches a destroyed pool
+static pthread_mutex_t g_live_pools_mutex = PTHREAD_MUTEX_INITIALIZER;
+static BufferPool *g_live_pools = NULL;
+static atomic_uint_fast64_t g_next_pool_id = 1;
+
+static pthread_key_t g_pool_cache_key;
+static pthread_once_t g_pool_cache_key_once = PTHREAD_ONCE_INIT;
+
+static int pool_class_for(size_t size)
+{
+    for (int c = 0; c < POOL_CLASS_COUNT; c++)
     {
-        free(pool->buffers);
-        free(pool->buffer_sizes);
-        free(pool->in_use);
-        free(pool);
-        return NULL;
+        if (size <= g_pool_class_sizes[c])
+            return c;
     }
+    return -1;
+}
+
+static inline uint32_t pool_encode(int slab, size_t block)
+{
+    return ((uint32_t)slab << 16 | (uint32_t)block) + 1;
+}
+
+static inline char *pool_decode(BufferPool *pool, uint32_t encoded)
+{
+    uint32_t id = encoded - 1;
+    PoolSlab *slab = &pool->slabs[id >> 16];
+    return slab->base + (size_t)(id & 0xFFFF) * g_pool_class_sizes[slab->size_class];
+}
+
+static inline size_t pool_registry_slot(uintptr_t base)
+{
+    return (size_t)((base / POOL_SLAB_SIZE) * 0x9E3779B97F4A7C15ull) & (POOL_REGISTRY_SIZE - 1);
+}
 
-    int index = 0;
+// Find the slab a pointer was carved from; -1 if the pool did not hand it out
+static int pool_lookup_slab(BufferPool *pool, const char *ptr)
+{
+    uintptr_t base = (uintptr_t)ptr & ~((uintptr_t)POOL_SLAB_SIZE - 1);
+    size_t slot = pool_registry_slot(base);
 
-    // Create small buffers
-    for (int i = 0; i < SMALL_BUFFER_COUNT; i++)
+    for (size_t probe = 0; probe < POOL_REGISTRY_SIZE; probe++)
     {
-        pool->buffers[index] = malloc(SMALL_BUFFER_SIZE);
-        pool->buffer_sizes[index] = SMALL_BUFFER_SIZE;
-        if (!pool->buffers[index])
-        {
-            // Cleanup on failure
-            for (int j = 0; j < index; j++)
-            {
-                free(pool->buffers[j]);
-            }
-            free(pool->buffers);
-            free(pool->buffer_sizes);
-            free(pool->in_use);
-            free(pool);
-            return NULL;
-        }
-        index++;
+        uintptr_t key = atomic_load_explicit(&pool->registry_keys[slot], memory_order_acquire);
+        if (key == 0)
+            return -1;
+        if (key == base)
+            return pool->registry_values[slot];
+        slot = (slot + 1) & (POOL_REGISTRY_SIZE - 1);
     }
+    return -1;
+}
+
+// Called with grow_mutex held
+static void pool_registry_insert(BufferPool *pool, uintptr_t base, int slab)
+{
+    size_t slot = pool_registry_slot(base);
+    while (atomic_load_explicit(&pool->registry_keys[slot], memory_order_relaxed) != 0)
+        slot = (slot + 1) & (POOL_REGISTRY_SIZE - 1);
 
-    // Create medium buffers
-    for (int i = 0; i < MEDIUM_BUFFER_COUNT; i++)
+    pool->registry_values[slot] = slab;
+    atomic_store_explicit(&pool->registry_keys[slot], base, memory_order_release);
+}
+
+// Push a chain of blocks already linked through their next fields, from
+// the block encoded as first_encoded up to last
+static void pool_push_chain(BufferPool *pool, int size_class, uint32_t first_encoded, char *last)
+{
+    _Atomic uint64_t *head = &pool->free_heads[size_class];
+    uint64_t old = atomic_load_explicit(head, memory_order_relaxed);
+
+    for (;;)
     {
-        pool->buffers[index] = malloc(MEDIUM_BUFFER_SIZE);
-        pool->buffer_sizes[index] = MEDIUM_BUFFER_SIZE;
-        if (!pool->buffers[index])
-        {
-            // Cleanup on failure
-            for (int j = 0; j < index; j++)
-            {
-                free(pool->buffers[j]);
-            }
-            free(pool->buffers);
-            free(pool->buffer_sizes);
-            free(pool->in_use);
-            free(pool);
+        __atomic_store_n((uint32_t *)last, (uint32_t)old, __ATOMIC_RELAXED);
+        uint64_t desired = ((old >> 32) + 1) << 32 | first_encoded;
+        if (atomic_compare_exchange_weak_explicit(head, &old, desired,
+                                                  memory_order_release, memory_order_relaxed))
+            return;
+    }
+}
+
+static void pool_push(BufferPool *pool, int size_class, char *block, uint32_t encoded)
+{
+    pool_push_chain(pool, size_class, encoded, block);
+}
+
+static char *pool_pop(BufferPool *pool, int size_class)
+{
+    _Atomic uint64_t *head = &pool->free_heads[size_class];
+    uint64_t old = atomic_load_explicit(head, memory_order_acquire);
+
+    for (;;)
+    {
+        uint32_t encoded = (uint32_t)old;
+        if (encoded == 0)
             return NULL;
-        }
-        index++;
+
+        // Slabs are never unmapped while the pool lives, so reading a block
+        // another thread just took is harmless: the CAS below then fails
+        char *block = pool_decode(pool, encoded);
+        uint32_t next = __atomic_load_n((uint32_t *)block, __ATOMIC_RELAXED);
+        uint64_t desired = ((old >> 32) + 1) << 32 | next;
+        if (atomic_compare_exchange_weak_explicit(head, &old, desired,
+                                                  memory_order_acquire, memory_order_acquire))
+            return block;
+    }
+}
+
+static uint32_t pool_block_encoding(BufferPool *pool, int slab, const char *block)
+{
+    const PoolSlab *s = &pool->slabs[slab];
+    return pool_encode(slab, (size_t)(block - s->base) / g_pool_class_sizes[s->size_class]);
+}
+
+// Carve a new slab for a class; returns one block and shares the rest
+static char *pool_grow(BufferPool *pool, int size_class)
+{
+    pthread_mutex_lock(&pool->grow_mutex);
+
+    // Another thread may have grown this class while we waited
+    char *block = pool_pop(pool, size_class);
+    if (block)
+    {
+        pthread_mutex_unlock(&pool->grow_mutex);
+        atomic_fetch_add_explicit(&pool->shared_hits, 1, memory_order_relaxed);
+        return block;
+    }
+
+    int slab = atomic_load_explicit(&pool->slab_count, memory_order_relaxed);
+    if (slab >= POOL_MAX_SLABS)
+    {
+        pthread_mutex_unlock(&pool->grow_mutex);
+        return NULL;
+    }
+
+    char *base = aligned_alloc(POOL_SLAB_SIZE, POOL_SLAB_SIZE);
+    if (!base)
+    {
+        pthread_mutex_unlock(&pool->grow_mutex);
+        return NULL;
+    }
+
+    pool->slabs[slab].base = base;
+    pool->slabs[slab].size_class = size_class;
+    pool_registry_insert(pool, (uintptr_t)base, slab);
+    atomic_store_explicit(&pool->slab_count, slab + 1, memory_order_release);
+
+    // Link blocks 1..n-1 into a chain and publish it in one CAS
+    size_t block_size = g_pool_class_sizes[size_class];
+    size_t blocks = POOL_SLAB_SIZE / block_size;
+    if (blocks > 1)
+    {
+        for (size_t i = 1; i + 1 < blocks; i++)
+            __atomic_store_n((uint32_t *)(base + i * block_size), pool_encode(slab, i + 1), __ATOMIC_RELAXED);
+        pool_push_chain(pool, size_class, pool_encode(slab, 1),
+                        base + (blocks - 1) * block_size);
     }
 
-    // Create large buffers
-    for (int i = 0; i < LARGE_BUFFER_COUNT; i++)
+    pthread_mutex_unlock(&pool->grow_mutex);
+    atomic_fetch_add_explicit(&pool->grow_count, 1, memory_order_relaxed);
+    return base;
+}
+
+static bool pool_is_live(const BufferPool *pool, uint64_t id)
+{
+    for (BufferPool *p = g_live_pools; p; p = p->next_live)
     {
-        pool->buffers[index] = malloc(LARGE_BUFFER_SIZE);
-        pool->buffer_sizes[index] = LARGE_BUFFER_SIZE;
-        if (!pool->buffers[index])
+        if (p == pool && p->id == id)
+            return true;
+    }
+    return false;
+}
+
+// Hand cached buffers back to their pool (if it still exists) and unbind
+static void pool_cache_flush(PoolThreadCache *cache)
+{
+    if (!cache->pool)
+        return;
+
+    pthread_mutex_lock(&g_live_pools_mutex);
+    if (pool_is_live(cache->pool, cache->pool_id))
+    {
+        for (int c = 0; c < POOL_CLASS_COUNT; c++)
         {
-            // Cleanup on failure
-            for (int j = 0; j < index; j++)
+            for (int i = 0; i < cache->count[c]; i++)
             {
-                free(pool->buffers[j]);
+                char *block = cache->blocks[c][i];
+                int slab = pool_lookup_slab(cache->pool, block);
+                pool_push(cache->pool, c, block, pool_block_encoding(cache->pool, slab, block));
             }
-            free(pool->buffers);
-            free(pool->buffer_sizes);
-            free(pool->in_use);
-            free(pool);
-            return NULL;
         }
-        index++;
     }
+    pthread_mutex_unlock(&g_live_pools_mutex);
+
+    memset(cache, 0, sizeof(*cache));
+}
+
+static void pool_cache_destructor(void *arg)
+{
+    pool_cache_flush((PoolThreadCache *)arg);
+}
+
+static void pool_cache_key_init(void)
+{
+    pthread_key_create(&g_pool_cache_key, pool_cache_destructor);
+}
+
+static PoolThreadCache *pool_cache_bind(BufferPool *pool)
+{
+    PoolThreadCache *cache = &t_pool_cache;
+    if (cache->pool == pool && cache->pool_id == pool->id)
+        return cache;
+
+    pool_cache_flush(cache);
+    cache->pool = pool;
+    cache->pool_id = pool->id;
+
+    // Registering the cache makes it flush when the thread exits
+    pthread_once(&g_pool_cache_key_once, pool_cache_key_init);
+    pthread_setspecific(g_pool_cache_key, cache);
+    return cache;
+}
+
+BufferPool *buffer_pool_create(void)
+{
+    BufferPool *pool = calloc(1, sizeof(BufferPool));
+    if (!pool)
+        return NULL;
+
+    pool->slabs = calloc(POOL_MAX_SLABS, sizeof(PoolSlab));
+    pool->registry_keys = calloc(POOL_REGISTRY_SIZE, sizeof(*pool->registry_keys));
+    pool->registry_values = calloc(POOL_REGISTRY_SIZE, sizeof(int));
 
-    if (pthread_mutex_init(&pool->mutex, NULL) != 0)
+    if (!pool->slabs || !pool->registry_keys || !pool->registry_values ||
+        pthread_mutex_init(&pool->grow_mutex, NULL) != 0)
     {
-        // Cleanup on failure
-        for (int i = 0; i < pool->pool_size; i++)
-        {
-            free(pool->buffers[i]);
-        }
-        free(pool->buffers);
-        free(pool->buffer_sizes);
-        free(pool->in_use);
+        free(pool->slabs);
+        free(pool->registry_keys);
+        free(pool->registry_values);
         free(pool);
         return NULL;
     }
 
+    pool->id = atomic_fetch_add(&g_next_pool_id, 1);
+    for (int c = 0; c < POOL_CLASS_COUNT; c++)
+        atomic_init(&pool->free_heads[c], 0);
+    atomic_init(&pool->slab_count, 0);
+
+    pthread_mutex_lock(&g_live_pools_mutex);
+    pool->next_live = g_live_pools;
+    g_live_pools = pool;
+    pthread_mutex_unlock(&g_live_pools_mutex);
+
     return pool;
 }
 
@@ -220,56 +417,86 @@ void buffer_pool_destroy(BufferPool *pool)
     if (!pool)
         return;
 
-    pthread_mutex_lock(&pool->mutex);
-
-    // Free all buffers
-    for (int i = 0; i < pool->pool_size; i++)
+    pthread_mutex_lock(&g_live_pools_mutex);
+    for (BufferPool **link = &g_live_pools; *link; link = &(*link)->next_live)
     {
-        free(pool->buffers[i]);
+        if (*link == pool)
+        {
+            *link = pool->next_live;
+            break;
+        }
     }
+    pthread_mutex_unlock(&g_live_pools_mutex);
 
-    free(pool->buffers);
-    free(pool->buffer_sizes);
-    free(pool->in_use);
+    // The caller's own cache points into the slabs about to go away
+    if (t_pool_cache.pool == pool)
+        memset(&t_pool_cache, 0, sizeof(t_pool_cache));
 
-    pthread_mutex_unlock(&pool->mutex);
-    pthread_mutex_destroy(&pool->mutex);
+    int slab_count = atomic_load(&pool->slab_count);
+    for (int i = 0; i < slab_count; i++)
+    {
+        free(pool->slabs[i].base);
+    }
+
+    pthread_mutex_destroy(&pool->grow_mutex);
+    free(pool->slabs);
+    free(pool->registry_keys);
+    free(pool->registry_values);
     free(pool);
 }
 
+// Buffers of a slab or more are aligned and sized so transparent huge
+// pages can back them; they are still released through free()
+static char *pool_alloc_oversize(size_t size)
+{
+    if (size >= POOL_SLAB_SIZE && size <= SIZE_MAX - POOL_SLAB_SIZE)
+    {
+        size_t rounded = (size + POOL_SLAB_SIZE - 1) & ~((size_t)POOL_SLAB_SIZE - 1);
+        char *buffer = aligned_alloc(POOL_SLAB_SIZE, rounded);
+        if (buffer)
+        {
+#ifdef MADV_HUGEPAGE
+            madvise(buffer, rounded, MADV_HUGEPAGE);
+#endif
+            return buffer;
+        }
+    }
+    return malloc(size);
+}
+
 char *buffer_pool_get(BufferPool *pool, size_t size)
 {
     if (!pool)
         return malloc(size);
 
-    pthread_mutex_lock(&pool->mutex);
-
-    // Find best fit buffer
-    int best_index = -1;
-    size_t best_size = SIZE_MAX;
+    int size_class = pool_class_for(size);
+    if (size_class < 0)
+    {
+        // Larger than any class: release recognises it as foreign and frees it
+        atomic_fetch_add_explicit(&pool->oversize_count, 1, memory_order_relaxed);
+        return pool_alloc_oversize(size);
+    }
 
-    for (int i = 0; i < pool->pool_size; i++)
+    PoolThreadCache *cache = pool_cache_bind(pool);
+    if (cache->count[size_class] > 0)
     {
-        if (!pool->in_use[i] && pool->buffer_sizes[i] >= size)
-        {
-            if (pool->buffer_sizes[i] < best_size)
-            {
-                best_size = pool->buffer_sizes[i];
-                best_index = i;
-            }
-        }
+        atomic_fetch_add_explicit(&pool->cache_hits, 1, memory_order_relaxed);
+        return cache->blocks[size_class][--cache->count[size_class]];
     }
 
-    if (best_index != -1)
+    char *block = pool_pop(pool, size_class);
+    if (block)
     {
-        pool->in_use[best_index] = true;
-        pthread_mutex_unlock(&pool->mutex);
-        return pool->buffers[best_index];
+        atomic_fetch_add_explicit(&pool->shared_hits, 1, memory_order_relaxed);
+        return block;
     }
 
-    pthread_mutex_unlock(&pool->mutex);
+    block = pool_grow(pool, size_class);
+    if (block)
+        return block;
 
-    // Pool exhausted, fall back to malloc
+    // Slab limit reached or out of memory
+    atomic_fetch_add_explicit(&pool->fallback_count, 1, memory_order_relaxed);
     return malloc(size);
 }
 
@@ -282,23 +509,54 @@ void buffer_pool_release(BufferPool *pool, char *buffer)
         return;
     }
 
-    pthread_mutex_lock(&pool->mutex);
+    int slab = pool_lookup_slab(pool, buffer);
+    if (slab < 0)
+    {
+        // Buffer not from pool, must be malloc'd
+        free(buffer);
+        return;
+    }
+
+    int size_class = pool->slabs[slab].size_class;
+    size_t block_size = g_pool_class_sizes[size_class];
+    size_t offset = (size_t)(buffer - pool->slabs[slab].base);
+    if (offset % block_size != 0)
+    {
+        fprintf(stderr, "buffer_pool_release: pointer is inside a pooled buffer, not its start!\n");
+        return;
+    }
 
-    // Find buffer in pool
-    for (int i = 0; i < pool->pool_size; i++)
+    PoolThreadCache *cache = pool_cache_bind(pool);
+    if (cache->count[size_class] == POOL_CACHE_SLOTS)
     {
-        if (pool->buffers[i] == buffer)
+        // Keep half, share the older half with other threads
+        for (int i = 0; i < POOL_CACHE_SLOTS / 2; i++)
         {
-            pool->in_use[i] = false;
-            pthread_mutex_unlock(&pool->mutex);
-            return;
+            char *block = cache->blocks[size_class][i];
+            pool_push(pool, size_class, block, pool_block_encoding(pool, pool_lookup_slab(pool, block), block));
         }
+        memmove(cache->blocks[size_class], cache->blocks[size_class] + POOL_CACHE_SLOTS / 2,
+                (POOL_CACHE_SLOTS / 2) * sizeof(char *));
+        cache->count[size_class] = POOL_CACHE_SLOTS / 2;
     }
 
-    pthread_mutex_unlock(&pool->mutex);
+    cache->blocks[size_class][cache->count[size_class]++] = buffer;
+}
+
+BufferPoolStats buffer_pool_get_stats(BufferPool *pool)
+{
+    BufferPoolStats stats = {0};
+    if (!pool)
+        return stats;
 
-    // Buffer not from pool, must be malloc'd
-    free(buffer);
+    stats.slab_count = (size_t)atomic_load(&pool->slab_count);
+    stats.reserved_bytes = stats.slab_count * POOL_SLAB_SIZE;
+    stats.cache_hits = atomic_load(&pool->cache_hits);
+    stats.shared_hits = atomic_load(&pool->shared_hits);
+    stats.grow_count = atomic_load(&pool->grow_count);
+    stats.oversize_count = atomic_load(&pool->oversize_count);
+    stats.fallback_count = atomic_load(&pool->fallback_count);
+    return stats;
 }
 
 MemoryManager *memory_manager_create(void)
@@ -478,6 +736,9 @@ MemoryStats memory_get_stats(MemoryManager *manager)
     stats = manager->stats;
     pthread_mutex_unlock(&manager->mutex);
 
+    stats.allocation_count += atomic_load_explicit(&manager->buffer_gets, memory_order_relaxed);
+    stats.free_count += atomic_load_explicit(&manager->buffer_releases, memory_order_relaxed);
+
     return stats;
 }
 
@@ -501,11 +762,7 @@ char *memory_get_buffer(MemoryManager *manager, size_t size)
     char *buffer = buffer_pool_get(manager->buffer_pool, size);
 
     if (manager->track_allocations)
-    {
-        pthread_mutex_lock(&manager->mutex);
-        manager->stats.allocation_count++;
-        pthread_mutex_unlock(&manager->mutex);
-    }
+        atomic_fetch_add_explicit(&manager->buffer_gets, 1, memory_order_relaxed);
 
     return buffer;
 }
@@ -521,30 +778,44 @@ void memory_release_buffer(MemoryManager *manager, char *buffer)
     buffer_pool_release(manager->buffer_pool, buffer);
 
     if (manager->track_allocations)
-    {
-        pthread_mutex_lock(&manager->mutex);
-        manager->stats.free_count++;
-        pthread_mutex_unlock(&manager->mutex);
-    }
+        atomic_fetch_add_explicit(&manager->buffer_releases, 1, memory_order_relaxed);
 }
 
 // Stream buffer implementation
+
+#define STREAM_SEGMENT_DATA (STREAM_SEGMENT_SIZE - sizeof(StreamSegment))
+
+static StreamSegment *stream_segment_create(MemoryManager *manager, size_t capacity)
+{
+    StreamSegment *segment = (StreamSegment *)memory_get_buffer(manager, sizeof(StreamSegment) + capacity);
+    if (!segment)
+        return NULL;
+    segment->next = NULL;
+    segment->used = 0;
+    segment->capacity = capacity;
+    return segment;
+}
+
 StreamBuffer *stream_buffer_create(MemoryManager *manager, size_t initial_size)
 {
     StreamBuffer *buffer = memory_alloc(manager, sizeof(StreamBuffer));
     if (!buffer)
         return NULL;
 
-    buffer->data = memory_alloc(manager, initial_size);
-    if (!buffer->data)
+    // A small first segment for buffers that stay small; the rest are full size
+    size_t first = initial_size == 0 ? STREAM_SEGMENT_DATA
+                                     : initial_size < STREAM_SEGMENT_DATA ? initial_size : STREAM_SEGMENT_DATA;
+    buffer->head = stream_segment_create(manager, first);
+    if (!buffer->head)
     {
         memory_free(manager, buffer);
         return NULL;
     }
 
+    buffer->tail = buffer->head;
     buffer->size = 0;
-    buffer->capacity = initial_size;
-    buffer->position = 0;
+    buffer->capacity = first;
+    buffer->segment_count = 1;
     buffer->memory_manager = manager;
 
     return buffer;
@@ -555,69 +826,130 @@ int stream_buffer_write(StreamBuffer *buffer, const char *data, size_t size)
     if (!buffer || !data || size == 0)
         return -1;
 
-    // Check if addition would overflow
-    if (buffer->size > SIZE_MAX - size)
-        return -1;  // Would overflow
+    // Check if addition would overflow or exceed the limit
+    if (buffer->size > SIZE_MAX - size || buffer->size + size > MAX_STREAM_BUFFER_SIZE)
+        return -1;
 
-    // Resize buffer if needed
-    if (buffer->size + size > buffer->capacity)
+    while (size > 0)
     {
-        // Overflow-safe capacity doubling
-        size_t new_capacity = buffer->capacity;
-        size_t target = buffer->size + size;
-        
-        while (new_capacity < target) {
-            // Check for overflow before doubling
-            if (new_capacity > MAX_STREAM_BUFFER_SIZE / 2) {
-                // Can't double, try exact fit if under limit
-                if (target <= MAX_STREAM_BUFFER_SIZE) {
-                    new_capacity = target;
-                    break;
-                }
-                return -1;  // Would exceed max buffer size
-            }
-            new_capacity *= 2;
+        StreamSegment *tail = buffer->tail;
+        if (tail->used == tail->capacity)
+        {
+            StreamSegment *segment = stream_segment_create(buffer->memory_manager, STREAM_SEGMENT_DATA);
+            if (!segment)
+                return -1; // What fitted stays written
+            tail->next = segment;
+            buffer->tail = segment;
+            buffer->capacity += segment->capacity;
+            buffer->segment_count++;
+            continue;
         }
-        
-        // Final limit check
-        if (new_capacity > MAX_STREAM_BUFFER_SIZE)
-            return -1;
-
-        char *new_data = memory_realloc(buffer->memory_manager, buffer->data, new_capacity);
-        if (!new_data)
-            return -1;
 
-        buffer->data = new_data;
-        buffer->capacity = new_capacity;
+        size_t n = tail->capacity - tail->used;
+        if (n > size)
+            n = size;
+        memcpy(tail->data + tail->used, data, n);
+        tail->used += n;
+        buffer->size += n;
+        data += n;
+        size -= n;
     }
 
-    memcpy(buffer->data + buffer->size, data, size);
-    buffer->size += size;
-
     return 0;
 }
 
-int stream_buffer_flush(StreamBuffer *buffer)
+int stream_buffer_drain(StreamBuffer *buffer, StreamDrainFn write, void *target)
 {
-    if (!buffer)
+    if (!buffer || !write)
+        return -1;
+
+    struct iovec iov[STREAM_BUFFER_IOV_MAX];
+    int count = 0;
+    for (StreamSegment *segment = buffer->head; segment; segment = segment->next)
+    {
+        if (segment->used == 0)
+            continue;
+        iov[count].iov_base = segment->data;
+        iov[count].iov_len = segment->used;
+        if (++count == STREAM_BUFFER_IOV_MAX)
+        {
+            if (write(target, iov, count) != 0)
+                return -1;
+            count = 0;
+        }
+    }
+    if (count > 0 && write(target, iov, count) != 0)
         return -1;
 
-    // Write to stdout for now
-    if (buffer->size > 0)
+    // Keep the first segment for the next round of appends
+    StreamSegment *segment = buffer->head->next;
+    while (segment)
     {
-        fwrite(buffer->data, 1, buffer->size, stdout);
-        buffer->size = 0;
-        buffer->position = 0;
+        StreamSegment *next = segment->next;
+        memory_release_buffer(buffer->memory_manager, (char *)segment);
+        segment = next;
     }
+    buffer->head->next = NULL;
+    buffer->head->used = 0;
+    buffer->tail = buffer->head;
+    buffer->size = 0;
+    buffer->capacity = buffer->head->capacity;
+    buffer->segment_count = 1;
 
     return 0;
 }
 
+static int stream_write_stdout(void *target, const struct iovec *iov, int count)
+{
+    (void)target;
+    struct iovec pending[STREAM_BUFFER_IOV_MAX];
+    memcpy(pending, iov, (size_t)count * sizeof(struct iovec));
+
+    // Short writes continue where the kernel stopped
+    struct iovec *at = pending;
+    while (count > 0)
+    {
+        ssize_t n = writev(STDOUT_FILENO, at, count);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+        while (count > 0 && (size_t)n >= at->iov_len)
+        {
+            n -= (ssize_t)at->iov_len;
+            at++;
+            count--;
+        }
+        if (count > 0)
+        {
+            at->iov_base = (char *)at->iov_base + n;
+            at->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+int stream_buffer_flush(StreamBuffer *buffer)
+{
+    if (!buffer)
+        return -1;
+
+    // Whatever stdio holds goes first
+    fflush(stdout);
+    return stream_buffer_drain(buffer, stream_write_stdout, NULL);
+}
+
 void stream_buffer_destroy(StreamBuffer *buffer)
 {
     if (!buffer)
         return;
 
-    memory_free(buffer->memory_manager, buffer->data);
+    StreamSegment *segment = buffer->head;
+    while (segment)
+    {
+        StreamSegment *next = segment->next;
+        memory_release_buffer(buffer->memory_manager, (char *)segment);
+        segment = next;
+    }
     memory_free(buffer->memory_manager, buffer);
 }
@@ -4,23 +4,30 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/uio.h>
 
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
+    // Size-classed buffer pool. Buffers are carved from 2MB slabs, one size
+    // class per slab; get/release go through a per-thread cache and then a
+    // lock-free free list, and new slabs are added on demand. Pointers that
+    // did not come from the pool are recognised on release and free()'d.
+    typedef struct BufferPool BufferPool;
+
     typedef struct
     {
-        char **buffers;
-        size_t *buffer_sizes;
-        bool *in_use;
-        int pool_size;
-        int small_buffer_count;
-        int medium_buffer_count;
-        int large_buffer_count;
-        pthread_mutex_t mutex;
-    } BufferPool;
+        size_t slab_count;      // Slabs carved so far
+        size_t reserved_bytes;  // Memory held by those slabs
+        size_t cache_hits;      // Served from the calling thread's cache
+        size_t shared_hits;     // Served from a shared free list
+        size_t grow_count;      // Requests that had to carve a new slab
+        size_t oversize_count;  // Requests above the largest class (malloc'd)
+        size_t fallback_count;  // Requests malloc'd because the pool was full
+    } BufferPoolStats;
 
     // Memory statistics
     typedef struct
@@ -37,6 +44,7 @@ extern "C"
     void buffer_pool_destroy(BufferPool *pool);
     char *buffer_pool_get(BufferPool *pool, size_t size);
     void buffer_pool_release(BufferPool *pool, char *buffer);
+    BufferPoolStats buffer_pool_get_stats(BufferPool *pool);
 
     // Memory manager
     typedef struct
@@ -45,6 +53,8 @@ extern "C"
         BufferPool *buffer_pool;
         pthread_mutex_t mutex;
         int track_allocations;
+        atomic_size_t buffer_gets;     // Pool traffic, folded into stats on read
+        atomic_size_t buffer_releases;
     } MemoryManager;
 
     // Memory management functions
@@ -58,18 +68,40 @@ extern "C"
     char *memory_get_buffer(MemoryManager *manager, size_t size);
     void memory_release_buffer(MemoryManager *manager, char *buffer);
 
-    // Stream buffer functions
-    typedef struct
+    // Stream buffer: an append-only chain of segments taken from the buffer
+    // pool. An append copies into the last segment and starts a new one
+    // when that is full, so nothing already written is ever moved, and the
+    // chain leaves through writev-style calls without being flattened.
+#define STREAM_SEGMENT_SIZE 65536 // Pool block behind a segment, header included
+#define STREAM_BUFFER_IOV_MAX 64  // Segments handed over per drain call
+
+    typedef struct StreamSegment
     {
-        char *data;
-        size_t size;
+        struct StreamSegment *next;
+        size_t used;
         size_t capacity;
-        size_t position;
+        char data[];
+    } StreamSegment;
+
+    typedef struct
+    {
+        StreamSegment *head;
+        StreamSegment *tail;  // Where appends go
+        size_t size;          // Bytes held over all segments
+        size_t capacity;      // Bytes the segments can hold
+        size_t segment_count;
         MemoryManager *memory_manager;
     } StreamBuffer;
 
+    // Receives the held bytes in order; returns 0, or -1 to stop the drain
+    typedef int (*StreamDrainFn)(void *target, const struct iovec *iov, int count);
+
     StreamBuffer *stream_buffer_create(MemoryManager *manager, size_t initial_size);
     int stream_buffer_write(StreamBuffer *buffer, const char *data, size_t size);
+    // Pass everything held to write, then empty the buffer (its first segment
+    // is kept for reuse). When write fails the buffer is left as it was.
+    int stream_buffer_drain(StreamBuffer *buffer, StreamDrainFn write, void *target);
+    // Drain to standard output
     int stream_buffer_flush(StreamBuffer *buffer);
     void stream_buffer_destroy(StreamBuffer *buffer);
 
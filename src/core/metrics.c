@@ -0,0 +1,208 @@
+#include "metrics.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+{
+    atomic_uint_fast64_t ns;
+    atomic_uint_fast64_t calls;
+    atomic_uint_fast64_t bytes;
+} StageCounter;
+
+typedef struct
+{
+    uint64_t ns;
+    uint64_t bytes;
+    char *path;
+} SlowFile;
+
+struct Metrics
+{
+    StageCounter stages[METRICS_STAGE_COUNT];
+    uint64_t start_ns;
+
+    // Sorted slowest first. slowest_floor is the time a file has to beat
+    // once the list is full, so most files never take the lock.
+    pthread_mutex_t slowest_mutex;
+    SlowFile slowest[METRICS_SLOWEST_FILES];
+    int slowest_count;
+    atomic_uint_fast64_t slowest_floor;
+};
+
+static const char *g_stage_names[METRICS_STAGE_COUNT] = {
+    "readdir", "stat", "path_filter", "open", "read", "binary_scan", "transform", "plugins", "format", "compress",
+    "write"};
+
+Metrics *metrics_create(void)
+{
+    Metrics *metrics = calloc(1, sizeof(Metrics));
+    if (!metrics)
+        return NULL;
+
+    if (pthread_mutex_init(&metrics->slowest_mutex, NULL) != 0)
+    {
+        free(metrics);
+        return NULL;
+    }
+
+    metrics->start_ns = metrics_now_ns();
+    return metrics;
+}
+
+void metrics_destroy(Metrics *metrics)
+{
+    if (!metrics)
+        return;
+
+    for (int i = 0; i < metrics->slowest_count; i++)
+        free(metrics->slowest[i].path);
+    pthread_mutex_destroy(&metrics->slowest_mutex);
+    free(metrics);
+}
+
+void metrics_record(Metrics *metrics, MetricsStage stage, uint64_t ns, uint64_t calls, uint64_t bytes)
+{
+    if (!metrics || (unsigned)stage >= METRICS_STAGE_COUNT)
+        return;
+
+    StageCounter *counter = &metrics->stages[stage];
+    atomic_fetch_add_explicit(&counter->ns, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&counter->calls, calls, memory_order_relaxed);
+    if (bytes)
+        atomic_fetch_add_explicit(&counter->bytes, bytes, memory_order_relaxed);
+}
+
+void metrics_record_file(Metrics *metrics, const char *path, uint64_t ns, uint64_t bytes)
+{
+    if (!metrics || !path)
+        return;
+    if (ns <= atomic_load_explicit(&metrics->slowest_floor, memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&metrics->slowest_mutex);
+
+    int count = metrics->slowest_count;
+    int slot = count;
+    while (slot > 0 && metrics->slowest[slot - 1].ns < ns)
+        slot--;
+
+    if (slot < METRICS_SLOWEST_FILES)
+    {
+        char *copy = strdup(path);
+        if (copy)
+        {
+            if (count == METRICS_SLOWEST_FILES)
+                free(metrics->slowest[--count].path);
+            memmove(&metrics->slowest[slot + 1], &metrics->slowest[slot], (size_t)(count - slot) * sizeof(SlowFile));
+            metrics->slowest[slot] = (SlowFile){ns, bytes, copy};
+            metrics->slowest_count = count + 1;
+
+            if (metrics->slowest_count == METRICS_SLOWEST_FILES)
+                atomic_store_explicit(&metrics->slowest_floor, metrics->slowest[METRICS_SLOWEST_FILES - 1].ns,
+                                      memory_order_relaxed);
+        }
+    }
+
+    pthread_mutex_unlock(&metrics->slowest_mutex);
+}
+
+MetricsCounter metrics_get(const Metrics *metrics, MetricsStage stage)
+{
+    MetricsCounter counter = {0};
+    if (!metrics || (unsigned)stage >= METRICS_STAGE_COUNT)
+        return counter;
+
+    // Atomic loads do not modify the counters
+    StageCounter *stage_counter = (StageCounter *)&metrics->stages[stage];
+    counter.ns = atomic_load_explicit(&stage_counter->ns, memory_order_relaxed);
+    counter.calls = atomic_load_explicit(&stage_counter->calls, memory_order_relaxed);
+    counter.bytes = atomic_load_explicit(&stage_counter->bytes, memory_order_relaxed);
+    return counter;
+}
+
+const char *metrics_stage_name(MetricsStage stage)
+{
+    if ((unsigned)stage >= METRICS_STAGE_COUNT)
+        return "unknown";
+    return g_stage_names[stage];
+}
+
+static void write_json_string(FILE *stream, const char *text)
+{
+    fputc('"', stream);
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fprintf(stream, "\\%c", *p);
+        else if (*p < 0x20)
+            fprintf(stream, "\\u%04x", *p);
+        else
+            fputc(*p, stream);
+    }
+    fputc('"', stream);
+}
+
+static void report_json(const Metrics *metrics, FILE *stream, uint64_t wall_ns)
+{
+    fprintf(stream, "{\n  \"wall_ns\": %llu,\n  \"stages\": [\n", (unsigned long long)wall_ns);
+    for (int s = 0; s < METRICS_STAGE_COUNT; s++)
+    {
+        MetricsCounter counter = metrics_get(metrics, (MetricsStage)s);
+        fprintf(stream, "    {\"stage\": \"%s\", \"calls\": %llu, \"ns\": %llu, \"bytes\": %llu}%s\n",
+                g_stage_names[s], (unsigned long long)counter.calls, (unsigned long long)counter.ns,
+                (unsigned long long)counter.bytes, s + 1 < METRICS_STAGE_COUNT ? "," : "");
+    }
+    fprintf(stream, "  ],\n  \"slowest_files\": [\n");
+    for (int i = 0; i < metrics->slowest_count; i++)
+    {
+        const SlowFile *file = &metrics->slowest[i];
+        fprintf(stream, "    {\"path\": ");
+        write_json_string(stream, file->path);
+        fprintf(stream, ", \"ns\": %llu, \"bytes\": %llu}%s\n", (unsigned long long)file->ns,
+                (unsigned long long)file->bytes, i + 1 < metrics->slowest_count ? "," : "");
+    }
+    fprintf(stream, "  ]\n}\n");
+}
+
+static void report_table(const Metrics *metrics, FILE *stream, uint64_t wall_ns)
+{
+    fprintf(stream, "\nPerformance counters (wall %.3f ms)\n", wall_ns / 1e6);
+    fprintf(stream, "%-12s %12s %12s %7s %16s\n", "Stage", "Calls", "Time ms", "Wall", "Bytes");
+    for (int s = 0; s < METRICS_STAGE_COUNT; s++)
+    {
+        MetricsCounter counter = metrics_get(metrics, (MetricsStage)s);
+        double share = wall_ns ? 100.0 * (double)counter.ns / (double)wall_ns : 0.0;
+        fprintf(stream, "%-12s %12llu %12.3f %6.1f%% %16llu\n", g_stage_names[s], (unsigned long long)counter.calls,
+                counter.ns / 1e6, share, (unsigned long long)counter.bytes);
+    }
+
+    if (metrics->slowest_count > 0)
+    {
+        fprintf(stream, "\nSlowest files\n");
+        for (int i = 0; i < metrics->slowest_count; i++)
+        {
+            const SlowFile *file = &metrics->slowest[i];
+            fprintf(stream, "%12.3f ms %14llu B  %s\n", file->ns / 1e6, (unsigned long long)file->bytes, file->path);
+        }
+    }
+}
+
+int metrics_report(const Metrics *metrics, FILE *stream, bool json)
+{
+    if (!metrics || !stream)
+        return -1;
+
+    uint64_t wall_ns = metrics_now_ns() - metrics->start_ns;
+
+    // Workers have finished by now; the lock only orders the list reads
+    pthread_mutex_lock((pthread_mutex_t *)&metrics->slowest_mutex);
+    if (json)
+        report_json(metrics, stream, wall_ns);
+    else
+        report_table(metrics, stream, wall_ns);
+    pthread_mutex_unlock((pthread_mutex_t *)&metrics->slowest_mutex);
+
+    return ferror(stream) ? -1 : 0;
+}
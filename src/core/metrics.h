@@ -0,0 +1,89 @@
+#ifndef CORE_METRICS_H
+#define CORE_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Per-stage timers and counters behind --stats. Every instrumented
+    // site holds a Metrics pointer that is NULL unless --stats was given,
+    // and the inline helpers below test it before touching the clock, so a
+    // normal run pays a predictable branch per site and nothing else.
+    // Recording is thread safe; the content workers record concurrently.
+    typedef struct Metrics Metrics;
+
+    // Stages nest the way the work does: plugins include formatting what
+    // the chain emits, format includes buffering what the formatter emits,
+    // and write is only the system calls below it. Compression runs beside
+    // all of them on its own threads.
+    typedef enum
+    {
+        METRICS_READDIR,   // opendir/readdir/closedir during the walk
+        METRICS_STAT,      // lstat/stat of walked entries
+        METRICS_PATH_FILTER, // Include/exclude rules and filter plugins on paths
+        METRICS_OPEN,      // Opening input files
+        METRICS_READ,      // Reading input files (bytes in)
+        METRICS_BINARY_SCAN, // Binary detection on the first chunk
+        METRICS_TRANSFORM, // Filter plugin content transforms
+        METRICS_PLUGINS,   // Content plugin chain
+        METRICS_FORMAT,    // Formatter callbacks
+        METRICS_COMPRESS,  // --compress workers, summed over threads (bytes in)
+        METRICS_WRITE,     // Output write system calls and kernel copies (bytes out)
+        METRICS_STAGE_COUNT
+    } MetricsStage;
+
+    // Files kept in the slowest-files list
+#define METRICS_SLOWEST_FILES 10
+
+    typedef struct
+    {
+        uint64_t ns;
+        uint64_t calls;
+        uint64_t bytes;
+    } MetricsCounter;
+
+    Metrics *metrics_create(void);
+    void metrics_destroy(Metrics *metrics);
+
+    static inline uint64_t metrics_now_ns(void)
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    }
+
+    void metrics_record(Metrics *metrics, MetricsStage stage, uint64_t ns, uint64_t calls, uint64_t bytes);
+    void metrics_record_file(Metrics *metrics, const char *path, uint64_t ns, uint64_t bytes);
+
+    // Start of a timed call; 0 without metrics, which skips the clock
+    static inline uint64_t metrics_begin(const Metrics *metrics)
+    {
+        return metrics ? metrics_now_ns() : 0;
+    }
+
+    // One call of stage that started at start and moved bytes
+    static inline void metrics_end(Metrics *metrics, MetricsStage stage, uint64_t start, uint64_t bytes)
+    {
+        if (metrics)
+            metrics_record(metrics, stage, metrics_now_ns() - start, 1, bytes);
+    }
+
+    MetricsCounter metrics_get(const Metrics *metrics, MetricsStage stage);
+    const char *metrics_stage_name(MetricsStage stage);
+
+    // Write the counters and the wall time since metrics_create to stream,
+    // as an aligned table or as one JSON object
+    int metrics_report(const Metrics *metrics, FILE *stream, bool json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_METRICS_H */
@@ -0,0 +1,571 @@
+#include "output.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Caller iovecs gathered behind the buffer in one writev()
+#define OUTPUT_SINK_MAX_GATHER 16
+
+struct OutputSink
+{
+    int fd;
+    OutputSinkWriteFn writer; // Takes the stream instead of fd when set
+    void *writer_opaque;
+    char *buffer; // OUTPUT_SINK_ALIGN aligned, capacity a multiple of it
+    size_t capacity;
+    size_t used;
+    off_t position; // Stream offset of buffer[0]
+    off_t fd_position; // Descriptor offset; behind position when compressing
+    bool direct;    // O_DIRECT currently set on fd
+    bool drop_cache;
+    bool regular;       // Page cache hints only make sense for files
+    off_t written_back; // Writeback started for [start, written_back)
+    off_t dropped;      // Pages before this were dropped from the cache
+    int error;          // Sticky errno of the first failed write
+    Compressor *compressor; // Takes the stream instead of the descriptor
+    Metrics *metrics;
+    OutputSinkStats stats;
+};
+
+static int sink_fail(OutputSink *sink, int err)
+{
+    if (!sink->error)
+        sink->error = err ? err : EIO;
+    errno = sink->error;
+    return -1;
+}
+
+static void sink_set_direct(OutputSink *sink, bool enable)
+{
+#ifdef O_DIRECT
+    int flags = fcntl(sink->fd, F_GETFL);
+    if (flags >= 0)
+    {
+        int wanted = enable ? (flags | O_DIRECT) : (flags & ~O_DIRECT);
+        if (wanted == flags || fcntl(sink->fd, F_SETFL, wanted) == 0)
+        {
+            sink->direct = enable;
+            return;
+        }
+    }
+#endif
+    if (!enable)
+        sink->direct = false;
+}
+
+// Hand iovecs to the writer callback, which takes each one whole
+static int sink_writev_writer(OutputSink *sink, const struct iovec *iov, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (iov[i].iov_len == 0)
+            continue;
+        uint64_t start = metrics_begin(sink->metrics);
+        errno = 0;
+        int result = sink->writer(sink->writer_opaque, iov[i].iov_base, iov[i].iov_len);
+        metrics_end(sink->metrics, METRICS_WRITE, start, result == 0 ? iov[i].iov_len : 0);
+        sink->stats.write_calls++;
+        if (result != 0)
+        {
+            if (!errno)
+                errno = EIO;
+            return -1;
+        }
+        sink->fd_position += (off_t)iov[i].iov_len;
+        sink->stats.bytes_written += iov[i].iov_len;
+    }
+    return 0;
+}
+
+// Write iovecs to the descriptor completely, resuming after short writes
+static int sink_writev_fd(OutputSink *sink, struct iovec *iov, int count)
+{
+    if (sink->writer)
+        return sink_writev_writer(sink, iov, count);
+
+    while (count > 0)
+    {
+        uint64_t start = metrics_begin(sink->metrics);
+        ssize_t n = count == 1 ? write(sink->fd, iov[0].iov_base, iov[0].iov_len)
+                               : writev(sink->fd, iov, count);
+        metrics_end(sink->metrics, METRICS_WRITE, start, n > 0 ? (uint64_t)n : 0);
+        sink->stats.write_calls++;
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        size_t done = (size_t)n;
+        sink->fd_position += (off_t)done;
+        sink->stats.bytes_written += done;
+
+        while (count > 0 && done >= iov[0].iov_len)
+        {
+            done -= iov[0].iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov[0].iov_base = (char *)iov[0].iov_base + done;
+            iov[0].iov_len -= done;
+        }
+    }
+    return 0;
+}
+
+// Compressed members go straight to the descriptor
+static int sink_write_member(void *opaque, const void *data, size_t size)
+{
+    struct iovec iov = {(void *)data, size};
+    return size ? sink_writev_fd((OutputSink *)opaque, &iov, 1) : 0;
+}
+
+// Append iovecs to the stream, through the compressor when there is one
+static int sink_writev_all(OutputSink *sink, struct iovec *iov, int count)
+{
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += iov[i].iov_len;
+
+    if (sink->compressor)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (compressor_write(sink->compressor, iov[i].iov_base, iov[i].iov_len) != 0)
+                return -1;
+        }
+    }
+    else if (sink_writev_fd(sink, iov, count) != 0)
+    {
+        return -1;
+    }
+
+    sink->position += (off_t)total;
+    return 0;
+}
+
+static int sink_write_all(OutputSink *sink, const char *data, size_t size)
+{
+    struct iovec iov = {(void *)data, size};
+    return size ? sink_writev_all(sink, &iov, 1) : 0;
+}
+
+// Streamed output is never read back: start writeback of what was just
+// written and drop the pages of the previous window, which by now have
+// usually reached the disk (dirty pages are left alone by the kernel)
+static void sink_drop_cache(OutputSink *sink)
+{
+    if (!sink->drop_cache || !sink->regular || sink->fd_position <= sink->written_back)
+        return;
+
+#ifdef __linux__
+    sync_file_range(sink->fd, sink->written_back, sink->fd_position - sink->written_back, SYNC_FILE_RANGE_WRITE);
+#endif
+    if (sink->written_back > sink->dropped)
+    {
+        posix_fadvise(sink->fd, sink->dropped, sink->written_back - sink->dropped, POSIX_FADV_DONTNEED);
+        sink->dropped = sink->written_back;
+    }
+    sink->written_back = sink->fd_position;
+}
+
+// Write out the buffer. O_DIRECT only takes whole aligned blocks, so a
+// partial tail stays buffered unless drain asks for everything, in which
+// case direct I/O is given up since the file offset will no longer be aligned.
+static int sink_flush_buffer(OutputSink *sink, bool drain)
+{
+    if (sink->error)
+        return sink_fail(sink, sink->error);
+    if (sink->used == 0)
+        return 0;
+
+    size_t count = sink->used;
+    if (sink->direct)
+    {
+        size_t aligned = count & ~(size_t)(OUTPUT_SINK_ALIGN - 1);
+        if (aligned > 0 && sink_write_all(sink, sink->buffer, aligned) != 0)
+        {
+            if (errno != EINVAL)
+                return sink_fail(sink, errno);
+            // The filesystem rejected direct I/O after all
+            sink_set_direct(sink, false);
+            aligned = 0;
+        }
+
+        if (aligned > 0)
+        {
+            memmove(sink->buffer, sink->buffer + aligned, count - aligned);
+            sink->used = count - aligned;
+            count = sink->used;
+        }
+
+        if (sink->direct)
+        {
+            if (!drain || count == 0)
+            {
+                sink_drop_cache(sink);
+                return 0;
+            }
+            sink_set_direct(sink, false);
+        }
+    }
+
+    if (sink_write_all(sink, sink->buffer, count) != 0)
+        return sink_fail(sink, errno);
+
+    sink->used = 0;
+    sink_drop_cache(sink);
+    return 0;
+}
+
+static OutputSink *sink_create(int fd, OutputSinkWriteFn writer, void *writer_opaque,
+                               const OutputSinkOptions *options)
+{
+    OutputSink *sink = calloc(1, sizeof(OutputSink));
+    if (!sink)
+        return NULL;
+
+    size_t size = options && options->buffer_size ? options->buffer_size : OUTPUT_SINK_DEFAULT_BUFFER;
+    if (size > SIZE_MAX / 2)
+        size = OUTPUT_SINK_DEFAULT_BUFFER;
+    sink->capacity = (size + OUTPUT_SINK_ALIGN - 1) & ~(size_t)(OUTPUT_SINK_ALIGN - 1);
+    sink->buffer = aligned_alloc(OUTPUT_SINK_ALIGN, sink->capacity);
+    if (!sink->buffer)
+    {
+        free(sink);
+        return NULL;
+    }
+
+    sink->fd = fd;
+    sink->writer = writer;
+    sink->writer_opaque = writer_opaque;
+    struct stat st;
+    sink->regular = fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+
+    off_t position = sink->regular ? lseek(fd, 0, SEEK_CUR) : -1;
+    sink->position = position > 0 ? position : 0;
+    sink->fd_position = sink->position;
+    sink->written_back = sink->position;
+    sink->dropped = sink->position;
+    sink->drop_cache = options && options->drop_cache;
+    sink->metrics = options ? options->metrics : NULL;
+
+    if (options && options->compression != OUTPUT_COMPRESS_NONE)
+    {
+        int threads = options->compress_threads > 0 ? options->compress_threads : 1;
+        sink->compressor = compressor_create(options->compression, options->compress_level, threads,
+                                             sink_write_member, sink, sink->metrics);
+        if (!sink->compressor)
+        {
+            int saved_errno = errno;
+            free(sink->buffer);
+            free(sink);
+            errno = saved_errno;
+            return NULL;
+        }
+        return sink;
+    }
+
+    // Direct I/O needs an aligned starting offset as well as aligned buffers
+    if (options && options->direct_io && sink->regular && position >= 0 &&
+        position % OUTPUT_SINK_ALIGN == 0)
+        sink_set_direct(sink, true);
+
+    return sink;
+}
+
+OutputSink *output_sink_create(int fd, const OutputSinkOptions *options)
+{
+    if (fd < 0)
+        return NULL;
+    return sink_create(fd, NULL, NULL, options);
+}
+
+OutputSink *output_sink_create_writer(OutputSinkWriteFn write, void *opaque, const OutputSinkOptions *options)
+{
+    if (!write)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    return sink_create(-1, write, opaque, options);
+}
+
+int output_sink_destroy(OutputSink *sink)
+{
+    if (!sink)
+        return 0;
+
+    int result = output_sink_flush(sink);
+    int saved_errno = errno;
+
+    // Leave the descriptor as it was handed over
+    if (sink->direct)
+        sink_set_direct(sink, false);
+
+    compressor_destroy(sink->compressor);
+    free(sink->buffer);
+    free(sink);
+    errno = saved_errno;
+    return result;
+}
+
+int output_sink_write(OutputSink *sink, const void *data, size_t size)
+{
+    if (!sink || (!data && size))
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sink->error)
+        return sink_fail(sink, sink->error);
+
+    const char *bytes = (const char *)data;
+    if (size <= sink->capacity - sink->used)
+    {
+        memcpy(sink->buffer + sink->used, bytes, size);
+        sink->used += size;
+        return 0;
+    }
+
+    // Large blocks go out behind the buffered bytes without being copied
+    if (!sink->direct && size >= sink->capacity / 2)
+    {
+        struct iovec iov[2] = {{sink->buffer, sink->used}, {(void *)bytes, size}};
+        int first = sink->used ? 0 : 1;
+        if (sink_writev_all(sink, iov + first, 2 - first) != 0)
+            return sink_fail(sink, errno);
+
+        sink->used = 0;
+        sink->stats.gathered++;
+        sink_drop_cache(sink);
+        return 0;
+    }
+
+    while (size > 0)
+    {
+        size_t room = sink->capacity - sink->used;
+        size_t n = size < room ? size : room;
+        memcpy(sink->buffer + sink->used, bytes, n);
+        sink->used += n;
+        bytes += n;
+        size -= n;
+
+        if (sink->used == sink->capacity && sink_flush_buffer(sink, false) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int output_sink_writev(OutputSink *sink, const struct iovec *iov, int count)
+{
+    if (!sink || (!iov && count > 0) || count < 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sink->error)
+        return sink_fail(sink, sink->error);
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+        total += iov[i].iov_len;
+
+    // One writev() for the buffer and every piece, when none needs a copy
+    if (!sink->direct && total > sink->capacity - sink->used && total >= sink->capacity / 2 &&
+        count < OUTPUT_SINK_MAX_GATHER)
+    {
+        struct iovec gather[OUTPUT_SINK_MAX_GATHER];
+        int n = 0;
+        if (sink->used)
+            gather[n++] = (struct iovec){sink->buffer, sink->used};
+        for (int i = 0; i < count; i++)
+        {
+            if (iov[i].iov_len)
+                gather[n++] = iov[i];
+        }
+
+        if (sink_writev_all(sink, gather, n) != 0)
+            return sink_fail(sink, errno);
+
+        sink->used = 0;
+        sink->stats.gathered++;
+        sink_drop_cache(sink);
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (output_sink_write(sink, iov[i].iov_base, iov[i].iov_len) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+int output_sink_write_repeat(OutputSink *sink, char c, size_t count)
+{
+    if (!sink)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sink->error)
+        return sink_fail(sink, sink->error);
+
+    while (count > 0)
+    {
+        size_t room = sink->capacity - sink->used;
+        size_t n = count < room ? count : room;
+        memset(sink->buffer + sink->used, c, n);
+        sink->used += n;
+        count -= n;
+
+        if (sink->used == sink->capacity && sink_flush_buffer(sink, false) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+char *output_sink_reserve(OutputSink *sink, size_t size, size_t *room)
+{
+    if (!sink || size == 0 || size > sink->capacity)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    if (sink->error)
+    {
+        sink_fail(sink, sink->error);
+        return NULL;
+    }
+
+    // Direct I/O can leave an unaligned tail behind; drain it if need be
+    if (sink->capacity - sink->used < size && sink_flush_buffer(sink, false) != 0)
+        return NULL;
+    if (sink->capacity - sink->used < size && sink_flush_buffer(sink, true) != 0)
+        return NULL;
+
+    if (room)
+        *room = sink->capacity - sink->used;
+    return sink->buffer + sink->used;
+}
+
+void output_sink_commit(OutputSink *sink, size_t size)
+{
+    if (!sink)
+        return;
+    sink->used += size < sink->capacity - sink->used ? size : sink->capacity - sink->used;
+}
+
+int output_sink_flush(OutputSink *sink)
+{
+    if (!sink)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sink_flush_buffer(sink, true) != 0)
+        return -1;
+    if (sink->compressor && compressor_flush(sink->compressor) != 0)
+        return sink_fail(sink, errno);
+    return 0;
+}
+
+// Feed a byte range of in_fd to the compressor or the writer through the
+// buffer, which has just been flushed
+static int sink_copy_through_buffer(OutputSink *sink, int in_fd, off_t offset, size_t length, size_t *copied)
+{
+    while (*copied < length)
+    {
+        size_t want = length - *copied;
+        if (want > sink->capacity)
+            want = sink->capacity;
+
+        uint64_t start = metrics_begin(sink->metrics);
+        ssize_t n = pread(in_fd, sink->buffer, want, offset + (off_t)*copied);
+        metrics_end(sink->metrics, METRICS_READ, start, n > 0 ? (uint64_t)n : 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        // Like the kernel copies, a shorter or unreadable input ends early
+        if (n <= 0)
+            return 0;
+
+        if (sink_write_all(sink, sink->buffer, (size_t)n) != 0)
+            return sink_fail(sink, errno);
+        *copied += (size_t)n;
+    }
+    return 0;
+}
+
+int output_sink_copy_fd(OutputSink *sink, int in_fd, off_t offset, size_t length,
+                        size_t *copied, ZeroCopyMethod *method)
+{
+    if (copied)
+        *copied = 0;
+    if (!sink)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (sink_flush_buffer(sink, true) != 0)
+        return -1;
+
+    if (sink->compressor || sink->writer)
+    {
+        size_t done = 0;
+        int result = sink_copy_through_buffer(sink, in_fd, offset, length, &done);
+        if (method)
+            *method = ZEROCOPY_READ_WRITE;
+        if (copied)
+            *copied = done;
+        return result;
+    }
+
+    // The copied length is arbitrary, so aligned offsets are over from here
+    if (sink->direct)
+        sink_set_direct(sink, false);
+
+    uint64_t start = metrics_begin(sink->metrics);
+    ssize_t n = zerocopy_fd_range(sink->fd, in_fd, offset, length, method);
+    metrics_end(sink->metrics, METRICS_WRITE, start, n > 0 ? (uint64_t)n : 0);
+    if (n < 0)
+        return sink_fail(sink, errno);
+
+    sink->position += (off_t)n;
+    sink->fd_position += (off_t)n;
+    sink->stats.bytes_written += (size_t)n;
+    sink_drop_cache(sink);
+    if (copied)
+        *copied = (size_t)n;
+    return 0;
+}
+
+int output_sink_fd(const OutputSink *sink)
+{
+    return sink ? sink->fd : -1;
+}
+
+off_t output_sink_tell(const OutputSink *sink)
+{
+    return sink ? sink->position + (off_t)sink->used : -1;
+}
+
+OutputSinkStats output_sink_get_stats(const OutputSink *sink)
+{
+    OutputSinkStats stats = {0};
+    if (sink)
+    {
+        stats = sink->stats;
+        stats.uncompressed = compressor_bytes_in(sink->compressor);
+        stats.direct_io = sink->direct;
+    }
+    return stats;
+}
@@ -0,0 +1,102 @@
+#ifndef CORE_OUTPUT_H
+#define CORE_OUTPUT_H
+
+#include "compress.h"
+#include "metrics.h"
+#include "zerocopy.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Buffered writer in front of the output descriptor. Small tokens are
+    // copied into one large aligned buffer that goes out in a single
+    // write(); blocks at least half the buffer size skip the copy and
+    // leave together with whatever is buffered in one writev(). Not thread
+    // safe: all output is written from the thread committing results.
+    //
+    // With compression the buffer drains into a Compressor instead, whose
+    // members reach the descriptor through the same write path. Offsets
+    // (output_sink_tell) then count uncompressed bytes.
+    typedef struct OutputSink OutputSink;
+
+#define OUTPUT_SINK_DEFAULT_BUFFER (1024 * 1024)
+    // Buffer alignment and O_DIRECT write granularity
+#define OUTPUT_SINK_ALIGN 4096
+
+    typedef struct
+    {
+        size_t buffer_size; // 0 selects OUTPUT_SINK_DEFAULT_BUFFER
+        bool direct_io;     // Write through O_DIRECT while offsets stay aligned
+        bool drop_cache;    // Start writeback and drop written pages from the page cache
+        Metrics *metrics;   // Times the system calls under METRICS_WRITE, or NULL
+        OutputCompression compression; // Compress the stream; turns direct I/O off
+        int compress_level;            // -1 selects the codec default
+        int compress_threads;          // Compression workers (0 = one)
+    } OutputSinkOptions;
+
+    typedef struct
+    {
+        size_t bytes_written;  // Bytes handed to the kernel, including copied ranges
+        size_t write_calls;    // write()/writev() system calls issued
+        size_t gathered;       // Large blocks written without being copied
+        size_t uncompressed;   // Stream bytes before compression, 0 when not compressing
+        bool direct_io;        // O_DIRECT is still in effect
+    } OutputSinkStats;
+
+    // Takes the stream in place of a descriptor: called with each block
+    // that leaves the sink, returns 0, or -1 with errno set
+    typedef int (*OutputSinkWriteFn)(void *opaque, const void *data, size_t size);
+
+    // The descriptor stays owned by the caller and is not closed. Returns
+    // NULL with errno set when the compressor cannot be started.
+    OutputSink *output_sink_create(int fd, const OutputSinkOptions *options);
+    // A sink whose output goes to write instead of a descriptor. Direct
+    // I/O and page cache hints do not apply; ranges copied with
+    // output_sink_copy_fd are read through the buffer. output_sink_fd
+    // returns -1.
+    OutputSink *output_sink_create_writer(OutputSinkWriteFn write, void *opaque, const OutputSinkOptions *options);
+    // Flushes what is left, finishing a compressed stream; returns the
+    // flush result
+    int output_sink_destroy(OutputSink *sink);
+
+    // All writers return 0, or -1 with errno set. A failed write is sticky:
+    // later calls fail with the same errno.
+    int output_sink_write(OutputSink *sink, const void *data, size_t size);
+    int output_sink_writev(OutputSink *sink, const struct iovec *iov, int count);
+    // Append count copies of c (indentation, padding)
+    int output_sink_write_repeat(OutputSink *sink, char c, size_t count);
+
+    // Space for writing straight into the buffer: returns a pointer with
+    // at least size bytes free, flushing first when needed, and reports
+    // all that is free in *room. Bytes put there count once passed to
+    // output_sink_commit. NULL with errno set when size exceeds the buffer
+    // or on a sticky error.
+    char *output_sink_reserve(OutputSink *sink, size_t size, size_t *room);
+    void output_sink_commit(OutputSink *sink, size_t size);
+
+    // Push everything buffered to the descriptor; a compressed stream
+    // ends its current member there
+    int output_sink_flush(OutputSink *sink);
+
+    // Flush, then copy a byte range of in_fd to the output in the kernel
+    // (see zerocopy_fd_range). Turns O_DIRECT off for good. A compressed
+    // sink reads the range through its buffer instead.
+    int output_sink_copy_fd(OutputSink *sink, int in_fd, off_t offset, size_t length,
+                            size_t *copied, ZeroCopyMethod *method);
+
+    int output_sink_fd(const OutputSink *sink);
+    // Output offset the next byte written lands at, buffered bytes included
+    off_t output_sink_tell(const OutputSink *sink);
+    OutputSinkStats output_sink_get_stats(const OutputSink *sink);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_OUTPUT_H */
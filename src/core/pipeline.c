@@ -0,0 +1,1534 @@
+#include "pipeline.h"
+#include "aio.h"
+#include "arena.h"
+#include "dedup.h"
+#include "incremental.h"
+#include "metrics.h"
+#include "progress.h"
+#include "tree.h"
+#include "zerocopy.h"
+#include "../filter/filter.h"
+#include "../format/format.h"
+#include "../plugins/plugin.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+// Results kept in flight per worker; bounds memory held by the reorder stage
+#define PIPELINE_WINDOW_PER_JOB 4
+// Files below this size are read whole by the I/O engine ahead of their
+// turn; larger ones stream through fread and may be copied in the kernel
+#define PIPELINE_PREFETCH_MAX_FILE ZEROCOPY_MIN_SIZE
+// A chunk is doubled after a full read that took less than this, so a
+// fast device quickly reaches large chunks while slow reads stay short
+#define PIPELINE_CHUNK_GROW_NS (25 * 1000 * 1000)
+// Furthest a line-counted side of a --sample policy reads looking for its
+// lines, so a file without newlines is not read whole
+#define PIPELINE_SAMPLE_LINE_SCAN (4 * 1024 * 1024)
+
+// Contents of a file read ahead by the I/O engine
+typedef struct
+{
+    const char *data;
+    size_t size;
+} PreloadedFile;
+
+// ============================================================================
+// PER-FILE CONTENT PROCESSING
+// ============================================================================
+
+static int chunk_buffer_append(ChunkBuffer *buf, const char *data, size_t size)
+{
+    if (buf->chunk_count >= buf->chunk_capacity)
+    {
+        size_t new_capacity = buf->chunk_capacity ? buf->chunk_capacity * 2 : 8;
+        size_t *new_sizes = realloc(buf->chunk_sizes, new_capacity * sizeof(size_t));
+        if (!new_sizes)
+            return -1;
+        buf->chunk_sizes = new_sizes;
+        buf->chunk_capacity = new_capacity;
+    }
+
+    if (buf->size + size > buf->capacity)
+    {
+        size_t new_capacity = buf->capacity ? buf->capacity : 4096;
+        while (new_capacity < buf->size + size)
+            new_capacity *= 2;
+        char *new_data = realloc(buf->data, new_capacity);
+        if (!new_data)
+            return -1;
+        buf->data = new_data;
+        buf->capacity = new_capacity;
+    }
+
+    memcpy(buf->data + buf->size, data, size);
+    buf->size += size;
+    buf->chunk_sizes[buf->chunk_count++] = size;
+    return 0;
+}
+
+static void file_output_reset(FileOutput *out)
+{
+    free(out->chunks.data);
+    free(out->chunks.chunk_sizes);
+    memset(out, 0, sizeof(*out));
+}
+
+static int emit_chunk(FconcatContext *ctx, FileOutput *out, const char *data, size_t size)
+{
+    // A transform or replacement may leave nothing of a chunk
+    if (size == 0)
+        return 0;
+    if (out)
+        return chunk_buffer_append(&out->chunks, data, size);
+
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (internal->format_engine)
+        return format_engine_write_file_chunk(internal->format_engine, ctx, data, size);
+    return 0;
+}
+
+// Content plugin output goes where unprocessed chunks would
+typedef struct
+{
+    FileOutput *out;
+} ContentSink;
+
+static int emit_content_output(FconcatContext *ctx, const char *data, size_t size, void *user_data)
+{
+    return emit_chunk(ctx, ((ContentSink *)user_data)->out, data, size);
+}
+
+// Direct writes of large files whose bytes reach the output unchanged can
+// skip the read/fwrite round trip after the first chunk
+static bool can_copy_raw(FconcatContext *ctx, const FileInfo *info, const FileOutput *out, const FilterFilePlan *plan)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+
+    if (out || info->size < ZEROCOPY_MIN_SIZE || !internal->format_engine)
+        return false;
+    if (!(format_engine_active_capabilities(internal->format_engine) & FORMAT_CAP_RAW_CHUNKS))
+        return false;
+    return !plan->inspect_content && !plan->transform_content;
+}
+
+// Bodies that reach the output unaltered may be written as a reference
+// to an earlier identical one
+static bool dedup_eligible(FconcatContext *ctx, const FileInfo *info, const FilterFilePlan *plan)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+
+    if (!internal->dedup || info->size < DEDUP_MIN_SIZE || !internal->format_engine)
+        return false;
+    if (!(format_engine_active_capabilities(internal->format_engine) & FORMAT_CAP_FILE_REFERENCES))
+        return false;
+    return !plan->inspect_content && !plan->transform_content;
+}
+
+// Hash the rest of a file whose first chunk is already in state, without
+// disturbing the read position. False if the file no longer has info->size bytes.
+static bool dedup_hash_rest(FILE *file, const PreloadedFile *preloaded, size_t first, const FileInfo *info,
+                            Xxh64State *state)
+{
+    if (preloaded)
+    {
+        xxh64_update(state, preloaded->data + first, preloaded->size - first);
+        return preloaded->size == info->size;
+    }
+
+    ssize_t n = dedup_hash_range(fileno(file), (off_t)first, info->size - first, state);
+    return n >= 0 && first + (size_t)n == info->size;
+}
+
+static void record_progress(FconcatContext *ctx, FileOutput *out, size_t bytes)
+{
+    if (!out)
+    {
+        update_context_progress(ctx, bytes);
+        return;
+    }
+
+    ctx->current_file_processed_bytes += bytes;
+    out->delta.processed_bytes += bytes;
+    progress_reporter_add(((InternalContextState *)ctx->internal_state)->progress, bytes, 0);
+}
+
+size_t pipeline_chunk_size(size_t file_size)
+{
+    if (file_size == 0)
+        return 4096; // Size unknown (empty or special file)
+    if (file_size <= PIPELINE_WHOLE_FILE_CHUNK)
+        return file_size; // Read the whole file at once
+    return PIPELINE_WHOLE_FILE_CHUNK;
+}
+
+size_t pipeline_max_chunk_size(size_t file_size)
+{
+    if (file_size <= PIPELINE_WHOLE_FILE_CHUNK)
+        return pipeline_chunk_size(file_size);
+
+    // Power of two near a quarter of the file, within the bounds
+    size_t chunk = PIPELINE_WHOLE_FILE_CHUNK;
+    while (chunk < PIPELINE_MAX_CHUNK && chunk < file_size / 4)
+        chunk *= 2;
+    return chunk;
+}
+
+// Tell the kernel a large file is about to be read front to back, and
+// start reading the first window
+static void advise_sequential(FILE *file, size_t window)
+{
+    int fd = fileno(file);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#ifdef __linux__
+    readahead(fd, 0, window);
+#else
+    posix_fadvise(fd, 0, (off_t)window, POSIX_FADV_WILLNEED);
+#endif
+}
+
+int pipeline_classify_file(FconcatContext *ctx, const char *path, FileInfo *info)
+{
+    if (!ctx || !path || !info)
+        return -1;
+
+    if (info->binary_checked)
+        return 0;
+
+    char full_path[MAX_PATH];
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    int path_len = snprintf(full_path, sizeof(full_path), "%s/%s", config->input_directory, path);
+    if (path_len < 0 || path_len >= (int)sizeof(full_path))
+        return -1;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    FILE *file = fopen(full_path, "rb");
+    metrics_end(metrics, METRICS_OPEN, start, 0);
+    if (!file)
+        return -1; // Leave unclassified; the content pass reports the error
+
+    // Sample exactly what the content pass would see in its first chunk so
+    // both passes always agree on the verdict
+    char sample[BINARY_CHECK_SIZE];
+    size_t chunk = pipeline_chunk_size(info->size);
+    size_t sample_size = chunk < sizeof(sample) ? chunk : sizeof(sample);
+    start = metrics_begin(metrics);
+    size_t bytes_read = fread(sample, 1, sample_size, file);
+    metrics_end(metrics, METRICS_READ, start, bytes_read);
+    fclose(file);
+
+    start = metrics_begin(metrics);
+    info->is_binary = filter_detect_binary(sample, bytes_read) == 1;
+    info->binary_checked = true;
+    metrics_end(metrics, METRICS_BINARY_SCAN, start, bytes_read);
+    return 0;
+}
+
+// Next chunk of a file, either read into buffer or pointing into the
+// preloaded contents
+static size_t next_chunk(FILE *file, const PreloadedFile *preloaded, size_t *offset,
+                         char *buffer, size_t buffer_size, const char **chunk)
+{
+    if (!preloaded)
+    {
+        *chunk = buffer;
+        return fread(buffer, 1, buffer_size, file);
+    }
+
+    size_t remaining = preloaded->size - *offset;
+    size_t n = remaining < buffer_size ? remaining : buffer_size;
+    *chunk = preloaded->data + *offset;
+    *offset += n;
+    return n;
+}
+
+// Reads the parts of a file a --sample policy keeps, with pread at their
+// offsets or from the preloaded contents; the middle is never read
+typedef struct
+{
+    const SamplePolicy *policy;
+    int fd;
+    const PreloadedFile *preloaded;
+    size_t size;         // Bytes in the file when it was stat'd
+    size_t offset;       // Next byte to read
+    size_t chunk_offset; // Of the chunk returned last
+    size_t tail_start;
+    size_t head_lines;   // Newlines the head has taken so far
+    bool in_tail;
+    size_t gap;          // Bytes skipped just before the chunk returned last
+    size_t skipped;      // Bytes skipped after it, not reported yet
+} SampleReader;
+
+static size_t sample_read_at(SampleReader *reader, char *buffer, size_t size, size_t offset, const char **chunk)
+{
+    if (reader->preloaded)
+    {
+        size_t available = offset < reader->preloaded->size ? reader->preloaded->size - offset : 0;
+        *chunk = reader->preloaded->data + offset;
+        return size < available ? size : available;
+    }
+
+    size_t total = 0;
+    while (total < size)
+    {
+        ssize_t n = pread(reader->fd, buffer + total, size - total, (off_t)(offset + total));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break; // Read errors end the file early, as fread does
+        total += (size_t)n;
+    }
+    *chunk = buffer;
+    return total;
+}
+
+// Where the tail starts: before the last policy->tail lines, found by
+// reading backwards from the end, at most PIPELINE_SAMPLE_LINE_SCAN bytes
+static size_t sample_find_tail_lines(SampleReader *reader, char *buffer, size_t buffer_size)
+{
+    size_t floor = reader->size > PIPELINE_SAMPLE_LINE_SCAN ? reader->size - PIPELINE_SAMPLE_LINE_SCAN : 0;
+    size_t wanted = reader->policy->tail;
+    size_t pos = reader->size;
+    while (pos > floor)
+    {
+        size_t block = pos - floor < buffer_size ? pos - floor : buffer_size;
+        size_t start = pos - block;
+        const char *data = NULL;
+        if (sample_read_at(reader, buffer, block, start, &data) != block)
+            return floor;
+        for (size_t i = block; i-- > 0;)
+        {
+            // The newline ending the file closes the last line, not a line before it
+            if (data[i] == '\n' && start + i + 1 < reader->size && --wanted == 0)
+                return start + i + 1;
+        }
+        pos = start;
+    }
+    return floor;
+}
+
+// Settles where the tail starts, using buffer before any chunk is read
+static void sample_reader_init(SampleReader *reader, const SamplePolicy *policy, FILE *file,
+                               const PreloadedFile *preloaded, size_t size, char *buffer, size_t buffer_size)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->policy = policy;
+    reader->fd = file ? fileno(file) : -1;
+    reader->preloaded = preloaded;
+    reader->size = preloaded ? preloaded->size : size;
+
+    if (policy->tail == 0)
+        reader->tail_start = reader->size;
+    else if (policy->tail_lines)
+        reader->tail_start = sample_find_tail_lines(reader, buffer, buffer_size);
+    else
+        reader->tail_start = reader->size > policy->tail ? reader->size - policy->tail : 0;
+}
+
+static bool sample_reader_done(const SampleReader *reader)
+{
+    return reader->in_tail && reader->offset >= reader->size;
+}
+
+// The head is over: jump to the tail, leaving out what lies between
+static void sample_end_head(SampleReader *reader)
+{
+    reader->in_tail = true;
+    if (reader->tail_start > reader->offset)
+    {
+        reader->skipped = reader->tail_start - reader->offset;
+        reader->offset = reader->tail_start;
+    }
+}
+
+// Next kept chunk: the head, then the tail. A head that runs into the
+// tail carries straight on, so nothing is left out.
+static size_t sample_next(SampleReader *reader, char *buffer, size_t buffer_size, const char **chunk)
+{
+    const SamplePolicy *policy = reader->policy;
+    reader->gap = 0;
+
+    if (!reader->in_tail)
+    {
+        size_t limit = policy->head_lines ? PIPELINE_SAMPLE_LINE_SCAN : policy->head;
+        if (limit > reader->tail_start)
+            limit = reader->tail_start;
+        if (reader->offset < limit)
+        {
+            size_t want = limit - reader->offset < buffer_size ? limit - reader->offset : buffer_size;
+            size_t n = sample_read_at(reader, buffer, want, reader->offset, chunk);
+            bool head_done = n < want;
+            for (size_t i = 0; policy->head_lines && i < n; i++)
+            {
+                if ((*chunk)[i] == '\n' && ++reader->head_lines == policy->head)
+                {
+                    n = i + 1;
+                    head_done = true;
+                    break;
+                }
+            }
+            reader->chunk_offset = reader->offset;
+            reader->offset += n;
+            if (head_done || reader->offset >= limit)
+                sample_end_head(reader);
+            if (n > 0)
+                return n;
+        }
+        else
+            sample_end_head(reader);
+    }
+
+    if (reader->offset >= reader->size)
+        return 0;
+    size_t want = reader->size - reader->offset < buffer_size ? reader->size - reader->offset : buffer_size;
+    size_t n = sample_read_at(reader, buffer, want, reader->offset, chunk);
+    if (n == 0)
+    {
+        reader->offset = reader->size; // The file shrank
+        return 0;
+    }
+    reader->gap = reader->skipped;
+    reader->skipped = 0;
+    reader->chunk_offset = reader->offset;
+    reader->offset += n;
+    return n;
+}
+
+// A line saying how much of a sampled file was left out, written where
+// the bytes would have been
+static int emit_elision(FconcatContext *ctx, FileOutput *out, ContentChain *content, ContentSink *sink,
+                        size_t omitted, bool at_line_start)
+{
+    char marker[96];
+    int length =
+        snprintf(marker, sizeof(marker), "%s" PIPELINE_SAMPLE_MARKER "\n", at_line_start ? "" : "\n", omitted);
+    if (length <= 0 || length >= (int)sizeof(marker))
+        return -1;
+    if (content->count > 0)
+        return content_chain_write(content, ctx, marker, (size_t)length, emit_content_output, sink);
+    return emit_chunk(ctx, out, marker, (size_t)length);
+}
+
+// Chunks of one file waiting for the filter engine, which runs over all
+// of them in one call. Each slot keeps its bytes until the batch is
+// flushed: slot 0 reads into the file's buffer, the others into spare.
+typedef struct
+{
+    FilterChunk chunks[FILTER_BATCH_MAX];
+    FilterSegment segments[FILTER_BATCH_MAX];
+    size_t gaps[FILTER_BATCH_MAX]; // Sampled bytes left out before each chunk
+    size_t count;
+    size_t capacity;
+    char *first;
+    char *spare;
+    size_t slot_size;
+} ChunkBatch;
+
+static char *chunk_batch_slot(const ChunkBatch *batch, size_t slot)
+{
+    return slot == 0 ? batch->first : batch->spare + (slot - 1) * batch->slot_size;
+}
+
+static void chunk_batch_add(ChunkBatch *batch, const char *path, const char *data, size_t size, size_t offset,
+                            bool last, size_t gap)
+{
+    size_t i = batch->count++;
+    batch->segments[i] = (FilterSegment){data, size};
+    batch->gaps[i] = gap;
+    batch->chunks[i] = (FilterChunk){0};
+    batch->chunks[i].path = path;
+    batch->chunks[i].segments = &batch->segments[i];
+    batch->chunks[i].segment_count = 1;
+    batch->chunks[i].size = size;
+    batch->chunks[i].offset = offset;
+    batch->chunks[i].flags = (offset == 0 ? FILTER_CHUNK_FIRST : 0) | (last ? FILTER_CHUNK_LAST : 0);
+}
+
+// Content checks and transforms over the batch, then its chunks to the
+// output in order up to the first one that excludes the rest of the file.
+// Whatever the transforms took from the arena is dead once they are out.
+static int chunk_batch_flush(FconcatContext *ctx, FileOutput *out, const char *path, const FilterFilePlan *plan,
+                             ChunkBatch *batch, ContentChain *content, ContentSink *sink, bool *at_line_start,
+                             bool *excluded)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    ProcessingStats *stats = out ? &out->delta : (ProcessingStats *)ctx->stats;
+    size_t count = batch->count;
+    batch->count = 0;
+
+    ArenaMark mark = arena_mark((Arena *)ctx->arena);
+    if ((plan->inspect_content || plan->transform_content) &&
+        filter_engine_filter_chunks(internal->filter_engine, ctx, plan, batch->chunks, count) != 0)
+    {
+        arena_rewind((Arena *)ctx->arena, mark);
+        ctx->error(ctx, "Failed to filter content of file: %s", path);
+        return -1;
+    }
+
+    int status = 0;
+    for (size_t i = 0; i < count && status == 0; i++)
+    {
+        FilterChunk *chunk = &batch->chunks[i];
+        if (chunk->exclude)
+        {
+            ctx->log(ctx, LOG_DEBUG, "Excluding content for: %s", path);
+            // Still count as processed but mark as skipped
+            if (stats)
+            {
+                stats->skipped_files++;
+                stats->processed_files--; // Subtract from processed count
+            }
+            *excluded = true;
+            break;
+        }
+
+        const char *data = chunk->segments[0].data;
+        size_t data_size = chunk->size;
+        if (chunk->output)
+        {
+            // Use transformed data
+            data = chunk->output;
+            data_size = chunk->output_size;
+            if (stats)
+            {
+                stats->filtered_bytes += data_size;
+            }
+        }
+        // Otherwise the original data goes on; record_progress below accounts for it
+
+        if (batch->gaps[i] > 0)
+            status = emit_elision(ctx, out, content, sink, batch->gaps[i], *at_line_start);
+        if (status == 0 && content->count > 0)
+            status = content_chain_write(content, ctx, data, data_size, emit_content_output, sink);
+        else if (status == 0)
+            status = emit_chunk(ctx, out, data, data_size);
+        if (data_size > 0)
+            *at_line_start = data[data_size - 1] == '\n';
+
+        if (out && status != 0)
+            ctx->error(ctx, "Failed to buffer content for file: %s", path);
+        else
+        {
+            status = 0;
+            record_progress(ctx, out, chunk->size);
+        }
+    }
+
+    for (size_t j = 0; j < count; j++)
+        context_scratch_release(ctx, batch->chunks[j].output);
+    arena_rewind((Arena *)ctx->arena, mark);
+    return status;
+}
+
+static int process_file_content(FconcatContext *ctx, const char *path, FileInfo *info, FileOutput *out,
+                                const PreloadedFile *preloaded)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    ProcessingStats *stats = out ? &out->delta : (ProcessingStats *)ctx->stats;
+
+    if (fconcat_log_enabled(ctx, LOG_DEBUG))
+        ctx->log(ctx, LOG_DEBUG, "Processing file: %s", path);
+    ctx->current_file_processed_bytes = 0;
+
+    // Update file count in stats
+    if (stats)
+    {
+        stats->processed_files++;
+        stats->total_files++;
+    }
+
+    // Write file header (buffered output gets its header at commit time)
+    if (!out && internal->format_engine)
+    {
+        int result = format_engine_write_file_header(internal->format_engine, ctx, path);
+        if (result != 0)
+            return result;
+    }
+
+    // Build full path for file access
+    char full_path[MAX_PATH];
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    int path_len = snprintf(full_path, sizeof(full_path), "%s/%s", config->input_directory, path);
+    if (path_len < 0 || path_len >= (int)sizeof(full_path))
+    {
+        ctx->error(ctx, "Path too long: %s", path);
+        return -1;
+    }
+
+    // A sampled file is read only as far as its policy reaches, so the
+    // size limit does not apply to it
+    const SamplePolicy *sample = filter_engine_sample_policy(internal->filter_engine, path, info);
+
+    // SAFETY: Check file size limit to prevent resource exhaustion
+    if (!sample && info->size > MAX_FILE_SIZE)
+    {
+        ctx->warning(ctx, "File too large, skipping (limit %lluMB): %s (%zu bytes)",
+                     (unsigned long long)(MAX_FILE_SIZE / (1024 * 1024)), path, info->size);
+        if (stats)
+        {
+            stats->skipped_files++;
+        }
+        return 0; // Continue with other files
+    }
+
+    // FIXED: Graceful file opening with permission handling
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t open_start = metrics_begin(metrics);
+    FILE *file = preloaded ? NULL : fopen(full_path, "rb");
+    if (!preloaded)
+        metrics_end(metrics, METRICS_OPEN, open_start, 0);
+    if (!file && !preloaded)
+    {
+        if (errno == EACCES)
+        {
+            ctx->warning(ctx, "Permission denied opening file: %s", full_path);
+        }
+        else if (errno == ENOENT)
+        {
+            ctx->warning(ctx, "File disappeared during processing: %s", full_path);
+        }
+        else
+        {
+            ctx->warning(ctx, "Cannot open file: %s - %s", full_path, strerror(errno));
+        }
+        return 0; // Continue processing other files
+    }
+
+    size_t buffer_size = pipeline_chunk_size(info->size);
+    size_t max_chunk = preloaded || sample ? buffer_size : pipeline_max_chunk_size(info->size);
+    if (file && !sample && info->size > PIPELINE_WHOLE_FILE_CHUNK)
+        advise_sequential(file, max_chunk);
+
+    // Get buffer from pool; preloaded contents are processed in place
+    char *buffer = preloaded ? NULL : memory_get_buffer(internal->memory_manager, buffer_size);
+    if (!buffer && !preloaded)
+    {
+        ctx->error(ctx, "Failed to allocate buffer for file: %s", full_path);
+        fclose(file);
+        return -1;
+    }
+
+    // Read file content in chunks
+    const char *chunk = NULL;
+    size_t preloaded_offset = 0;
+    size_t bytes_read;
+    size_t consumed = 0;
+    bool content_excluded = false;
+    bool first_chunk = true;
+    bool copy_raw = false;
+    FilterFilePlan plan = {0};
+    int status = 0;
+    ContentChain content;      // Content plugins taking this file
+    content.count = 0;
+    ContentSink content_sink = {out};
+    bool dedup = false;        // Body is hashed for the dedup index
+    bool dedup_whole = false;  // dedup_state already covers the whole file
+    bool referenced = false;   // Written as a reference instead of its body
+    bool replaced = false;     // A file rule wrote a replacement for all of it
+    Xxh64State dedup_state;
+    SampleReader sampler;
+    bool at_line_start = true; // Whether the last byte emitted ends a line
+    if (sample)
+    {
+        // Reading at offsets leaves the stream position alone, so the
+        // pread calls bypass its buffer
+        sample_reader_init(&sampler, sample, file, preloaded, info->size, buffer, buffer_size);
+    }
+
+    uint64_t read_start = metrics_now_ns();
+
+    ChunkBatch batch = {.capacity = 1, .first = buffer};
+    char *read_into = buffer;
+    while ((bytes_read = sample ? sample_next(&sampler, buffer, buffer_size, &chunk)
+                                : next_chunk(file, preloaded, &preloaded_offset, read_into, buffer_size, &chunk)) > 0)
+    {
+        uint64_t read_ns = metrics_now_ns() - read_start;
+        if (file && metrics)
+            metrics_record(metrics, METRICS_READ, read_ns, 1, bytes_read);
+
+        // File-level decisions are made once, on the first chunk
+        if (first_chunk)
+        {
+            first_chunk = false;
+
+            if (!info->binary_checked)
+            {
+                uint64_t scan_start = metrics_begin(metrics);
+                const char *head = chunk;
+                size_t scanned = bytes_read < BINARY_CHECK_SIZE ? bytes_read : BINARY_CHECK_SIZE;
+                char head_buffer[BINARY_CHECK_SIZE];
+                if (sample)
+                {
+                    // A sampled first chunk is only what the policy keeps of
+                    // the head; classify the start of the file instead, the
+                    // same bytes pipeline_classify_file looks at
+                    size_t want = pipeline_chunk_size(info->size);
+                    if (want > sizeof(head_buffer))
+                        want = sizeof(head_buffer);
+                    scanned = sample_read_at(&sampler, head_buffer, want, 0, &head);
+                }
+                info->is_binary = filter_detect_binary(head, scanned) == 1;
+                info->binary_checked = true;
+                metrics_end(metrics, METRICS_BINARY_SCAN, scan_start, scanned);
+            }
+
+            if (!filter_engine_should_include_file(internal->filter_engine, ctx, path, info))
+            {
+                ctx->log(ctx, LOG_DEBUG, "Excluding content for: %s", path);
+                if (stats)
+                {
+                    stats->skipped_files++;
+                    stats->processed_files--; // Subtract from processed count
+                }
+                content_excluded = true;
+                break;
+            }
+
+            char *replacement = NULL;
+            size_t replacement_size = 0;
+            if (filter_engine_replace_file(internal->filter_engine, ctx, path, info,
+                                           &replacement, &replacement_size) == 0)
+            {
+                // The whole file is represented by the replacement
+                status = emit_chunk(ctx, out, replacement, replacement_size);
+                if (stats)
+                {
+                    stats->filtered_bytes += replacement_size;
+                }
+                context_scratch_release(ctx, replacement);
+
+                if (out && status != 0)
+                    ctx->error(ctx, "Failed to buffer content for file: %s", path);
+                else
+                    status = 0;
+
+                record_progress(ctx, out, bytes_read);
+                replaced = true;
+                break;
+            }
+
+            filter_engine_plan_file(internal->filter_engine, ctx, path, info, &plan);
+
+            ContentPlugin *plugins[MAX_PLUGINS];
+            int plugin_count = plugin_manager_content_plugins(internal->plugin_manager, plugins, MAX_PLUGINS);
+            if (plugin_count > 0)
+                content_chain_begin(&content, plugins, plugin_count, ctx, path, info);
+
+            // Plugins may rewrite any chunk, so the body is only known once
+            // they have seen it
+            // A sampled body is not the file's, and most of it is never read
+            copy_raw = file && !sample && content.count == 0 && can_copy_raw(ctx, info, out, &plan);
+            dedup = !sample && content.count == 0 && dedup_eligible(ctx, info, &plan);
+            if (dedup)
+                xxh64_reset(&dedup_state, 0);
+
+            // Plugins that take chunks in batches see several per call; the
+            // chunks after this one are read into spare slots of its size
+            size_t chunks_left = (info->size + buffer_size - 1) / buffer_size;
+            if (!sample && (plan.inspect_content || plan.transform_content) && chunks_left > 1 &&
+                internal->filter_engine && internal->filter_engine->stages.batch_plugin_count > 0)
+            {
+                size_t capacity = PIPELINE_FILTER_BATCH_BYTES / buffer_size;
+                if (capacity > chunks_left)
+                    capacity = chunks_left;
+                if (capacity > FILTER_BATCH_MAX)
+                    capacity = FILTER_BATCH_MAX;
+                if (capacity > 1 && !preloaded)
+                    batch.spare = memory_get_buffer(internal->memory_manager, (capacity - 1) * buffer_size);
+                if (capacity > 1 && (preloaded || batch.spare))
+                {
+                    batch.capacity = capacity;
+                    batch.slot_size = buffer_size;
+                }
+            }
+
+            // An earlier body of the same size may be this one; that has to
+            // be settled before any of it is written
+            if (dedup && !out && dedup_index_has_size(internal->dedup, info->size))
+            {
+                xxh64_update(&dedup_state, chunk, bytes_read);
+                dedup_whole = dedup_hash_rest(file, preloaded, bytes_read, info, &dedup_state);
+                dedup = dedup_whole;
+
+                DedupBody body = {preloaded ? preloaded->data : NULL, preloaded ? -1 : fileno(file)};
+                const char *original =
+                    dedup_whole ? dedup_index_find(internal->dedup, info->size, xxh64_digest(&dedup_state), &body)
+                                : NULL;
+                if (original)
+                {
+                    ctx->log(ctx, LOG_DEBUG, "Identical to %s: %s", original, path);
+                    status = format_engine_write_file_reference(internal->format_engine, ctx, original);
+                    dedup_index_note_duplicate(internal->dedup, info->size);
+                    record_progress(ctx, out, info->size);
+                    referenced = true;
+                    break;
+                }
+            }
+        }
+
+        size_t offset = sample ? sampler.chunk_offset : consumed;
+        bool last = sample ? sample_reader_done(&sampler) : consumed + bytes_read >= info->size;
+        chunk_batch_add(&batch, path, chunk, bytes_read, offset, last, sample ? sampler.gap : 0);
+        if (dedup && !dedup_whole)
+            xxh64_update(&dedup_state, chunk, bytes_read);
+        consumed += bytes_read;
+
+        if (batch.count == batch.capacity || last)
+        {
+            status = chunk_batch_flush(ctx, out, path, &plan, &batch, &content, &content_sink, &at_line_start,
+                                       &content_excluded);
+            if (status != 0 || content_excluded)
+                break;
+        }
+        read_into = preloaded ? NULL : chunk_batch_slot(&batch, batch.count);
+
+        // The first chunk settled every file-level rule; the rest of the file
+        // goes to the output in the kernel without passing through buffer
+        if (copy_raw)
+        {
+            struct stat st;
+            if (fstat(fileno(file), &st) == 0 && st.st_size > (off_t)consumed)
+            {
+                size_t copied = 0;
+                if (context_write_output_fd(ctx, fileno(file), (off_t)consumed,
+                                            (size_t)(st.st_size - (off_t)consumed), &copied) != 0)
+                {
+                    ctx->error(ctx, "Failed to write content of file: %s - %s", path, strerror(errno));
+                    status = -1;
+                }
+                record_progress(ctx, out, copied);
+            }
+            break;
+        }
+
+        // Fewer, larger chunks for big files on a device that keeps up
+        // (a batch keeps its slots the same size instead)
+        if (batch.capacity == 1 && buffer_size < max_chunk && bytes_read == buffer_size &&
+            read_ns < PIPELINE_CHUNK_GROW_NS)
+        {
+            char *larger = memory_get_buffer(internal->memory_manager, buffer_size * 2);
+            if (larger)
+            {
+                memory_release_buffer(internal->memory_manager, buffer);
+                buffer = larger;
+                buffer_size *= 2;
+                batch.first = read_into = buffer;
+            }
+        }
+        read_start = metrics_now_ns();
+    }
+
+    // A file that ended sooner than its size said leaves a batch behind
+    if (batch.count > 0 && status == 0)
+        status = chunk_batch_flush(ctx, out, path, &plan, &batch, &content, &content_sink, &at_line_start,
+                                   &content_excluded);
+
+    // A head with no tail after it leaves the rest of the file out
+    if (sample && status == 0 && !content_excluded && !replaced && sampler.skipped > 0)
+    {
+        status = emit_elision(ctx, out, &content, &content_sink, sampler.skipped, at_line_start);
+        if (out && status != 0)
+            ctx->error(ctx, "Failed to buffer content for file: %s", path);
+        else
+            status = 0;
+    }
+
+    // Release buffer back to pool
+    if (buffer)
+        memory_release_buffer(internal->memory_manager, buffer);
+    if (batch.spare)
+        memory_release_buffer(internal->memory_manager, batch.spare);
+    if (file)
+        fclose(file);
+
+    // What plugins held back for the end of the file comes out now
+    if (content.count > 0)
+    {
+        if (status == 0 && !content_excluded)
+            status = content_chain_end(&content, ctx, emit_content_output, &content_sink);
+        else
+            content_chain_abort(&content, ctx);
+        if (out && status != 0)
+            ctx->error(ctx, "Failed to buffer content for file: %s", path);
+        else
+            status = 0;
+    }
+
+    if (status != 0)
+        return status;
+
+    // Index the body for later files. A kernel copy skipped most of it, so
+    // it is hashed from disk if a file of the same size turns up.
+    if (dedup && !referenced && !content_excluded)
+    {
+        bool complete = dedup_whole || consumed == info->size;
+        if (out)
+        {
+            out->dedup_hashed = complete;
+            out->dedup_size = info->size;
+            out->dedup_hash = xxh64_digest(&dedup_state);
+        }
+        else if (copy_raw && !dedup_whole)
+            dedup_index_add(internal->dedup, path, info, 0, false);
+        else if (complete)
+            dedup_index_add(internal->dedup, path, info, xxh64_digest(&dedup_state), true);
+    }
+
+    // Write file footer (only if content wasn't excluded)
+    if (!content_excluded)
+    {
+        if (out)
+            out->write_footer = true;
+        else if (internal->format_engine)
+            return format_engine_write_file_footer(internal->format_engine, ctx);
+    }
+
+    return 0;
+}
+
+static int process_file(FconcatContext *ctx, const char *path, FileInfo *info, FileOutput *out,
+                        const PreloadedFile *preloaded)
+{
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    int result = process_file_content(ctx, path, info, out, preloaded);
+    if (metrics)
+        metrics_record_file(metrics, path, metrics_now_ns() - start, info->size);
+
+    // Whatever of the file was skipped, sampled out or never read still
+    // counts as done, so the reported progress reaches the total
+    size_t unread = info->size > ctx->current_file_processed_bytes ? info->size - ctx->current_file_processed_bytes : 0;
+    progress_reporter_add(((InternalContextState *)ctx->internal_state)->progress, unread, 1);
+
+    // Buffered outputs hold copies, so nothing of this file's scratch
+    // memory outlives the footer
+    arena_reset((Arena *)ctx->arena);
+    return result;
+}
+
+int pipeline_process_file(FconcatContext *ctx, const char *path, FileInfo *info, FileOutput *out)
+{
+    if (!ctx || !path || !info)
+        return -1;
+
+    return process_file(ctx, path, info, out, NULL);
+}
+
+// Replay a buffered result through the format engine on the writer thread
+static int pipeline_commit_output(FconcatContext *ctx, TreeEntry *entry, FileOutput *out)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    ProcessingStats *stats = (ProcessingStats *)ctx->stats;
+
+    ctx->current_file_path = entry->path;
+    ctx->current_file_info = &entry->info;
+    ctx->current_directory_level = entry->level;
+
+    if (stats)
+    {
+        stats->total_files += out->delta.total_files;
+        stats->processed_files += out->delta.processed_files;
+        stats->skipped_files += out->delta.skipped_files;
+        stats->processed_bytes += out->delta.processed_bytes;
+        stats->filtered_bytes += out->delta.filtered_bytes;
+    }
+    ctx->current_file_processed_bytes = out->delta.processed_bytes;
+
+    int result = 0;
+    if (internal->format_engine)
+    {
+        result = format_engine_write_file_header(internal->format_engine, ctx, entry->path);
+        if (result != 0)
+            goto done;
+
+        if (out->status != 0)
+        {
+            result = out->status;
+            goto done;
+        }
+
+        // Workers only hash; the index is consulted in output order here
+        DedupBody body = {out->chunks.data, -1};
+        const char *original =
+            out->dedup_hashed ? dedup_index_find(internal->dedup, out->dedup_size, out->dedup_hash, &body) : NULL;
+        if (original)
+        {
+            ctx->log(ctx, LOG_DEBUG, "Identical to %s: %s", original, entry->path);
+            result = format_engine_write_file_reference(internal->format_engine, ctx, original);
+            dedup_index_note_duplicate(internal->dedup, out->dedup_size);
+        }
+        else
+        {
+            const char *cursor = out->chunks.data;
+            for (size_t i = 0; i < out->chunks.chunk_count && result == 0; i++)
+            {
+                size_t size = out->chunks.chunk_sizes[i];
+                result = format_engine_write_file_chunk(internal->format_engine, ctx, cursor, size);
+                cursor += size;
+            }
+            // A body that did not make it out whole cannot be referred to
+            if (out->dedup_hashed && result == 0)
+                dedup_index_add(internal->dedup, entry->path, &entry->info, out->dedup_hash, true);
+        }
+        if (result != 0)
+            goto done;
+
+        if (out->write_footer)
+            result = format_engine_write_file_footer(internal->format_engine, ctx);
+    }
+    else
+    {
+        result = out->status;
+    }
+
+done:
+    ctx->current_file_info = NULL;
+    return result;
+}
+
+// Incremental runs bracket every rendered file so its block can be found
+// again; reused blocks queued before it are copied out first
+static int pipeline_render_begin(FconcatContext *ctx, off_t *start)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    *start = -1;
+    if (!internal->incremental)
+        return 0;
+
+    if (incremental_flush(internal->incremental, ctx) != 0)
+        return -1;
+    *start = context_output_offset(ctx);
+    return 0;
+}
+
+static void pipeline_render_end(FconcatContext *ctx, const TreeEntry *entry, off_t start)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (!internal->incremental || start < 0)
+        return;
+
+    off_t end = context_output_offset(ctx);
+    if (end >= start)
+        incremental_record(internal->incremental, entry->path, &entry->info, start, end - start);
+}
+
+// ============================================================================
+// WORKER POOL AND REORDER STAGE
+// ============================================================================
+
+typedef struct
+{
+    FileOutput output;
+    size_t seq;
+    bool ready;
+} PipelineSlot;
+
+typedef struct
+{
+    FconcatContext *ctx;
+    FileTree *tree;
+    TreeEntry **files;
+    size_t file_count;
+    PipelineSlot *slots;
+    size_t window;
+    size_t next_seq;   // Next file a worker may claim
+    size_t committed;  // Files already handed to the format engine
+    bool abort;
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_ready;
+    pthread_cond_t space_available;
+} Pipeline;
+
+static void *pipeline_worker(void *arg)
+{
+    Pipeline *pipeline = (Pipeline *)arg;
+
+    // Each worker gets a private copy of the context so the current-file
+    // fields plugins read do not race; services stay shared except the
+    // scratch arena, which is per thread.
+    FconcatContext worker_ctx = *pipeline->ctx;
+    worker_ctx.arena = arena_create(0);
+    InternalContextState *internal = (InternalContextState *)worker_ctx.internal_state;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pipeline->mutex);
+        while (!pipeline->abort && pipeline->next_seq < pipeline->file_count &&
+               pipeline->next_seq >= pipeline->committed + pipeline->window)
+        {
+            pthread_cond_wait(&pipeline->space_available, &pipeline->mutex);
+        }
+
+        if (pipeline->abort || pipeline->next_seq >= pipeline->file_count)
+        {
+            pthread_mutex_unlock(&pipeline->mutex);
+            break;
+        }
+
+        size_t seq = pipeline->next_seq++;
+        pthread_mutex_unlock(&pipeline->mutex);
+
+        TreeEntry *entry = pipeline->files[seq];
+        PipelineSlot *slot = &pipeline->slots[seq % pipeline->window];
+        FileOutput *out = &slot->output;
+        out->buffered = true;
+
+        if (incremental_reusable(internal->incremental, (size_t)(entry - pipeline->tree->entries)))
+        {
+            // The writer copies the previous block; nothing to render
+        }
+        else if (entry->info.size > PIPELINE_MAX_BUFFERED_FILE)
+        {
+            out->deferred = true;
+        }
+        else
+        {
+            worker_ctx.current_file_path = entry->path;
+            worker_ctx.current_file_info = &entry->info;
+            worker_ctx.current_directory_level = entry->level;
+            out->status = pipeline_process_file(&worker_ctx, entry->path, &entry->info, out);
+            worker_ctx.current_file_info = NULL;
+        }
+
+        pthread_mutex_lock(&pipeline->mutex);
+        slot->seq = seq;
+        slot->ready = true;
+        pthread_cond_broadcast(&pipeline->slot_ready);
+        pthread_mutex_unlock(&pipeline->mutex);
+    }
+
+    arena_destroy((Arena *)worker_ctx.arena);
+    return NULL;
+}
+
+// ============================================================================
+// READ-AHEAD FOR THE SERIAL PASS
+// ============================================================================
+
+// One whole-file read issued ahead of the file's turn
+typedef struct
+{
+    IoRequest request;
+    size_t entry_index;
+    bool done;
+    char path[MAX_PATH];
+} PrefetchSlot;
+
+// Reads are issued in tree order and consumed in the same order, so the
+// slots form a FIFO ring: head is the next file to be processed
+typedef struct
+{
+    IoEngine *engine;
+    MemoryManager *memory;
+    const char *base_dir;
+    PrefetchSlot *slots;
+    size_t depth;
+    size_t head;
+    size_t count;
+    size_t cursor; // Next tree entry to consider for read-ahead
+    bool stopped;  // The engine refused a read; nothing more is issued
+    const Incremental *incremental; // Reused files are not read
+} Prefetcher;
+
+static bool prefetch_eligible(const Prefetcher *pf, const TreeEntry *entry, size_t index)
+{
+    return entry->type != ENTRY_TYPE_DIRECTORY && entry->info.size < PIPELINE_PREFETCH_MAX_FILE &&
+           !incremental_reusable(pf->incremental, index);
+}
+
+// Keep depth reads in flight. An entry left without a read is read by
+// the content pass itself; the cursor always moves past it, since a slot
+// for an entry already behind the content pass would never be taken.
+static void prefetch_fill(Prefetcher *pf, FconcatContext *ctx, FileTree *tree)
+{
+    while (!pf->stopped && pf->count < pf->depth && pf->cursor < tree->count)
+    {
+        TreeEntry *entry = &tree->entries[pf->cursor];
+        if (!prefetch_eligible(pf, entry, pf->cursor))
+        {
+            pf->cursor++;
+            continue;
+        }
+
+        PrefetchSlot *slot = &pf->slots[(pf->head + pf->count) % pf->depth];
+        int len = snprintf(slot->path, sizeof(slot->path), "%s/%s", pf->base_dir, entry->path);
+        if (len < 0 || len >= (int)sizeof(slot->path))
+        {
+            pf->cursor++; // The content pass reports the long path
+            continue;
+        }
+
+        // One spare byte tells a file that grew since the scan from a full read
+        slot->request.path = slot->path;
+        slot->request.capacity = entry->info.size + 1;
+        slot->request.buffer = memory_get_buffer(pf->memory, slot->request.capacity);
+        slot->request.user_data = slot;
+        slot->entry_index = pf->cursor;
+        slot->done = false;
+        pf->cursor++;
+        if (!slot->request.buffer)
+            return;
+
+        // Fewer than depth are in flight, so the engine itself failed;
+        // the reads already issued are still taken as their turn comes
+        if (io_engine_submit(pf->engine, &slot->request) != 0)
+        {
+            memory_release_buffer(pf->memory, slot->request.buffer);
+            slot->request.buffer = NULL;
+            pf->stopped = true;
+            ctx->log(ctx, LOG_DEBUG, "Read-ahead stopped: %s refused a read of %s",
+                     io_engine_name(io_engine_kind(pf->engine)), entry->path);
+            return;
+        }
+
+        pf->count++;
+    }
+}
+
+static void prefetch_release(Prefetcher *pf, PrefetchSlot *slot)
+{
+    memory_release_buffer(pf->memory, slot->request.buffer);
+    slot->request.buffer = NULL;
+    pf->head = (pf->head + 1) % pf->depth;
+    pf->count--;
+}
+
+static int prefetch_start(Prefetcher *pf, FconcatContext *ctx)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+
+    memset(pf, 0, sizeof(*pf));
+    if (!config || config->io_engine == IO_ENGINE_SYNC)
+        return -1;
+
+    unsigned depth = config->io_depth > 0 ? (unsigned)config->io_depth : IO_ENGINE_DEFAULT_DEPTH;
+    pf->engine = io_engine_create(config->io_engine, depth);
+    if (!pf->engine)
+    {
+        ctx->warning(ctx, "Cannot start the %s I/O engine, reading files synchronously",
+                     io_engine_name(config->io_engine));
+        return -1;
+    }
+
+    pf->depth = depth > IO_ENGINE_MAX_DEPTH ? IO_ENGINE_MAX_DEPTH : depth;
+    pf->slots = calloc(pf->depth, sizeof(PrefetchSlot));
+    if (!pf->slots)
+    {
+        io_engine_destroy(pf->engine);
+        pf->engine = NULL;
+        return -1;
+    }
+
+    pf->memory = internal->memory_manager;
+    pf->base_dir = config->input_directory;
+    pf->incremental = internal->incremental;
+    ctx->log(ctx, LOG_DEBUG, "Reading small files through %s, %zu in flight",
+             io_engine_name(io_engine_kind(pf->engine)), pf->depth);
+    return 0;
+}
+
+static void prefetch_stop(Prefetcher *pf)
+{
+    if (!pf->engine)
+        return;
+
+    // Reads still in flight write into the slot buffers until they finish
+    io_engine_destroy(pf->engine);
+    while (pf->count > 0)
+        prefetch_release(pf, &pf->slots[pf->head]);
+    free(pf->slots);
+    pf->slots = NULL;
+    pf->engine = NULL;
+    pf->stopped = true;
+}
+
+// The read-ahead slot holding entry_index, waiting for it to complete
+static PrefetchSlot *prefetch_take(Prefetcher *pf, FconcatContext *ctx, size_t entry_index)
+{
+    if (pf->count == 0 || pf->slots[pf->head].entry_index != entry_index)
+        return NULL;
+
+    PrefetchSlot *slot = &pf->slots[pf->head];
+    while (!slot->done)
+    {
+        IoRequest *request = io_engine_reap(pf->engine, true);
+        if (!request)
+        {
+            // The slots could never be taken again; the content pass reads
+            // this file and the rest itself
+            ctx->log(ctx, LOG_DEBUG, "Read-ahead stopped: %s failed to complete a read of %s",
+                     io_engine_name(io_engine_kind(pf->engine)), slot->path);
+            prefetch_stop(pf);
+            return NULL;
+        }
+        ((PrefetchSlot *)request->user_data)->done = true;
+    }
+    return slot;
+}
+
+static int pipeline_run_serial(FconcatContext *ctx, FileTree *tree)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    Prefetcher prefetcher;
+    bool prefetching = prefetch_start(&prefetcher, ctx) == 0;
+    int result = 0;
+
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        TreeEntry *entry = &tree->entries[i];
+        if (entry->type == ENTRY_TYPE_DIRECTORY)
+            continue;
+
+        if (incremental_reusable(internal->incremental, i))
+        {
+            result = incremental_reuse(internal->incremental, ctx, tree, i);
+            if (result != 0)
+                break;
+            continue;
+        }
+
+        off_t start;
+        if (pipeline_render_begin(ctx, &start) != 0)
+        {
+            result = -1;
+            break;
+        }
+
+        PrefetchSlot *slot = NULL;
+        if (prefetching)
+        {
+            prefetch_fill(&prefetcher, ctx, tree);
+
+            // Time the content pass waits for the read-ahead of this file
+            Metrics *metrics = context_metrics(ctx);
+            uint64_t wait_start = metrics_begin(metrics);
+            slot = prefetch_take(&prefetcher, ctx, i);
+            if (slot && slot->request.error == 0)
+                metrics_end(metrics, METRICS_READ, wait_start, slot->request.size);
+        }
+
+        ctx->current_file_path = entry->path;
+        ctx->current_file_info = &entry->info;
+        ctx->current_directory_level = entry->level;
+
+        // Failed or short reads take the regular path, which reports them
+        PreloadedFile preloaded = {0};
+        bool use_preloaded = slot && slot->request.error == 0 && !slot->request.truncated;
+        if (use_preloaded)
+        {
+            preloaded.data = slot->request.buffer;
+            preloaded.size = slot->request.size;
+        }
+
+        result = process_file(ctx, entry->path, &entry->info, NULL, use_preloaded ? &preloaded : NULL);
+        ctx->current_file_info = NULL;
+        if (result == 0)
+            pipeline_render_end(ctx, entry, start);
+
+        if (slot)
+            prefetch_release(&prefetcher, slot);
+        if (result != 0)
+            break;
+    }
+
+    if (prefetching)
+        prefetch_stop(&prefetcher);
+    if (result == 0)
+        result = incremental_flush(internal->incremental, ctx);
+    return result;
+}
+
+int pipeline_resolve_jobs(int requested)
+{
+    if (requested > 0)
+        return requested > PIPELINE_MAX_JOBS ? PIPELINE_MAX_JOBS : requested;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+        return 1;
+    return cpus > PIPELINE_MAX_JOBS ? PIPELINE_MAX_JOBS : (int)cpus;
+}
+
+static int pipeline_run_jobs(FconcatContext *ctx, FileTree *tree, int jobs)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+
+    if (jobs > 1 && internal->filter_engine && internal->filter_engine->plugin_count > 0)
+    {
+        // Third-party filter plugins were written for a single caller
+        ctx->log(ctx, LOG_INFO, "Filter plugins loaded, processing content on a single thread");
+        jobs = 1;
+    }
+
+    ContentPlugin *content_plugins[1];
+    if (jobs > 1 && plugin_manager_content_plugins(internal->plugin_manager, content_plugins, 1) > 0)
+    {
+        // Content plugins keep per-file state in their own globals as often as not
+        ctx->log(ctx, LOG_INFO, "Content plugins loaded, processing content on a single thread");
+        jobs = 1;
+    }
+
+    if (jobs <= 1 || tree->file_count < 2)
+        return pipeline_run_serial(ctx, tree);
+
+    Pipeline pipeline = {0};
+    pipeline.ctx = ctx;
+    pipeline.tree = tree;
+    pipeline.file_count = tree->file_count;
+    if ((size_t)jobs > pipeline.file_count)
+        jobs = (int)pipeline.file_count;
+    pipeline.window = (size_t)jobs * PIPELINE_WINDOW_PER_JOB;
+
+    pipeline.files = malloc(pipeline.file_count * sizeof(TreeEntry *));
+    pipeline.slots = calloc(pipeline.window, sizeof(PipelineSlot));
+    pthread_t *threads = calloc((size_t)jobs, sizeof(pthread_t));
+    if (!pipeline.files || !pipeline.slots || !threads)
+    {
+        free(pipeline.files);
+        free(pipeline.slots);
+        free(threads);
+        ctx->warning(ctx, "Cannot allocate worker pipeline, processing content on a single thread");
+        return pipeline_run_serial(ctx, tree);
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        if (tree->entries[i].type != ENTRY_TYPE_DIRECTORY)
+            pipeline.files[n++] = &tree->entries[i];
+    }
+
+    pthread_mutex_init(&pipeline.mutex, NULL);
+    pthread_cond_init(&pipeline.slot_ready, NULL);
+    pthread_cond_init(&pipeline.space_available, NULL);
+
+    int started = 0;
+    for (int i = 0; i < jobs; i++)
+    {
+        if (pthread_create(&threads[i], NULL, pipeline_worker, &pipeline) != 0)
+            break;
+        started++;
+    }
+
+    int result = 0;
+    if (started == 0)
+    {
+        ctx->warning(ctx, "Cannot start worker threads, processing content on a single thread");
+        result = pipeline_run_serial(ctx, tree);
+    }
+    else
+    {
+        ctx->log(ctx, LOG_DEBUG, "Processing %zu files with %d workers", pipeline.file_count, started);
+
+        // Reorder stage: commit results strictly in traversal order
+        for (size_t seq = 0; seq < pipeline.file_count; seq++)
+        {
+            PipelineSlot *slot = &pipeline.slots[seq % pipeline.window];
+
+            pthread_mutex_lock(&pipeline.mutex);
+            while (!(slot->ready && slot->seq == seq))
+                pthread_cond_wait(&pipeline.slot_ready, &pipeline.mutex);
+            pthread_mutex_unlock(&pipeline.mutex);
+
+            TreeEntry *entry = pipeline.files[seq];
+            size_t index = (size_t)(entry - tree->entries);
+            bool reused = incremental_reusable(internal->incremental, index);
+            off_t start = -1;
+            if (reused)
+                result = incremental_reuse(internal->incremental, ctx, tree, index);
+            else
+                result = pipeline_render_begin(ctx, &start);
+
+            if (result == 0 && !reused)
+            {
+                if (slot->output.deferred)
+                {
+                    ctx->current_file_path = entry->path;
+                    ctx->current_file_info = &entry->info;
+                    ctx->current_directory_level = entry->level;
+                    result = pipeline_process_file(ctx, entry->path, &entry->info, NULL);
+                    ctx->current_file_info = NULL;
+                }
+                else
+                {
+                    result = pipeline_commit_output(ctx, entry, &slot->output);
+                }
+                if (result == 0)
+                    pipeline_render_end(ctx, entry, start);
+            }
+            file_output_reset(&slot->output);
+
+            pthread_mutex_lock(&pipeline.mutex);
+            slot->ready = false;
+            pipeline.committed = seq + 1;
+            if (result != 0)
+                pipeline.abort = true;
+            pthread_cond_broadcast(&pipeline.space_available);
+            pthread_mutex_unlock(&pipeline.mutex);
+
+            if (result != 0)
+                break;
+        }
+    }
+
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    // Results produced after an abort are dropped
+    for (size_t i = 0; i < pipeline.window; i++)
+        file_output_reset(&pipeline.slots[i].output);
+
+    pthread_cond_destroy(&pipeline.space_available);
+    pthread_cond_destroy(&pipeline.slot_ready);
+    pthread_mutex_destroy(&pipeline.mutex);
+    free(threads);
+    free(pipeline.slots);
+    free(pipeline.files);
+
+    if (result == 0)
+        result = incremental_flush(internal->incremental, ctx);
+    return result;
+}
+
+int pipeline_run_content(FconcatContext *ctx, FileTree *tree, int jobs)
+{
+    if (!ctx || !tree)
+        return -1;
+
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    ProcessingStats *stats = (ProcessingStats *)ctx->stats;
+    const ResolvedConfig *config = internal->config;
+
+    uint64_t total_bytes = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        if (tree->entries[i].type != ENTRY_TYPE_DIRECTORY)
+            total_bytes += tree->entries[i].info.size;
+    }
+    if (stats)
+        stats->total_bytes = (size_t)total_bytes;
+
+    // Workers only bump their own counters; the reporter thread does the rest
+    FILE *display = config && config->progress ? stderr : NULL;
+    if (progress_reporter_begin(internal->progress, total_bytes, tree->file_count, PROGRESS_INTERVAL_MS,
+                                internal->progress_callback, internal->progress_user_data, display) != 0)
+        ctx->warning(ctx, "Cannot start the progress reporter, progress goes unreported");
+
+    int result = pipeline_run_jobs(ctx, tree, jobs);
+
+    progress_reporter_end(internal->progress);
+    if (stats)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        stats->current_time = (double)now.tv_sec + now.tv_nsec / 1000000000.0;
+    }
+    return result;
+}
@@ -0,0 +1,79 @@
+#ifndef CORE_PIPELINE_H
+#define CORE_PIPELINE_H
+
+#include "context.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    struct FileTree;
+
+#define PIPELINE_MAX_JOBS 256
+#define PIPELINE_MAX_BUFFERED_FILE (4 * 1024 * 1024) // Larger files stream on the writer thread
+
+    // Chunks a worker produced for one file, replayed verbatim by the writer
+    typedef struct
+    {
+        char *data;
+        size_t size;
+        size_t capacity;
+        size_t *chunk_sizes;
+        size_t chunk_count;
+        size_t chunk_capacity;
+    } ChunkBuffer;
+
+    // Result of the content pass for one file. When buffered is false the
+    // output goes straight to the format engine and stats are applied live;
+    // otherwise everything is recorded here for the reorder stage.
+    typedef struct
+    {
+        bool buffered;
+        bool deferred;     // Too large to buffer: the writer streams it instead
+        bool write_footer;
+        int status;        // Non-zero aborts the content pass
+        ChunkBuffer chunks;
+        ProcessingStats delta;
+        bool dedup_hashed; // chunks hold the whole, unaltered body hashed below
+        uint64_t dedup_size;
+        uint64_t dedup_hash;
+    } FileOutput;
+
+    // Files up to this size are read in a single chunk
+#define PIPELINE_WHOLE_FILE_CHUNK (256 * 1024)
+    // Upper bound for the chunk of a very large file
+#define PIPELINE_MAX_CHUNK (4 * 1024 * 1024)
+    // How far a file is read ahead to hand batched filter plugins several
+    // chunks per call
+#define PIPELINE_FILTER_BATCH_BYTES (1024 * 1024)
+
+    // Written on a line of its own where --sample left bytes of a file out
+#define PIPELINE_SAMPLE_MARKER "[... %zu bytes omitted ...]"
+
+    // Size of the first read from a file of the given size
+    size_t pipeline_chunk_size(size_t file_size);
+    // Largest chunk a file of the given size grows to while it is read.
+    // Keeps a large file to a handful of chunks without letting one read
+    // hold more than PIPELINE_MAX_CHUNK.
+    size_t pipeline_max_chunk_size(size_t file_size);
+
+    // Classify info->is_binary now instead of on the first content read.
+    // Only needed when something before the content pass looks at it.
+    int pipeline_classify_file(FconcatContext *ctx, const char *path, FileInfo *info);
+
+    // Run the content pass for a single file. out == NULL writes directly.
+    int pipeline_process_file(FconcatContext *ctx, const char *path, FileInfo *info, FileOutput *out);
+
+    // Run the content pass over a cached tree using up to `jobs` worker
+    // threads. Output is committed in tree order, byte-identical to jobs == 1.
+    int pipeline_run_content(FconcatContext *ctx, struct FileTree *tree, int jobs);
+
+    // Resolve a --jobs value (0 = one per online CPU) to a worker count
+    int pipeline_resolve_jobs(int requested);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_PIPELINE_H */
@@ -0,0 +1,355 @@
+#include "progress.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Weight of the latest interval in the smoothed throughput
+#define PROGRESS_RATE_WEIGHT 0.3
+
+typedef struct
+{
+    _Alignas(64) atomic_uint_fast64_t bytes;
+    atomic_uint_fast64_t files;
+} ProgressCounter;
+
+struct ProgressReporter
+{
+    ProgressCounter *counters;
+    atomic_uint generation; // Of the pass being reported, 0 when none
+    atomic_size_t next_counter;
+    uint64_t total_bytes;
+    uint64_t total_files;
+    unsigned interval_ms;
+    ProgressCallback callback;
+    void *user_data;
+    FILE *display;
+    bool display_tty;
+
+    pthread_t thread;
+    bool running;
+    bool stopping;
+    pthread_mutex_t mutex; // Guards what follows, the stop flag and the wakeup
+    pthread_cond_t wake;
+    double start;
+    double last_time;  // When the rate was last updated
+    uint64_t last_bytes;
+    double rate;
+    char operation[64]; // Latest report posted by a plugin
+    size_t operation_current;
+    size_t operation_total;
+    bool operation_pending;
+};
+
+// Generations are unique across reporters, so a thread's cached counter
+// never outlives the pass it was claimed for
+static atomic_uint progress_generations;
+
+static _Thread_local struct
+{
+    unsigned generation;
+    ProgressCounter *counter;
+} progress_thread;
+
+static double progress_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + now.tv_nsec / 1000000000.0;
+}
+
+ProgressReporter *progress_reporter_create(void)
+{
+    ProgressReporter *reporter = calloc(1, sizeof(ProgressReporter));
+    if (!reporter)
+        return NULL;
+    reporter->counters = aligned_alloc(64, PROGRESS_MAX_COUNTERS * sizeof(ProgressCounter));
+    if (!reporter->counters)
+    {
+        free(reporter);
+        return NULL;
+    }
+    for (size_t i = 0; i < PROGRESS_MAX_COUNTERS; i++)
+    {
+        atomic_init(&reporter->counters[i].bytes, 0);
+        atomic_init(&reporter->counters[i].files, 0);
+    }
+    atomic_init(&reporter->generation, 0);
+    atomic_init(&reporter->next_counter, 0);
+    pthread_mutex_init(&reporter->mutex, NULL);
+    pthread_cond_init(&reporter->wake, NULL);
+    return reporter;
+}
+
+void progress_reporter_destroy(ProgressReporter *reporter)
+{
+    if (!reporter)
+        return;
+    progress_reporter_end(reporter);
+    pthread_cond_destroy(&reporter->wake);
+    pthread_mutex_destroy(&reporter->mutex);
+    free(reporter->counters);
+    free(reporter);
+}
+
+void progress_reporter_add(ProgressReporter *reporter, size_t bytes, size_t files)
+{
+    if (!reporter)
+        return;
+    unsigned generation = atomic_load_explicit(&reporter->generation, memory_order_relaxed);
+    if (generation == 0)
+        return;
+
+    if (progress_thread.generation != generation)
+    {
+        size_t index = atomic_fetch_add_explicit(&reporter->next_counter, 1, memory_order_relaxed);
+        if (index >= PROGRESS_MAX_COUNTERS)
+            index = PROGRESS_MAX_COUNTERS - 1;
+        progress_thread.counter = &reporter->counters[index];
+        progress_thread.generation = generation;
+    }
+
+    ProgressCounter *counter = progress_thread.counter;
+    if (bytes)
+        atomic_fetch_add_explicit(&counter->bytes, bytes, memory_order_relaxed);
+    if (files)
+        atomic_fetch_add_explicit(&counter->files, files, memory_order_relaxed);
+}
+
+// Sum of the counters; called with the mutex held
+static ProgressSnapshot progress_collect(ProgressReporter *reporter, double now)
+{
+    ProgressSnapshot snapshot = {0};
+    size_t used = atomic_load_explicit(&reporter->next_counter, memory_order_relaxed);
+    if (used > PROGRESS_MAX_COUNTERS)
+        used = PROGRESS_MAX_COUNTERS;
+    for (size_t i = 0; i < used; i++)
+    {
+        snapshot.bytes += atomic_load_explicit(&reporter->counters[i].bytes, memory_order_relaxed);
+        snapshot.files += atomic_load_explicit(&reporter->counters[i].files, memory_order_relaxed);
+    }
+    snapshot.total_bytes = reporter->total_bytes;
+    snapshot.total_files = reporter->total_files;
+    snapshot.elapsed = reporter->running ? now - reporter->start : 0;
+    snapshot.bytes_per_second = reporter->rate;
+    snapshot.eta = -1;
+    if (snapshot.bytes >= snapshot.total_bytes && snapshot.files >= snapshot.total_files)
+        snapshot.eta = 0;
+    else if (reporter->rate > 0 && snapshot.total_bytes > snapshot.bytes)
+        snapshot.eta = (double)(snapshot.total_bytes - snapshot.bytes) / reporter->rate;
+    return snapshot;
+}
+
+ProgressSnapshot progress_reporter_snapshot(ProgressReporter *reporter)
+{
+    ProgressSnapshot snapshot = {0};
+    if (!reporter)
+        return snapshot;
+    pthread_mutex_lock(&reporter->mutex);
+    snapshot = progress_collect(reporter, progress_now());
+    pthread_mutex_unlock(&reporter->mutex);
+    return snapshot;
+}
+
+static void format_size(uint64_t bytes, char *buffer, size_t size)
+{
+    static const char *units[] = {"B", "KB", "MB", "GB", "TB"};
+    double value = (double)bytes;
+    size_t unit = 0;
+    while (value >= 1024 && unit + 1 < sizeof(units) / sizeof(units[0]))
+    {
+        value /= 1024;
+        unit++;
+    }
+    if (unit == 0)
+        snprintf(buffer, size, "%llu B", (unsigned long long)bytes);
+    else
+        snprintf(buffer, size, "%.1f %s", value, units[unit]);
+}
+
+int progress_format_line(const ProgressSnapshot *snapshot, char *buffer, size_t size)
+{
+    if (!snapshot || !buffer || size == 0)
+        return -1;
+
+    char done[32], total[32], rate[32], eta[32];
+    format_size(snapshot->bytes, done, sizeof(done));
+    format_size(snapshot->total_bytes, total, sizeof(total));
+    format_size((uint64_t)snapshot->bytes_per_second, rate, sizeof(rate));
+
+    unsigned percent = 100;
+    if (snapshot->total_bytes > 0 && snapshot->bytes < snapshot->total_bytes)
+        percent = (unsigned)(snapshot->bytes * 100 / snapshot->total_bytes);
+
+    if (snapshot->eta < 0)
+        snprintf(eta, sizeof(eta), "--:--");
+    else
+    {
+        unsigned long seconds = (unsigned long)(snapshot->eta + 0.5);
+        if (seconds >= 3600)
+            snprintf(eta, sizeof(eta), "%lu:%02lu:%02lu", seconds / 3600, seconds / 60 % 60, seconds % 60);
+        else
+            snprintf(eta, sizeof(eta), "%lu:%02lu", seconds / 60, seconds % 60);
+    }
+
+    return snprintf(buffer, size, "%s / %s (%u%%), %llu/%llu files, %s/s, ETA %s", done, total, percent,
+                    (unsigned long long)snapshot->files, (unsigned long long)snapshot->total_files, rate, eta);
+}
+
+// One report; called with the mutex held, which is dropped around the
+// callback so a plugin may post from inside it
+static void progress_report(ProgressReporter *reporter, bool final)
+{
+    double now = progress_now();
+    ProgressSnapshot snapshot = progress_collect(reporter, now);
+
+    double interval = now - reporter->last_time;
+    if (interval > 0)
+    {
+        double instant = (double)(snapshot.bytes - reporter->last_bytes) / interval;
+        reporter->rate = reporter->rate > 0 ? reporter->rate + PROGRESS_RATE_WEIGHT * (instant - reporter->rate)
+                                            : instant;
+        reporter->last_time = now;
+        reporter->last_bytes = snapshot.bytes;
+        snapshot = progress_collect(reporter, now);
+    }
+    // The last line gives the average over the whole pass
+    if (final && snapshot.elapsed > 0)
+        snapshot.bytes_per_second = (double)snapshot.bytes / snapshot.elapsed;
+
+    char operation[sizeof(reporter->operation)];
+    size_t operation_current = reporter->operation_current;
+    size_t operation_total = reporter->operation_total;
+    bool posted = reporter->operation_pending;
+    memcpy(operation, reporter->operation, sizeof(operation));
+    reporter->operation_pending = false;
+
+    pthread_mutex_unlock(&reporter->mutex);
+    if (reporter->callback)
+    {
+        if (posted)
+            reporter->callback(operation, operation_current, operation_total, reporter->user_data);
+        reporter->callback("content", (size_t)snapshot.bytes, (size_t)snapshot.total_bytes, reporter->user_data);
+    }
+    if (reporter->display)
+    {
+        char line[256];
+        progress_format_line(&snapshot, line, sizeof(line));
+        // A terminal gets one line redrawn in place, anything else a line per report
+        if (reporter->display_tty)
+            fprintf(reporter->display, "\r⏳ %s\033[K%s", line, final ? "\n" : "");
+        else
+            fprintf(reporter->display, "⏳ %s\n", line);
+        fflush(reporter->display);
+    }
+    pthread_mutex_lock(&reporter->mutex);
+}
+
+static void *progress_thread_main(void *arg)
+{
+    ProgressReporter *reporter = arg;
+    pthread_mutex_lock(&reporter->mutex);
+    for (;;)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += reporter->interval_ms / 1000;
+        deadline.tv_nsec += (long)(reporter->interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (!reporter->stopping &&
+               pthread_cond_timedwait(&reporter->wake, &reporter->mutex, &deadline) == 0)
+            ;
+        // Stopping still gets a last report, however early it came
+        bool final = reporter->stopping;
+        progress_report(reporter, final);
+        if (final)
+            break;
+    }
+    pthread_mutex_unlock(&reporter->mutex);
+    return NULL;
+}
+
+int progress_reporter_begin(ProgressReporter *reporter, uint64_t total_bytes, uint64_t total_files,
+                            unsigned interval_ms, ProgressCallback callback, void *user_data, FILE *display)
+{
+    if (!reporter)
+        return -1;
+    progress_reporter_end(reporter);
+    if (!callback && !display)
+        return 0;
+
+    for (size_t i = 0; i < PROGRESS_MAX_COUNTERS; i++)
+    {
+        atomic_store_explicit(&reporter->counters[i].bytes, 0, memory_order_relaxed);
+        atomic_store_explicit(&reporter->counters[i].files, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&reporter->next_counter, 0, memory_order_relaxed);
+
+    reporter->total_bytes = total_bytes;
+    reporter->total_files = total_files;
+    reporter->interval_ms = interval_ms > 0 ? interval_ms : PROGRESS_INTERVAL_MS;
+    reporter->callback = callback;
+    reporter->user_data = user_data;
+    reporter->display = display;
+    reporter->display_tty = display && isatty(fileno(display));
+    reporter->start = progress_now();
+    reporter->last_time = reporter->start;
+    reporter->last_bytes = 0;
+    reporter->rate = 0;
+    reporter->operation_pending = false;
+    reporter->stopping = false;
+
+    unsigned generation = atomic_fetch_add(&progress_generations, 1) + 1;
+    if (generation == 0)
+        generation = atomic_fetch_add(&progress_generations, 1) + 1; // Never 0 after wrapping
+    atomic_store_explicit(&reporter->generation, generation, memory_order_release);
+
+    reporter->running = true;
+    if (pthread_create(&reporter->thread, NULL, progress_thread_main, reporter) != 0)
+    {
+        reporter->running = false;
+        atomic_store_explicit(&reporter->generation, 0, memory_order_release);
+        return -1;
+    }
+    return 0;
+}
+
+void progress_reporter_end(ProgressReporter *reporter)
+{
+    if (!reporter || !reporter->running)
+        return;
+
+    pthread_mutex_lock(&reporter->mutex);
+    reporter->stopping = true;
+    pthread_cond_signal(&reporter->wake);
+    pthread_mutex_unlock(&reporter->mutex);
+    pthread_join(reporter->thread, NULL);
+
+    atomic_store_explicit(&reporter->generation, 0, memory_order_release);
+    reporter->running = false;
+}
+
+bool progress_reporter_active(const ProgressReporter *reporter)
+{
+    return reporter && atomic_load_explicit(&reporter->generation, memory_order_relaxed) != 0;
+}
+
+int progress_reporter_post(ProgressReporter *reporter, const char *operation, size_t current, size_t total)
+{
+    if (!progress_reporter_active(reporter))
+        return -1;
+
+    pthread_mutex_lock(&reporter->mutex);
+    snprintf(reporter->operation, sizeof(reporter->operation), "%s", operation ? operation : "");
+    reporter->operation_current = current;
+    reporter->operation_total = total;
+    reporter->operation_pending = true;
+    pthread_mutex_unlock(&reporter->mutex);
+    return 0;
+}
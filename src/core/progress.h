@@ -0,0 +1,69 @@
+#ifndef CORE_PROGRESS_H
+#define CORE_PROGRESS_H
+
+#include "../../include/fconcat_api.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Progress of the content pass, kept off the per-chunk path. Every
+    // thread adds to a counter of its own, on a cache line of its own,
+    // with one relaxed atomic add and no clock read. A reporter thread
+    // sums the counters at a fixed interval, works out throughput and ETA
+    // and is the only caller of the progress callback and the --progress
+    // line while a pass runs.
+    typedef struct ProgressReporter ProgressReporter;
+
+#define PROGRESS_INTERVAL_MS 250
+    // Threads past this many share the last counter
+#define PROGRESS_MAX_COUNTERS 64
+
+    typedef struct
+    {
+        uint64_t bytes;
+        uint64_t files;
+        uint64_t total_bytes;
+        uint64_t total_files;
+        double elapsed;          // Seconds since the pass began
+        double bytes_per_second; // Smoothed over the last few intervals
+        double eta;              // Seconds left, or -1 while unknown
+    } ProgressSnapshot;
+
+    ProgressReporter *progress_reporter_create(void);
+    // Stops the reporter thread first if it still runs
+    void progress_reporter_destroy(ProgressReporter *reporter);
+
+    // Reset the counters for a pass over total_bytes in total_files and
+    // start reporting every interval_ms to callback and, when display is
+    // not NULL, as a status line on it. Without either nothing is started
+    // and counting stays off. Returns 0, or -1 when the thread cannot start.
+    int progress_reporter_begin(ProgressReporter *reporter, uint64_t total_bytes, uint64_t total_files,
+                                unsigned interval_ms, ProgressCallback callback, void *user_data, FILE *display);
+    // Report the final figures, stop the thread and end the status line
+    void progress_reporter_end(ProgressReporter *reporter);
+    bool progress_reporter_active(const ProgressReporter *reporter);
+
+    // Count work done by the calling thread; a no-op unless a pass is being reported
+    void progress_reporter_add(ProgressReporter *reporter, size_t bytes, size_t files);
+
+    // Queue a progress report of a plugin for the reporter thread to hand
+    // to the callback. Reports arriving within one interval are coalesced
+    // to the latest. Returns -1 when no pass is being reported.
+    int progress_reporter_post(ProgressReporter *reporter, const char *operation, size_t current, size_t total);
+
+    ProgressSnapshot progress_reporter_snapshot(ProgressReporter *reporter);
+
+    // "12.0 MB / 48.0 MB (25%), 10/40 files, 96.0 MB/s, ETA 0:01"
+    int progress_format_line(const ProgressSnapshot *snapshot, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_PROGRESS_H */
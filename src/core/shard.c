@@ -0,0 +1,260 @@
+#include "shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A directory on the path from the root to the entry being placed
+typedef struct
+{
+    const TreeEntry *entry;
+    size_t emitted; // 1 + the last shard it was written to, 0 when none yet
+} OpenDirectory;
+
+typedef struct
+{
+    FileTree **shards;
+    OpenDirectory *stack;
+    size_t depth;
+    size_t stack_capacity;
+} ShardBuilder;
+
+uint64_t shard_entry_weight(const TreeEntry *entry, ShardUnit unit)
+{
+    uint64_t size = entry ? (uint64_t)entry->info.size : 0;
+    if (unit == SHARD_UNIT_TOKENS)
+        return (size + SHARD_BYTES_PER_TOKEN - 1) / SHARD_BYTES_PER_TOKEN;
+    return size;
+}
+
+static int shard_add(ShardBuilder *builder, size_t shard, const TreeEntry *entry)
+{
+    return file_tree_add(builder->shards[shard], entry->path, entry->type, &entry->info, entry->level);
+}
+
+// Write the open directories above depth that shard does not have yet
+static int shard_add_parents(ShardBuilder *builder, size_t shard, size_t depth)
+{
+    for (size_t d = 0; d < depth && d < builder->depth; d++)
+    {
+        OpenDirectory *dir = &builder->stack[d];
+        if (!dir->entry || dir->emitted == shard + 1)
+            continue;
+        if (shard_add(builder, shard, dir->entry) != 0)
+            return -1;
+        dir->emitted = shard + 1;
+    }
+    return 0;
+}
+
+// Leave every open directory at level or deeper. One that never received
+// a file is empty and still belongs in the output, so it joins shard.
+static int shard_close_directories(ShardBuilder *builder, size_t shard, size_t level)
+{
+    while (builder->depth > level)
+    {
+        const OpenDirectory *top = &builder->stack[builder->depth - 1];
+        if (top->entry && top->emitted == 0 && shard_add_parents(builder, shard, builder->depth) != 0)
+            return -1;
+        builder->depth--;
+    }
+    return 0;
+}
+
+static int shard_open_directory(ShardBuilder *builder, const TreeEntry *entry)
+{
+    size_t level = (size_t)entry->level;
+    if (level >= builder->stack_capacity)
+    {
+        size_t capacity = builder->stack_capacity ? builder->stack_capacity * 2 : 16;
+        while (capacity <= level)
+            capacity *= 2;
+        OpenDirectory *stack = realloc(builder->stack, capacity * sizeof(OpenDirectory));
+        if (!stack)
+            return -1;
+        builder->stack = stack;
+        builder->stack_capacity = capacity;
+    }
+    // A level skipped by the walk (never expected) leaves no stale parent
+    for (size_t d = builder->depth; d < level; d++)
+        builder->stack[d] = (OpenDirectory){NULL, 0};
+    builder->stack[level] = (OpenDirectory){entry, 0};
+    builder->depth = level + 1;
+    return 0;
+}
+
+// Distribute the entries of tree given the shard of each file, in tree
+// order; assignment is non-decreasing and indexed by file, not entry
+static int shard_build(const FileTree *tree, const size_t *assignment, size_t count,
+                       FileTree ***shards_out, size_t *count_out)
+{
+    ShardBuilder builder = {0};
+    builder.shards = calloc(count, sizeof(FileTree *));
+    if (!builder.shards)
+        return -1;
+    for (size_t i = 0; i < count; i++)
+    {
+        builder.shards[i] = file_tree_create();
+        if (!builder.shards[i])
+            goto fail;
+    }
+
+    size_t shard = 0;
+    size_t file = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        const TreeEntry *entry = &tree->entries[i];
+        size_t level = entry->level > 0 ? (size_t)entry->level : 0;
+        if (shard_close_directories(&builder, shard, level) != 0)
+            goto fail;
+
+        if (entry->type == ENTRY_TYPE_DIRECTORY)
+        {
+            if (shard_open_directory(&builder, entry) != 0)
+                goto fail;
+            continue;
+        }
+
+        shard = assignment[file++];
+        if (shard_add_parents(&builder, shard, level) != 0 || shard_add(&builder, shard, entry) != 0)
+            goto fail;
+    }
+    if (shard_close_directories(&builder, shard, 0) != 0)
+        goto fail;
+
+    free(builder.stack);
+    *shards_out = builder.shards;
+    *count_out = count;
+    return 0;
+
+fail:
+    free(builder.stack);
+    shard_free(builder.shards, count);
+    return -1;
+}
+
+int shard_split_by_budget(const FileTree *tree, uint64_t budget, ShardUnit unit,
+                          FileTree ***shards, size_t *count)
+{
+    if (!tree || !shards || !count || budget == 0)
+        return -1;
+
+    size_t *assignment = malloc((tree->file_count ? tree->file_count : 1) * sizeof(size_t));
+    if (!assignment)
+        return -1;
+
+    size_t shard = 0;
+    size_t file = 0;
+    size_t files_in_shard = 0;
+    uint64_t used = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        const TreeEntry *entry = &tree->entries[i];
+        if (entry->type != ENTRY_TYPE_FILE)
+            continue;
+
+        uint64_t weight = shard_entry_weight(entry, unit);
+        if (files_in_shard > 0 && (used + weight > budget || used + weight < used))
+        {
+            shard++;
+            used = 0;
+            files_in_shard = 0;
+        }
+        used += weight;
+        files_in_shard++;
+        assignment[file++] = shard;
+    }
+
+    int result = shard_build(tree, assignment, shard + 1, shards, count);
+    free(assignment);
+    return result;
+}
+
+int shard_split_evenly(const FileTree *tree, size_t parts, FileTree ***shards, size_t *count)
+{
+    if (!tree || !shards || !count || parts == 0)
+        return -1;
+
+    size_t *assignment = malloc((tree->file_count ? tree->file_count : 1) * sizeof(size_t));
+    if (!assignment)
+        return -1;
+
+    // Files of nothing but empty files are spread by count instead
+    double total = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        if (tree->entries[i].type == ENTRY_TYPE_FILE)
+            total += (double)tree->entries[i].info.size;
+    }
+    bool by_count = total == 0;
+    if (by_count)
+        total = (double)tree->file_count;
+
+    // A file belongs to the part its midpoint falls in; parts no midpoint
+    // falls in are left out rather than written empty
+    size_t shard = 0;
+    size_t file = 0;
+    size_t last_part = 0;
+    double before = 0;
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        const TreeEntry *entry = &tree->entries[i];
+        if (entry->type != ENTRY_TYPE_FILE)
+            continue;
+
+        double weight = by_count ? 1.0 : (double)entry->info.size;
+        size_t part = (size_t)((before + weight / 2) * (double)parts / total);
+        if (part >= parts)
+            part = parts - 1;
+        if (file > 0 && part != last_part)
+            shard++;
+        last_part = part;
+        before += weight;
+        assignment[file++] = shard;
+    }
+
+    int result = shard_build(tree, assignment, shard + 1, shards, count);
+    free(assignment);
+    return result;
+}
+
+void shard_free(FileTree **shards, size_t count)
+{
+    if (!shards)
+        return;
+    for (size_t i = 0; i < count; i++)
+        file_tree_destroy(shards[i]);
+    free(shards);
+}
+
+char *shard_output_path(const char *output_file, size_t index, size_t count)
+{
+    if (!output_file || index >= count)
+        return NULL;
+
+    // Zero-padded to the width of count, at least three digits
+    char number[24];
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%zu", index + 1);
+    size_t width = (size_t)snprintf(number, sizeof(number), "%zu", count);
+    if (width < 3)
+        width = 3;
+    size_t length = strlen(digits);
+    size_t padding = width > length ? width - length : 0;
+    memset(number, '0', padding);
+    memcpy(number + padding, digits, length + 1);
+
+    // The extension stays last so tools still recognise the file; a dot
+    // that starts the name or belongs to a directory is not one
+    const char *base = strrchr(output_file, '/');
+    base = base ? base + 1 : output_file;
+    const char *dot = strrchr(base, '.');
+    size_t stem = dot && dot != base ? (size_t)(dot - output_file) : strlen(output_file);
+    const char *extension = output_file + stem;
+
+    size_t size = stem + strlen(".part") + strlen(number) + strlen(extension) + 1;
+    char *path = malloc(size);
+    if (!path)
+        return NULL;
+    snprintf(path, size, "%.*s.part%s%s", (int)stem, output_file, number, extension);
+    return path;
+}
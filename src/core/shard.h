@@ -0,0 +1,45 @@
+#ifndef CORE_SHARD_H
+#define CORE_SHARD_H
+
+#include "tree.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Token estimate behind --shard-size <n>tokens: source text averages
+    // about four bytes per token
+#define SHARD_BYTES_PER_TOKEN 4
+
+    // --shard-size and --shards cut a walked tree into contiguous groups of
+    // files, each rendered as a document of its own. A shard's tree holds
+    // its files plus the directories leading to them, in the original
+    // order, so every shard carries its own structure header. Empty
+    // directories go with the shard being filled when the walk met them.
+
+    // Share of a budget one file takes, from its size
+    uint64_t shard_entry_weight(const TreeEntry *entry, ShardUnit unit);
+
+    // Close a shard before the file that would take it past budget; a
+    // file larger than the budget gets a shard to itself. An empty tree
+    // yields one empty shard. Returns 0 and the shards in *shards, or -1.
+    int shard_split_by_budget(const FileTree *tree, uint64_t budget, ShardUnit unit,
+                              FileTree ***shards, size_t *count);
+
+    // At most parts shards of about equal total size; fewer when there are
+    // fewer files than parts
+    int shard_split_evenly(const FileTree *tree, size_t parts, FileTree ***shards, size_t *count);
+
+    void shard_free(FileTree **shards, size_t count);
+
+    // Path of shard index (0-based) out of count: "all.txt" becomes
+    // "all.part001.txt", numbered from 1 and zero-padded to the width of
+    // count (at least three digits). Caller frees.
+    char *shard_output_path(const char *output_file, size_t index, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_SHARD_H */
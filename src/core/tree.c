@@ -0,0 +1,601 @@
+#include "tree.h"
+#include "inode_set.h"
+#include "pipeline.h"
+#include "walk.h"
+#include "../filter/filter.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Paths are packed into large blocks instead of one malloc per entry so a
+// 400k entry tree costs a few hundred allocations rather than 400k.
+#define TREE_STRING_BLOCK_SIZE (256 * 1024)
+#define TREE_INITIAL_CAPACITY 1024
+
+struct TreeStringBlock
+{
+    TreeStringBlock *next;
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+static char *tree_intern_string(FileTree *tree, const char *str)
+{
+    size_t len = strlen(str) + 1;
+    TreeStringBlock *block = tree->strings;
+
+    if (!block || block->capacity - block->used < len)
+    {
+        size_t capacity = len > TREE_STRING_BLOCK_SIZE ? len : TREE_STRING_BLOCK_SIZE;
+        TreeStringBlock *new_block = malloc(sizeof(TreeStringBlock) + capacity);
+        if (!new_block)
+            return NULL;
+
+        new_block->next = block;
+        new_block->used = 0;
+        new_block->capacity = capacity;
+        tree->strings = new_block;
+        block = new_block;
+    }
+
+    char *dest = block->data + block->used;
+    memcpy(dest, str, len);
+    block->used += len;
+    return dest;
+}
+
+FileTree *file_tree_create(void)
+{
+    FileTree *tree = calloc(1, sizeof(FileTree));
+    if (!tree)
+        return NULL;
+
+    tree->entries = malloc(TREE_INITIAL_CAPACITY * sizeof(TreeEntry));
+    if (!tree->entries)
+    {
+        free(tree);
+        return NULL;
+    }
+    tree->capacity = TREE_INITIAL_CAPACITY;
+
+    return tree;
+}
+
+void file_tree_clear(FileTree *tree)
+{
+    if (!tree)
+        return;
+
+    TreeStringBlock *block = tree->strings;
+    while (block)
+    {
+        TreeStringBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    tree->strings = NULL;
+    tree->count = 0;
+    tree->file_count = 0;
+    tree->directory_count = 0;
+}
+
+void file_tree_destroy(FileTree *tree)
+{
+    if (!tree)
+        return;
+
+    file_tree_clear(tree);
+    free(tree->entries);
+    free(tree);
+}
+
+int file_tree_add(FileTree *tree, const char *path, EntryType type, const FileInfo *info, int level)
+{
+    if (!tree || !path || !info)
+        return -1;
+
+    if (tree->count >= tree->capacity)
+    {
+        size_t new_capacity = tree->capacity * 2;
+        TreeEntry *new_entries = realloc(tree->entries, new_capacity * sizeof(TreeEntry));
+        if (!new_entries)
+            return -1;
+        tree->entries = new_entries;
+        tree->capacity = new_capacity;
+    }
+
+    char *stored_path = tree_intern_string(tree, path);
+    if (!stored_path)
+        return -1;
+
+    TreeEntry *entry = &tree->entries[tree->count++];
+    entry->path = stored_path;
+    entry->info = *info;
+    entry->info.path = stored_path;
+    entry->type = type;
+    entry->level = level;
+
+    if (type == ENTRY_TYPE_DIRECTORY)
+        tree->directory_count++;
+    else
+        tree->file_count++;
+
+    return 0;
+}
+
+// Collecting callback used for the single walk
+static int tree_collect_callback(FconcatContext *ctx, const char *path, EntryType type,
+                                 FileInfo *info, int level, void *user_data)
+{
+    FileTree *tree = (FileTree *)user_data;
+
+    if (file_tree_add(tree, path, type, info, level) != 0)
+    {
+        ctx->error(ctx, "Failed to record directory entry: %s", path);
+        return -1;
+    }
+
+    return 0;
+}
+
+int file_tree_build(FconcatContext *ctx, FileTree *tree, const char *base_path,
+                    const char *relative_path, int level)
+{
+    if (!ctx || !tree || !base_path || !relative_path)
+        return -1;
+
+    DirectoryCallback callback = {
+        .handle_entry = tree_collect_callback,
+        .user_data = tree};
+
+    // --jobs also spreads the walk; filter plugins keep it on this thread,
+    // as they do the content pass
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    int threads = config ? pipeline_resolve_jobs(config->jobs) : 1;
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (internal && internal->filter_engine && internal->filter_engine->plugin_count > 0)
+        threads = 1;
+
+    if (threads > 1)
+        return walk_directory_parallel(ctx, base_path, relative_path, level, threads, &callback);
+    return traverse_directory(ctx, base_path, relative_path, level, &callback);
+}
+
+char *file_tree_read_list(const char *source, size_t *size)
+{
+    if (!source || !size)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    bool from_stdin = strcmp(source, "-") == 0;
+    int fd = from_stdin ? STDIN_FILENO : open(source, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    size_t used = 0;
+    size_t capacity = 64 * 1024;
+    char *list = malloc(capacity);
+    while (list)
+    {
+        if (capacity - used < 2)
+        {
+            char *grown = realloc(list, capacity * 2);
+            if (!grown)
+            {
+                free(list);
+                list = NULL;
+                break;
+            }
+            list = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, list + used, capacity - used - 1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+        {
+            int saved = errno;
+            free(list);
+            list = NULL;
+            errno = saved;
+            break;
+        }
+        if (n == 0)
+            break;
+        used += (size_t)n;
+    }
+
+    if (!from_stdin)
+        close(fd);
+    if (!list)
+        return NULL;
+    list[used] = '\0';
+    *size = used;
+    return list;
+}
+
+// Turn a listed path into one relative to the input: "./", "." and empty
+// components go, absolute paths lose the input prefix. Paths leaving the
+// input return -1.
+static int tree_list_normalize(const char *path, const char *root, size_t root_len, char *out, size_t out_size)
+{
+    if (path[0] == '/')
+    {
+        if (!root || strncmp(path, root, root_len) != 0 || (path[root_len] != '/' && path[root_len] != '\0'))
+            return -1;
+        path += root_len;
+    }
+
+    size_t length = 0;
+    while (*path)
+    {
+        while (*path == '/')
+            path++;
+        const char *end = strchr(path, '/');
+        size_t component = end ? (size_t)(end - path) : strlen(path);
+        if (component == 0)
+            break;
+        if (component == 2 && path[0] == '.' && path[1] == '.')
+            return -1;
+        if (!(component == 1 && path[0] == '.'))
+        {
+            if (length + component + 2 > out_size)
+                return -1;
+            if (length > 0)
+                out[length++] = '/';
+            memcpy(out + length, path, component);
+            length += component;
+        }
+        path += component;
+    }
+
+    out[length] = '\0';
+    return length > 0 ? 0 : -1;
+}
+
+// Files recorded from the list so far, by relative path: open addressing
+// over tree entry indices, so a list that names a file twice costs no more
+// than one lookup per line however long it is
+typedef struct
+{
+    size_t *slots; // Entry index, SIZE_MAX when free
+    size_t mask;
+    size_t count;
+} ListedPaths;
+
+#define LIST_PATHS_INITIAL_SLOTS 1024
+
+static size_t listed_paths_slot(const ListedPaths *set, const char *path)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++)
+    {
+        hash ^= *p;
+        hash *= 1099511628211ULL; // FNV-1a
+    }
+    return (size_t)hash & set->mask;
+}
+
+static bool listed_paths_contains(const ListedPaths *set, const FileTree *tree, const char *path)
+{
+    if (!set->slots)
+        return false;
+
+    for (size_t i = listed_paths_slot(set, path);; i = (i + 1) & set->mask)
+    {
+        if (set->slots[i] == SIZE_MAX)
+            return false;
+        if (strcmp(tree->entries[set->slots[i]].path, path) == 0)
+            return true;
+    }
+}
+
+static void listed_paths_place(ListedPaths *set, const FileTree *tree, size_t entry)
+{
+    size_t i = listed_paths_slot(set, tree->entries[entry].path);
+    while (set->slots[i] != SIZE_MAX)
+        i = (i + 1) & set->mask;
+    set->slots[i] = entry;
+    set->count++;
+}
+
+// Record tree entry entry; the table stays at most half full
+static int listed_paths_insert(ListedPaths *set, const FileTree *tree, size_t entry)
+{
+    size_t capacity = set->slots ? set->mask + 1 : 0;
+    if ((set->count + 1) * 2 > capacity)
+    {
+        size_t grown_capacity = capacity ? capacity * 2 : LIST_PATHS_INITIAL_SLOTS;
+        ListedPaths grown = {malloc(grown_capacity * sizeof(size_t)), grown_capacity - 1, 0};
+        if (!grown.slots)
+            return -1;
+        for (size_t i = 0; i < grown_capacity; i++)
+            grown.slots[i] = SIZE_MAX;
+        for (size_t i = 0; i < capacity; i++)
+        {
+            if (set->slots[i] != SIZE_MAX)
+                listed_paths_place(&grown, tree, set->slots[i]);
+        }
+        free(set->slots);
+        *set = grown;
+    }
+
+    listed_paths_place(set, tree, entry);
+    return 0;
+}
+
+// Directories above the file being recorded; each is the prefix of path
+// up to its end
+typedef struct
+{
+    char path[MAX_PATH];
+    size_t ends[MAX_DIRECTORY_DEPTH]; // Length of the path up to each directory
+    bool included[MAX_DIRECTORY_DEPTH];
+    size_t depth;
+} ListDirectories;
+
+// Whether the directory at full_path can be entered the way the walk
+// would: a symlink to one only when symlinks are followed. Warns about
+// listed and returns false otherwise.
+static bool tree_list_directory_usable(FconcatContext *ctx, const char *full_path, const char *listed)
+{
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    Metrics *metrics = context_metrics(ctx);
+    struct stat st;
+    uint64_t start = metrics_begin(metrics);
+    int stat_result = fstatat(AT_FDCWD, full_path, &st, AT_SYMLINK_NOFOLLOW);
+    if (stat_result == 0 && S_ISLNK(st.st_mode) && config && config->symlink_handling == SYMLINK_FOLLOW)
+        stat_result = fstatat(AT_FDCWD, full_path, &st, 0);
+    metrics_end(metrics, METRICS_STAT, start, 0);
+
+    if (stat_result != 0 && errno != ENOENT && errno != ENOTDIR)
+    {
+        if (errno == EACCES)
+            ctx->warning(ctx, "Permission denied accessing: %s", full_path);
+        else
+            ctx->warning(ctx, "Cannot stat: %s - %s", full_path, strerror(errno));
+        return false;
+    }
+    if (stat_result == 0 && S_ISLNK(st.st_mode))
+    {
+        ctx->warning(ctx, "Under a symbolic link that is not followed, skipped: %s", listed);
+        return false;
+    }
+    if (stat_result != 0 || !S_ISDIR(st.st_mode))
+    {
+        ctx->warning(ctx, "Listed file not found: %s", listed);
+        return false;
+    }
+    return true;
+}
+
+// Open the directories of relative that are not open yet, recording
+// each; 0 when one of them is excluded or cannot be entered, -1 on
+// failure
+static int tree_list_enter(FconcatContext *ctx, FileTree *tree, ListDirectories *dirs, const char *base_path,
+                           const char *relative, const char *listed, size_t *level)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+
+    // Keep the directories relative shares with the previous file
+    size_t depth = 0;
+    while (depth < dirs->depth)
+    {
+        size_t end = dirs->ends[depth];
+        if (strncmp(relative, dirs->path, end) != 0 || relative[end] != '/')
+            break;
+        depth++;
+    }
+    dirs->depth = depth;
+
+    size_t start = depth > 0 ? dirs->ends[depth - 1] + 1 : 0;
+    for (const char *slash = strchr(relative + start, '/'); slash; slash = strchr(slash + 1, '/'))
+    {
+        if (dirs->depth >= MAX_DIRECTORY_DEPTH)
+        {
+            ctx->warning(ctx, "Maximum directory depth exceeded: %s", relative);
+            return 0;
+        }
+
+        size_t end = (size_t)(slash - relative);
+        memcpy(dirs->path, relative, end);
+        dirs->path[end] = '\0';
+
+        // Directories under an excluded one are left out with it
+        bool included = dirs->depth == 0 || dirs->included[dirs->depth - 1];
+        FileInfo info = {0};
+        info.path = dirs->path;
+        info.is_directory = true;
+        if (included && internal && internal->filter_engine &&
+            !filter_engine_should_include_path(internal->filter_engine, ctx, dirs->path, &info))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", dirs->path);
+            included = false;
+        }
+        if (included)
+        {
+            char full_path[MAX_PATH * 2];
+            snprintf(full_path, sizeof(full_path), "%s/%s", base_path, dirs->path);
+            if (!tree_list_directory_usable(ctx, full_path, listed))
+                return 0;
+        }
+        if (included && file_tree_add(tree, dirs->path, ENTRY_TYPE_DIRECTORY, &info, (int)dirs->depth) != 0)
+        {
+            ctx->error(ctx, "Failed to record directory entry: %s", dirs->path);
+            return -1;
+        }
+
+        dirs->ends[dirs->depth] = end;
+        dirs->included[dirs->depth] = included;
+        dirs->depth++;
+    }
+
+    *level = dirs->depth;
+    return dirs->depth == 0 || dirs->included[dirs->depth - 1] ? 1 : 0;
+}
+
+int file_tree_build_from_list(FconcatContext *ctx, FileTree *tree, const char *base_path,
+                              char *list, size_t size)
+{
+    if (!ctx || !tree || !base_path || !list)
+        return -1;
+
+    const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+    char separator = memchr(list, '\0', size) ? '\0' : '\n';
+    char *root = realpath(base_path, NULL);
+    size_t root_len = root ? strlen(root) : 0;
+    InodeSet *seen = config && config->unique_inodes ? inode_set_create() : NULL;
+    ListDirectories *dirs = calloc(1, sizeof(ListDirectories));
+    if (!dirs || (config && config->unique_inodes && !seen))
+    {
+        ctx->error(ctx, "Out of memory while reading the file list");
+        free(dirs);
+        inode_set_destroy(seen);
+        free(root);
+        return -1;
+    }
+
+    int result = 0;
+    ListedPaths recorded = {0};
+    char relative[MAX_PATH];
+    char full_path[MAX_PATH * 2];
+    char *cursor = list;
+    char *end = list + size;
+    while (cursor < end && result == 0)
+    {
+        char *next = memchr(cursor, separator, (size_t)(end - cursor));
+        char *line_end = next ? next : end;
+        *line_end = '\0';
+        if (separator == '\n' && line_end > cursor && line_end[-1] == '\r')
+            line_end[-1] = '\0';
+        const char *listed = cursor;
+        cursor = line_end + 1;
+
+        if (listed[0] == '\0')
+            continue;
+        if (tree_list_normalize(listed, root, root_len, relative, sizeof(relative)) != 0)
+        {
+            ctx->warning(ctx, "Not inside %s, skipped: %s", base_path, listed);
+            continue;
+        }
+        if (listed_paths_contains(&recorded, tree, relative))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Listed more than once: %s", listed);
+            continue;
+        }
+
+        size_t level = 0;
+        int entered = tree_list_enter(ctx, tree, dirs, base_path, relative, listed, &level);
+        if (entered < 0)
+        {
+            result = entered;
+            break;
+        }
+        if (entered == 0)
+            continue;
+
+        // Files the path rules reject by name are never stat'd
+        int type_verdict = context_filter_entry_type(ctx, relative, DT_REG);
+        if (type_verdict == 0)
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", relative);
+            continue;
+        }
+
+        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, relative);
+        FileInfo info;
+        if (context_stat_entry_quiet(ctx, AT_FDCWD, full_path, full_path, relative, &info) != 0)
+        {
+            if (errno == ENOENT || errno == ENOTDIR)
+                ctx->warning(ctx, "Listed file not found: %s", listed);
+            else if (errno == EACCES)
+                ctx->warning(ctx, "Permission denied accessing: %s", full_path);
+            else
+                ctx->warning(ctx, "Cannot stat: %s - %s", full_path, strerror(errno));
+            continue;
+        }
+        if (info.is_directory)
+        {
+            ctx->warning(ctx, "Not a file, skipped: %s", full_path);
+            continue;
+        }
+
+        // The verdict above took the entry for a regular file
+        InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+        if ((type_verdict < 0 || info.is_symlink) &&
+            !filter_engine_should_include_path(internal->filter_engine, ctx, relative, &info))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", relative);
+            continue;
+        }
+
+        if (seen)
+        {
+            int added = inode_set_insert(seen, info.device, info.inode);
+            if (added < 0)
+            {
+                ctx->error(ctx, "Out of memory while reading the file list");
+                result = -1;
+                break;
+            }
+            if (added == 0)
+            {
+                if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                    ctx->log(ctx, LOG_DEBUG, "Already reached through another path: %s", relative);
+                continue;
+            }
+        }
+
+        if (file_tree_add(tree, relative, ENTRY_TYPE_FILE, &info, (int)level) != 0 ||
+            listed_paths_insert(&recorded, tree, tree->count - 1) != 0)
+        {
+            ctx->error(ctx, "Failed to record directory entry: %s", relative);
+            result = -1;
+        }
+    }
+
+    free(recorded.slots);
+    free(dirs);
+    inode_set_destroy(seen);
+    free(root);
+    return result;
+}
+
+int file_tree_replay(FconcatContext *ctx, FileTree *tree, DirectoryCallback *callback)
+{
+    if (!ctx || !tree || !callback || !callback->handle_entry)
+        return -1;
+
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        TreeEntry *entry = &tree->entries[i];
+
+        ctx->current_file_path = entry->path;
+        ctx->current_file_info = &entry->info;
+        ctx->current_directory_level = entry->level;
+
+        int result = callback->handle_entry(ctx, entry->path, entry->type, &entry->info,
+                                            entry->level, callback->user_data);
+        ctx->current_file_info = NULL;
+
+        if (result != 0)
+            return result;
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CORE_TREE_H
+#define CORE_TREE_H
+
+#include "context.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // One entry of the cached directory tree. Only entries that passed the
+    // path filters are recorded, so the filter verdict is implicit.
+    typedef struct
+    {
+        char *path;     // Relative path (owned by the tree's string blocks)
+        FileInfo info;  // info.path aliases path
+        EntryType type;
+        int level;
+    } TreeEntry;
+
+    typedef struct TreeStringBlock TreeStringBlock;
+
+    // Compact in-memory snapshot of a single directory walk, in the exact
+    // pre-order the traversal produced. Both output passes replay from it.
+    typedef struct FileTree
+    {
+        TreeEntry *entries;
+        size_t count;
+        size_t capacity;
+        size_t file_count;
+        size_t directory_count;
+        TreeStringBlock *strings;
+    } FileTree;
+
+    FileTree *file_tree_create(void);
+    void file_tree_destroy(FileTree *tree);
+    void file_tree_clear(FileTree *tree);
+
+    // Append a copy of an entry; the path is interned into tree storage
+    int file_tree_add(FileTree *tree, const char *path, EntryType type, const FileInfo *info, int level);
+
+    // Walk base_path/relative_path once and record every included entry
+    int file_tree_build(FconcatContext *ctx, FileTree *tree, const char *base_path,
+                        const char *relative_path, int level);
+
+    // --files-from: read a list of paths from the named file, or from
+    // standard input for "-". Returns a NUL-terminated buffer the caller
+    // frees and the list length in *size, or NULL with errno set.
+    char *file_tree_read_list(const char *source, size_t *size);
+
+    // Record the files named in list instead of walking base_path. Paths
+    // are separated by NULs when the list holds any (git ls-files -z),
+    // otherwise by newlines, and are relative to base_path (absolute ones
+    // must lie inside it). Each listed file costs one stat, skipped for
+    // files the path rules reject by name; nothing is read with readdir.
+    // Their directories are recorded ahead of them, again whenever the
+    // list comes back to one, and a file under a directory the path rules
+    // exclude is left out as the walk would, as is one under a symlinked
+    // directory unless symlinks are followed. Each directory newly entered
+    // costs a stat too. List order is kept, and a file listed again under
+    // any spelling of its path is recorded once. The buffer is modified in
+    // place.
+    int file_tree_build_from_list(FconcatContext *ctx, FileTree *tree, const char *base_path,
+                                  char *list, size_t size);
+
+    // Invoke callback for every cached entry, setting the current-file fields
+    // on ctx the same way the live traversal does
+    int file_tree_replay(FconcatContext *ctx, FileTree *tree, DirectoryCallback *callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_TREE_H */
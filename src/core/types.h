@@ -20,6 +20,7 @@ extern "C"
 #define MAX_BUFFER_SIZE 1024 * 4
 #define BINARY_CHECK_SIZE 8192
 #define BINARY_DETECTION_SAMPLE_SIZE 1024  // Bytes to sample for binary detection in content
+#define BINARY_CONTROL_PERCENT 10  // Share of unexpected control bytes that marks a sample binary
 #define PLUGIN_CHUNK_SIZE 4096
 #define MAX_PATH 4096
 #define MAX_PLUGIN_PARAMS 16
@@ -53,6 +54,12 @@ extern "C"
         bool is_symlink;
         bool is_binary;
         uint32_t permissions;
+        bool binary_checked; // is_binary is valid; classification happens lazily on first read
+        // Identity of the file whose bytes are read (the target of a followed symlink)
+        uint64_t device;
+        uint64_t inode;
+        int64_t modified_nsec; // Modification time in nanoseconds since the epoch
+        int64_t changed_nsec;  // Status change time, same unit
     } FileInfo;
 
     // Binary handling modes
@@ -72,6 +79,54 @@ extern "C"
         SYMLINK_PLACEHOLDER
     } SymlinkHandling;
 
+    // How the content pass reads small files
+    typedef enum
+    {
+        IO_ENGINE_SYNC,   // Blocking fopen/fread when each file's turn comes
+        IO_ENGINE_AUTO,   // io_uring where available, else reader threads
+        IO_ENGINE_URING,  // Read ahead through io_uring
+        IO_ENGINE_THREADS // Read ahead on a pool of blocking reader threads
+    } IoEngineKind;
+
+    // Performance counter report printed at exit (--stats)
+    typedef enum
+    {
+        STATS_REPORT_NONE,
+        STATS_REPORT_TABLE,
+        STATS_REPORT_JSON
+    } StatsReport;
+
+    // Compression of the output stream (--compress)
+    typedef enum
+    {
+        OUTPUT_COMPRESS_NONE,
+        OUTPUT_COMPRESS_GZIP
+    } OutputCompression;
+
+    // What a --shard-size budget counts
+    typedef enum
+    {
+        SHARD_UNIT_BYTES,
+        SHARD_UNIT_TOKENS // Estimated from file sizes
+    } ShardUnit;
+
+    // What --sample keeps of a file: head bytes (or lines) from the start
+    // and tail bytes (or lines) from the end; the middle is never read
+    typedef struct
+    {
+        size_t head;
+        size_t tail;
+        bool head_lines; // head counts lines instead of bytes
+        bool tail_lines;
+    } SamplePolicy;
+
+    // One --sample rule; a NULL pattern applies to every file
+    typedef struct
+    {
+        char *pattern;
+        SamplePolicy policy;
+    } SampleRule;
+
     // Configuration source types
     typedef enum
     {
@@ -130,6 +185,27 @@ extern "C"
         int include_count;        
         PluginConfig *plugins;
         int plugin_count;
+        int jobs;                 // Content workers (0 = one per CPU)
+        bool direct_io;           // Write the output with O_DIRECT
+        bool drop_cache;          // Keep the output out of the page cache
+        IoEngineKind io_engine;   // Read-ahead backend for small files
+        int io_depth;             // Reads kept in flight (0 = engine default)
+        char *incremental_cache;  // Manifest of the previous run (NULL = full run)
+        bool dedup;               // Emit identical file bodies once, then refer back
+        StatsReport stats_report; // Collect per-stage counters and print them at exit
+        OutputCompression compression; // Compress the output stream
+        int compress_level;       // Codec level (-1 = codec default)
+        bool watch;               // Rebuild the output whenever the input changes
+        bool gitignore;           // Honour .gitignore/.ignore files found by the walk
+        bool unique_inodes;       // Walk each directory and emit each file inode once
+        bool log_async;           // Queue log lines for a writer thread, dropping on overflow
+        uint64_t shard_size;      // Content budget of one output shard (0 = no budget)
+        ShardUnit shard_unit;     // What shard_size counts
+        int shards;               // Split into this many even shards (0 = off)
+        char *files_from;         // List of files to process instead of walking ("-" = stdin)
+        SampleRule *samples;      // --sample rules, first match wins
+        int sample_count;
+        bool progress;            // Report progress, throughput and ETA on stderr
     } ResolvedConfig;
 
     // Plugin types
@@ -0,0 +1,612 @@
+#include "walk.h"
+#include "inode_set.h"
+#include "metrics.h"
+#include "../filter/filter.h"
+#include "../filter/filter_ignore.h"
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define WALK_DEQUE_INITIAL 64
+#define WALK_ENTRIES_INITIAL 16
+#define WALK_NAMES_INITIAL 1024
+
+typedef struct WalkDir WalkDir;
+
+typedef struct
+{
+    size_t path;    // Offset of the relative path in the listing's names
+    FileInfo info;  // info.path is set on replay, once names stops moving
+    WalkDir *child; // Listing of the subdirectory when it was entered
+} WalkEntry;
+
+// One directory and, once a worker has listed it, its included entries in
+// readdir order
+struct WalkDir
+{
+    WalkDir *parent;
+    WalkDir *next_allocated;
+    const char *path; // Full path; the relative path is its tail from Walker.rel_start
+    int level;
+    dev_t dev;
+    ino_t ino;
+    IgnoreLayer *ignore;             // Rules of the directory's own ignore files
+    const IgnoreLayer *ignore_scope; // Rules in scope for its entries, set before it is listed
+    WalkEntry *entries;
+    size_t count;
+    size_t capacity;
+    char *names;
+    size_t names_used;
+    size_t names_capacity;
+    char path_storage[];
+};
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    WalkDir **items; // Ring buffer
+    size_t head;     // Oldest item, where thieves take from
+    size_t count;
+    size_t capacity;
+} WalkDeque;
+
+typedef struct
+{
+    FconcatContext *ctx;
+    FilterEngine *filter_engine;
+    int base_level;
+    size_t rel_start; // Offset of relative paths in full ones
+    int threads;
+    WalkDeque *deques;
+    atomic_size_t pending; // Directories queued or being listed
+    atomic_size_t queued;  // Directories in a deque, counted before they land there
+    atomic_bool failed;    // Out of memory; remaining directories are dropped
+    pthread_mutex_t idle_mutex;
+    pthread_cond_t idle_cond;
+    _Atomic(WalkDir *) allocated; // Every directory, for cleanup
+} Walker;
+
+typedef struct
+{
+    Walker *walker;
+    int index;
+} WalkWorker;
+
+/* ==== Listings ==== */
+
+static WalkDir *walk_dir_create(Walker *walker, WalkDir *parent, const char *path, size_t path_len, int level,
+                                dev_t dev, ino_t ino)
+{
+    WalkDir *dir = calloc(1, sizeof(WalkDir) + path_len + 1);
+    if (!dir)
+        return NULL;
+
+    memcpy(dir->path_storage, path, path_len);
+    dir->path_storage[path_len] = '\0';
+    dir->path = dir->path_storage;
+    dir->parent = parent;
+    dir->level = level;
+    dir->dev = dev;
+    dir->ino = ino;
+
+    WalkDir *head = atomic_load_explicit(&walker->allocated, memory_order_relaxed);
+    do
+    {
+        dir->next_allocated = head;
+    } while (!atomic_compare_exchange_weak_explicit(&walker->allocated, &head, dir, memory_order_release,
+                                                    memory_order_relaxed));
+    return dir;
+}
+
+static void walk_dir_free_all(Walker *walker)
+{
+    WalkDir *dir = atomic_load_explicit(&walker->allocated, memory_order_acquire);
+    while (dir)
+    {
+        WalkDir *next = dir->next_allocated;
+        free(dir->entries);
+        free(dir->names);
+        ignore_layer_destroy(dir->ignore);
+        free(dir);
+        dir = next;
+    }
+}
+
+static WalkEntry *walk_dir_add(WalkDir *dir, const char *relative_path, size_t len, const FileInfo *info)
+{
+    if (dir->count == dir->capacity)
+    {
+        size_t capacity = dir->capacity ? dir->capacity * 2 : WALK_ENTRIES_INITIAL;
+        WalkEntry *entries = realloc(dir->entries, capacity * sizeof(WalkEntry));
+        if (!entries)
+            return NULL;
+        dir->entries = entries;
+        dir->capacity = capacity;
+    }
+
+    len++;
+    if (dir->names_used + len > dir->names_capacity)
+    {
+        size_t capacity = dir->names_capacity ? dir->names_capacity : WALK_NAMES_INITIAL;
+        while (dir->names_used + len > capacity)
+            capacity *= 2;
+        char *names = realloc(dir->names, capacity);
+        if (!names)
+            return NULL;
+        dir->names = names;
+        dir->names_capacity = capacity;
+    }
+
+    WalkEntry *entry = &dir->entries[dir->count++];
+    entry->path = dir->names_used;
+    entry->info = *info;
+    entry->info.path = NULL;
+    entry->child = NULL;
+    memcpy(dir->names + dir->names_used, relative_path, len);
+    dir->names_used += len;
+    return entry;
+}
+
+/* ==== Work-stealing deques ==== */
+
+static int deque_push(WalkDeque *deque, WalkDir *dir)
+{
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count == deque->capacity)
+    {
+        size_t capacity = deque->capacity ? deque->capacity * 2 : WALK_DEQUE_INITIAL;
+        WalkDir **items = malloc(capacity * sizeof(WalkDir *));
+        if (!items)
+        {
+            pthread_mutex_unlock(&deque->mutex);
+            return -1;
+        }
+        for (size_t i = 0; i < deque->count; i++)
+            items[i] = deque->items[(deque->head + i) % deque->capacity];
+        free(deque->items);
+        deque->items = items;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+
+    deque->items[(deque->head + deque->count) % deque->capacity] = dir;
+    deque->count++;
+    pthread_mutex_unlock(&deque->mutex);
+    return 0;
+}
+
+// The owner works depth first on what it found last
+static WalkDir *deque_pop_newest(WalkDeque *deque)
+{
+    WalkDir *dir = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0)
+    {
+        deque->count--;
+        dir = deque->items[(deque->head + deque->count) % deque->capacity];
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return dir;
+}
+
+// Thieves take the oldest directory, usually the one with most below it
+static WalkDir *deque_steal_oldest(WalkDeque *deque)
+{
+    WalkDir *dir = NULL;
+    pthread_mutex_lock(&deque->mutex);
+    if (deque->count > 0)
+    {
+        dir = deque->items[deque->head];
+        deque->head = (deque->head + 1) % deque->capacity;
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->mutex);
+    return dir;
+}
+
+static void walker_enqueue(Walker *walker, int index, WalkDir *dir)
+{
+    atomic_fetch_add_explicit(&walker->pending, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&walker->queued, 1, memory_order_release);
+    if (deque_push(&walker->deques[index], dir) != 0)
+    {
+        atomic_store(&walker->failed, true);
+        atomic_fetch_sub_explicit(&walker->queued, 1, memory_order_relaxed);
+        atomic_fetch_sub_explicit(&walker->pending, 1, memory_order_relaxed);
+        return;
+    }
+
+    pthread_mutex_lock(&walker->idle_mutex);
+    pthread_cond_signal(&walker->idle_cond);
+    pthread_mutex_unlock(&walker->idle_mutex);
+}
+
+static WalkDir *walker_take(Walker *walker, int index)
+{
+    WalkDir *dir = deque_pop_newest(&walker->deques[index]);
+    for (int i = 1; !dir && i < walker->threads; i++)
+        dir = deque_steal_oldest(&walker->deques[(index + i) % walker->threads]);
+
+    if (dir)
+        atomic_fetch_sub_explicit(&walker->queued, 1, memory_order_relaxed);
+    return dir;
+}
+
+static void walker_finish(Walker *walker)
+{
+    if (atomic_fetch_sub_explicit(&walker->pending, 1, memory_order_acq_rel) == 1)
+    {
+        pthread_mutex_lock(&walker->idle_mutex);
+        pthread_cond_broadcast(&walker->idle_cond);
+        pthread_mutex_unlock(&walker->idle_mutex);
+    }
+}
+
+/* ==== Listing a directory ==== */
+
+// Queue an included subdirectory unless that would loop or go too deep.
+// info holds the device and inode of the directory or followed target.
+static void walk_enter(Walker *walker, int index, WalkDir *parent, WalkEntry *entry, const char *full_path,
+                       size_t full_len, const FileInfo *info)
+{
+    FconcatContext *ctx = walker->ctx;
+    dev_t dev = (dev_t)info->device;
+    ino_t ino = (ino_t)info->inode;
+
+    for (WalkDir *ancestor = parent; ancestor; ancestor = ancestor->parent)
+    {
+        if (ancestor->dev == dev && ancestor->ino == ino)
+        {
+            ctx->warning(ctx, "Circular symlink detected, skipping: %s", full_path);
+            return;
+        }
+    }
+
+    // The serial walk holds at most this many open directories
+    if (parent->level + 1 - walker->base_level >= MAX_DIRECTORY_DEPTH)
+    {
+        ctx->warning(ctx, "Directory stack full, skipping: %s", full_path);
+        return;
+    }
+
+    WalkDir *child = walk_dir_create(walker, parent, full_path, full_len, parent->level + 1, dev, ino);
+    if (!child)
+    {
+        atomic_store(&walker->failed, true);
+        return;
+    }
+
+    entry->child = child;
+    walker_enqueue(walker, index, child);
+}
+
+// Everything traverse_directory does for one directory, except calling back
+static void walk_list(Walker *walker, int index, WalkDir *dir)
+{
+    FconcatContext *ctx = walker->ctx;
+    Metrics *metrics = context_metrics(ctx);
+
+    uint64_t start = metrics_begin(metrics);
+    DIR *handle = opendir(dir->path);
+    metrics_end(metrics, METRICS_READDIR, start, 0);
+    if (!handle)
+    {
+        if (errno == EACCES)
+            ctx->warning(ctx, "Permission denied accessing directory: %s", dir->path);
+        else
+            ctx->warning(ctx, "Cannot open directory: %s - %s", dir->path, strerror(errno));
+        return;
+    }
+
+    // Names are appended to the directory's path in place
+    char full_path[MAX_PATH];
+    size_t dir_len = strlen(dir->path);
+    memcpy(full_path, dir->path, dir_len);
+    full_path[dir_len] = '/';
+    const char *relative_path = full_path + walker->rel_start;
+    int dir_fd = dirfd(handle);
+
+    // Layers only ever point up, at listings that are done by now
+    const IgnoreLayer *parent_scope = dir->parent ? dir->parent->ignore_scope : NULL;
+    size_t relative_len = dir_len > walker->rel_start ? dir_len - walker->rel_start : 0;
+    const IgnoreLayer *scope = context_enter_ignore_scope(ctx, dir_fd, dir->path, relative_path, relative_len,
+                                                          parent_scope, &dir->ignore);
+    dir->ignore_scope = scope;
+
+    for (;;)
+    {
+        start = metrics_begin(metrics);
+        struct dirent *entry = readdir(handle);
+        metrics_end(metrics, METRICS_READDIR, start, 0);
+        if (!entry || atomic_load_explicit(&walker->failed, memory_order_relaxed))
+            break;
+
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            continue;
+
+        if (dir->level >= MAX_DIRECTORY_DEPTH)
+        {
+            ctx->warning(ctx, "Maximum directory depth (%d) exceeded, skipping deeper entries",
+                         MAX_DIRECTORY_DEPTH);
+            continue;
+        }
+
+        size_t name_len = strlen(entry->d_name);
+        if (dir_len + 1 + name_len >= sizeof(full_path))
+        {
+            ctx->warning(ctx, "Path too long, skipping: %s", entry->d_name);
+            continue;
+        }
+        memcpy(full_path + dir_len + 1, entry->d_name, name_len + 1);
+        size_t full_len = dir_len + 1 + name_len;
+
+        int ignore_directory = scope ? ignore_entry_is_directory(entry->d_type) : 0;
+        if (scope && ignore_directory >= 0 && ignore_layer_match(scope, relative_path, ignore_directory))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Ignoring path: %s", relative_path);
+            continue;
+        }
+
+        int type_verdict = context_filter_entry_type(ctx, relative_path, entry->d_type);
+        if (type_verdict == 0)
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", relative_path);
+            continue;
+        }
+
+        FileInfo info;
+        if (context_stat_entry(ctx, dir_fd, entry->d_name, full_path, relative_path, &info) != 0)
+            continue;
+        if (scope && ignore_directory < 0 &&
+            ignore_layer_match(scope, relative_path, info.is_directory && !info.is_symlink))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Ignoring path: %s", relative_path);
+            continue;
+        }
+
+        if (type_verdict < 0 && !filter_engine_should_include_path(walker->filter_engine, ctx, relative_path, &info))
+        {
+            if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                ctx->log(ctx, LOG_DEBUG, "Excluding path: %s", relative_path);
+            continue;
+        }
+
+        WalkEntry *added = walk_dir_add(dir, relative_path, full_len - walker->rel_start, &info);
+        if (!added)
+            atomic_store(&walker->failed, true);
+        else if (info.is_directory)
+            walk_enter(walker, index, dir, added, full_path, full_len, &info);
+    }
+
+    start = metrics_begin(metrics);
+    closedir(handle);
+    metrics_end(metrics, METRICS_READDIR, start, 0);
+}
+
+static void *walk_worker(void *arg)
+{
+    WalkWorker *worker = (WalkWorker *)arg;
+    Walker *walker = worker->walker;
+
+    for (;;)
+    {
+        WalkDir *dir = walker_take(walker, worker->index);
+        if (dir)
+        {
+            if (!atomic_load_explicit(&walker->failed, memory_order_relaxed))
+                walk_list(walker, worker->index, dir);
+            walker_finish(walker);
+            continue;
+        }
+
+        pthread_mutex_lock(&walker->idle_mutex);
+        while (atomic_load(&walker->queued) == 0 && atomic_load(&walker->pending) > 0)
+            pthread_cond_wait(&walker->idle_cond, &walker->idle_mutex);
+        bool done = atomic_load(&walker->pending) == 0;
+        pthread_mutex_unlock(&walker->idle_mutex);
+
+        if (done)
+            return NULL;
+    }
+}
+
+/* ==== Replay ==== */
+
+typedef struct
+{
+    WalkDir *dir;
+    size_t next;
+} ReplayFrame;
+
+// Depth first over the listings: a directory's own entry, then its contents.
+// With seen (--unique-inodes) an inode only counts the first time, in the
+// same order the serial walk would have reached it.
+static int walk_replay(FconcatContext *ctx, WalkDir *root, InodeSet *seen, DirectoryCallback *callback)
+{
+    size_t capacity = 32;
+    size_t depth = 0;
+    ReplayFrame *frames = malloc(capacity * sizeof(ReplayFrame));
+    if (!frames)
+    {
+        ctx->error(ctx, "Failed to allocate directory stack");
+        return -1;
+    }
+    frames[depth++] = (ReplayFrame){root, 0};
+
+    int result = 0;
+    while (depth > 0)
+    {
+        ReplayFrame *frame = &frames[depth - 1];
+        WalkDir *dir = frame->dir;
+        if (frame->next == dir->count)
+        {
+            depth--;
+            continue;
+        }
+
+        WalkEntry *entry = &dir->entries[frame->next++];
+        char *path = dir->names + entry->path;
+        entry->info.path = path;
+
+        if (seen)
+        {
+            int added = inode_set_insert(seen, entry->info.device, entry->info.inode);
+            if (added < 0)
+            {
+                ctx->error(ctx, "Out of memory while walking: %s", path);
+                result = -1;
+                break;
+            }
+            if (added == 0)
+            {
+                if (fconcat_log_enabled(ctx, LOG_DEBUG))
+                    ctx->log(ctx, LOG_DEBUG, "Already reached through another path: %s", path);
+                continue;
+            }
+        }
+
+        ctx->current_file_path = path;
+        ctx->current_file_info = &entry->info;
+        ctx->current_directory_level = dir->level;
+
+        EntryType type = entry->info.is_directory ? ENTRY_TYPE_DIRECTORY : ENTRY_TYPE_FILE;
+        result = callback->handle_entry(ctx, path, type, &entry->info, dir->level, callback->user_data);
+        ctx->current_file_info = NULL;
+        if (result != 0)
+            break;
+
+        if (entry->child)
+        {
+            if (depth == capacity)
+            {
+                ReplayFrame *grown = realloc(frames, capacity * 2 * sizeof(ReplayFrame));
+                if (!grown)
+                {
+                    ctx->error(ctx, "Failed to allocate directory stack");
+                    result = -1;
+                    break;
+                }
+                frames = grown;
+                capacity *= 2;
+            }
+            frames[depth++] = (ReplayFrame){entry->child, 0};
+        }
+    }
+
+    free(frames);
+    return result;
+}
+
+int walk_directory_parallel(FconcatContext *ctx, const char *base_path, const char *relative_path,
+                            int level, int threads, DirectoryCallback *callback)
+{
+    if (!ctx || !base_path || !relative_path || !callback || !callback->handle_entry)
+        return -1;
+    if (threads <= 1)
+        return traverse_directory(ctx, base_path, relative_path, level, callback);
+    if (threads > WALK_MAX_THREADS)
+        threads = WALK_MAX_THREADS;
+
+    char root_path[MAX_PATH];
+    int n = relative_path[0] ? snprintf(root_path, sizeof(root_path), "%s/%s", base_path, relative_path)
+                             : snprintf(root_path, sizeof(root_path), "%s", base_path);
+    if (n < 0 || n >= (int)sizeof(root_path))
+    {
+        ctx->error(ctx, "Path too long: %s/%s", base_path, relative_path);
+        return -1;
+    }
+
+    Metrics *metrics = context_metrics(ctx);
+    struct stat st;
+    uint64_t start = metrics_begin(metrics);
+    int stat_result = stat(root_path, &st);
+    metrics_end(metrics, METRICS_STAT, start, 0);
+    if (stat_result != 0)
+    {
+        ctx->warning(ctx, "Cannot stat directory: %s - %s", root_path, strerror(errno));
+        return 0;
+    }
+
+    Walker walker = {0};
+    walker.ctx = ctx;
+    walker.filter_engine = ((InternalContextState *)ctx->internal_state)->filter_engine;
+    walker.base_level = level;
+    walker.rel_start = strlen(base_path) + 1;
+    walker.threads = threads;
+    walker.deques = calloc((size_t)threads, sizeof(WalkDeque));
+    if (!walker.deques)
+    {
+        ctx->error(ctx, "Failed to allocate directory stack");
+        return -1;
+    }
+    for (int i = 0; i < threads; i++)
+        pthread_mutex_init(&walker.deques[i].mutex, NULL);
+    pthread_mutex_init(&walker.idle_mutex, NULL);
+    pthread_cond_init(&walker.idle_cond, NULL);
+
+    int result = 0;
+    WalkDir *root = walk_dir_create(&walker, NULL, root_path, (size_t)n, level, st.st_dev, st.st_ino);
+    if (root)
+        walker_enqueue(&walker, 0, root);
+
+    pthread_t handles[WALK_MAX_THREADS];
+    WalkWorker workers[WALK_MAX_THREADS];
+    int started = 0;
+    for (int i = 1; root && i < threads; i++)
+    {
+        workers[i] = (WalkWorker){&walker, i};
+        if (pthread_create(&handles[i], NULL, walk_worker, &workers[i]) != 0)
+            break; // The deques of threads that did not start are still stolen from
+        started = i;
+    }
+
+    workers[0] = (WalkWorker){&walker, 0};
+    if (root)
+        walk_worker(&workers[0]);
+    for (int i = 1; i <= started; i++)
+        pthread_join(handles[i], NULL);
+
+    if (!root || atomic_load(&walker.failed))
+    {
+        ctx->error(ctx, "Out of memory while walking: %s", root_path);
+        result = -1;
+    }
+    else
+    {
+        const ResolvedConfig *config = (const ResolvedConfig *)ctx->config;
+        InodeSet *seen = config && config->unique_inodes ? inode_set_create() : NULL;
+        if (seen && inode_set_insert(seen, (uint64_t)st.st_dev, (uint64_t)st.st_ino) < 0)
+        {
+            inode_set_destroy(seen);
+            seen = NULL;
+        }
+        if (config && config->unique_inodes && !seen)
+        {
+            ctx->error(ctx, "Out of memory while walking: %s", root_path);
+            result = -1;
+        }
+        else
+        {
+            result = walk_replay(ctx, root, seen, callback);
+        }
+        inode_set_destroy(seen);
+    }
+
+    walk_dir_free_all(&walker);
+    for (int i = 0; i < threads; i++)
+    {
+        free(walker.deques[i].items);
+        pthread_mutex_destroy(&walker.deques[i].mutex);
+    }
+    free(walker.deques);
+    pthread_mutex_destroy(&walker.idle_mutex);
+    pthread_cond_destroy(&walker.idle_cond);
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef CORE_WALK_H
+#define CORE_WALK_H
+
+#include "context.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Upper bound for the threads of one walk
+#define WALK_MAX_THREADS 64
+
+    // Walk base_path/relative_path on `threads` threads, the caller being
+    // one of them, and hand every included entry to callback on the calling
+    // thread in exactly the order traverse_directory reports them.
+    //
+    // Each directory is listed, and its entries examined and filtered, by a
+    // single worker. Workers take directories from their own deque newest
+    // first and steal the oldest from the others when it runs dry. Once
+    // every listing is in, they are replayed depth first. Like the serial
+    // walk, a directory is never entered again below itself; the check runs
+    // against the chain of parent directories instead of a VisitedSet.
+    //
+    // threads <= 1 runs traverse_directory.
+    int walk_directory_parallel(FconcatContext *ctx, const char *base_path, const char *relative_path,
+                                int level, int threads, DirectoryCallback *callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_WALK_H */
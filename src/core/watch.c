@@ -0,0 +1,319 @@
+#include "watch.h"
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+struct Watcher
+{
+    int fd;
+    char *input_directory;
+    char *ignored[WATCH_MAX_IGNORED]; // Absolute paths
+    int ignored_count;
+    char **directories; // Canonical path per watch descriptor, or NULL
+    size_t directory_capacity;
+    size_t events; // Relevant events of the last wait
+};
+
+bool watcher_supported(void)
+{
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Absolute form of a path whose last component may not exist yet
+static char *absolute_path(const char *path)
+{
+    char *resolved = realpath(path, NULL);
+    if (resolved)
+        return resolved;
+
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    char *dir_resolved = dir ? realpath(dir, NULL) : NULL;
+    free(dir);
+    if (!dir_resolved)
+        return strdup(path);
+
+    const char *name = slash ? slash + 1 : path;
+    size_t length = strlen(dir_resolved) + strlen(name) + 2;
+    char *joined = malloc(length);
+    if (joined)
+        snprintf(joined, length, "%s/%s", strcmp(dir_resolved, "/") == 0 ? "" : dir_resolved, name);
+    free(dir_resolved);
+    return joined;
+}
+
+Watcher *watcher_create(const char *input_directory, const char *const *ignored, int ignored_count)
+{
+#ifdef __linux__
+    if (!input_directory || ignored_count < 0 || ignored_count > WATCH_MAX_IGNORED)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    Watcher *watcher = calloc(1, sizeof(Watcher));
+    if (!watcher)
+        return NULL;
+
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    watcher->input_directory = strdup(input_directory);
+    if (watcher->fd < 0 || !watcher->input_directory)
+    {
+        int saved_errno = errno;
+        watcher_destroy(watcher);
+        errno = saved_errno;
+        return NULL;
+    }
+
+    for (int i = 0; i < ignored_count; i++)
+    {
+        if (ignored[i])
+            watcher->ignored[watcher->ignored_count] = absolute_path(ignored[i]);
+        if (watcher->ignored[watcher->ignored_count])
+            watcher->ignored_count++;
+    }
+    return watcher;
+#else
+    (void)input_directory;
+    (void)ignored;
+    (void)ignored_count;
+    errno = ENOTSUP;
+    return NULL;
+#endif
+}
+
+void watcher_destroy(Watcher *watcher)
+{
+    if (!watcher)
+        return;
+    if (watcher->fd >= 0)
+        close(watcher->fd);
+    for (size_t i = 0; i < watcher->directory_capacity; i++)
+        free(watcher->directories[i]);
+    free(watcher->directories);
+    for (int i = 0; i < watcher->ignored_count; i++)
+        free(watcher->ignored[i]);
+    free(watcher->input_directory);
+    free(watcher);
+}
+
+size_t watcher_event_count(const Watcher *watcher)
+{
+    return watcher ? watcher->events : 0;
+}
+
+#ifdef __linux__
+
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVED_FROM | \
+                      IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static int watch_directory(Watcher *watcher, const char *path)
+{
+    int wd = inotify_add_watch(watcher->fd, path, WATCH_EVENTS | IN_ONLYDIR | IN_EXCL_UNLINK);
+    if (wd < 0)
+        return errno == ENOENT || errno == ENOTDIR || errno == EACCES ? 0 : -1;
+
+    if ((size_t)wd >= watcher->directory_capacity)
+    {
+        size_t capacity = watcher->directory_capacity ? watcher->directory_capacity : 64;
+        while (capacity <= (size_t)wd)
+            capacity *= 2;
+        char **directories = realloc(watcher->directories, capacity * sizeof(char *));
+        if (!directories)
+            return -1;
+        memset(directories + watcher->directory_capacity, 0,
+               (capacity - watcher->directory_capacity) * sizeof(char *));
+        watcher->directories = directories;
+        watcher->directory_capacity = capacity;
+    }
+
+    // The same directory hands back its existing descriptor
+    if (!watcher->directories[wd])
+        watcher->directories[wd] = absolute_path(path);
+    return 0;
+}
+
+int watcher_sync(Watcher *watcher, const FileTree *tree)
+{
+    if (!watcher)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    if (watch_directory(watcher, watcher->input_directory) != 0)
+        return -1;
+    if (!tree)
+        return 0;
+
+    char path[PATH_MAX];
+    for (size_t i = 0; i < tree->count; i++)
+    {
+        const TreeEntry *entry = &tree->entries[i];
+        if (entry->type != ENTRY_TYPE_DIRECTORY)
+            continue;
+        int length = snprintf(path, sizeof(path), "%s/%s", watcher->input_directory, entry->path);
+        if (length < 0 || length >= (int)sizeof(path))
+            continue;
+        if (watch_directory(watcher, path) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// The output and its temporaries: the path itself or path.<suffix>
+static bool is_ignored(const Watcher *watcher, int wd, const char *name)
+{
+    if (wd < 0 || (size_t)wd >= watcher->directory_capacity || !watcher->directories[wd] || !name[0])
+        return false;
+
+    const char *dir = watcher->directories[wd];
+    size_t dir_length = strlen(dir);
+    for (int i = 0; i < watcher->ignored_count; i++)
+    {
+        const char *ignored = watcher->ignored[i];
+        if (strncmp(ignored, dir, dir_length) != 0 || ignored[dir_length] != '/')
+            continue;
+        const char *ignored_name = ignored + dir_length + 1;
+        size_t length = strlen(ignored_name);
+        if (strncmp(name, ignored_name, length) == 0 && (name[length] == '\0' || name[length] == '.'))
+            return true;
+    }
+    return false;
+}
+
+// Drain pending events; returns how many of them matter
+static long read_events(Watcher *watcher)
+{
+    char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+    long relevant = 0;
+
+    for (;;)
+    {
+        ssize_t n = read(watcher->fd, buffer, sizeof(buffer));
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR)
+                return relevant;
+            return -1;
+        }
+        if (n == 0)
+            return relevant;
+
+        for (char *at = buffer; at < buffer + n;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)at;
+            at += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                relevant++;
+                continue;
+            }
+            if (event->mask & IN_IGNORED)
+            {
+                // Removed, or moved away: a later sync subscribes it again
+                if (event->wd >= 0 && (size_t)event->wd < watcher->directory_capacity)
+                {
+                    free(watcher->directories[event->wd]);
+                    watcher->directories[event->wd] = NULL;
+                }
+                continue;
+            }
+            if (event->len > 0 && is_ignored(watcher, event->wd, event->name))
+                continue;
+            relevant++;
+        }
+    }
+}
+
+static long elapsed_ms(const struct timespec *since)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+int watcher_wait(Watcher *watcher, bool (*stop)(void))
+{
+    if (!watcher)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    size_t events = 0;
+    struct timespec first = {0};
+    for (;;)
+    {
+        if (stop && stop())
+            return 0;
+
+        int timeout = 200;
+        if (events > 0)
+        {
+            long left = WATCH_MAX_DELAY_MS - elapsed_ms(&first);
+            if (left <= 0)
+                break;
+            timeout = left < WATCH_SETTLE_MS ? (int)left : WATCH_SETTLE_MS;
+        }
+
+        struct pollfd pfd = {watcher->fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (ready == 0)
+        {
+            // Quiet for the settle time: the burst is over
+            if (events > 0)
+                break;
+            continue;
+        }
+
+        long relevant = read_events(watcher);
+        if (relevant < 0)
+            return -1;
+        if (relevant > 0 && events == 0)
+            clock_gettime(CLOCK_MONOTONIC, &first);
+        events += (size_t)relevant;
+    }
+
+    watcher->events = events;
+    return 1;
+}
+
+#else
+
+int watcher_sync(Watcher *watcher, const FileTree *tree)
+{
+    (void)watcher;
+    (void)tree;
+    errno = ENOTSUP;
+    return -1;
+}
+
+int watcher_wait(Watcher *watcher, bool (*stop)(void))
+{
+    (void)watcher;
+    (void)stop;
+    errno = ENOTSUP;
+    return -1;
+}
+
+#endif /* __linux__ */
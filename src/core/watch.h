@@ -0,0 +1,50 @@
+#ifndef CORE_WATCH_H
+#define CORE_WATCH_H
+
+#include "tree.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Change notification for --watch. Every directory of the last tree is
+    // subscribed to (inotify on Linux); a burst of events is collapsed into
+    // one change once the tree has been quiet for WATCH_SETTLE_MS.
+    //
+    // Events on the output file and on paths next to it that start with its
+    // name (temporaries, the incremental manifest) are ignored, so writing
+    // the output does not trigger another run.
+    typedef struct Watcher Watcher;
+
+#define WATCH_SETTLE_MS 20
+    // Upper bound for collapsing a steady stream of events
+#define WATCH_MAX_DELAY_MS 250
+
+    // ignored may hold up to WATCH_MAX_IGNORED paths, NULL entries skipped.
+    // NULL with errno set; ENOTSUP where there is no backend.
+#define WATCH_MAX_IGNORED 4
+    Watcher *watcher_create(const char *input_directory, const char *const *ignored, int ignored_count);
+    void watcher_destroy(Watcher *watcher);
+
+    bool watcher_supported(void);
+
+    // Subscribe to the input directory and every directory entry of tree.
+    // Directories already watched keep their subscription; ones that are
+    // gone drop out by themselves.
+    int watcher_sync(Watcher *watcher, const FileTree *tree);
+
+    // Block until something under the tree changed. Returns 1 on a change,
+    // 0 when stop() turned true (polled at least every 200 ms and after
+    // signals), -1 with errno set on failure.
+    int watcher_wait(Watcher *watcher, bool (*stop)(void));
+
+    // Changes seen by the last successful watcher_wait
+    size_t watcher_event_count(const Watcher *watcher);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_WATCH_H */
@@ -0,0 +1,277 @@
+#include "zerocopy.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+// Largest request handed to one syscall (sendfile caps at 0x7ffff000 anyway)
+#define ZEROCOPY_MAX_REQUEST (1024 * 1024 * 1024)
+// Window mapped at once by the mmap fallback
+#define ZEROCOPY_MMAP_WINDOW (8 * 1024 * 1024)
+// Bounce buffer of the last-resort read/write loop
+#define ZEROCOPY_BOUNCE_SIZE (128 * 1024)
+
+// Progress through the requested range, shared by every stage
+typedef struct
+{
+    int out_fd;
+    int in_fd;
+    off_t offset;
+    size_t remaining;
+    size_t copied;
+    bool eof;
+} CopyState;
+
+// Stage results: the range is done, try the next mechanism, or give up
+enum
+{
+    STAGE_DONE = 1,
+    STAGE_FALLBACK = 0,
+    STAGE_ERROR = -1
+};
+
+static size_t request_size(const CopyState *state)
+{
+    return state->remaining > ZEROCOPY_MAX_REQUEST ? ZEROCOPY_MAX_REQUEST : state->remaining;
+}
+
+// Errors that no other mechanism can get around
+static bool is_hard_error(int err)
+{
+    return err == EPIPE || err == ENOSPC || err == EDQUOT || err == EFBIG || err == EIO;
+}
+
+static void advance(CopyState *state, size_t n)
+{
+    state->offset += (off_t)n;
+    state->remaining -= n;
+    state->copied += n;
+}
+
+// Shared loop for the syscalls that move bytes without a userspace buffer
+typedef ssize_t (*KernelCopy)(CopyState *state, size_t count);
+
+static int run_kernel_copy(CopyState *state, KernelCopy copy)
+{
+    while (state->remaining > 0)
+    {
+        ssize_t n = copy(state, request_size(state));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return is_hard_error(errno) ? STAGE_ERROR : STAGE_FALLBACK;
+        }
+        if (n == 0)
+        {
+            state->eof = true;
+            return STAGE_DONE;
+        }
+        advance(state, (size_t)n);
+    }
+    return STAGE_DONE;
+}
+
+#ifdef __linux__
+
+static ssize_t copy_range_call(CopyState *state, size_t count)
+{
+    off_t offset = state->offset;
+    return copy_file_range(state->in_fd, &offset, state->out_fd, NULL, count, 0);
+}
+
+static ssize_t splice_call(CopyState *state, size_t count)
+{
+    off_t offset = state->offset;
+    return splice(state->in_fd, &offset, state->out_fd, NULL, count, SPLICE_F_MOVE | SPLICE_F_MORE);
+}
+
+static ssize_t sendfile_call(CopyState *state, size_t count)
+{
+    off_t offset = state->offset;
+    return sendfile(state->out_fd, state->in_fd, &offset, count);
+}
+
+#endif /* __linux__ */
+
+static int write_all(int fd, const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int stage_mmap(CopyState *state)
+{
+    struct stat st;
+    if (fstat(state->in_fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return STAGE_FALLBACK;
+
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0)
+        return STAGE_FALLBACK;
+
+    while (state->remaining > 0)
+    {
+        // Never map past the current end of file: touching those pages
+        // would raise SIGBUS if the file shrank since it was listed
+        if (state->offset >= st.st_size)
+        {
+            state->eof = true;
+            return STAGE_DONE;
+        }
+
+        off_t base = state->offset - (state->offset % page);
+        size_t lead = (size_t)(state->offset - base);
+        size_t available = (size_t)(st.st_size - state->offset);
+        size_t count = state->remaining < available ? state->remaining : available;
+        if (count > ZEROCOPY_MMAP_WINDOW)
+            count = ZEROCOPY_MMAP_WINDOW;
+
+        void *map = mmap(NULL, lead + count, PROT_READ, MAP_PRIVATE, state->in_fd, base);
+        if (map == MAP_FAILED)
+            return STAGE_FALLBACK;
+
+        madvise(map, lead + count, MADV_SEQUENTIAL);
+        int result = write_all(state->out_fd, (const char *)map + lead, count);
+        int saved_errno = errno;
+        munmap(map, lead + count);
+
+        if (result != 0)
+        {
+            errno = saved_errno;
+            return STAGE_ERROR;
+        }
+        advance(state, count);
+    }
+    return STAGE_DONE;
+}
+
+static int stage_read_write(CopyState *state)
+{
+    char *buffer = malloc(ZEROCOPY_BOUNCE_SIZE);
+    if (!buffer)
+        return STAGE_ERROR;
+
+    int result = STAGE_DONE;
+    while (state->remaining > 0)
+    {
+        size_t count = state->remaining < ZEROCOPY_BOUNCE_SIZE ? state->remaining : ZEROCOPY_BOUNCE_SIZE;
+        ssize_t n = pread(state->in_fd, buffer, count, state->offset);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            result = STAGE_ERROR;
+            break;
+        }
+        if (n == 0)
+        {
+            state->eof = true;
+            break;
+        }
+        if (write_all(state->out_fd, buffer, (size_t)n) != 0)
+        {
+            result = STAGE_ERROR;
+            break;
+        }
+        advance(state, (size_t)n);
+    }
+
+    int saved_errno = errno;
+    free(buffer);
+    errno = saved_errno;
+    return result;
+}
+
+ssize_t zerocopy_fd_range(int out_fd, int in_fd, off_t offset, size_t length, ZeroCopyMethod *method)
+{
+    if (method)
+        *method = ZEROCOPY_NONE;
+    if (out_fd < 0 || in_fd < 0 || offset < 0)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    CopyState state = {out_fd, in_fd, offset, length, 0, false};
+    ZeroCopyMethod used = ZEROCOPY_NONE;
+    int result = STAGE_FALLBACK;
+
+#ifdef __linux__
+    struct stat out_st;
+    bool out_is_pipe = fstat(out_fd, &out_st) == 0 && S_ISFIFO(out_st.st_mode);
+
+    // A pipe only accepts spliced pages; copy_file_range needs two files
+    if (out_is_pipe)
+    {
+        used = ZEROCOPY_SPLICE;
+        result = run_kernel_copy(&state, splice_call);
+    }
+    else
+    {
+        used = ZEROCOPY_COPY_FILE_RANGE;
+        result = run_kernel_copy(&state, copy_range_call);
+    }
+
+    if (result == STAGE_FALLBACK)
+    {
+        used = ZEROCOPY_SENDFILE;
+        result = run_kernel_copy(&state, sendfile_call);
+    }
+#endif
+
+    if (result == STAGE_FALLBACK)
+    {
+        used = ZEROCOPY_MMAP;
+        result = stage_mmap(&state);
+    }
+
+    if (result == STAGE_FALLBACK)
+    {
+        used = ZEROCOPY_READ_WRITE;
+        result = stage_read_write(&state);
+    }
+
+    if (method)
+        *method = used;
+    if (result == STAGE_ERROR)
+        return -1;
+    return (ssize_t)state.copied;
+}
+
+const char *zerocopy_method_name(ZeroCopyMethod method)
+{
+    switch (method)
+    {
+    case ZEROCOPY_COPY_FILE_RANGE:
+        return "copy_file_range";
+    case ZEROCOPY_SPLICE:
+        return "splice";
+    case ZEROCOPY_SENDFILE:
+        return "sendfile";
+    case ZEROCOPY_MMAP:
+        return "mmap";
+    case ZEROCOPY_READ_WRITE:
+        return "read/write";
+    default:
+        return "none";
+    }
+}
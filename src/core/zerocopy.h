@@ -0,0 +1,42 @@
+#ifndef CORE_ZEROCOPY_H
+#define CORE_ZEROCOPY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // How a range of bytes was moved from the input to the output descriptor
+    typedef enum
+    {
+        ZEROCOPY_NONE = 0,
+        ZEROCOPY_COPY_FILE_RANGE, // In-kernel file-to-file copy (may reflink)
+        ZEROCOPY_SPLICE,          // File pages into a pipe
+        ZEROCOPY_SENDFILE,        // File pages to any descriptor
+        ZEROCOPY_MMAP,            // Mapped input, one write() per window
+        ZEROCOPY_READ_WRITE       // Plain pread()/write() loop
+    } ZeroCopyMethod;
+
+    // Files smaller than this are not worth the extra syscalls
+#define ZEROCOPY_MIN_SIZE (64 * 1024)
+
+    // Copy length bytes of in_fd starting at offset to the current position
+    // of out_fd, trying the cheapest mechanism the kernel accepts for this
+    // pair of descriptors and falling back on EINVAL/EXDEV/ENOSYS and
+    // friends. The input file position is not used or changed. Stops early
+    // if the input turns out to be shorter. Returns the number of bytes
+    // copied, or -1 with errno set if an output write failed; *method (if
+    // not NULL) receives the mechanism that moved the last bytes.
+    ssize_t zerocopy_fd_range(int out_fd, int in_fd, off_t offset, size_t length, ZeroCopyMethod *method);
+
+    // Short name of a method, for debug logs
+    const char *zerocopy_method_name(ZeroCopyMethod method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CORE_ZEROCOPY_H */
@@ -1,6 +1,9 @@
 #include "filter.h"
+#include "filter_pattern.h"
+#include "filter_scan.h"
 #include "../core/error.h"
 #include "../core/memory.h"
+#include "../core/metrics.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -26,6 +29,27 @@ char *get_absolute_path_util(const char *path)
     char *abs_path = realpath(path, NULL);
 #endif
 
+#ifndef _WIN32
+    if (!abs_path)
+    {
+        // A file that does not exist yet (an output about to be created)
+        // still resolves through its directory
+        const char *slash = strrchr(path, PATH_SEP);
+        char *dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+        char *abs_dir = dir ? realpath(dir, NULL) : NULL;
+        free(dir);
+        if (abs_dir)
+        {
+            const char *name = slash ? slash + 1 : path;
+            size_t size = strlen(abs_dir) + strlen(name) + 2;
+            abs_path = malloc(size);
+            if (abs_path)
+                snprintf(abs_path, size, "%s/%s", strcmp(abs_dir, "/") == 0 ? "" : abs_dir, name);
+            free(abs_dir);
+        }
+    }
+#endif
+
     if (!abs_path)
     {
         // Fallback to duplicating path
@@ -86,6 +110,28 @@ char *get_relative_path_util(const char *base_dir, const char *target_path)
     return result;
 }
 
+// Classify a sample (normally the start of a file) as binary or text
+// Returns: 1 if binary, 0 if text
+int filter_detect_binary(const char *data, size_t size)
+{
+    if (!data || size == 0)
+        return 0; // Empty file is treated as text
+
+    // UTF-16/UTF-32 text need not contain NULs (e.g. CJK) but is unreadable
+    // in a concatenated UTF-8 dump, so a wide-encoding BOM marks it binary
+    const unsigned char *bytes = (const unsigned char *)data;
+    if (size >= 2 && ((bytes[0] == 0xFF && bytes[1] == 0xFE) || (bytes[0] == 0xFE && bytes[1] == 0xFF)))
+        return 1;
+
+    // Null bytes are the primary binary indicator; otherwise too many
+    // control characters that text never uses
+    ByteScanResult scan = filter_scan_bytes(data, size);
+    if (scan.has_nul)
+        return 1;
+
+    return scan.control_count * 100 > size * BINARY_CONTROL_PERCENT;
+}
+
 // Check if a file is binary by reading the first portion and looking for null bytes
 // Returns: 1 if binary, 0 if text, -1 on error
 int filter_is_binary_file(const char *filepath)
@@ -97,21 +143,11 @@ int filter_is_binary_file(const char *filepath)
     if (!file)
         return -1;
 
-    unsigned char buffer[BINARY_CHECK_SIZE];
+    char buffer[BINARY_CHECK_SIZE];
     size_t bytes_read = fread(buffer, 1, sizeof(buffer), file);
     fclose(file);
 
-    if (bytes_read == 0)
-        return 0; // Empty file is treated as text
-
-    // Check for null bytes - primary binary indicator
-    for (size_t i = 0; i < bytes_read; i++)
-    {
-        if (buffer[i] == 0)
-            return 1; // Binary
-    }
-
-    return 0; // Text
+    return filter_detect_binary(buffer, bytes_read);
 }
 
 FilterEngine *filter_engine_create(void)
@@ -128,6 +164,8 @@ FilterEngine *filter_engine_create(void)
         return NULL;
     }
 
+    atomic_init(&engine->sealed, false);
+
     engine->rule_capacity = 100;
     engine->rules = calloc(engine->rule_capacity, sizeof(FilterRule));
     if (!engine->rules)
@@ -168,22 +206,30 @@ void filter_engine_destroy(FilterEngine *engine)
 
     // Cleanup rules
     free(engine->rules);
+    free(engine->stages.content_rules);
+    free(engine->stages.chunk_transforms);
+    free(engine->stages.file_rules);
+    filter_sample_rules_destroy(engine);
 
     pthread_mutex_unlock(&engine->mutex);
     pthread_mutex_destroy(&engine->mutex);
     free(engine);
 }
 
-static int add_output_file_exclusion(FilterEngine *engine, const ResolvedConfig *config)
+// Keep a file fconcat itself writes out of the walk when it lies inside
+// the input. With temporaries, the mkstemp() siblings (path.XXXXXX) it is
+// written to before being renamed into place are excluded as well.
+static int add_generated_file_exclusion(FilterEngine *engine, const ResolvedConfig *config, const char *path,
+                                        bool temporaries)
 {
-    if (!engine || !config || !config->output_file || !config->input_directory)
+    if (!engine || !config || !path || !config->input_directory)
     {
         return 0;
     }
 
     // Get absolute paths
     char *abs_input = get_absolute_path_util(config->input_directory);
-    char *abs_output = get_absolute_path_util(config->output_file);
+    char *abs_output = get_absolute_path_util(path);
 
     if (!abs_input || !abs_output)
     {
@@ -214,66 +260,60 @@ static int add_output_file_exclusion(FilterEngine *engine, const ResolvedConfig
     }
 
     bool output_inside_input = (strncmp(abs_output, normalized_input, input_len) == 0);
+    int result = 0;
 
     if (output_inside_input)
     {
-        // Create exclusion context for output file
-        ExcludeContext *ctx = malloc(sizeof(ExcludeContext));
-        if (!ctx)
-        {
-            if (normalized_input != abs_input)
-                free(normalized_input);
-            free(abs_input);
-            free(abs_output);
-            return -1;
-        }
-
-        // Create patterns array (max 3 patterns)
-        ctx->patterns = malloc(3 * sizeof(char *));
-        if (!ctx->patterns)
+        // Absolute path, relative path and basename, each optionally with
+        // the temporary suffix
+        char *names[3] = {strdup(abs_output), get_relative_path_util(config->input_directory, path),
+                          strdup(get_filename_util(path))};
+        char *patterns[6];
+        int pattern_count = 0;
+
+        for (int i = 0; i < 3; i++)
         {
-            free(ctx);
-            if (normalized_input != abs_input)
-                free(normalized_input);
-            free(abs_input);
-            free(abs_output);
-            return -1;
-        }
-
-        ctx->pattern_count = 0;
-
-        // Add absolute path
-        ctx->patterns[ctx->pattern_count++] = strdup(abs_output);
-
-        // Add relative path
-        char *rel_path = get_relative_path_util(config->input_directory, config->output_file);
-        if (rel_path)
-        {
-            ctx->patterns[ctx->pattern_count++] = rel_path;
+            if (!names[i])
+                continue;
+            patterns[pattern_count++] = names[i];
+            if (temporaries)
+            {
+                size_t len = strlen(names[i]);
+                char *temporary = malloc(len + 8);
+                if (temporary)
+                {
+                    memcpy(temporary, names[i], len);
+                    memcpy(temporary + len, ".??????", 8);
+                    patterns[pattern_count++] = temporary;
+                }
+            }
         }
 
-        // Add basename
-        ctx->patterns[ctx->pattern_count++] = strdup(get_filename_util(config->output_file));
+        // Compile the patterns like any other exclude rule
+        PatternSet *set = pattern_count > 0 ? pattern_set_create(patterns, pattern_count) : NULL;
+        for (int i = 0; i < pattern_count; i++)
+            free(patterns[i]);
 
         // Create filter rule
         FilterRule rule = {
             .type = FILTER_TYPE_EXCLUDE,
             .priority = 200, // Higher priority than user patterns
-            .match_path = exclude_match_path,
+            .match_path = exclude_match_compiled,
             .match_content = NULL,
             .transform = NULL,
-            .destroy_context = destroy_exclude_context_wrapper,
-            .context = ctx};
+            .destroy_context = destroy_pattern_set_wrapper,
+            .context = set,
+            .path_type_only = true};
 
-        if (filter_engine_add_rule_internal(engine, &rule) != 0)
+        if (!set)
         {
-            // Clean up ctx on failure - it wasn't added to the engine
-            destroy_exclude_context_wrapper(ctx);
-            if (normalized_input != abs_input)
-                free(normalized_input);
-            free(abs_input);
-            free(abs_output);
-            return -1;
+            result = -1;
+        }
+        else if (filter_engine_add_rule_internal(engine, &rule) != 0)
+        {
+            // Clean up set on failure - it wasn't added to the engine
+            pattern_set_destroy(set);
+            result = -1;
         }
     }
 
@@ -281,7 +321,7 @@ static int add_output_file_exclusion(FilterEngine *engine, const ResolvedConfig
         free(normalized_input);
     free(abs_input);
     free(abs_output);
-    return 0;
+    return result;
 }
 
 int filter_engine_configure(FilterEngine *engine, const ResolvedConfig *config)
@@ -291,19 +331,101 @@ int filter_engine_configure(FilterEngine *engine, const ResolvedConfig *config)
 
     pthread_mutex_lock(&engine->mutex);
 
+    if (filter_engine_is_sealed(engine))
+    {
+        pthread_mutex_unlock(&engine->mutex);
+        return -1;
+    }
+
     engine->config = config;
 
-    // SUPER IMPORTANT: Prevents endless loop if src and dst are the same
-    add_output_file_exclusion(engine, config);
+    // SUPER IMPORTANT: Prevents endless loop if src and dst are the same.
+    // Incremental runs write both files to temporaries first.
+    bool incremental = config->incremental_cache != NULL;
+    add_generated_file_exclusion(engine, config, config->output_file, incremental);
+    add_generated_file_exclusion(engine, config, config->incremental_cache, true);
 
     // Initialize built-in filters
     filter_include_patterns_init_internal(engine, config); 
     filter_exclude_patterns_init_internal(engine, config);
     filter_binary_detection_init_internal(engine, config);
     filter_symlink_handling_init_internal(engine, config);
+    int result = filter_sample_rules_init_internal(engine, config);
 
     pthread_mutex_unlock(&engine->mutex);
 
+    return result;
+}
+
+static void filter_engine_count_plugin_stages(FilterEngine *engine)
+{
+    engine->stages.content_plugin_count = 0;
+    engine->stages.transform_plugin_count = 0;
+    engine->stages.path_plugin_count = 0;
+
+    engine->stages.batch_plugin_count = 0;
+
+    for (int i = 0; i < engine->plugin_count; i++)
+    {
+        FilterPlugin *plugin = engine->plugins[i];
+        // A batched plugin's per-chunk callbacks are never called
+        if (engine->batch_plugins[i])
+            engine->stages.batch_plugin_count++;
+        else if (plugin && plugin->should_include_content)
+            engine->stages.content_plugin_count++;
+        if (!engine->batch_plugins[i] && plugin && plugin->transform_content)
+            engine->stages.transform_plugin_count++;
+        if (plugin && plugin->should_include_path)
+            engine->stages.path_plugin_count++;
+    }
+}
+
+// Recompute which rules take part in each stage; called with the mutex held
+static int filter_engine_rebuild_stages(FilterEngine *engine)
+{
+    size_t slots = engine->rule_count > 0 ? (size_t)engine->rule_count : 1;
+    int *content_rules = malloc(slots * sizeof(int));
+    int *chunk_transforms = malloc(slots * sizeof(int));
+    int *file_rules = malloc(slots * sizeof(int));
+    if (!content_rules || !chunk_transforms || !file_rules)
+    {
+        free(content_rules);
+        free(chunk_transforms);
+        free(file_rules);
+        return -1;
+    }
+
+    FilterStages *stages = &engine->stages;
+    free(stages->content_rules);
+    free(stages->chunk_transforms);
+    free(stages->file_rules);
+    stages->content_rules = content_rules;
+    stages->chunk_transforms = chunk_transforms;
+    stages->file_rules = file_rules;
+    stages->content_rule_count = 0;
+    stages->chunk_transform_count = 0;
+    stages->file_rule_count = 0;
+    stages->stat_path_rule_count = 0;
+
+    for (int i = 0; i < engine->rule_count; i++)
+    {
+        FilterRule *rule = &engine->rules[i];
+
+        if (rule->match_content)
+            stages->content_rules[stages->content_rule_count++] = i;
+
+        // File-level transforms are applied by filter_engine_replace_file
+        if (rule->type == FILTER_TYPE_TRANSFORM && rule->transform && !rule->match_file)
+            stages->chunk_transforms[stages->chunk_transform_count++] = i;
+
+        if (rule->match_file)
+            stages->file_rules[stages->file_rule_count++] = i;
+
+        if (rule->match_path && !rule->path_type_only &&
+            (rule->type == FILTER_TYPE_INCLUDE || rule->type == FILTER_TYPE_EXCLUDE))
+            stages->stat_path_rule_count++;
+    }
+
     return 0;
 }
 
@@ -314,16 +436,39 @@ int filter_engine_register_plugin(FilterEngine *engine, FilterPlugin *plugin)
 
     pthread_mutex_lock(&engine->mutex);
 
+    if (filter_engine_is_sealed(engine) || engine->plugin_count >= MAX_PLUGINS)
+    {
+        pthread_mutex_unlock(&engine->mutex);
+        return -1;
+    }
+
     engine->plugins[engine->plugin_count] = plugin;
+    engine->batch_plugins[engine->plugin_count] = NULL;
     engine->plugin_count++;
+    filter_engine_count_plugin_stages(engine);
 
     pthread_mutex_unlock(&engine->mutex);
     return 0;
 }
 
+int filter_engine_register_plugin_v2(FilterEngine *engine, const FilterPluginV2 *plugin)
+{
+    if (!plugin || filter_engine_register_plugin(engine, (FilterPlugin *)&plugin->base) != 0)
+        return -1;
+
+    if ((plugin->capabilities & FILTER_CAP_BATCH_CHUNKS) && plugin->filter_chunks)
+    {
+        pthread_mutex_lock(&engine->mutex);
+        engine->batch_plugins[engine->plugin_count - 1] = plugin;
+        filter_engine_count_plugin_stages(engine);
+        pthread_mutex_unlock(&engine->mutex);
+    }
+    return 0;
+}
+
 int filter_engine_add_rule_internal(FilterEngine *engine, const FilterRule *rule)
 {
-    if (!engine || !rule)
+    if (!engine || !rule || filter_engine_is_sealed(engine))
         return -1;
 
     if (engine->rule_count >= engine->rule_capacity)
@@ -342,6 +487,12 @@ int filter_engine_add_rule_internal(FilterEngine *engine, const FilterRule *rule
     engine->rules[engine->rule_count] = *rule;
     engine->rule_count++;
 
+    if (filter_engine_rebuild_stages(engine) != 0)
+    {
+        engine->rule_count--;
+        return -1;
+    }
+
     return 0;
 }
 
@@ -359,13 +510,43 @@ int filter_engine_add_rule(FilterEngine *engine, FilterRule *rule)
     return result;
 }
 
-int filter_engine_should_include_path(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info)
+int filter_engine_seal(FilterEngine *engine)
 {
-    if (!engine || !path)
-        return 1;
+    if (!engine)
+        return -1;
 
+    // Taking the mutex orders the seal after any in-flight configuration;
+    // the release store publishes the final rule set to lock-free readers
     pthread_mutex_lock(&engine->mutex);
+    atomic_store_explicit(&engine->sealed, true, memory_order_release);
+    pthread_mutex_unlock(&engine->mutex);
+
+    return 0;
+}
+
+bool filter_engine_is_sealed(const FilterEngine *engine)
+{
+    return engine && atomic_load_explicit(&engine->sealed, memory_order_acquire);
+}
 
+// Evaluation only needs the mutex while the rule set can still change
+static bool filter_engine_read_lock(FilterEngine *engine)
+{
+    if (filter_engine_is_sealed(engine))
+        return false;
+
+    pthread_mutex_lock(&engine->mutex);
+    return true;
+}
+
+static void filter_engine_read_unlock(FilterEngine *engine, bool locked)
+{
+    if (locked)
+        pthread_mutex_unlock(&engine->mutex);
+}
+
+static int filter_engine_should_include_path_internal(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info)
+{
     // Check include rules first - if any include patterns are specified,
     // the file must match at least one include pattern
     bool has_include_rules = false;
@@ -390,7 +571,6 @@ int filter_engine_should_include_path(FilterEngine *engine, FconcatContext *ctx,
     // If there are include rules but this path doesn't match any, exclude it
     if (has_include_rules && !matches_include)
     {
-        pthread_mutex_unlock(&engine->mutex);
         return 0;
     }
 
@@ -404,7 +584,6 @@ int filter_engine_should_include_path(FilterEngine *engine, FconcatContext *ctx,
             int result = rule->match_path(path, info, rule->context);
             if (result)
             {
-                pthread_mutex_unlock(&engine->mutex);
                 return 0; // Exclude this path
             }
         }
@@ -419,134 +598,497 @@ int filter_engine_should_include_path(FilterEngine *engine, FconcatContext *ctx,
             int result = plugin->should_include_path(ctx, path, info);
             if (!result)
             {
-                pthread_mutex_unlock(&engine->mutex);
                 return 0; // Plugin excluded this path
             }
         }
     }
 
-    pthread_mutex_unlock(&engine->mutex);
     return 1; // Include by default
 }
 
-int filter_engine_should_include_content(FilterEngine *engine, FconcatContext *ctx, const char *path, const char *content, size_t size)
+static int filter_engine_should_include_content_internal(FilterEngine *engine, FconcatContext *ctx, const char *path, const char *content, size_t size)
 {
-    if (!engine || !path || !content)
-        return 1;
-
-    pthread_mutex_lock(&engine->mutex);
-
     // Check rules
-    for (int i = 0; i < engine->rule_count; i++)
+    for (int i = 0; i < engine->stages.content_rule_count; i++)
     {
-        FilterRule *rule = &engine->rules[i];
+        FilterRule *rule = &engine->rules[engine->stages.content_rules[i]];
+        int result = rule->match_content(path, content, size, rule->context);
 
-        if (rule->match_content)
+        if (rule->type == FILTER_TYPE_EXCLUDE && result)
         {
-            int result = rule->match_content(path, content, size, rule->context);
-
-            if (rule->type == FILTER_TYPE_EXCLUDE && result)
-            {
-                pthread_mutex_unlock(&engine->mutex);
-                return 0; // Exclude this content
-            }
-            else if (rule->type == FILTER_TYPE_INCLUDE && !result)
-            {
-                pthread_mutex_unlock(&engine->mutex);
-                return 0; // Don't include this content
-            }
+            return 0; // Exclude this content
+        }
+        else if (rule->type == FILTER_TYPE_INCLUDE && !result)
+        {
+            return 0; // Don't include this content
         }
     }
 
     // Check plugins
-    for (int i = 0; i < engine->plugin_count; i++)
+    for (int i = 0; engine->stages.content_plugin_count > 0 && i < engine->plugin_count; i++)
     {
         FilterPlugin *plugin = engine->plugins[i];
-        if (plugin && plugin->should_include_content)
+        if (plugin && !engine->batch_plugins[i] && plugin->should_include_content)
         {
             int result = plugin->should_include_content(ctx, path, content, size);
             if (!result)
             {
-                pthread_mutex_unlock(&engine->mutex);
                 return 0; // Plugin excluded this content
             }
         }
     }
 
-    pthread_mutex_unlock(&engine->mutex);
     return 1; // Include by default
 }
 
-int filter_engine_transform_content(FilterEngine *engine, FconcatContext *ctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size)
+// A NULL plan applies every chunk transform, as filter_engine_transform_content always has
+static bool plan_applies(const FilterFilePlan *plan, int stage_index)
 {
-    if (!engine || !path || !input || !output || !output_size)
-        return -1;
+    if (!plan || stage_index >= FILTER_PLAN_MAX_TRANSFORMS)
+        return true;
+    return (plan->transforms >> stage_index) & 1u;
+}
 
-    pthread_mutex_lock(&engine->mutex);
+// Where one chunk of a batch stands between stages
+typedef struct
+{
+    const char *data;      // Contiguous form, NULL until a stage needs one
+    size_t size;
+    char *owned;           // Latest buffer a stage produced, or the gathered segments
+    FilterSegment segment; // data as the single segment handed to batched plugins
+    bool excluded;
+} ChunkState;
+
+// Contiguous bytes of a chunk; its segments are gathered on first use
+static const char *chunk_data(FconcatContext *ctx, const FilterChunk *chunk, ChunkState *state)
+{
+    if (state->data)
+        return state->data;
 
-    // Get internal state to access memory manager
-    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (chunk->segment_count <= 1)
+    {
+        state->data = chunk->segment_count ? chunk->segments[0].data : "";
+        state->size = chunk->segment_count ? chunk->segments[0].size : 0;
+        return state->data;
+    }
 
-    // Start with input data - use buffer pool
-    char *current_data = memory_get_buffer(internal->memory_manager, input_size);
-    if (!current_data)
+    size_t total = 0;
+    for (size_t i = 0; i < chunk->segment_count; i++)
+        total += chunk->segments[i].size;
+    char *gathered = context_arena_alloc(ctx, total ? total : 1);
+    if (!gathered)
+        return NULL;
+    size_t used = 0;
+    for (size_t i = 0; i < chunk->segment_count; i++)
     {
-        pthread_mutex_unlock(&engine->mutex);
-        return -1;
+        memcpy(gathered + used, chunk->segments[i].data, chunk->segments[i].size);
+        used += chunk->segments[i].size;
     }
-    memcpy(current_data, input, input_size);
-    size_t current_size = input_size;
+    state->owned = gathered;
+    state->data = gathered;
+    state->size = used;
+    return gathered;
+}
 
-    // Apply transform rules
-    for (int i = 0; i < engine->rule_count; i++)
+static void chunk_replace(FconcatContext *ctx, ChunkState *state, char *data, size_t size)
+{
+    // Arena memory stays put until the caller rewinds
+    if (state->owned)
+        context_scratch_release(ctx, state->owned);
+    state->owned = data;
+    state->data = data;
+    state->size = size;
+}
+
+static int apply_rule_transforms(FilterEngine *engine, FconcatContext *ctx, const FilterFilePlan *plan,
+                                 const FilterChunk *chunk, ChunkState *state)
+{
+    for (int i = 0; i < engine->stages.chunk_transform_count; i++)
     {
-        FilterRule *rule = &engine->rules[i];
+        if (!plan_applies(plan, i))
+            continue;
 
-        if (rule->type == FILTER_TYPE_TRANSFORM && rule->transform)
-        {
-            char *transformed_data = NULL;
-            size_t transformed_size = 0;
+        const char *data = chunk_data(ctx, chunk, state);
+        if (!data)
+            return -1;
 
-            int result = rule->transform(path, current_data, current_size, &transformed_data, &transformed_size, rule->context);
+        FilterRule *rule = &engine->rules[engine->stages.chunk_transforms[i]];
+        char *transformed_data = NULL;
+        size_t transformed_size = 0;
+        int result = rule->transform(ctx, chunk->path, data, state->size, &transformed_data, &transformed_size,
+                                     rule->context);
+        if (result == 0 && transformed_data)
+            chunk_replace(ctx, state, transformed_data, transformed_size);
+    }
+    return 0;
+}
 
-            if (result == 0 && transformed_data)
-            {
-                // Release old buffer back to pool
-                memory_release_buffer(internal->memory_manager, current_data);
+// The adapter for plugins without filter_chunks: one call per chunk
+static int apply_plugin_transform(FilterPlugin *plugin, FconcatContext *ctx, const FilterChunk *chunk,
+                                  ChunkState *state)
+{
+    const char *data = chunk_data(ctx, chunk, state);
+    if (!data)
+        return -1;
+
+    char *transformed_data = NULL;
+    size_t transformed_size = 0;
+    int result = plugin->transform_content(ctx, chunk->path, data, state->size, &transformed_data, &transformed_size);
+    if (result == 0 && transformed_data)
+        chunk_replace(ctx, state, transformed_data, transformed_size);
+    return 0;
+}
 
-                // Use transformed data (might be from malloc or pool)
-                current_data = transformed_data;
-                current_size = transformed_size;
+// One call for every chunk still in the batch
+static void apply_batched_plugin(const FilterPluginV2 *plugin, FconcatContext *ctx, const FilterChunk *chunks,
+                                 ChunkState *states, size_t count, bool honour_exclude)
+{
+    FilterChunk views[FILTER_BATCH_MAX];
+    size_t index[FILTER_BATCH_MAX];
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        ChunkState *state = &states[i];
+        if (state->excluded)
+            continue;
+
+        FilterChunk *view = &views[n];
+        *view = chunks[i];
+        // Untouched chunks go as they came, still scattered
+        if (state->data)
+        {
+            state->segment = (FilterSegment){state->data, state->size};
+            view->segments = &state->segment;
+            view->segment_count = 1;
+            view->size = state->size;
+        }
+        view->exclude = false;
+        view->output = NULL;
+        view->output_size = 0;
+        index[n++] = i;
+    }
+    if (n == 0)
+        return;
+
+    int result = plugin->filter_chunks(ctx, views, n);
+    for (size_t j = 0; j < n; j++)
+    {
+        ChunkState *state = &states[index[j]];
+        if (result != 0 || (views[j].exclude && honour_exclude))
+        {
+            context_scratch_release(ctx, views[j].output);
+            if (result == 0)
+            {
+                context_scratch_release(ctx, state->owned);
+                state->owned = NULL;
+                state->excluded = true;
             }
+            continue;
         }
+        if (views[j].output)
+            chunk_replace(ctx, state, views[j].output, views[j].output_size);
     }
+}
 
-    // Apply plugin transformations
-    for (int i = 0; i < engine->plugin_count; i++)
+// Up to FILTER_BATCH_MAX chunks through the requested stages, stage by stage
+static int filter_engine_filter_batch_internal(FilterEngine *engine, FconcatContext *ctx, const FilterFilePlan *plan,
+                                               bool inspect, bool transform, bool honour_exclude,
+                                               FilterChunk *chunks, size_t count)
+{
+    ChunkState states[FILTER_BATCH_MAX];
+    memset(states, 0, count * sizeof(ChunkState));
+    const FilterStages *stages = &engine->stages;
+    int result = 0;
+
+    if (inspect && (stages->content_rule_count > 0 || stages->content_plugin_count > 0))
     {
-        FilterPlugin *plugin = engine->plugins[i];
-        if (plugin && plugin->transform_content)
+        for (size_t i = 0; i < count && result == 0; i++)
         {
-            char *transformed_data = NULL;
-            size_t transformed_size = 0;
+            const char *data = chunk_data(ctx, &chunks[i], &states[i]);
+            if (!data)
+                result = -1;
+            else if (!filter_engine_should_include_content_internal(engine, ctx, chunks[i].path, data, states[i].size))
+                states[i].excluded = true;
+        }
+    }
 
-            int result = plugin->transform_content(ctx, path, current_data, current_size, &transformed_data, &transformed_size);
+    if (transform)
+    {
+        for (size_t i = 0; i < count && result == 0; i++)
+        {
+            if (!states[i].excluded)
+                result = apply_rule_transforms(engine, ctx, plan, &chunks[i], &states[i]);
+        }
 
-            if (result == 0 && transformed_data)
+        bool plugins = stages->transform_plugin_count > 0 || stages->batch_plugin_count > 0;
+        for (int p = 0; plugins && p < engine->plugin_count && result == 0; p++)
+        {
+            FilterPlugin *plugin = engine->plugins[p];
+            if (engine->batch_plugins[p])
             {
-                // Release old buffer back to pool
-                memory_release_buffer(internal->memory_manager, current_data);
-
-                // Use transformed data (might be from malloc or pool)
-                current_data = transformed_data;
-                current_size = transformed_size;
+                apply_batched_plugin(engine->batch_plugins[p], ctx, chunks, states, count, honour_exclude);
+                continue;
+            }
+            if (!plugin || !plugin->transform_content)
+                continue;
+            for (size_t i = 0; i < count && result == 0; i++)
+            {
+                if (!states[i].excluded)
+                    result = apply_plugin_transform(plugin, ctx, &chunks[i], &states[i]);
             }
         }
     }
 
-    *output = current_data;
-    *output_size = current_size;
+    for (size_t i = 0; i < count; i++)
+    {
+        FilterChunk *chunk = &chunks[i];
+        chunk->exclude = result == 0 && states[i].excluded;
+        chunk->output = NULL;
+        chunk->output_size = 0;
+        if (result == 0 && !states[i].excluded && states[i].owned)
+        {
+            chunk->output = states[i].owned;
+            chunk->output_size = states[i].size;
+        }
+        else
+            context_scratch_release(ctx, states[i].owned);
+    }
+    return result;
+}
+
+static int filter_engine_transform_content_internal(FilterEngine *engine, FconcatContext *ctx, const char *path, const FilterFilePlan *plan, const char *input, size_t input_size, char **output, size_t *output_size)
+{
+    FilterSegment segment = {input, input_size};
+    FilterChunk chunk = {0};
+    chunk.path = path;
+    chunk.segments = &segment;
+    chunk.segment_count = 1;
+    chunk.size = input_size;
+
+    if (filter_engine_filter_batch_internal(engine, ctx, plan, false, true, false, &chunk, 1) != 0)
+        return -1;
+    if (!chunk.output)
+        return 1; // Nothing changed the chunk
+
+    *output = chunk.output;
+    *output_size = chunk.output_size;
 
-    pthread_mutex_unlock(&engine->mutex);
     return 0;
-}
\ No newline at end of file
+}
+
+static int filter_engine_should_include_file_internal(FilterEngine *engine, const char *path, FileInfo *info)
+{
+    for (int i = 0; i < engine->stages.file_rule_count; i++)
+    {
+        FilterRule *rule = &engine->rules[engine->stages.file_rules[i]];
+        int result = rule->match_file(path, info, rule->context);
+
+        if (rule->type == FILTER_TYPE_EXCLUDE && result)
+            return 0; // Exclude this file
+        else if (rule->type == FILTER_TYPE_INCLUDE && !result)
+            return 0; // Don't include this file
+    }
+
+    return 1; // Include by default
+}
+
+static int filter_engine_replace_file_internal(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info, char **output, size_t *output_size)
+{
+    for (int i = 0; i < engine->stages.file_rule_count; i++)
+    {
+        FilterRule *rule = &engine->rules[engine->stages.file_rules[i]];
+
+        if (rule->type != FILTER_TYPE_TRANSFORM || !rule->transform)
+            continue;
+
+        if (!rule->match_file(path, info, rule->context))
+            continue;
+
+        // First matching rule wins; the input is irrelevant to a replacement
+        if (rule->transform(ctx, path, "", 0, output, output_size, rule->context) == 0 && *output)
+            return 0;
+    }
+
+    return 1; // Keep the original content
+}
+
+int filter_engine_should_include_path(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info)
+{
+    if (!engine || !path)
+        return 1;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_should_include_path_internal(engine, ctx, path, info);
+    filter_engine_read_unlock(engine, locked);
+    metrics_end(metrics, METRICS_PATH_FILTER, start, 0);
+
+    return result;
+}
+
+bool filter_engine_path_needs_stat(FilterEngine *engine)
+{
+    if (!engine)
+        return false;
+
+    bool locked = filter_engine_read_lock(engine);
+    bool needs_stat = engine->stages.stat_path_rule_count > 0 || engine->stages.path_plugin_count > 0;
+    filter_engine_read_unlock(engine, locked);
+
+    return needs_stat;
+}
+
+int filter_engine_should_include_content(FilterEngine *engine, FconcatContext *ctx, const char *path, const char *content, size_t size)
+{
+    if (!engine || !path || !content)
+        return 1;
+
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_should_include_content_internal(engine, ctx, path, content, size);
+    filter_engine_read_unlock(engine, locked);
+
+    return result;
+}
+
+int filter_engine_transform_content(FilterEngine *engine, FconcatContext *ctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size)
+{
+    if (!engine || !path || !input || !output || !output_size)
+        return -1;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_transform_content_internal(engine, ctx, path, NULL, input, input_size, output, output_size);
+    filter_engine_read_unlock(engine, locked);
+    metrics_end(metrics, METRICS_TRANSFORM, start, input_size);
+
+    return result;
+}
+
+static void filter_engine_plan_file_internal(FilterEngine *engine, const char *path, FileInfo *info, FilterFilePlan *plan)
+{
+    const FilterStages *stages = &engine->stages;
+
+    plan->inspect_content = stages->content_rule_count > 0 || stages->content_plugin_count > 0;
+    plan->transforms = 0;
+
+    for (int i = 0; i < stages->chunk_transform_count && i < FILTER_PLAN_MAX_TRANSFORMS; i++)
+    {
+        FilterRule *rule = &engine->rules[stages->chunk_transforms[i]];
+        if (!rule->match_path || rule->match_path(path, info, rule->context))
+            plan->transforms |= (uint64_t)1 << i;
+    }
+
+    plan->transform_content = plan->transforms != 0 ||
+                              stages->chunk_transform_count > FILTER_PLAN_MAX_TRANSFORMS ||
+                              stages->transform_plugin_count > 0 || stages->batch_plugin_count > 0;
+}
+
+void filter_engine_plan_file(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info, FilterFilePlan *plan)
+{
+    (void)ctx; // Reserved for plugin hooks
+    if (!plan)
+        return;
+
+    memset(plan, 0, sizeof(*plan));
+    if (!engine || !path)
+        return;
+
+    bool locked = filter_engine_read_lock(engine);
+    filter_engine_plan_file_internal(engine, path, info, plan);
+    filter_engine_read_unlock(engine, locked);
+}
+
+int filter_engine_transform_chunk(FilterEngine *engine, FconcatContext *ctx, const char *path, const FilterFilePlan *plan, const char *input, size_t input_size, char **output, size_t *output_size)
+{
+    if (!engine || !path || !plan || !input || !output || !output_size)
+        return -1;
+
+    if (!plan->transform_content)
+        return 1;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_transform_content_internal(engine, ctx, path, plan, input, input_size, output, output_size);
+    filter_engine_read_unlock(engine, locked);
+    metrics_end(metrics, METRICS_TRANSFORM, start, input_size);
+
+    return result;
+}
+
+int filter_engine_filter_chunks(FilterEngine *engine, FconcatContext *ctx, const FilterFilePlan *plan, FilterChunk *chunks, size_t count)
+{
+    if (!chunks)
+        return count ? -1 : 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        chunks[i].exclude = false;
+        chunks[i].output = NULL;
+        chunks[i].output_size = 0;
+    }
+    if (!engine || count == 0)
+        return 0;
+
+    // A NULL plan inspects and transforms everything
+    bool inspect = !plan || plan->inspect_content;
+    bool transform = !plan || plan->transform_content;
+    if (!inspect && !transform)
+        return 0;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i++)
+        bytes += chunks[i].size;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = transform ? metrics_begin(metrics) : 0;
+    bool locked = filter_engine_read_lock(engine);
+    int result = 0;
+    for (size_t done = 0; done < count && result == 0; done += FILTER_BATCH_MAX)
+    {
+        size_t batch = count - done < FILTER_BATCH_MAX ? count - done : FILTER_BATCH_MAX;
+        result = filter_engine_filter_batch_internal(engine, ctx, plan, inspect, transform, true, chunks + done, batch);
+    }
+    // All or nothing: earlier batches give their buffers back on failure
+    for (size_t i = 0; result != 0 && i < count; i++)
+    {
+        context_scratch_release(ctx, chunks[i].output);
+        chunks[i].output = NULL;
+        chunks[i].exclude = false;
+    }
+    filter_engine_read_unlock(engine, locked);
+    if (transform)
+        metrics_end(metrics, METRICS_TRANSFORM, start, bytes);
+
+    return result;
+}
+
+int filter_engine_should_include_file(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info)
+{
+    (void)ctx; // Reserved for plugin hooks
+    if (!engine || !path || !info)
+        return 1;
+
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_should_include_file_internal(engine, path, info);
+    filter_engine_read_unlock(engine, locked);
+
+    return result;
+}
+
+int filter_engine_replace_file(FilterEngine *engine, FconcatContext *ctx, const char *path, FileInfo *info, char **output, size_t *output_size)
+{
+    if (!engine || !path || !info || !output || !output_size)
+        return -1;
+
+    *output = NULL;
+    *output_size = 0;
+
+    bool locked = filter_engine_read_lock(engine);
+    int result = filter_engine_replace_file_internal(engine, ctx, path, info, output, output_size);
+    filter_engine_read_unlock(engine, locked);
+
+    return result;
+}
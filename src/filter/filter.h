@@ -4,6 +4,7 @@
 #include "../core/types.h"
 #include "../core/context.h"
 #include "../../include/fconcat_filter.h"
+#include <stdatomic.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -20,11 +21,55 @@ extern "C"
         int priority;
         int (*match_path)(const char *path, FileInfo *info, void *context);
         int (*match_content)(const char *path, const char *content, size_t size, void *context);
-        int (*transform)(const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context);
+        // Outputs come from context_arena_alloc(ctx, ...); ctx may be NULL
+        int (*transform)(struct FconcatContext *ctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context);
         void (*destroy_context)(void *context); 
         void *context;
+        // File-level verdict, evaluated once per file after its first chunk
+        // has been read and info->is_binary is known. TRANSFORM rules with
+        // match_file replace the whole file instead of each chunk.
+        int (*match_file)(const char *path, FileInfo *info, void *context);
+        // match_path reads nothing of info but is_directory and is_symlink,
+        // which the walk knows from the dirent before any stat
+        bool path_type_only;
     } FilterRule;
 
+    // Rule indices per evaluation stage, kept current as rules and plugins
+    // are added so the per-chunk paths only visit rules that take part
+    typedef struct
+    {
+        int *content_rules;         // Rules with match_content
+        int content_rule_count;
+        int *chunk_transforms;      // TRANSFORM rules applied to every chunk
+        int chunk_transform_count;
+        int *file_rules;            // Rules with match_file
+        int file_rule_count;
+        int content_plugin_count;   // Plugins with should_include_content
+        int transform_plugin_count; // Plugins with transform_content
+        int stat_path_rule_count;   // Include/exclude rules that read stat fields
+        int path_plugin_count;      // Plugins with should_include_path
+        int batch_plugin_count;     // v2 plugins with filter_chunks
+    } FilterStages;
+
+#define FILTER_PLAN_MAX_TRANSFORMS 64
+
+    // What the chunk stages have to do for one file, worked out once after
+    // its first chunk. Chunk transforms past FILTER_PLAN_MAX_TRANSFORMS
+    // are not tracked per file and apply to every file.
+    typedef struct
+    {
+        bool inspect_content;   // Content rules or plugins must see each chunk
+        bool transform_content; // At least one chunk transform applies
+        uint64_t transforms;    // Bit i set: stages.chunk_transforms[i] applies
+    } FilterFilePlan;
+
+    // A --sample rule with its pattern compiled
+    typedef struct
+    {
+        struct PatternSet *patterns; // NULL: every file
+        SamplePolicy policy;
+    } FilterSampleRule;
+
     // Filter engine
     typedef struct FilterEngine
     {
@@ -32,9 +77,14 @@ extern "C"
         int rule_count;
         int rule_capacity;
         FilterPlugin *plugins[MAX_PLUGINS];
+        const FilterPluginV2 *batch_plugins[MAX_PLUGINS]; // Per plugin: its batched interface, or NULL
         int plugin_count;
         const ResolvedConfig *config;
-        pthread_mutex_t mutex;
+        pthread_mutex_t mutex;        // Guards rules/plugins until the engine is sealed
+        atomic_bool sealed;           // Once set, rules are immutable and read lock-free
+        FilterStages stages;
+        FilterSampleRule *samples;
+        int sample_count;
     } FilterEngine;
 
     // Exclude pattern context (shared between filter modules)
@@ -56,10 +106,52 @@ extern "C"
     void filter_engine_destroy(FilterEngine *engine);
     int filter_engine_configure(FilterEngine *engine, const ResolvedConfig *config);
     int filter_engine_register_plugin(FilterEngine *engine, FilterPlugin *plugin);
+    // Register a v2 plugin; without FILTER_CAP_BATCH_CHUNKS it is treated as
+    // the v1 plugin in its base
+    int filter_engine_register_plugin_v2(FilterEngine *engine, const FilterPluginV2 *plugin);
     int filter_engine_add_rule(FilterEngine *engine, FilterRule *rule);
+
+    // Freeze the rule set. Evaluation after this point takes no locks and any
+    // further configure/add_rule/register_plugin call fails with -1.
+    int filter_engine_seal(FilterEngine *engine);
+    bool filter_engine_is_sealed(const FilterEngine *engine);
+
     int filter_engine_should_include_path(FilterEngine *engine, struct FconcatContext *ctx, const char *path, FileInfo *info);
+    // Whether the path verdict can depend on more than the path and the
+    // entry type, so the walk has to stat an entry before filtering it
+    bool filter_engine_path_needs_stat(FilterEngine *engine);
     int filter_engine_should_include_content(FilterEngine *engine, struct FconcatContext *ctx, const char *path, const char *content, size_t size);
+    // Apply every chunk transform regardless of path; returns 1 (no copy
+    // made) when none changed the input
     int filter_engine_transform_content(FilterEngine *engine, struct FconcatContext *ctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size);
+    int filter_engine_should_include_file(FilterEngine *engine, struct FconcatContext *ctx, const char *path, FileInfo *info);
+    // Returns 0 and a replacement for the whole file (release with
+    // context_scratch_release), 1 if no rule applies
+    int filter_engine_replace_file(FilterEngine *engine, struct FconcatContext *ctx, const char *path, FileInfo *info, char **output, size_t *output_size);
+
+    // Decide which chunk stages apply to a file. TRANSFORM rules with a
+    // match_path only apply to the paths it accepts.
+    void filter_engine_plan_file(FilterEngine *engine, struct FconcatContext *ctx, const char *path, FileInfo *info, FilterFilePlan *plan);
+    // Run the planned transforms over one chunk. Returns 0 with a new buffer
+    // (release with context_scratch_release), 1 if the chunk is unchanged and
+    // the input should be used as is, -1 on error.
+    int filter_engine_transform_chunk(FilterEngine *engine, struct FconcatContext *ctx, const char *path, const FilterFilePlan *plan, const char *input, size_t input_size, char **output, size_t *output_size);
+
+    // Every planned chunk stage over a batch of chunks sharing one plan (NULL
+    // runs every stage): content checks, then transforms,
+    // with each batched plugin called once per FILTER_BATCH_MAX chunks.
+    // Sets exclude, or output to a new buffer (release with
+    // context_scratch_release) when the chunk changed, on every chunk.
+    // A chunk gathered from several segments always gets an output. Returns
+    // 0, or -1 with no chunk changed when gathering runs out of memory.
+    // filter_engine_transform_chunk is the same without the content checks
+    // and without exclusions by batched plugins.
+#define FILTER_BATCH_MAX 16
+    int filter_engine_filter_chunks(FilterEngine *engine, struct FconcatContext *ctx, const FilterFilePlan *plan, FilterChunk *chunks, size_t count);
+
+    // Policy of the first --sample rule matching a file, or NULL when none
+    // does or the policy would keep all of it anyway
+    const SamplePolicy *filter_engine_sample_policy(const FilterEngine *engine, const char *path, const FileInfo *info);
 
     // Built-in filters
     int filter_exclude_patterns_init(FilterEngine *engine, const ResolvedConfig *config);
@@ -72,15 +164,24 @@ extern "C"
     int filter_include_patterns_init_internal(FilterEngine *engine, const ResolvedConfig *config); 
     int filter_binary_detection_init_internal(FilterEngine *engine, const ResolvedConfig *config);
     int filter_symlink_handling_init_internal(FilterEngine *engine, const ResolvedConfig *config);
+    int filter_sample_rules_init_internal(FilterEngine *engine, const ResolvedConfig *config);
+    void filter_sample_rules_destroy(FilterEngine *engine);
 
+    // Reference matchers: loop over ExcludeContext/IncludeContext patterns
     int exclude_match_path(const char *path, FileInfo *info, void *context);
     int include_match_path(const char *path, FileInfo *info, void *context); 
     void destroy_exclude_context_wrapper(void *context);
     void destroy_include_context_wrapper(void *context); 
+
+    // Compiled matchers used by the engine; context is a PatternSet
+    int exclude_match_compiled(const char *path, FileInfo *info, void *context);
+    int include_match_compiled(const char *path, FileInfo *info, void *context);
+    void destroy_pattern_set_wrapper(void *context);
     char *get_absolute_path_util(const char *path);
     char *get_relative_path_util(const char *base_dir, const char *target_path);
     const char *get_filename_util(const char *path);
     int filter_is_binary_file(const char *filepath);
+    int filter_detect_binary(const char *data, size_t size);
 
 #ifdef __cplusplus
 }
@@ -9,28 +9,18 @@ typedef struct
     BinaryHandling handling;
 } BinaryContext;
 
-static int binary_match_content(const char *path, const char *content, size_t size, void *context)
+// File-level check: the pipeline classifies each file once on its first chunk
+static int binary_match_file(const char *path, FileInfo *info, void *context)
 {
+    (void)path; // Mark as intentionally unused
     BinaryContext *ctx = (BinaryContext *)context;
-    if (!ctx || !content)
+    if (!ctx || !info)
         return 0;
 
-    (void)path; // Mark as intentionally unused
-
-    // Simple binary detection - look for null bytes in first BINARY_DETECTION_SAMPLE_SIZE bytes
-    size_t check_size = (size < BINARY_DETECTION_SAMPLE_SIZE) ? size : BINARY_DETECTION_SAMPLE_SIZE;
-    for (size_t i = 0; i < check_size; i++)
-    {
-        if (content[i] == '\0')
-        {
-            return 1; // Binary detected
-        }
-    }
-
-    return 0; // Not binary
+    return info->is_binary;
 }
 
-static int binary_transform(const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context)
+static int binary_transform(FconcatContext *fctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context)
 {
     BinaryContext *ctx = (BinaryContext *)context;
     if (!ctx || !input || !output || !output_size)
@@ -45,7 +35,7 @@ static int binary_transform(const char *path, const char *input, size_t input_si
         const char *placeholder = "// [Binary file content not displayed]\n";
         size_t placeholder_len = strlen(placeholder);
 
-        *output = malloc(placeholder_len);
+        *output = context_arena_alloc(fctx, placeholder_len);
         if (!*output)
             return -1;
 
@@ -84,10 +74,11 @@ int filter_binary_detection_init_internal(FilterEngine *engine, const ResolvedCo
             .type = FILTER_TYPE_EXCLUDE,
             .priority = 90,
             .match_path = NULL,
-            .match_content = binary_match_content,
+            .match_content = NULL,
             .transform = NULL,
             .destroy_context = destroy_binary_context,
-            .context = ctx};
+            .context = ctx,
+            .match_file = binary_match_file};
 
         int result = filter_engine_add_rule_internal(engine, &rule);
         return result;
@@ -99,10 +90,11 @@ int filter_binary_detection_init_internal(FilterEngine *engine, const ResolvedCo
             .type = FILTER_TYPE_TRANSFORM,
             .priority = 90,
             .match_path = NULL,
-            .match_content = binary_match_content,
+            .match_content = NULL,
             .transform = binary_transform,
             .destroy_context = destroy_binary_context,
-            .context = ctx};
+            .context = ctx,
+            .match_file = binary_match_file};
 
         int result = filter_engine_add_rule_internal(engine, &rule);
         return result;
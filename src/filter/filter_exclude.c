@@ -1,5 +1,6 @@
 #include "filter.h"
 #include "filter_utils.h"
+#include "filter_pattern.h"
 #include <stdlib.h>
 #include <string.h>
 #include <fnmatch.h>
@@ -52,6 +53,17 @@ int exclude_match_path(const char *path, FileInfo *info, void *context)
     return 0; // No match
 }
 
+// Compiled matcher used by the engine; same verdicts as exclude_match_path
+int exclude_match_compiled(const char *path, FileInfo *info, void *context)
+{
+    return pattern_set_match((const PatternSet *)context, path, info && info->is_directory);
+}
+
+void destroy_pattern_set_wrapper(void *context)
+{
+    pattern_set_destroy((PatternSet *)context);
+}
+
 // Create exclude context and add patterns
 static ExcludeContext *create_exclude_context(const ResolvedConfig *config)
 {
@@ -136,25 +148,31 @@ int filter_exclude_patterns_init_internal(FilterEngine *engine, const ResolvedCo
     if (config->exclude_count == 0)
         return 0; // No patterns to exclude
 
-    // Create exclude context
+    // Normalize the patterns, then compile them into a single matcher
     ExcludeContext *ctx = create_exclude_context(config);
     if (!ctx)
         return -1;
 
+    PatternSet *set = pattern_set_create(ctx->patterns, ctx->pattern_count);
+    destroy_exclude_context(ctx);
+    if (!set)
+        return -1;
+
     // Create filter rule
     FilterRule rule = {
         .type = FILTER_TYPE_EXCLUDE,
         .priority = 100,
-        .match_path = exclude_match_path,
+        .match_path = exclude_match_compiled,
         .match_content = NULL,
         .transform = NULL,
-        .destroy_context = destroy_exclude_context_wrapper,
-        .context = ctx};
+        .destroy_context = destroy_pattern_set_wrapper,
+        .context = set,
+        .path_type_only = true};
 
     int result = filter_engine_add_rule_internal(engine, &rule);
     if (result != 0)
     {
-        destroy_exclude_context(ctx);
+        pattern_set_destroy(set);
         return result;
     }
 
@@ -0,0 +1,459 @@
+/**
+ * @file filter_ignore.c
+ * @brief Hierarchical .gitignore / .ignore rules for --gitignore
+ *
+ * Each line becomes a rule once, when its directory is entered:
+ *   - literals ("build", "docs/out.pdf")  -> strcmp
+ *   - leading-star names ("*.o")          -> suffix compare
+ *   - everything else                     -> glob with git's "**"
+ *
+ * A rule without a slash (other than a trailing one) matches the entry's
+ * name at any depth below its directory; any other rule is anchored to
+ * its directory and matches the rest of the path. Matching is case
+ * sensitive, as git's is by default.
+ */
+#include "filter_ignore.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Ignore files larger than this are not read
+#define IGNORE_FILE_MAX_SIZE (16u << 20)
+
+typedef enum
+{
+    IGNORE_RULE_LITERAL,
+    IGNORE_RULE_SUFFIX, // "*<literal>", stored without the star
+    IGNORE_RULE_GLOB
+} IgnoreRuleKind;
+
+typedef struct
+{
+    const char *pattern; // Inside the layer's storage
+    size_t len;
+    IgnoreRuleKind kind;
+    bool negated;
+    bool directory_only;
+    bool anchored; // Matched against the path below the layer's directory
+} IgnoreRule;
+
+struct IgnoreLayer
+{
+    const IgnoreLayer *parent;
+    size_t prefix_len; // Bytes of a relative path taken by the directory and its '/'
+    IgnoreRule *rules;
+    size_t count;
+    char *storage;
+};
+
+static bool is_glob_special(char c)
+{
+    return c == '*' || c == '?' || c == '[' || c == '\\';
+}
+
+static bool has_glob_special(const char *str, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (is_glob_special(str[i]))
+            return true;
+    }
+    return false;
+}
+
+/* Parsing */
+
+// Compile one line in place; false when it holds no rule
+static bool parse_rule(char *line, size_t len, IgnoreRule *rule)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+    if (len == 0 || line[0] == '#')
+        return false;
+
+    // Trailing spaces go unless escaped with a backslash
+    while (len > 0 && line[len - 1] == ' ' && !(len >= 2 && line[len - 2] == '\\'))
+        len--;
+
+    memset(rule, 0, sizeof(*rule));
+    if (len > 0 && line[0] == '!')
+    {
+        rule->negated = true;
+        line++;
+        len--;
+    }
+    if (len > 0 && line[len - 1] == '/')
+    {
+        rule->directory_only = true;
+        len--;
+    }
+    if (memchr(line, '/', len))
+    {
+        rule->anchored = true;
+        if (line[0] == '/')
+        {
+            line++;
+            len--;
+        }
+    }
+    if (len == 0)
+        return false;
+    line[len] = '\0';
+
+    rule->pattern = line;
+    rule->len = len;
+    if (!has_glob_special(line, len))
+        rule->kind = IGNORE_RULE_LITERAL;
+    else if (line[0] == '*' && !rule->anchored && !has_glob_special(line + 1, len - 1))
+    {
+        rule->kind = IGNORE_RULE_SUFFIX;
+        rule->pattern = line + 1;
+        rule->len = len - 1;
+    }
+    else
+        rule->kind = IGNORE_RULE_GLOB;
+    return true;
+}
+
+int ignore_layer_create(const char *rules, size_t size, const char *directory, size_t directory_len,
+                        const IgnoreLayer *parent, IgnoreLayer **layer)
+{
+    if (!layer || (size > 0 && !rules) || (directory_len > 0 && !directory))
+        return -1;
+    *layer = NULL;
+
+    // The root layer starts with the rule that keeps the repository out
+    static const char builtin[] = ".git\n";
+    size_t builtin_len = parent ? 0 : sizeof(builtin) - 1;
+    size_t total = builtin_len + size;
+    if (total == 0)
+        return 0;
+
+    IgnoreLayer *created = calloc(1, sizeof(IgnoreLayer));
+    char *storage = malloc(total + 1);
+    size_t max_rules = 1;
+    for (size_t i = 0; i < size; i++)
+        max_rules += rules[i] == '\n';
+    IgnoreRule *compiled = malloc((max_rules + 1) * sizeof(IgnoreRule));
+    if (!created || !storage || !compiled)
+    {
+        free(created);
+        free(storage);
+        free(compiled);
+        return -1;
+    }
+
+    memcpy(storage, builtin, builtin_len);
+    if (size > 0)
+        memcpy(storage + builtin_len, rules, size);
+    storage[total] = '\0';
+
+    // Every line is NUL terminated where it ends, so patterns stay in place
+    size_t count = 0;
+    char *line = storage;
+    char *end = storage + total;
+    while (line < end)
+    {
+        char *newline = memchr(line, '\n', (size_t)(end - line));
+        size_t len = newline ? (size_t)(newline - line) : (size_t)(end - line);
+        if (parse_rule(line, len, &compiled[count]))
+            count++;
+        line += len + 1;
+    }
+
+    if (count == 0 && parent)
+    {
+        free(created);
+        free(storage);
+        free(compiled);
+        return 0;
+    }
+
+    created->parent = parent;
+    created->prefix_len = directory_len ? directory_len + 1 : 0;
+    created->rules = compiled;
+    created->count = count;
+    created->storage = storage;
+    *layer = created;
+    return 0;
+}
+
+// Whole file into *data (NULL when it does not exist)
+static int read_ignore_file(int dir_fd, const char *name, char **data, size_t *size)
+{
+    *data = NULL;
+    *size = 0;
+
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0)
+        return errno == ENOENT || errno == ELOOP || errno == ENOTDIR ? 0 : -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return -1;
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+    if ((uint64_t)st.st_size > IGNORE_FILE_MAX_SIZE)
+    {
+        close(fd);
+        errno = EFBIG;
+        return -1;
+    }
+
+    char *buffer = malloc((size_t)st.st_size);
+    size_t used = 0;
+    while (buffer && used < (size_t)st.st_size)
+    {
+        ssize_t n = read(fd, buffer + used, (size_t)st.st_size - used);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break; // Shrunk while reading: keep what is there
+        used += (size_t)n;
+    }
+    int saved_errno = errno;
+    close(fd);
+    if (!buffer)
+    {
+        errno = saved_errno;
+        return -1;
+    }
+
+    *data = buffer;
+    *size = used;
+    return 0;
+}
+
+int ignore_layer_load(int dir_fd, const char *directory, size_t directory_len, const IgnoreLayer *parent,
+                      IgnoreLayer **layer)
+{
+    if (!layer)
+        return -1;
+    *layer = NULL;
+
+    char *gitignore = NULL;
+    char *ignore = NULL;
+    size_t gitignore_size = 0;
+    size_t ignore_size = 0;
+    if (read_ignore_file(dir_fd, ".gitignore", &gitignore, &gitignore_size) != 0 ||
+        read_ignore_file(dir_fd, ".ignore", &ignore, &ignore_size) != 0)
+    {
+        int saved_errno = errno;
+        free(gitignore);
+        errno = saved_errno;
+        return -1;
+    }
+
+    // One layer for both files; a newline keeps their last and first lines apart
+    char *rules = gitignore;
+    size_t size = gitignore_size;
+    if (ignore)
+    {
+        rules = realloc(gitignore, gitignore_size + 1 + ignore_size);
+        if (!rules)
+        {
+            free(gitignore);
+            free(ignore);
+            errno = ENOMEM;
+            return -1;
+        }
+        rules[gitignore_size] = '\n';
+        memcpy(rules + gitignore_size + 1, ignore, ignore_size);
+        size = gitignore_size + 1 + ignore_size;
+        free(ignore);
+    }
+
+    int result = ignore_layer_create(rules, size, directory, directory_len, parent, layer);
+    free(rules);
+    if (result != 0)
+        errno = ENOMEM;
+    return result;
+}
+
+void ignore_layer_destroy(IgnoreLayer *layer)
+{
+    if (!layer)
+        return;
+    free(layer->rules);
+    free(layer->storage);
+    free(layer);
+}
+
+/* Matching */
+
+// Bracket expression at p (just past '['); 1 or 0 for c, -1 when malformed.
+// *end is set past the closing ']'.
+static int match_class(const char *p, char c, const char **end)
+{
+    bool negated = *p == '!' || *p == '^';
+    if (negated)
+        p++;
+
+    bool matched = false;
+    bool first = true;
+    while (*p && (*p != ']' || first))
+    {
+        char low = *p;
+        if (low == '\\' && p[1])
+            low = *++p;
+        p++;
+
+        char high = low;
+        if (*p == '-' && p[1] && p[1] != ']')
+        {
+            p++;
+            high = *p;
+            if (high == '\\' && p[1])
+                high = *++p;
+            p++;
+        }
+        if (c >= low && c <= high)
+            matched = true;
+        first = false;
+    }
+    if (*p != ']')
+        return -1;
+
+    *end = p + 1;
+    return matched != negated;
+}
+
+// fnmatch() with FNM_PATHNAME, plus "**" as a whole path segment matching
+// any number of directories
+static bool glob_match(const char *pattern, const char *p, const char *s)
+{
+    while (*p)
+    {
+        if (*p == '*')
+        {
+            if (p[1] == '*' && (p == pattern || p[-1] == '/') && (p[2] == '/' || p[2] == '\0'))
+            {
+                // "<dir>/**" takes everything inside; "**/" any leading directories
+                if (p[2] == '\0')
+                    return true;
+                for (const char *t = s;; t++)
+                {
+                    if ((t == s || t[-1] == '/') && glob_match(pattern, p + 3, t))
+                        return true;
+                    if (!*t)
+                        return false;
+                }
+            }
+
+            while (*p == '*')
+                p++;
+            for (const char *t = s;; t++)
+            {
+                if (glob_match(pattern, p, t))
+                    return true;
+                if (!*t || *t == '/')
+                    return false;
+            }
+        }
+
+        if (*p == '?')
+        {
+            if (!*s || *s == '/')
+                return false;
+            p++;
+            s++;
+            continue;
+        }
+
+        if (*p == '[')
+        {
+            const char *end = NULL;
+            int matched = match_class(p + 1, *s, &end);
+            if (matched >= 0)
+            {
+                if (!matched || !*s || *s == '/')
+                    return false;
+                p = end;
+                s++;
+                continue;
+            }
+            // Unterminated: the '[' is an ordinary character
+        }
+
+        if (*p == '\\' && p[1])
+            p++;
+        if (*p != *s)
+            return false;
+        p++;
+        s++;
+    }
+    return *s == '\0';
+}
+
+static bool rule_matches(const IgnoreRule *rule, const char *subject, size_t subject_len)
+{
+    switch (rule->kind)
+    {
+    case IGNORE_RULE_LITERAL:
+        return subject_len == rule->len && memcmp(subject, rule->pattern, rule->len) == 0;
+    case IGNORE_RULE_SUFFIX:
+        return subject_len >= rule->len &&
+               memcmp(subject + subject_len - rule->len, rule->pattern, rule->len) == 0;
+    case IGNORE_RULE_GLOB:
+    default:
+        return glob_match(rule->pattern, rule->pattern, subject);
+    }
+}
+
+bool ignore_layer_match(const IgnoreLayer *scope, const char *relative_path, bool is_directory)
+{
+    if (!relative_path)
+        return false;
+
+    size_t len = strlen(relative_path);
+    const char *slash = strrchr(relative_path, '/');
+    const char *name = slash ? slash + 1 : relative_path;
+    size_t name_len = len - (size_t)(name - relative_path);
+
+    for (const IgnoreLayer *layer = scope; layer; layer = layer->parent)
+    {
+        if (layer->prefix_len > len)
+            continue;
+        const char *below = relative_path + layer->prefix_len;
+        size_t below_len = len - layer->prefix_len;
+
+        // The last matching line of the deepest file decides
+        for (size_t i = layer->count; i > 0; i--)
+        {
+            const IgnoreRule *rule = &layer->rules[i - 1];
+            if (rule->directory_only && !is_directory)
+                continue;
+            bool matched = rule->anchored ? rule_matches(rule, below, below_len)
+                                          : rule_matches(rule, name, name_len);
+            if (matched)
+                return !rule->negated;
+        }
+    }
+    return false;
+}
+
+int ignore_entry_is_directory(unsigned char d_type)
+{
+    switch (d_type)
+    {
+    case DT_DIR:
+        return 1;
+    case DT_UNKNOWN:
+        return -1;
+    default:
+        return 0; // Git lists a symlink to a directory as a file
+    }
+}
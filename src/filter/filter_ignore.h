@@ -0,0 +1,81 @@
+/**
+ * @file filter_ignore.h
+ * @brief Hierarchical .gitignore / .ignore rules for --gitignore
+ *
+ * The walk loads the ignore files of each directory it enters into an
+ * IgnoreLayer chained to the layer of the directory above. An entry is
+ * checked against the chain from the deepest layer up, so only the rules
+ * in scope are looked at and they take precedence the way git gives them:
+ * a deeper file wins over a shallower one, a later line over an earlier.
+ * Ignored directories are never opened, so nothing below them is read and
+ * a negation cannot re-include a file whose directory is ignored.
+ */
+#ifndef FILTER_IGNORE_H
+#define FILTER_IGNORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct IgnoreLayer IgnoreLayer;
+
+/**
+ * @brief Compile ignore rules written in .gitignore syntax
+ *
+ * A layer without a parent is the root of the walk; it also ignores any
+ * ".git" entry, which git never lists either.
+ *
+ * @param rules Contents of one or more ignore files, NULL when there are none
+ * @param size Bytes in rules
+ * @param directory Relative path of the directory the rules belong to ("" for the root)
+ * @param directory_len Length of directory
+ * @param parent Layer in scope above it; must outlive the new layer
+ * @param layer Set to the new layer, or to NULL when a non-root directory has no rules
+ * @return 0 on success, -1 on allocation failure
+ */
+int ignore_layer_create(const char *rules, size_t size, const char *directory, size_t directory_len,
+                        const IgnoreLayer *parent, IgnoreLayer **layer);
+
+/**
+ * @brief Read .gitignore and then .ignore from an open directory
+ *
+ * Rules of .ignore come later, so they win over those of .gitignore.
+ *
+ * @param dir_fd Descriptor of the directory
+ * @return 0 on success (missing files are not an error), -1 with errno set
+ *         when a file exists but cannot be read
+ */
+int ignore_layer_load(int dir_fd, const char *directory, size_t directory_len, const IgnoreLayer *parent,
+                      IgnoreLayer **layer);
+
+/**
+ * @brief Free a layer (NULL is allowed); its parent is left alone
+ */
+void ignore_layer_destroy(IgnoreLayer *layer);
+
+/**
+ * @brief Whether the rules in scope ignore an entry
+ *
+ * @param scope Deepest layer covering the entry's directory, or NULL
+ * @param relative_path Path of the entry below the walk root
+ * @param is_directory The entry is a directory (symlinks never are)
+ * @return true if the entry is ignored
+ */
+bool ignore_layer_match(const IgnoreLayer *scope, const char *relative_path, bool is_directory);
+
+/**
+ * @brief Whether a readdir type is a directory for matching purposes
+ *
+ * @return 1 for a directory, 0 for anything else, -1 when d_type is unknown
+ *         and the entry has to be stat'd first
+ */
+int ignore_entry_is_directory(unsigned char d_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILTER_IGNORE_H */
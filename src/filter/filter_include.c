@@ -1,5 +1,6 @@
 #include "filter.h"
 #include "filter_utils.h"
+#include "filter_pattern.h"
 #include <stdlib.h>
 #include <string.h>
 #include <fnmatch.h>
@@ -65,6 +66,24 @@ int include_match_path(const char *path, FileInfo *info, void *context)
     return 0; // No match
 }
 
+// Compiled matcher used by the engine; same verdicts as include_match_path
+int include_match_compiled(const char *path, FileInfo *info, void *context)
+{
+    const PatternSet *set = (const PatternSet *)context;
+    if (!set || !path)
+        return 0;
+
+    // Directories are always traversed, matching include_match_path
+    if (info && info->is_directory)
+        return 1;
+
+    if (pattern_set_match(set, path, false))
+        return 1;
+
+    // For path-based patterns, also try with src/ prefix removed
+    return strncmp(path, "src/", 4) == 0 && pattern_set_match(set, path + 4, false);
+}
+
 // Create include context and add patterns
 static IncludeContext *create_include_context(const ResolvedConfig *config)
 {
@@ -147,25 +166,31 @@ int filter_include_patterns_init_internal(FilterEngine *engine, const ResolvedCo
         return 0; // No patterns to include
     }
 
-    // Create include context
+    // Normalize the patterns, then compile them into a single matcher
     IncludeContext *ctx = create_include_context(config);
     if (!ctx)
         return -1;
 
+    PatternSet *set = pattern_set_create(ctx->patterns, ctx->pattern_count);
+    destroy_include_context(ctx);
+    if (!set)
+        return -1;
+
     // Create filter rule with high priority so it runs first
     FilterRule rule = {
         .type = FILTER_TYPE_INCLUDE,
         .priority = 50,  // Higher priority than exclude patterns
-        .match_path = include_match_path,
+        .match_path = include_match_compiled,
         .match_content = NULL,
         .transform = NULL,
-        .destroy_context = destroy_include_context_wrapper,
-        .context = ctx};
+        .destroy_context = destroy_pattern_set_wrapper,
+        .context = set,
+        .path_type_only = true};
 
     int result = filter_engine_add_rule_internal(engine, &rule);
     if (result != 0)
     {
-        destroy_include_context(ctx);
+        pattern_set_destroy(set);
         return result;
     }
 
@@ -0,0 +1,537 @@
+/**
+ * @file filter_pattern.c
+ * @brief Compiled include/exclude pattern matcher
+ *
+ * Patterns are split by shape when the set is built:
+ *   - literals ("node_modules", "src/main.c")   -> hash set
+ *   - extensions ("*.log")                      -> hash set keyed by extension
+ *   - other leading-star globs ("*_test.go")    -> trie over reversed suffixes
+ *   - trailing-star globs ("build*")            -> trie over prefixes
+ *   - everything else                           -> fnmatch() per pattern
+ *
+ * The legacy matcher tried fnmatch() case-sensitively and then with
+ * FNM_CASEFOLD, so a match is effectively case-insensitive; the fast
+ * classes fold ASCII case on both sides. Patterns with non-ASCII bytes go
+ * to the fallback list so locale-dependent folding stays exactly as before.
+ */
+#include "filter_pattern.h"
+#include "filter_utils.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+// The legacy directory check built "<pattern>/*" in a 1024 byte buffer and
+// silently skipped longer patterns; keep those on the fallback path
+#define PATTERN_DIR_BUFFER_SIZE 1024
+#define STRING_SET_INITIAL_CAPACITY 16
+
+typedef struct
+{
+    char *key; // Lowercased, NULL marks an empty slot
+    size_t len;
+    uint64_t hash;
+} StringSetSlot;
+
+typedef struct
+{
+    StringSetSlot *slots;
+    size_t capacity; // Power of two
+    size_t count;
+} StringSet;
+
+typedef struct
+{
+    int first_child;
+    int next_sibling;
+    unsigned char ch;
+    bool terminal;
+} TrieNode;
+
+typedef struct
+{
+    TrieNode *nodes; // nodes[0] is the root
+    size_t count;
+    size_t capacity;
+} Trie;
+
+typedef struct
+{
+    char *pattern;
+    char *dir_pattern; // "<pattern>/*", NULL if it would not have fit
+} FallbackPattern;
+
+struct PatternSet
+{
+    StringSet literals;
+    StringSet extensions;
+    Trie suffixes;
+    Trie prefixes;
+    FallbackPattern *fallbacks;
+    size_t fallback_count;
+    PatternSetStats stats;
+};
+
+static inline unsigned char fold_ascii(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c + ('a' - 'A')) : c;
+}
+
+static uint64_t hash_folded(const char *str, size_t len)
+{
+    uint64_t hash = 14695981039346656037ULL; // FNV-1a
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= fold_ascii((unsigned char)str[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static bool is_glob_special(char c)
+{
+    return c == '*' || c == '?' || c == '[' || c == '\\';
+}
+
+static bool has_glob_special(const char *str, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        if (is_glob_special(str[i]))
+            return true;
+    }
+    return false;
+}
+
+static bool is_ascii(const char *str)
+{
+    for (; *str; str++)
+    {
+        if ((unsigned char)*str >= 0x80)
+            return false;
+    }
+    return true;
+}
+
+static int fold_match(const char *pattern, const char *string)
+{
+#ifdef FNM_CASEFOLD
+    // A case-sensitive match is always a case-folded match, so one call does
+    return fnmatch(pattern, string, FNM_CASEFOLD) == 0;
+#else
+    return filter_match_pattern(pattern, string);
+#endif
+}
+
+/* String set */
+
+static int string_set_init(StringSet *set)
+{
+    set->slots = calloc(STRING_SET_INITIAL_CAPACITY, sizeof(StringSetSlot));
+    if (!set->slots)
+        return -1;
+    set->capacity = STRING_SET_INITIAL_CAPACITY;
+    set->count = 0;
+    return 0;
+}
+
+static void string_set_free(StringSet *set)
+{
+    for (size_t i = 0; i < set->capacity; i++)
+        free(set->slots[i].key);
+    free(set->slots);
+    set->slots = NULL;
+    set->capacity = 0;
+    set->count = 0;
+}
+
+static bool string_set_contains(const StringSet *set, const char *str, size_t len)
+{
+    if (set->count == 0)
+        return false;
+
+    uint64_t hash = hash_folded(str, len);
+    size_t mask = set->capacity - 1;
+
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        const StringSetSlot *slot = &set->slots[i];
+        if (!slot->key)
+            return false;
+        if (slot->hash != hash || slot->len != len)
+            continue;
+
+        size_t j = 0;
+        while (j < len && (unsigned char)slot->key[j] == fold_ascii((unsigned char)str[j]))
+            j++;
+        if (j == len)
+            return true;
+    }
+}
+
+static int string_set_grow(StringSet *set)
+{
+    size_t new_capacity = set->capacity * 2;
+    StringSetSlot *new_slots = calloc(new_capacity, sizeof(StringSetSlot));
+    if (!new_slots)
+        return -1;
+
+    size_t mask = new_capacity - 1;
+    for (size_t i = 0; i < set->capacity; i++)
+    {
+        StringSetSlot *slot = &set->slots[i];
+        if (!slot->key)
+            continue;
+
+        size_t j = slot->hash & mask;
+        while (new_slots[j].key)
+            j = (j + 1) & mask;
+        new_slots[j] = *slot;
+    }
+
+    free(set->slots);
+    set->slots = new_slots;
+    set->capacity = new_capacity;
+    return 0;
+}
+
+static int string_set_add(StringSet *set, const char *str, size_t len)
+{
+    if (string_set_contains(set, str, len))
+        return 0;
+
+    // Keep the load factor at or below one half
+    if ((set->count + 1) * 2 > set->capacity && string_set_grow(set) != 0)
+        return -1;
+
+    char *key = malloc(len + 1);
+    if (!key)
+        return -1;
+    for (size_t i = 0; i < len; i++)
+        key[i] = (char)fold_ascii((unsigned char)str[i]);
+    key[len] = '\0';
+
+    uint64_t hash = hash_folded(str, len);
+    size_t mask = set->capacity - 1;
+    size_t i = hash & mask;
+    while (set->slots[i].key)
+        i = (i + 1) & mask;
+
+    set->slots[i].key = key;
+    set->slots[i].len = len;
+    set->slots[i].hash = hash;
+    set->count++;
+    return 0;
+}
+
+/* Trie */
+
+static int trie_new_node(Trie *trie, unsigned char ch)
+{
+    if (trie->count >= trie->capacity)
+    {
+        size_t new_capacity = trie->capacity ? trie->capacity * 2 : 64;
+        TrieNode *new_nodes = realloc(trie->nodes, new_capacity * sizeof(TrieNode));
+        if (!new_nodes)
+            return -1;
+        trie->nodes = new_nodes;
+        trie->capacity = new_capacity;
+    }
+
+    TrieNode *node = &trie->nodes[trie->count];
+    node->first_child = -1;
+    node->next_sibling = -1;
+    node->ch = ch;
+    node->terminal = false;
+    return (int)trie->count++;
+}
+
+static int trie_init(Trie *trie)
+{
+    trie->nodes = NULL;
+    trie->count = 0;
+    trie->capacity = 0;
+    return trie_new_node(trie, 0) == 0 ? 0 : -1;
+}
+
+static void trie_free(Trie *trie)
+{
+    free(trie->nodes);
+    trie->nodes = NULL;
+    trie->count = 0;
+    trie->capacity = 0;
+}
+
+static int trie_find_child(const Trie *trie, int node, unsigned char ch)
+{
+    for (int child = trie->nodes[node].first_child; child >= 0; child = trie->nodes[child].next_sibling)
+    {
+        if (trie->nodes[child].ch == ch)
+            return child;
+    }
+    return -1;
+}
+
+// Insert str (folded), walking it backwards when reverse is set
+static int trie_insert(Trie *trie, const char *str, size_t len, bool reverse)
+{
+    int node = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned char ch = fold_ascii((unsigned char)str[reverse ? len - 1 - i : i]);
+        int child = trie_find_child(trie, node, ch);
+        if (child < 0)
+        {
+            child = trie_new_node(trie, ch);
+            if (child < 0)
+                return -1;
+            trie->nodes[child].next_sibling = trie->nodes[node].first_child;
+            trie->nodes[node].first_child = child;
+        }
+        node = child;
+    }
+    trie->nodes[node].terminal = true;
+    return 0;
+}
+
+// Does any inserted prefix start str[0..len)?
+static bool trie_match_prefix(const Trie *trie, const char *str, size_t len)
+{
+    if (trie->count <= 1)
+        return trie->count == 1 && trie->nodes[0].terminal;
+
+    int node = 0;
+    for (size_t i = 0;; i++)
+    {
+        if (trie->nodes[node].terminal)
+            return true;
+        if (i == len)
+            return false;
+        node = trie_find_child(trie, node, fold_ascii((unsigned char)str[i]));
+        if (node < 0)
+            return false;
+    }
+}
+
+// Does any inserted (reversed) suffix end str[0..len)?
+static bool trie_match_suffix(const Trie *trie, const char *str, size_t len)
+{
+    if (trie->count <= 1)
+        return trie->count == 1 && trie->nodes[0].terminal;
+
+    int node = 0;
+    for (size_t i = len;; i--)
+    {
+        if (trie->nodes[node].terminal)
+            return true;
+        if (i == 0)
+            return false;
+        node = trie_find_child(trie, node, fold_ascii((unsigned char)str[i - 1]));
+        if (node < 0)
+            return false;
+    }
+}
+
+/* Pattern set */
+
+static int pattern_set_add_fallback(PatternSet *set, const char *pattern, size_t len, size_t *fallback_capacity)
+{
+    if (set->fallback_count >= *fallback_capacity)
+    {
+        size_t new_capacity = *fallback_capacity ? *fallback_capacity * 2 : 8;
+        FallbackPattern *new_fallbacks = realloc(set->fallbacks, new_capacity * sizeof(FallbackPattern));
+        if (!new_fallbacks)
+            return -1;
+        set->fallbacks = new_fallbacks;
+        *fallback_capacity = new_capacity;
+    }
+
+    FallbackPattern *fallback = &set->fallbacks[set->fallback_count];
+    fallback->pattern = strdup(pattern);
+    fallback->dir_pattern = NULL;
+    if (!fallback->pattern)
+        return -1;
+
+    if (len + 2 < PATTERN_DIR_BUFFER_SIZE)
+    {
+        fallback->dir_pattern = malloc(len + 3);
+        if (!fallback->dir_pattern)
+        {
+            free(fallback->pattern);
+            return -1;
+        }
+        memcpy(fallback->dir_pattern, pattern, len);
+        memcpy(fallback->dir_pattern + len, "/*", 3);
+    }
+
+    set->fallback_count++;
+    set->stats.fallback_count++;
+    return 0;
+}
+
+static int pattern_set_add(PatternSet *set, const char *pattern, size_t *fallback_capacity)
+{
+    size_t len = strlen(pattern);
+    if (len == 0)
+        return 0; // Empty patterns never matched
+
+    if (len + 2 >= PATTERN_DIR_BUFFER_SIZE || !is_ascii(pattern))
+        return pattern_set_add_fallback(set, pattern, len, fallback_capacity);
+
+    if (!has_glob_special(pattern, len))
+    {
+        set->stats.literal_count++;
+        return string_set_add(&set->literals, pattern, len);
+    }
+
+    if (pattern[0] == '*' && !has_glob_special(pattern + 1, len - 1))
+    {
+        const char *suffix = pattern + 1;
+        size_t suffix_len = len - 1;
+
+        // "*.ext" with a dot-free extension is decided by the text after the
+        // last '.' of the path, which is a single hash lookup
+        if (suffix_len > 1 && suffix[0] == '.' && !memchr(suffix + 1, '.', suffix_len - 1))
+        {
+            set->stats.extension_count++;
+            return string_set_add(&set->extensions, suffix + 1, suffix_len - 1);
+        }
+
+        set->stats.suffix_count++;
+        return trie_insert(&set->suffixes, suffix, suffix_len, true);
+    }
+
+    if (pattern[len - 1] == '*' && !has_glob_special(pattern, len - 1))
+    {
+        set->stats.prefix_count++;
+        return trie_insert(&set->prefixes, pattern, len - 1, false);
+    }
+
+    return pattern_set_add_fallback(set, pattern, len, fallback_capacity);
+}
+
+PatternSet *pattern_set_create(char **patterns, int count)
+{
+    PatternSet *set = calloc(1, sizeof(PatternSet));
+    if (!set)
+        return NULL;
+
+    if (string_set_init(&set->literals) != 0 || string_set_init(&set->extensions) != 0 ||
+        trie_init(&set->suffixes) != 0 || trie_init(&set->prefixes) != 0)
+    {
+        pattern_set_destroy(set);
+        return NULL;
+    }
+
+    size_t fallback_capacity = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!patterns || !patterns[i])
+            continue;
+
+        if (pattern_set_add(set, patterns[i], &fallback_capacity) != 0)
+        {
+            pattern_set_destroy(set);
+            return NULL;
+        }
+    }
+
+    return set;
+}
+
+void pattern_set_destroy(PatternSet *set)
+{
+    if (!set)
+        return;
+
+    if (set->literals.slots)
+        string_set_free(&set->literals);
+    if (set->extensions.slots)
+        string_set_free(&set->extensions);
+    trie_free(&set->suffixes);
+    trie_free(&set->prefixes);
+
+    for (size_t i = 0; i < set->fallback_count; i++)
+    {
+        free(set->fallbacks[i].pattern);
+        free(set->fallbacks[i].dir_pattern);
+    }
+    free(set->fallbacks);
+    free(set);
+}
+
+// Extension lookup for str[0..len): the text after its last '.'
+static bool match_extension(const PatternSet *set, const char *str, size_t len)
+{
+    if (set->extensions.count == 0)
+        return false;
+
+    for (size_t i = len; i > 0; i--)
+    {
+        if (str[i - 1] == '.')
+            return string_set_contains(&set->extensions, str + i, len - i);
+    }
+    return false;
+}
+
+// Would the string str[0..len) match a literal, extension or suffix pattern?
+static bool match_whole(const PatternSet *set, const char *str, size_t len)
+{
+    return string_set_contains(&set->literals, str, len) ||
+           match_extension(set, str, len) ||
+           trie_match_suffix(&set->suffixes, str, len);
+}
+
+int pattern_set_match(const PatternSet *set, const char *path, bool is_directory)
+{
+    if (!set || !path)
+        return 0;
+
+    size_t len = strlen(path);
+    const char *basename = filter_get_basename(path);
+    size_t basename_len = len - (size_t)(basename - path);
+
+    // Leading-star classes only look at the end of the string and the
+    // basename is a suffix of the path, so checking the path covers both
+    if (match_whole(set, path, len))
+        return 1;
+    if (string_set_contains(&set->literals, basename, basename_len))
+        return 1;
+
+    if (trie_match_prefix(&set->prefixes, path, len) ||
+        trie_match_prefix(&set->prefixes, basename, basename_len))
+        return 1;
+
+    // "<pattern>/*" matches when the pattern matches the path up to some '/'.
+    // Prefix patterns need no extra work: if a leading part of the path
+    // starts with the prefix, so does the path itself.
+    if (is_directory)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            if (path[i] == '/' && match_whole(set, path, i))
+                return 1;
+        }
+    }
+
+    for (size_t i = 0; i < set->fallback_count; i++)
+    {
+        const FallbackPattern *fallback = &set->fallbacks[i];
+
+        if (fold_match(fallback->pattern, path) || fold_match(fallback->pattern, basename))
+            return 1;
+
+        if (is_directory && fallback->dir_pattern && fold_match(fallback->dir_pattern, path))
+            return 1;
+    }
+
+    return 0;
+}
+
+PatternSetStats pattern_set_get_stats(const PatternSet *set)
+{
+    PatternSetStats stats = {0};
+    if (set)
+        stats = set->stats;
+    return stats;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file filter_pattern.h
+ * @brief Compiled include/exclude pattern matcher
+ *
+ * A PatternSet is built once from the user's glob list and answers "does
+ * any pattern match this path" with a cost that depends on the path, not
+ * on the number of patterns. Match semantics are identical to looping over
+ * the patterns with filter_match_pattern() against the full path, the
+ * basename and (for directories) "<pattern>/...".
+ */
+#ifndef FILTER_PATTERN_H
+#define FILTER_PATTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct PatternSet PatternSet;
+
+/**
+ * @brief Per-class pattern counts, mainly for diagnostics and tests
+ */
+typedef struct {
+    size_t literal_count;   /**< Exact names or paths ("node_modules") */
+    size_t extension_count; /**< Simple extensions ("*.log") */
+    size_t suffix_count;    /**< Other leading-star globs ("*_test.go") */
+    size_t prefix_count;    /**< Trailing-star globs ("build*") */
+    size_t fallback_count;  /**< Anything else, matched with fnmatch() */
+} PatternSetStats;
+
+/**
+ * @brief Compile a list of glob patterns
+ *
+ * NULL and empty patterns never match and are skipped, as before.
+ *
+ * @param patterns Array of pattern strings (copied, caller keeps ownership)
+ * @param count Number of entries in patterns
+ * @return New PatternSet, or NULL on allocation failure
+ */
+PatternSet *pattern_set_create(char **patterns, int count);
+
+/**
+ * @brief Free a PatternSet (NULL is allowed)
+ */
+void pattern_set_destroy(PatternSet *set);
+
+/**
+ * @brief Test a path against every compiled pattern at once
+ *
+ * @param set Compiled patterns
+ * @param path Relative path of the entry
+ * @param is_directory Also match "<pattern>/..." against path
+ * @return 1 if any pattern matches, 0 otherwise
+ */
+int pattern_set_match(const PatternSet *set, const char *path, bool is_directory);
+
+/**
+ * @brief Report how the patterns were classified
+ */
+PatternSetStats pattern_set_get_stats(const PatternSet *set);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILTER_PATTERN_H */
@@ -0,0 +1,74 @@
+#include "filter.h"
+#include "filter_pattern.h"
+#include <stdlib.h>
+#include <string.h>
+
+// --sample rules are not FilterRules: they never decide whether a file is
+// written, only which of its bytes the content pass reads. The rules keep
+// their command-line order and the first one whose pattern matches wins.
+
+int filter_sample_rules_init_internal(FilterEngine *engine, const ResolvedConfig *config)
+{
+    if (!engine || !config)
+        return -1;
+
+    filter_sample_rules_destroy(engine);
+    if (config->sample_count <= 0)
+        return 0;
+
+    engine->samples = calloc((size_t)config->sample_count, sizeof(FilterSampleRule));
+    if (!engine->samples)
+        return -1;
+
+    for (int i = 0; i < config->sample_count; i++)
+    {
+        FilterSampleRule *rule = &engine->samples[i];
+        rule->policy = config->samples[i].policy;
+        if (config->samples[i].pattern)
+        {
+            char *pattern = config->samples[i].pattern;
+            rule->patterns = pattern_set_create(&pattern, 1);
+            if (!rule->patterns)
+            {
+                engine->sample_count = i;
+                filter_sample_rules_destroy(engine);
+                return -1;
+            }
+        }
+        engine->sample_count = i + 1;
+    }
+    return 0;
+}
+
+void filter_sample_rules_destroy(FilterEngine *engine)
+{
+    if (!engine)
+        return;
+
+    for (int i = 0; i < engine->sample_count; i++)
+        pattern_set_destroy(engine->samples[i].patterns);
+    free(engine->samples);
+    engine->samples = NULL;
+    engine->sample_count = 0;
+}
+
+const SamplePolicy *filter_engine_sample_policy(const FilterEngine *engine, const char *path, const FileInfo *info)
+{
+    if (!engine || !path || !info || engine->sample_count == 0 || info->is_directory)
+        return NULL;
+
+    for (int i = 0; i < engine->sample_count; i++)
+    {
+        const FilterSampleRule *rule = &engine->samples[i];
+        if (rule->patterns && !pattern_set_match(rule->patterns, path, false))
+            continue;
+
+        // A line is at least one byte, so a file no longer than head + tail
+        // is kept whole whichever of them count lines
+        const SamplePolicy *policy = &rule->policy;
+        if (policy->head + policy->tail < policy->head || info->size <= policy->head + policy->tail)
+            return NULL;
+        return policy;
+    }
+    return NULL;
+}
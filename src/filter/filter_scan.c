@@ -0,0 +1,266 @@
+/**
+ * @file filter_scan.c
+ * @brief Vectorized byte scanning kernels used for binary detection
+ *
+ * Every kernel produces exactly the same ByteScanResult as the scalar
+ * loop: vector blocks are only used while they contain no NUL, and the
+ * block holding the first NUL is finished byte by byte.
+ */
+#include "filter_scan.h"
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FILTER_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define FILTER_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef ByteScanResult (*ScanKernel)(const unsigned char *data, size_t size);
+
+// Bytes below 0x20 that plain text routinely contains: \b \t \n \v \f \r, ESC
+static inline bool is_unexpected_control(unsigned char c)
+{
+    if (c == 0x7F)
+        return true;
+    if (c >= 0x20)
+        return false;
+    return !(c >= 0x08 && c <= 0x0D) && c != 0x1B;
+}
+
+static ByteScanResult scan_scalar(const unsigned char *data, size_t size)
+{
+    ByteScanResult result = {0};
+    size_t i = 0;
+
+    for (; i < size; i++)
+    {
+        unsigned char c = data[i];
+        if (c == 0)
+        {
+            result.has_nul = true;
+            i++;
+            break;
+        }
+        if (is_unexpected_control(c))
+            result.control_count++;
+    }
+
+    result.scanned = i;
+    return result;
+}
+
+// Finish a scan in scalar code from offset, keeping counts gathered so far
+static ByteScanResult scan_finish(const unsigned char *data, size_t size, size_t offset, size_t control_count)
+{
+    ByteScanResult tail = scan_scalar(data + offset, size - offset);
+    tail.control_count += control_count;
+    tail.scanned += offset;
+    return tail;
+}
+
+#ifdef FILTER_SCAN_X86
+
+__attribute__((target("sse2"))) static ByteScanResult scan_sse2(const unsigned char *data, size_t size)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const __m128i allowed_base = _mm_set1_epi8(0x08);
+    const __m128i allowed_span = _mm_set1_epi8(0x0D - 0x08);
+    const __m128i esc = _mm_set1_epi8(0x1B);
+    const __m128i del = _mm_set1_epi8(0x7F);
+
+    size_t control_count = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)))
+            return scan_finish(data, size, i, control_count);
+
+        // Unsigned v <= 0x1F and (v - 8) <= 5 via min/compare
+        __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, max_control), v);
+        __m128i shifted = _mm_sub_epi8(v, allowed_base);
+        __m128i allowed = _mm_cmpeq_epi8(_mm_min_epu8(shifted, allowed_span), shifted);
+        allowed = _mm_or_si128(allowed, _mm_cmpeq_epi8(v, esc));
+
+        __m128i control = _mm_or_si128(_mm_andnot_si128(allowed, low), _mm_cmpeq_epi8(v, del));
+        control_count += (size_t)__builtin_popcount((unsigned)_mm_movemask_epi8(control));
+    }
+
+    return scan_finish(data, size, i, control_count);
+}
+
+__attribute__((target("avx2"))) static ByteScanResult scan_avx2(const unsigned char *data, size_t size)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max_control = _mm256_set1_epi8(0x1F);
+    const __m256i allowed_base = _mm256_set1_epi8(0x08);
+    const __m256i allowed_span = _mm256_set1_epi8(0x0D - 0x08);
+    const __m256i esc = _mm256_set1_epi8(0x1B);
+    const __m256i del = _mm256_set1_epi8(0x7F);
+
+    size_t control_count = 0;
+    size_t i = 0;
+
+    // 64 bytes per step: NUL check on both halves first, since a NUL ends the scan
+    for (; i + 64 <= size; i += 64)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(data + i + 32));
+
+        __m256i nul = _mm256_or_si256(_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(b, zero));
+        if (_mm256_movemask_epi8(nul))
+            return scan_finish(data, size, i, control_count);
+
+        __m256i low_a = _mm256_cmpeq_epi8(_mm256_min_epu8(a, max_control), a);
+        __m256i low_b = _mm256_cmpeq_epi8(_mm256_min_epu8(b, max_control), b);
+        __m256i shifted_a = _mm256_sub_epi8(a, allowed_base);
+        __m256i shifted_b = _mm256_sub_epi8(b, allowed_base);
+        __m256i allowed_a = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted_a, allowed_span), shifted_a),
+                                            _mm256_cmpeq_epi8(a, esc));
+        __m256i allowed_b = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(shifted_b, allowed_span), shifted_b),
+                                            _mm256_cmpeq_epi8(b, esc));
+
+        __m256i control_a = _mm256_or_si256(_mm256_andnot_si256(allowed_a, low_a), _mm256_cmpeq_epi8(a, del));
+        __m256i control_b = _mm256_or_si256(_mm256_andnot_si256(allowed_b, low_b), _mm256_cmpeq_epi8(b, del));
+        control_count += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(control_a));
+        control_count += (size_t)__builtin_popcount((unsigned)_mm256_movemask_epi8(control_b));
+    }
+
+    return scan_finish(data, size, i, control_count);
+}
+
+#endif /* FILTER_SCAN_X86 */
+
+#ifdef FILTER_SCAN_NEON
+
+static ByteScanResult scan_neon(const unsigned char *data, size_t size)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t max_control = vdupq_n_u8(0x1F);
+    const uint8x16_t allowed_base = vdupq_n_u8(0x08);
+    const uint8x16_t allowed_span = vdupq_n_u8(0x0D - 0x08);
+    const uint8x16_t esc = vdupq_n_u8(0x1B);
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+
+    size_t control_count = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(data + i);
+
+        if (vmaxvq_u8(vceqq_u8(v, zero)))
+            return scan_finish(data, size, i, control_count);
+
+        uint8x16_t low = vcleq_u8(v, max_control);
+        uint8x16_t allowed = vorrq_u8(vcleq_u8(vsubq_u8(v, allowed_base), allowed_span), vceqq_u8(v, esc));
+        uint8x16_t control = vorrq_u8(vbicq_u8(low, allowed), vceqq_u8(v, del));
+        control_count += vaddvq_u8(vshrq_n_u8(control, 7));
+    }
+
+    return scan_finish(data, size, i, control_count);
+}
+
+#endif /* FILTER_SCAN_NEON */
+
+typedef struct
+{
+    const char *name;
+    ScanKernel kernel;
+} ScanKernelEntry;
+
+static ScanKernel g_scan_kernel = scan_scalar;
+static const char *g_scan_kernel_name = "scalar";
+static pthread_once_t g_scan_once = PTHREAD_ONCE_INIT;
+
+static bool kernel_supported(const char *name)
+{
+    if (strcmp(name, "scalar") == 0)
+        return true;
+#ifdef FILTER_SCAN_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+    if (strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef FILTER_SCAN_NEON
+    if (strcmp(name, "neon") == 0)
+        return true;
+#endif
+    return false;
+}
+
+static const ScanKernelEntry g_scan_kernels[] = {
+#ifdef FILTER_SCAN_X86
+    {"avx2", scan_avx2},
+    {"sse2", scan_sse2},
+#endif
+#ifdef FILTER_SCAN_NEON
+    {"neon", scan_neon},
+#endif
+    {"scalar", scan_scalar},
+};
+
+// Pick the widest kernel the CPU supports; the table is ordered best first
+static void select_scan_kernel(void)
+{
+    for (size_t i = 0; i < sizeof(g_scan_kernels) / sizeof(g_scan_kernels[0]); i++)
+    {
+        if (kernel_supported(g_scan_kernels[i].name))
+        {
+            g_scan_kernel = g_scan_kernels[i].kernel;
+            g_scan_kernel_name = g_scan_kernels[i].name;
+            return;
+        }
+    }
+}
+
+ByteScanResult filter_scan_bytes(const char *data, size_t size)
+{
+    if (!data || size == 0)
+    {
+        ByteScanResult empty = {0};
+        return empty;
+    }
+
+    pthread_once(&g_scan_once, select_scan_kernel);
+    return g_scan_kernel((const unsigned char *)data, size);
+}
+
+const char *filter_scan_kernel_name(void)
+{
+    pthread_once(&g_scan_once, select_scan_kernel);
+    return g_scan_kernel_name;
+}
+
+int filter_scan_force_kernel(const char *name)
+{
+    pthread_once(&g_scan_once, select_scan_kernel);
+
+    if (!name)
+    {
+        select_scan_kernel();
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(g_scan_kernels) / sizeof(g_scan_kernels[0]); i++)
+    {
+        if (strcmp(g_scan_kernels[i].name, name) == 0 && kernel_supported(name))
+        {
+            g_scan_kernel = g_scan_kernels[i].kernel;
+            g_scan_kernel_name = g_scan_kernels[i].name;
+            return 0;
+        }
+    }
+
+    return -1;
+}
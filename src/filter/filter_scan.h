@@ -0,0 +1,54 @@
+/**
+ * @file filter_scan.h
+ * @brief Vectorized byte scanning kernels used for binary detection
+ *
+ * The kernel is chosen once at runtime from what the CPU supports
+ * (AVX2, SSE2 or NEON, falling back to a portable scalar loop).
+ */
+#ifndef FILTER_SCAN_H
+#define FILTER_SCAN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Counts gathered from one pass over a sample
+ */
+typedef struct {
+    bool has_nul;         /**< A NUL byte was seen (the scan stops early) */
+    size_t control_count; /**< Control bytes other than \t \n \v \f \r \b and ESC */
+    size_t scanned;       /**< Bytes examined before stopping */
+} ByteScanResult;
+
+/**
+ * @brief Scan a buffer for NULs and unexpected control bytes
+ *
+ * @param data Bytes to scan
+ * @param size Number of bytes
+ * @return Counts for the scanned prefix; scanning stops at the first NUL
+ */
+ByteScanResult filter_scan_bytes(const char *data, size_t size);
+
+/**
+ * @brief Name of the kernel in use ("avx2", "sse2", "neon" or "scalar")
+ */
+const char *filter_scan_kernel_name(void);
+
+/**
+ * @brief Force a specific kernel (for tests and benchmarking)
+ *
+ * @param name Kernel name as returned by filter_scan_kernel_name(), or NULL
+ *             to restore automatic selection
+ * @return 0 on success, -1 if the kernel is unknown or unsupported here
+ */
+int filter_scan_force_kernel(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FILTER_SCAN_H */
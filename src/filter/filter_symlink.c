@@ -22,7 +22,7 @@ static int symlink_match_path(const char *path, FileInfo *info, void *context)
 }
 
 // FIXED: Enhanced symlink transformation for placeholder mode
-static int symlink_transform(const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context)
+static int symlink_transform(FconcatContext *fctx, const char *path, const char *input, size_t input_size, char **output, size_t *output_size, void *context)
 {
     SymlinkContext *ctx = (SymlinkContext *)context;
     (void)input;      // Mark as intentionally unused
@@ -56,7 +56,7 @@ static int symlink_transform(const char *path, const char *input, size_t input_s
         }
 
         size_t placeholder_len = strlen(placeholder);
-        *output = malloc(placeholder_len);
+        *output = context_arena_alloc(fctx, placeholder_len);
         if (!*output)
             return -1;
 
@@ -96,13 +96,15 @@ int filter_symlink_handling_init_internal(FilterEngine *engine, const ResolvedCo
             .match_content = NULL,
             .transform = NULL,
             .destroy_context = destroy_symlink_context,
-            .context = ctx};
+            .context = ctx,
+            .path_type_only = true};
 
         return filter_engine_add_rule_internal(engine, &rule);
     }
     else if (config->symlink_handling == SYMLINK_PLACEHOLDER)
     {
-        // Create transform rule for symlinks
+        // Create transform rule for symlinks; the placeholder stands in for
+        // the whole file, so it is a file-level replacement
         FilterRule rule = {
             .type = FILTER_TYPE_TRANSFORM,
             .priority = 80,
@@ -110,7 +112,8 @@ int filter_symlink_handling_init_internal(FilterEngine *engine, const ResolvedCo
             .match_content = NULL,
             .transform = symlink_transform,
             .destroy_context = destroy_symlink_context,
-            .context = ctx};
+            .context = ctx,
+            .match_file = symlink_match_path};
 
         return filter_engine_add_rule_internal(engine, &rule);
     }
@@ -1,6 +1,8 @@
 #include "format.h"
 #include "../core/error.h"
 #include "../core/memory.h"
+#include "../core/metrics.h"
+#include "../core/context.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -21,6 +23,8 @@ FormatEngine *format_engine_create(void)
 
     // Register built-in formatters
     format_engine_register_plugin(engine, format_text_plugin());
+    format_engine_register_plugin(engine, format_ndjson_plugin());
+    format_engine_register_plugin(engine, format_indexed_plugin());
 
     return engine;
 }
@@ -155,7 +159,11 @@ int format_engine_write_directory(FormatEngine *engine, FconcatContext *ctx, con
 
     if (engine->active_formatter->write_directory)
     {
-        return engine->active_formatter->write_directory(ctx, path, level);
+        Metrics *metrics = context_metrics(ctx);
+        uint64_t start = metrics_begin(metrics);
+        int result = engine->active_formatter->write_directory(ctx, path, level);
+        metrics_end(metrics, METRICS_FORMAT, start, 0);
+        return result;
     }
 
     return 0;
@@ -168,7 +176,11 @@ int format_engine_write_file_entry(FormatEngine *engine, FconcatContext *ctx, co
 
     if (engine->active_formatter->write_file_entry)
     {
-        return engine->active_formatter->write_file_entry(ctx, path, info);
+        Metrics *metrics = context_metrics(ctx);
+        uint64_t start = metrics_begin(metrics);
+        int result = engine->active_formatter->write_file_entry(ctx, path, info);
+        metrics_end(metrics, METRICS_FORMAT, start, 0);
+        return result;
     }
 
     return 0;
@@ -207,7 +219,11 @@ int format_engine_write_file_header(FormatEngine *engine, FconcatContext *ctx, c
 
     if (engine->active_formatter->write_file_header)
     {
-        return engine->active_formatter->write_file_header(ctx, path);
+        Metrics *metrics = context_metrics(ctx);
+        uint64_t start = metrics_begin(metrics);
+        int result = engine->active_formatter->write_file_header(ctx, path);
+        metrics_end(metrics, METRICS_FORMAT, start, 0);
+        return result;
     }
 
     return 0;
@@ -220,7 +236,11 @@ int format_engine_write_file_chunk(FormatEngine *engine, FconcatContext *ctx, co
 
     if (engine->active_formatter->write_file_chunk)
     {
-        return engine->active_formatter->write_file_chunk(ctx, data, size);
+        Metrics *metrics = context_metrics(ctx);
+        uint64_t start = metrics_begin(metrics);
+        int result = engine->active_formatter->write_file_chunk(ctx, data, size);
+        metrics_end(metrics, METRICS_FORMAT, start, size);
+        return result;
     }
 
     return 0;
@@ -233,12 +253,32 @@ int format_engine_write_file_footer(FormatEngine *engine, FconcatContext *ctx)
 
     if (engine->active_formatter->write_file_footer)
     {
-        return engine->active_formatter->write_file_footer(ctx);
+        Metrics *metrics = context_metrics(ctx);
+        uint64_t start = metrics_begin(metrics);
+        int result = engine->active_formatter->write_file_footer(ctx);
+        metrics_end(metrics, METRICS_FORMAT, start, 0);
+        return result;
     }
 
     return 0;
 }
 
+int format_engine_write_file_reference(FormatEngine *engine, FconcatContext *ctx, const char *original)
+{
+    if (!engine || !engine->active_formatter || !original)
+        return -1;
+
+    // The plugin ABI has no entry for this, so only the text builtin has one
+    if (!(format_engine_active_capabilities(engine) & FORMAT_CAP_FILE_REFERENCES))
+        return -1;
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    int result = format_text_write_file_reference(ctx, original);
+    metrics_end(metrics, METRICS_FORMAT, start, 0);
+    return result;
+}
+
 int format_engine_end_content(FormatEngine *engine, FconcatContext *ctx)
 {
     if (!engine || !engine->active_formatter)
@@ -263,4 +303,22 @@ int format_engine_end_document(FormatEngine *engine, FconcatContext *ctx)
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+bool format_engine_active_is_builtin(const FormatEngine *engine)
+{
+    return engine && (engine->active_formatter == format_text_plugin() ||
+                      engine->active_formatter == format_ndjson_plugin() ||
+                      engine->active_formatter == format_indexed_plugin());
+}
+
+unsigned format_engine_active_capabilities(const FormatEngine *engine)
+{
+    // Plugin formatters may escape or wrap chunks, so they get no shortcuts.
+    // Neither does ndjson: it escapes chunks, and a record left open by a
+    // file without footer is closed by the next file's header. The indexed
+    // format hashes every chunk and records where each block landed.
+    if (engine && engine->active_formatter == format_text_plugin())
+        return FORMAT_CAP_RAW_CHUNKS | FORMAT_CAP_SELF_CONTAINED_FILES | FORMAT_CAP_FILE_REFERENCES;
+    return 0;
+}
@@ -12,6 +12,11 @@ extern "C"
     // Forward declaration
     struct FconcatContext;
 
+    // Capabilities of the active formatter that the core may rely on
+#define FORMAT_CAP_RAW_CHUNKS 0x1u // write_file_chunk emits the bytes verbatim
+#define FORMAT_CAP_SELF_CONTAINED_FILES 0x2u // A file's header-to-footer block depends only on that file
+#define FORMAT_CAP_FILE_REFERENCES 0x4u // Can write a file as a reference to an earlier identical one
+
     // Format engine
     typedef struct FormatEngine
     {
@@ -38,13 +43,21 @@ extern "C"
     int format_engine_write_file_header(FormatEngine *engine, struct FconcatContext *ctx, const char *path);
     int format_engine_write_file_chunk(FormatEngine *engine, struct FconcatContext *ctx, const char *data, size_t size);
     int format_engine_write_file_footer(FormatEngine *engine, struct FconcatContext *ctx);
+    // In place of the chunks of a file whose contents equal those of the
+    // earlier file at original; needs FORMAT_CAP_FILE_REFERENCES
+    int format_engine_write_file_reference(FormatEngine *engine, struct FconcatContext *ctx, const char *original);
     int format_engine_end_content(FormatEngine *engine, struct FconcatContext *ctx);
     int format_engine_end_document(FormatEngine *engine, struct FconcatContext *ctx);
 
     int format_engine_set_active_formatter_unlocked(FormatEngine *engine, const char *name);
+    bool format_engine_active_is_builtin(const FormatEngine *engine);
+    unsigned format_engine_active_capabilities(const FormatEngine *engine);
 
     // Built-in formatters
     FormatPlugin *format_text_plugin(void);
+    int format_text_write_file_reference(struct FconcatContext *ctx, const char *original);
+    FormatPlugin *format_ndjson_plugin(void);
+    FormatPlugin *format_indexed_plugin(void);
 
 #ifdef __cplusplus
 }
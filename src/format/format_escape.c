@@ -0,0 +1,368 @@
+/**
+ * @file format_escape.c
+ * @brief Vectorized JSON string escaping used by the ndjson formatter
+ *
+ * The kernels only look for the next byte that is not plain ASCII; runs
+ * of plain bytes are then copied with memcpy, and the escapes and the
+ * UTF-8 checks of bytes from 0x80 up are done in scalar code. Every
+ * kernel returns exactly what the scalar loop does.
+ */
+#include "format_escape.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FORMAT_ESCAPE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define FORMAT_ESCAPE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef size_t (*EscapeKernel)(const unsigned char *data, size_t size);
+
+// Escaped, or the start of a UTF-8 sequence to check
+static inline bool needs_escape(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\' || c >= 0x80;
+}
+
+static size_t plain_scalar(const unsigned char *data, size_t size)
+{
+    size_t i = 0;
+    while (i < size && !needs_escape(data[i]))
+        i++;
+    return i;
+}
+
+#ifdef FORMAT_ESCAPE_X86
+
+__attribute__((target("sse2"))) static size_t plain_sse2(const unsigned char *data, size_t size)
+{
+    const __m128i max_control = _mm_set1_epi8(0x1F);
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+
+        // Unsigned v <= 0x1F via min/compare
+        __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(v, max_control), v);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, quote));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(v, backslash));
+
+        // The top bit of each byte marks the ones from 0x80 up
+        unsigned mask = (unsigned)(_mm_movemask_epi8(hit) | _mm_movemask_epi8(v));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + plain_scalar(data + i, size - i);
+}
+
+__attribute__((target("avx2"))) static size_t plain_avx2(const unsigned char *data, size_t size)
+{
+    const __m256i max_control = _mm256_set1_epi8(0x1F);
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+
+        __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(v, max_control), v);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, quote));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(v, backslash));
+
+        unsigned mask = (unsigned)(_mm256_movemask_epi8(hit) | _mm256_movemask_epi8(v));
+        if (mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+
+    return i + plain_scalar(data + i, size - i);
+}
+
+#endif /* FORMAT_ESCAPE_X86 */
+
+#ifdef FORMAT_ESCAPE_NEON
+
+static size_t plain_neon(const unsigned char *data, size_t size)
+{
+    const uint8x16_t max_control = vdupq_n_u8(0x1F);
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t min_high = vdupq_n_u8(0x80);
+
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16)
+    {
+        uint8x16_t v = vld1q_u8(data + i);
+        uint8x16_t hit = vorrq_u8(vcleq_u8(v, max_control), vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)));
+        hit = vorrq_u8(hit, vcgeq_u8(v, min_high));
+
+        // Narrow to one nibble per byte so the first hit can be counted to
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hit), 4)), 0);
+        if (mask)
+            return i + (size_t)(__builtin_ctzll(mask) >> 2);
+    }
+
+    return i + plain_scalar(data + i, size - i);
+}
+
+#endif /* FORMAT_ESCAPE_NEON */
+
+typedef struct
+{
+    const char *name;
+    EscapeKernel kernel;
+} EscapeKernelEntry;
+
+static EscapeKernel g_escape_kernel = plain_scalar;
+static const char *g_escape_kernel_name = "scalar";
+static pthread_once_t g_escape_once = PTHREAD_ONCE_INIT;
+
+static bool kernel_supported(const char *name)
+{
+    if (strcmp(name, "scalar") == 0)
+        return true;
+#ifdef FORMAT_ESCAPE_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+    if (strcmp(name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef FORMAT_ESCAPE_NEON
+    if (strcmp(name, "neon") == 0)
+        return true;
+#endif
+    return false;
+}
+
+static const EscapeKernelEntry g_escape_kernels[] = {
+#ifdef FORMAT_ESCAPE_X86
+    {"avx2", plain_avx2},
+    {"sse2", plain_sse2},
+#endif
+#ifdef FORMAT_ESCAPE_NEON
+    {"neon", plain_neon},
+#endif
+    {"scalar", plain_scalar},
+};
+
+// Pick the widest kernel the CPU supports; the table is ordered best first
+static void select_escape_kernel(void)
+{
+    for (size_t i = 0; i < sizeof(g_escape_kernels) / sizeof(g_escape_kernels[0]); i++)
+    {
+        if (kernel_supported(g_escape_kernels[i].name))
+        {
+            g_escape_kernel = g_escape_kernels[i].kernel;
+            g_escape_kernel_name = g_escape_kernels[i].name;
+            return;
+        }
+    }
+}
+
+size_t format_json_plain_prefix(const char *data, size_t size)
+{
+    if (!data || size == 0)
+        return 0;
+
+    pthread_once(&g_escape_once, select_escape_kernel);
+    return g_escape_kernel((const unsigned char *)data, size);
+}
+
+// Escape for one byte that needs it; returns its length
+static size_t escape_byte(unsigned char c, char *out)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out[0] = '\\';
+    switch (c)
+    {
+    case '"':
+        out[1] = '"';
+        return 2;
+    case '\\':
+        out[1] = '\\';
+        return 2;
+    case '\b':
+        out[1] = 'b';
+        return 2;
+    case '\f':
+        out[1] = 'f';
+        return 2;
+    case '\n':
+        out[1] = 'n';
+        return 2;
+    case '\r':
+        out[1] = 'r';
+        return 2;
+    case '\t':
+        out[1] = 't';
+        return 2;
+    default:
+        memcpy(out + 1, "u00", 3);
+        out[4] = hex[c >> 4];
+        out[5] = hex[c & 0xF];
+        return 6;
+    }
+}
+
+typedef enum
+{
+    UTF8_VALID,
+    UTF8_INVALID,
+    UTF8_TRUNCATED // A valid start the input ends in
+} Utf8Status;
+
+// Check the sequence at s, whose lead byte is from 0x80 up, against the
+// well-formed byte ranges of Unicode table 3-7. *length receives the
+// length of the sequence, or of its ill-formed start (replaced by one
+// U+FFFD), or of the valid start that is all there is.
+static Utf8Status utf8_sequence(const unsigned char *s, size_t size, size_t *length)
+{
+    unsigned char c = s[0];
+    unsigned char low = 0x80;
+    unsigned char high = 0xBF;
+    size_t continuation;
+
+    if (c >= 0xC2 && c <= 0xDF)
+        continuation = 1;
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+        continuation = 2;
+        if (c == 0xE0)
+            low = 0xA0; // Overlong
+        else if (c == 0xED)
+            high = 0x9F; // Surrogates
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+        continuation = 3;
+        if (c == 0xF0)
+            low = 0x90; // Overlong
+        else if (c == 0xF4)
+            high = 0x8F; // Beyond U+10FFFF
+    }
+    else
+    {
+        *length = 1;
+        return UTF8_INVALID;
+    }
+
+    for (size_t i = 1; i <= continuation; i++)
+    {
+        if (i == size)
+        {
+            *length = i;
+            return UTF8_TRUNCATED;
+        }
+        if (s[i] < low || s[i] > high)
+        {
+            *length = i;
+            return UTF8_INVALID;
+        }
+        low = 0x80;
+        high = 0xBF;
+    }
+    *length = continuation + 1;
+    return UTF8_VALID;
+}
+
+size_t format_json_escape(const char *in, size_t size, bool final, size_t *consumed, char *out, size_t room)
+{
+    size_t read = 0;
+    size_t written = 0;
+
+    if (in && out)
+    {
+        pthread_once(&g_escape_once, select_escape_kernel);
+
+        while (read < size && written < room)
+        {
+            // Scan no further than the run could be copied
+            size_t limit = size - read < room - written ? size - read : room - written;
+            size_t run = g_escape_kernel((const unsigned char *)in + read, limit);
+            memcpy(out + written, in + read, run);
+            read += run;
+            written += run;
+            if (run == limit)
+                continue;
+
+            unsigned char c = (unsigned char)in[read];
+            if (c < 0x80)
+            {
+                char escape[FORMAT_JSON_ESCAPE_MAX];
+                size_t length = escape_byte(c, escape);
+                if (length > room - written)
+                    break;
+                memcpy(out + written, escape, length);
+                written += length;
+                read++;
+                continue;
+            }
+
+            size_t length = 0;
+            Utf8Status status = utf8_sequence((const unsigned char *)in + read, size - read, &length);
+            if (status == UTF8_TRUNCATED && !final)
+                break; // The rest comes with the next chunk
+            if (status == UTF8_VALID)
+            {
+                if (length > room - written)
+                    break;
+                memcpy(out + written, in + read, length);
+                written += length;
+            }
+            else
+            {
+                if (sizeof(FORMAT_JSON_REPLACEMENT) - 1 > room - written)
+                    break;
+                memcpy(out + written, FORMAT_JSON_REPLACEMENT, sizeof(FORMAT_JSON_REPLACEMENT) - 1);
+                written += sizeof(FORMAT_JSON_REPLACEMENT) - 1;
+            }
+            read += length;
+        }
+    }
+
+    if (consumed)
+        *consumed = read;
+    return written;
+}
+
+const char *format_escape_kernel_name(void)
+{
+    pthread_once(&g_escape_once, select_escape_kernel);
+    return g_escape_kernel_name;
+}
+
+int format_escape_force_kernel(const char *name)
+{
+    pthread_once(&g_escape_once, select_escape_kernel);
+
+    if (!name)
+    {
+        select_escape_kernel();
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(g_escape_kernels) / sizeof(g_escape_kernels[0]); i++)
+    {
+        if (strcmp(g_escape_kernels[i].name, name) == 0 && kernel_supported(name))
+        {
+            g_escape_kernel = g_escape_kernels[i].kernel;
+            g_escape_kernel_name = g_escape_kernels[i].name;
+            return 0;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file format_escape.h
+ * @brief Vectorized JSON string escaping used by the ndjson formatter
+ *
+ * The kernel that finds the next byte needing an escape is chosen once
+ * at runtime from what the CPU supports (AVX2, SSE2 or NEON, falling
+ * back to a portable scalar loop).
+ */
+#ifndef FORMAT_ESCAPE_H
+#define FORMAT_ESCAPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Longest escape a single input byte or UTF-8 sequence turns into (\\u00XX, \\ufffd) */
+#define FORMAT_JSON_ESCAPE_MAX 6
+
+/** Longest UTF-8 sequence; at most one byte less is left over at the end of a chunk */
+#define FORMAT_JSON_UTF8_MAX 4
+
+/** What an ill-formed UTF-8 sequence is written as: U+FFFD, escaped to stay ASCII */
+#define FORMAT_JSON_REPLACEMENT "\\ufffd"
+
+/**
+ * @brief Length of the prefix a JSON string can hold as is
+ *
+ * @param data Bytes to scan
+ * @param size Number of bytes
+ * @return Bytes before the first quote, backslash, control byte below 0x20
+ *         or byte from 0x80 up
+ */
+size_t format_json_plain_prefix(const char *data, size_t size);
+
+/**
+ * @brief Escape as much of a buffer as fits into out
+ *
+ * Escapes are never split, so the input can be handed over in any
+ * chunks and the outputs concatenated. Bytes from 0x80 up are checked
+ * as UTF-8: well-formed sequences pass through unchanged, and each
+ * ill-formed one is written as FORMAT_JSON_REPLACEMENT, so the output is
+ * always valid JSON. Unless final is set, a sequence the input ends in
+ * the middle of is left unconsumed, to be handed over again in front of
+ * the next chunk.
+ *
+ * @param in Bytes to escape
+ * @param size Number of bytes
+ * @param final Nothing follows in; a sequence cut short at the end is ill-formed
+ * @param consumed Receives the number of input bytes escaped
+ * @param out Destination
+ * @param room Space at out; at least FORMAT_JSON_ESCAPE_MAX guarantees progress
+ * @return Bytes written to out
+ */
+size_t format_json_escape(const char *in, size_t size, bool final, size_t *consumed, char *out, size_t room);
+
+/**
+ * @brief Name of the kernel in use ("avx2", "sse2", "neon" or "scalar")
+ */
+const char *format_escape_kernel_name(void);
+
+/**
+ * @brief Force a specific kernel (for tests and benchmarking)
+ *
+ * @param name Kernel name as returned by format_escape_kernel_name(), or
+ *             NULL to restore automatic selection
+ * @return 0 on success, -1 if the kernel is unknown or unsupported here
+ */
+int format_escape_force_kernel(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORMAT_ESCAPE_H */
@@ -0,0 +1,295 @@
+#include "format.h"
+#include "format_indexed.h"
+#include "../core/context.h"
+#include "../core/hash.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Indexed formatter - the text document plus a trailing index (see
+// format_indexed.h). The structure pass lists the files with their size
+// and mtime; the content pass adds where each one's content landed.
+
+typedef struct
+{
+    char *path;
+    uint32_t flags;
+    bool written; // Got a content block
+    uint64_t offset;
+    uint64_t length;
+    uint64_t size;
+    int64_t modified_nsec;
+    uint64_t hash;
+} IndexedRecord;
+
+// The document being written, kept with the context rendering it
+typedef struct
+{
+    IndexedRecord *records;
+    size_t count;
+    size_t capacity;
+    size_t cursor;    // Both passes walk the same tree, so matches are found here
+    size_t open;      // Record whose content is being written
+    bool block_open;
+    Xxh64State hash;
+} IndexedState;
+
+static void indexed_reset(IndexedState *state)
+{
+    for (size_t i = 0; i < state->count; i++)
+        free(state->records[i].path);
+    free(state->records);
+    memset(state, 0, sizeof(*state));
+}
+
+static void indexed_state_destroy(void *state)
+{
+    indexed_reset(state);
+    free(state);
+}
+
+static IndexedState *indexed_state(FconcatContext *ctx)
+{
+    return context_format_state(ctx, sizeof(IndexedState), indexed_state_destroy);
+}
+
+static IndexedRecord *indexed_add(IndexedState *state, const char *path, const FileInfo *info)
+{
+    if (state->count == state->capacity)
+    {
+        size_t capacity = state->capacity ? state->capacity * 2 : 256;
+        IndexedRecord *records = realloc(state->records, capacity * sizeof(IndexedRecord));
+        if (!records)
+            return NULL;
+        state->records = records;
+        state->capacity = capacity;
+    }
+
+    IndexedRecord *record = &state->records[state->count];
+    memset(record, 0, sizeof(*record));
+    record->path = strdup(path);
+    if (!record->path)
+        return NULL;
+    if (info)
+    {
+        record->size = info->size;
+        record->modified_nsec = info->modified_nsec;
+    }
+    state->count++;
+    return record;
+}
+
+// The listed record for path, or a new one for a file the structure pass
+// did not report
+static IndexedRecord *indexed_match(IndexedState *state, const char *path, const FileInfo *info)
+{
+    for (size_t i = state->cursor; i < state->count; i++)
+    {
+        if (!state->records[i].written && strcmp(state->records[i].path, path) == 0)
+        {
+            state->cursor = i + 1;
+            return &state->records[i];
+        }
+    }
+    return indexed_add(state, path, info);
+}
+
+// End the open block at the current offset; without a footer it is marked
+// incomplete
+static void indexed_close_block(FconcatContext *ctx, IndexedState *state, bool footer)
+{
+    if (!state->block_open)
+        return;
+    state->block_open = false;
+
+    IndexedRecord *record = &state->records[state->open];
+    off_t end = context_output_offset(ctx);
+    record->length = end > (off_t)record->offset ? (uint64_t)end - record->offset : 0;
+    record->hash = xxh64_digest(&state->hash);
+    if (!footer)
+        record->flags |= FORMAT_INDEXED_INCOMPLETE;
+}
+
+static int indexed_begin_document(FconcatContext *ctx)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    indexed_reset(state);
+    return ctx->write_output(ctx, FORMAT_INDEXED_HEADER, sizeof(FORMAT_INDEXED_HEADER) - 1);
+}
+
+// The parts shared with the text format are its own callbacks
+static int indexed_begin_structure(FconcatContext *ctx)
+{
+    return format_text_plugin()->begin_structure(ctx);
+}
+
+static int indexed_write_directory(FconcatContext *ctx, const char *path, int level)
+{
+    return format_text_plugin()->write_directory(ctx, path, level);
+}
+
+static int indexed_begin_content(FconcatContext *ctx)
+{
+    return format_text_plugin()->begin_content(ctx);
+}
+
+static int indexed_write_file_entry(FconcatContext *ctx, const char *path, void *info)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state || !indexed_add(state, path, (const FileInfo *)info))
+        return -1;
+    return format_text_plugin()->write_file_entry(ctx, path, info);
+}
+
+static int indexed_write_file_header(FconcatContext *ctx, const char *path)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    indexed_close_block(ctx, state, false);
+
+    int ret = format_text_plugin()->write_file_header(ctx, path);
+    if (ret != 0) return ret;
+
+    off_t offset = context_output_offset(ctx);
+    IndexedRecord *record = indexed_match(state, path, (const FileInfo *)ctx->current_file_info);
+    if (!record || offset < 0)
+        return -1;
+
+    record->written = true;
+    record->offset = (uint64_t)offset;
+    state->open = (size_t)(record - state->records);
+    state->block_open = true;
+    xxh64_reset(&state->hash, 0);
+    return 0;
+}
+
+static int indexed_write_file_chunk(FconcatContext *ctx, const char *data, size_t size)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    if (state->block_open)
+        xxh64_update(&state->hash, data, size);
+    return ctx->write_output(ctx, data, size);
+}
+
+static int indexed_write_file_footer(FconcatContext *ctx)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    indexed_close_block(ctx, state, true);
+    return format_text_plugin()->write_file_footer(ctx);
+}
+
+static int indexed_end_content(FconcatContext *ctx)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    indexed_close_block(ctx, state, false);
+    return 0;
+}
+
+static void put_u32(unsigned char *out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static void put_u64(unsigned char *out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (unsigned char)(value >> (8 * i));
+}
+
+static int compare_records(const void *a, const void *b)
+{
+    return strcmp((*(const IndexedRecord *const *)a)->path, (*(const IndexedRecord *const *)b)->path);
+}
+
+static int indexed_end_document(FconcatContext *ctx)
+{
+    IndexedState *state = indexed_state(ctx);
+    if (!state)
+        return -1;
+    indexed_close_block(ctx, state, false);
+
+    off_t index_offset = context_output_offset(ctx);
+    if (index_offset < 0)
+        return -1;
+
+    // Only files that got a block are indexed
+    IndexedRecord **sorted = malloc((state->count ? state->count : 1) * sizeof(IndexedRecord *));
+    if (!sorted)
+        return -1;
+    size_t count = 0;
+    for (size_t i = 0; i < state->count; i++)
+    {
+        if (state->records[i].written)
+            sorted[count++] = &state->records[i];
+    }
+    qsort(sorted, count, sizeof(IndexedRecord *), compare_records);
+
+    int ret = 0;
+    uint64_t path_offset = 0;
+    for (size_t i = 0; i < count && ret == 0; i++)
+    {
+        const IndexedRecord *record = sorted[i];
+        size_t path_length = strlen(record->path);
+        unsigned char out[FORMAT_INDEXED_RECORD_SIZE];
+        put_u64(out, path_offset);
+        put_u32(out + 8, (uint32_t)path_length);
+        put_u32(out + 12, record->flags);
+        put_u64(out + 16, record->offset);
+        put_u64(out + 24, record->length);
+        put_u64(out + 32, record->size);
+        put_u64(out + 40, (uint64_t)record->modified_nsec);
+        put_u64(out + 48, record->hash);
+        ret = ctx->write_output(ctx, (const char *)out, sizeof(out));
+        path_offset += path_length + 1;
+    }
+
+    for (size_t i = 0; i < count && ret == 0; i++)
+        ret = ctx->write_output(ctx, sorted[i]->path, strlen(sorted[i]->path) + 1);
+
+    if (ret == 0)
+    {
+        unsigned char trailer[FORMAT_INDEXED_TRAILER_SIZE];
+        put_u64(trailer, (uint64_t)index_offset);
+        put_u64(trailer + 8, count);
+        put_u32(trailer + 16, FORMAT_INDEXED_VERSION);
+        put_u32(trailer + 20, FORMAT_INDEXED_RECORD_SIZE);
+        memcpy(trailer + 24, FORMAT_INDEXED_MAGIC, 8);
+        ret = ctx->write_output(ctx, (const char *)trailer, sizeof(trailer));
+    }
+
+    free(sorted);
+    indexed_reset(state);
+    return ret;
+}
+
+static FormatPlugin indexed_plugin = {
+    .name = "indexed",
+    .file_extension = "fcx",
+    .mime_type = "application/octet-stream",
+    .init = NULL,
+    .begin_document = indexed_begin_document,
+    .begin_structure = indexed_begin_structure,
+    .write_directory = indexed_write_directory,
+    .write_file_entry = indexed_write_file_entry,
+    .end_structure = NULL,
+    .begin_content = indexed_begin_content,
+    .write_file_header = indexed_write_file_header,
+    .write_file_chunk = indexed_write_file_chunk,
+    .write_file_footer = indexed_write_file_footer,
+    .end_content = indexed_end_content,
+    .end_document = indexed_end_document,
+    .cleanup = NULL};
+
+FormatPlugin *format_indexed_plugin(void)
+{
+    return &indexed_plugin;
+}
@@ -0,0 +1,74 @@
+#ifndef FORMAT_INDEXED_H
+#define FORMAT_INDEXED_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    // Layout written by --format indexed. The document is the text format's
+    // after a FORMAT_INDEXED_HEADER line, followed by an index that finds any
+    // file's content without scanning:
+    //
+    //   index    count records of FORMAT_INDEXED_RECORD_SIZE bytes, sorted
+    //            by path bytes:
+    //              u64 path_offset    into the string table
+    //              u32 path_length
+    //              u32 flags          FORMAT_INDEXED_*
+    //              u64 offset         first content byte in the output
+    //              u64 length         content bytes
+    //              u64 size           file size on disk
+    //              i64 modified_nsec
+    //              u64 hash           XXH64 (seed 0) of the content bytes
+    //   strings  the paths, each followed by a NUL
+    //   trailer  u64 index_offset, u64 count, u32 version, u32 record size,
+    //            FORMAT_INDEXED_MAGIC (FORMAT_INDEXED_TRAILER_SIZE bytes)
+    //
+    // Integers are little endian. Offsets count bytes of the uncompressed
+    // stream, so a --compress output must be decompressed first.
+#define FORMAT_INDEXED_HEADER "FCONCAT-INDEXED 1\n"
+#define FORMAT_INDEXED_MAGIC "FCXINDEX"
+#define FORMAT_INDEXED_VERSION 1u
+#define FORMAT_INDEXED_RECORD_SIZE 56
+#define FORMAT_INDEXED_TRAILER_SIZE 32
+
+    // The block has no footer: its content was dropped (binary files, content
+    // plugins) or cut short by a read error
+#define FORMAT_INDEXED_INCOMPLETE 0x1u
+
+    // Read side: the output is mapped and every lookup is a binary search
+    // of the index, so opening costs O(1) and finding a file O(log n)
+    typedef struct IndexedArchive IndexedArchive;
+
+    typedef struct
+    {
+        const char *path; // NUL terminated, inside the mapping
+        size_t path_length;
+        uint32_t flags;
+        uint64_t offset;
+        uint64_t length;
+        uint64_t size;
+        int64_t modified_nsec;
+        uint64_t hash;
+    } IndexedEntry;
+
+    // NULL with errno set; EINVAL when path is not a valid indexed output
+    IndexedArchive *indexed_archive_open(const char *path);
+    void indexed_archive_close(IndexedArchive *archive);
+
+    size_t indexed_archive_count(const IndexedArchive *archive);
+    // Entries in path order; both return 0, or -1 when out of range / not found
+    int indexed_archive_entry(const IndexedArchive *archive, size_t index, IndexedEntry *entry);
+    int indexed_archive_find(const IndexedArchive *archive, const char *path, IndexedEntry *entry);
+    // The entry's content bytes, valid until the archive is closed
+    const char *indexed_archive_content(const IndexedArchive *archive, const IndexedEntry *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FORMAT_INDEXED_H */
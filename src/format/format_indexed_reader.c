@@ -0,0 +1,181 @@
+#include "format_indexed.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct IndexedArchive
+{
+    const unsigned char *map;
+    size_t map_size;
+    const unsigned char *records;
+    uint64_t count;
+    const char *strings;
+    size_t strings_size;
+    uint64_t index_offset; // Content never reaches past this
+};
+
+static uint32_t get_u32(const unsigned char *in)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--)
+        value = (value << 8) | in[i];
+    return value;
+}
+
+static uint64_t get_u64(const unsigned char *in)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--)
+        value = (value << 8) | in[i];
+    return value;
+}
+
+IndexedArchive *indexed_archive_open(const char *path)
+{
+    if (!path)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    size_t header_size = sizeof(FORMAT_INDEXED_HEADER) - 1;
+    if (!S_ISREG(st.st_mode) || (uint64_t)st.st_size < header_size + FORMAT_INDEXED_TRAILER_SIZE)
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+
+    // Lookups touch a few pages at random
+    madvise(map, size, MADV_RANDOM);
+
+    const unsigned char *bytes = (const unsigned char *)map;
+    const unsigned char *trailer = bytes + size - FORMAT_INDEXED_TRAILER_SIZE;
+    uint64_t index_offset = get_u64(trailer);
+    uint64_t count = get_u64(trailer + 8);
+    uint64_t index_end = size - FORMAT_INDEXED_TRAILER_SIZE;
+
+    bool valid = memcmp(bytes, FORMAT_INDEXED_HEADER, header_size) == 0 &&
+                 memcmp(trailer + 24, FORMAT_INDEXED_MAGIC, 8) == 0 &&
+                 get_u32(trailer + 16) == FORMAT_INDEXED_VERSION &&
+                 get_u32(trailer + 20) == FORMAT_INDEXED_RECORD_SIZE &&
+                 index_offset >= header_size && index_offset <= index_end &&
+                 count <= (index_end - index_offset) / FORMAT_INDEXED_RECORD_SIZE;
+
+    IndexedArchive *archive = valid ? calloc(1, sizeof(IndexedArchive)) : NULL;
+    if (!archive)
+    {
+        munmap(map, size);
+        errno = valid ? ENOMEM : EINVAL;
+        return NULL;
+    }
+
+    archive->map = bytes;
+    archive->map_size = size;
+    archive->records = bytes + index_offset;
+    archive->count = count;
+    archive->strings = (const char *)archive->records + count * FORMAT_INDEXED_RECORD_SIZE;
+    archive->strings_size = (size_t)(index_end - index_offset - count * FORMAT_INDEXED_RECORD_SIZE);
+    archive->index_offset = index_offset;
+    return archive;
+}
+
+void indexed_archive_close(IndexedArchive *archive)
+{
+    if (!archive)
+        return;
+    munmap((void *)archive->map, archive->map_size);
+    free(archive);
+}
+
+size_t indexed_archive_count(const IndexedArchive *archive)
+{
+    return archive ? (size_t)archive->count : 0;
+}
+
+// Decode a record, refusing ones that point outside the file
+static int decode_record(const IndexedArchive *archive, size_t index, IndexedEntry *entry)
+{
+    const unsigned char *record = archive->records + index * FORMAT_INDEXED_RECORD_SIZE;
+    uint64_t path_offset = get_u64(record);
+    uint64_t path_length = get_u32(record + 8);
+    if (path_offset >= archive->strings_size || path_length >= archive->strings_size - path_offset ||
+        archive->strings[path_offset + path_length] != '\0')
+        return -1;
+
+    entry->path = archive->strings + path_offset;
+    entry->path_length = (size_t)path_length;
+    entry->flags = get_u32(record + 12);
+    entry->offset = get_u64(record + 16);
+    entry->length = get_u64(record + 24);
+    entry->size = get_u64(record + 32);
+    entry->modified_nsec = (int64_t)get_u64(record + 40);
+    entry->hash = get_u64(record + 48);
+    if (entry->offset > archive->index_offset || entry->length > archive->index_offset - entry->offset)
+        return -1;
+    return 0;
+}
+
+int indexed_archive_entry(const IndexedArchive *archive, size_t index, IndexedEntry *entry)
+{
+    if (!archive || !entry || index >= archive->count)
+        return -1;
+    return decode_record(archive, index, entry);
+}
+
+int indexed_archive_find(const IndexedArchive *archive, const char *path, IndexedEntry *entry)
+{
+    if (!archive || !path || !entry)
+        return -1;
+
+    // Records are sorted by path bytes, as strcmp orders them
+    size_t path_length = strlen(path);
+    size_t low = 0;
+    size_t high = (size_t)archive->count;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (decode_record(archive, middle, entry) != 0)
+            return -1;
+
+        size_t common = entry->path_length < path_length ? entry->path_length : path_length;
+        int order = memcmp(entry->path, path, common);
+        if (order == 0)
+            order = entry->path_length < path_length ? -1 : entry->path_length > path_length;
+        if (order == 0)
+            return 0;
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return -1;
+}
+
+const char *indexed_archive_content(const IndexedArchive *archive, const IndexedEntry *entry)
+{
+    if (!archive || !entry || entry->offset > archive->index_offset ||
+        entry->length > archive->index_offset - entry->offset)
+        return NULL;
+    return (const char *)archive->map + entry->offset;
+}
@@ -0,0 +1,191 @@
+#include "format.h"
+#include "format_escape.h"
+#include "../core/context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// NDJSON formatter - one JSON object per file and line:
+//   {"path":"src/main.c","size":1234,"content":"..."}
+// The structure pass writes nothing. Chunks are escaped as they stream
+// through, straight into the output buffer, so no file is held whole.
+
+// A record is left open when a file gets a header but no footer (its
+// content was dropped, or reading failed); it is closed before the next.
+// A chunk may end inside a UTF-8 sequence, whose start is kept until the
+// next chunk completes it or the record closes. The state lives with the
+// context rendering the document.
+typedef struct
+{
+    bool record_open;
+    char tail[FORMAT_JSON_UTF8_MAX - 1];
+    size_t tail_size;
+} NdjsonState;
+
+static NdjsonState *ndjson_state(FconcatContext *ctx)
+{
+    return context_format_state(ctx, sizeof(NdjsonState), free);
+}
+
+#define NDJSON_SPAN(literal) {literal, sizeof(literal) - 1}
+
+// Escape into the output sink's buffer, or through a bounce buffer when
+// output goes to a FILE. Unless final is set, *left receives the size of
+// the unfinished UTF-8 sequence at the end of data, which is not written.
+static int ndjson_write_escaped(FconcatContext *ctx, const char *data, size_t size, bool final, size_t *left)
+{
+    OutputSink *sink = context_output_sink(ctx);
+    char bounce[4096];
+
+    while (size > 0)
+    {
+        size_t consumed = 0;
+        if (sink)
+        {
+            size_t room = 0;
+            char *out = output_sink_reserve(sink, FORMAT_JSON_ESCAPE_MAX, &room);
+            if (!out)
+                return -1;
+            output_sink_commit(sink, format_json_escape(data, size, final, &consumed, out, room));
+        }
+        else
+        {
+            size_t written = format_json_escape(data, size, final, &consumed, bounce, sizeof(bounce));
+            if (ctx->write_output(ctx, bounce, written) != 0)
+                return -1;
+        }
+        // With room for any escape, only an unfinished sequence stops it
+        if (consumed == 0)
+            break;
+        data += consumed;
+        size -= consumed;
+    }
+    if (left)
+        *left = size;
+    return 0;
+}
+
+static int ndjson_close_record(FconcatContext *ctx)
+{
+    NdjsonState *state = ndjson_state(ctx);
+    if (!state)
+        return -1;
+    if (!state->record_open)
+        return 0;
+    state->record_open = false;
+
+    // A sequence the content ended in the middle of is ill-formed
+    size_t tail_size = state->tail_size;
+    state->tail_size = 0;
+    if (tail_size > 0 && ndjson_write_escaped(ctx, state->tail, tail_size, true, NULL) != 0)
+        return -1;
+    return ctx->write_output(ctx, "\"}\n", 3);
+}
+
+static int ndjson_begin_document(FconcatContext *ctx)
+{
+    NdjsonState *state = ndjson_state(ctx);
+    if (!state)
+        return -1;
+    state->record_open = false;
+    state->tail_size = 0;
+    return 0;
+}
+
+static int ndjson_write_file_header(FconcatContext *ctx, const char *path)
+{
+    int ret = ndjson_close_record(ctx);
+    if (ret != 0) return ret;
+
+    ret = ctx->write_output(ctx, "{\"path\":\"", 9);
+    if (ret != 0) return ret;
+    ret = ndjson_write_escaped(ctx, path, strlen(path), true, NULL);
+    if (ret != 0) return ret;
+
+    char size_buf[64];
+    int len = 0;
+    const FileInfo *info = (const FileInfo *)ctx->current_file_info;
+    if (info)
+        len = snprintf(size_buf, sizeof(size_buf), "\",\"size\":%zu", info->size);
+    if (len <= 0 || len >= (int)sizeof(size_buf))
+        len = snprintf(size_buf, sizeof(size_buf), "\"");
+
+    FconcatOutputSpan rest[] = {{size_buf, (size_t)len}, NDJSON_SPAN(",\"content\":\"")};
+    ret = ctx->write_outputv(ctx, rest, 2);
+    if (ret != 0) return ret;
+
+    ndjson_state(ctx)->record_open = true; // Allocated by the close above
+    return 0;
+}
+
+static int ndjson_write_file_chunk(FconcatContext *ctx, const char *data, size_t size)
+{
+    NdjsonState *state = ndjson_state(ctx);
+    if (!state)
+        return -1;
+
+    size_t left = 0;
+    if (state->tail_size > 0)
+    {
+        // Finish the sequence the last chunk ended in; the most it needs
+        // is one byte less than a whole sequence
+        char joined[2 * FORMAT_JSON_UTF8_MAX];
+        size_t take = size < FORMAT_JSON_UTF8_MAX - 1 ? size : FORMAT_JSON_UTF8_MAX - 1;
+        memcpy(joined, state->tail, state->tail_size);
+        memcpy(joined + state->tail_size, data, take);
+        size_t joined_size = state->tail_size + take;
+        if (ndjson_write_escaped(ctx, joined, joined_size, false, &left) != 0)
+            return -1;
+
+        size_t used = joined_size - left;
+        if (used < state->tail_size)
+        {
+            // Still unfinished: all of data went into it
+            memmove(state->tail, joined + used, left);
+            state->tail_size = left;
+            return 0;
+        }
+        data += used - state->tail_size;
+        size -= used - state->tail_size;
+        state->tail_size = 0;
+    }
+
+    if (ndjson_write_escaped(ctx, data, size, false, &left) != 0)
+        return -1;
+    memcpy(state->tail, data + size - left, left);
+    state->tail_size = left;
+    return 0;
+}
+
+static int ndjson_write_file_footer(FconcatContext *ctx)
+{
+    return ndjson_close_record(ctx);
+}
+
+static int ndjson_end_content(FconcatContext *ctx)
+{
+    return ndjson_close_record(ctx);
+}
+
+static FormatPlugin ndjson_plugin = {
+    .name = "ndjson",
+    .file_extension = "ndjson",
+    .mime_type = "application/x-ndjson",
+    .init = NULL,
+    .begin_document = ndjson_begin_document,
+    .begin_structure = NULL,
+    .write_directory = NULL,
+    .write_file_entry = NULL,
+    .end_structure = NULL,
+    .begin_content = NULL,
+    .write_file_header = ndjson_write_file_header,
+    .write_file_chunk = ndjson_write_file_chunk,
+    .write_file_footer = ndjson_write_file_footer,
+    .end_content = ndjson_end_content,
+    .end_document = ndjson_end_content,
+    .cleanup = NULL};
+
+FormatPlugin *format_ndjson_plugin(void)
+{
+    return &ndjson_plugin;
+}
@@ -9,45 +9,40 @@ static int text_begin_document(FconcatContext *ctx)
     return 0;
 }
 
+// Literal pieces of a line, handed to write_outputv without strlen calls
+#define TEXT_SPAN(literal) {literal, sizeof(literal) - 1}
+
 static int text_begin_structure(FconcatContext *ctx)
 {
-    return ctx->write_output(ctx, "Directory Structure:\n==================\n\n", 0);
+    static const char title[] = "Directory Structure:\n==================\n\n";
+    return ctx->write_output(ctx, title, sizeof(title) - 1);
 }
 
 static int text_write_directory(FconcatContext *ctx, const char *path, int level)
 {
-    int ret;
-    for (int i = 0; i < level * 2; i++)
-    {
-        ret = ctx->write_output(ctx, " ", 1);
-        if (ret != 0) return ret;
-    }
-    ret = ctx->write_output(ctx, "📁 ", 0);
-    if (ret != 0) return ret;
-    ret = ctx->write_output(ctx, path, 0);
+    int ret = ctx->write_indent(ctx, level > 0 ? (size_t)level * 2 : 0);
     if (ret != 0) return ret;
-    return ctx->write_output(ctx, "/\n", 2);
+
+    FconcatOutputSpan line[] = {TEXT_SPAN("📁 "), {path, strlen(path)}, TEXT_SPAN("/\n")};
+    return ctx->write_outputv(ctx, line, 3);
 }
 
 static int text_write_file_entry(FconcatContext *ctx, const char *path, void *info)
 {
-    int ret;
-    for (int i = 0; i < ctx->current_directory_level * 2; i++)
-    {
-        ret = ctx->write_output(ctx, " ", 1);
-        if (ret != 0) return ret;
-    }
-
-    ret = ctx->write_output(ctx, "📄 ", 0);
+    int level = ctx->current_directory_level;
+    int ret = ctx->write_indent(ctx, level > 0 ? (size_t)level * 2 : 0);
     if (ret != 0) return ret;
 
-    // Use context configuration access functions
-    bool show_size = ctx->get_config_bool(ctx, "show_size");
+    FconcatOutputSpan line[4] = {TEXT_SPAN("📄 ")};
+    int count = 1;
+    char size_buf[64]; // Referenced by line until it is written
+
+    // Resolved once per run; a key lookup only without settings
+    bool show_size = ctx->settings ? ctx->settings->show_size : ctx->get_config_bool(ctx, "show_size");
     if (show_size && info)
     {
         // Cast opaque pointer to FileInfo
         FileInfo *file_info = (FileInfo *)info;
-        char size_buf[64];
         // Convert bytes to KB (round up)
         size_t kb = (file_info->size + 1023) / 1024;
         if (kb == 0 && file_info->size > 0)
@@ -55,14 +50,13 @@ static int text_write_file_entry(FconcatContext *ctx, const char *path, void *in
         int len = snprintf(size_buf, sizeof(size_buf), "[%zu KB] ", kb);
         if (len > 0 && len < (int)sizeof(size_buf))
         {
-            ret = ctx->write_output(ctx, size_buf, 0);
-            if (ret != 0) return ret;
+            line[count++] = (FconcatOutputSpan){size_buf, (size_t)len};
         }
     }
 
-    ret = ctx->write_output(ctx, path, 0);
-    if (ret != 0) return ret;
-    return ctx->write_output(ctx, "\n", 1);
+    line[count++] = (FconcatOutputSpan){path, strlen(path)};
+    line[count++] = (FconcatOutputSpan)TEXT_SPAN("\n");
+    return ctx->write_outputv(ctx, line, count);
 }
 
 static int text_end_structure(FconcatContext *ctx)
@@ -73,17 +67,14 @@ static int text_end_structure(FconcatContext *ctx)
 
 static int text_begin_content(FconcatContext *ctx)
 {
-    return ctx->write_output(ctx, "\nFile Contents:\n=============\n\n", 0);
+    static const char title[] = "\nFile Contents:\n=============\n\n";
+    return ctx->write_output(ctx, title, sizeof(title) - 1);
 }
 
 static int text_write_file_header(FconcatContext *ctx, const char *path)
 {
-    int ret;
-    ret = ctx->write_output(ctx, "// File: ", 0);
-    if (ret != 0) return ret;
-    ret = ctx->write_output(ctx, path, 0);
-    if (ret != 0) return ret;
-    return ctx->write_output(ctx, "\n", 1);
+    FconcatOutputSpan line[] = {TEXT_SPAN("// File: "), {path, strlen(path)}, TEXT_SPAN("\n")};
+    return ctx->write_outputv(ctx, line, 3);
 }
 
 static int text_write_file_chunk(FconcatContext *ctx, const char *data, size_t size)
@@ -91,6 +82,13 @@ static int text_write_file_chunk(FconcatContext *ctx, const char *data, size_t s
     return ctx->write_output(ctx, data, size);
 }
 
+// Body of a file identical to one written earlier; the footer follows
+int format_text_write_file_reference(FconcatContext *ctx, const char *original)
+{
+    FconcatOutputSpan line[] = {TEXT_SPAN("// [Identical to: "), {original, strlen(original)}, TEXT_SPAN("]")};
+    return ctx->write_outputv(ctx, line, 3);
+}
+
 static int text_write_file_footer(FconcatContext *ctx)
 {
     return ctx->write_output(ctx, "\n\n", 2);
@@ -1,8 +1,20 @@
 #include "fconcat.h"
 #include "core/context.h"
+#include "core/dedup.h"
+#include "core/incremental.h"
+#include "core/metrics.h"
+#include "core/output.h"
+#include "core/pipeline.h"
+#include "core/shard.h"
+#include "core/tree.h"
+#include "core/watch.h"
 #include "plugins/plugin.h"
 #include "format/format.h"
 #include "filter/filter.h"
+#include "filter/filter_scan.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -86,19 +98,74 @@ void print_usage(const char *program_name)
             "  --show-size, -s       Display file sizes in the directory structure.\n"
             "  --verbose, -v         Enable verbose logging (sets log level to debug).\n"
             "  --log-level <level>   Set log level: error, warning, info, debug, trace\n"
+            "  --log-async           Hand log lines to a writer thread that prints them\n"
+            "                        in batches; lines that do not fit in its queue are\n"
+            "                        dropped and counted rather than slowing the run.\n"
+            "  --progress            Show bytes and files done, throughput and ETA on\n"
+            "                        stderr while content is processed, refreshed a\n"
+            "                        few times a second.\n"
             "  --interactive         Keep plugins active after processing.\n"
             "  --binary-skip         Skip binary files entirely (default).\n"
             "  --binary-include      Include binary files in concatenation.\n"
             "  --binary-placeholder  Show placeholder for binary files.\n"
             "  --symlinks <mode>     How to handle symbolic links:\n"
             "                        skip, follow, include, placeholder\n"
-            "  --format <format>     Output format: text, json\n"
+            "  --format <format>     Output format: text, ndjson (one JSON record per file),\n"
+            "                        indexed (text plus a trailing index of every file)\n"
             "  --plugin <spec>       Load a plugin with optional parameters.\n"
             "                        Format: path[:param1=value1,param2=value2,...]\n"
+            "  --jobs, -j <n>        Walk directories and read and filter file contents\n"
+            "                        on n worker threads (0 = one per CPU, default 1).\n"
+            "                        Output is identical to the single-threaded run.\n"
+            "  --direct-io           Write the output file with O_DIRECT, bypassing\n"
+            "                        the page cache where the filesystem allows it.\n"
+            "  --drop-cache          Drop written output from the page cache as it\n"
+            "                        reaches the disk.\n"
+            "  --io-engine <engine>  Read small files ahead of the content pass:\n"
+            "                        sync (default), auto, uring, threads\n"
+            "  --io-depth <n>        Reads kept in flight by the I/O engine (default 128)\n"
+            "  --incremental <cache> Keep a manifest in <cache> and copy the blocks of\n"
+            "                        unchanged files from the previous output instead\n"
+            "                        of reading them again.\n"
+            "  --dedup               Write the contents of byte-identical files once;\n"
+            "                        later copies refer back to the first.\n"
+            "  --stats [table|json]  Time readdir, stat, filters, reads, formatting and\n"
+            "                        writes, and print the counters and slowest files\n"
+            "                        to stderr at exit (default table).\n"
+            "  --compress <codec>[:level]\n"
+            "                        Compress the output on every core while it is\n"
+            "                        produced: gzip (levels 0-9, default 6).\n"
+            "  --gitignore           Skip what .gitignore and .ignore files in the input\n"
+            "                        ignore, as git does; ignored directories are not\n"
+            "                        read at all, and .git is always skipped.\n"
+            "  --unique-inodes       Emit each file and walk each directory once, under\n"
+            "                        the first path that reaches it: hardlinks and\n"
+            "                        directories reached again through symlinks are\n"
+            "                        left out.\n"
+            "  --files-from <file>   Process the files listed in <file> ('-' for stdin)\n"
+            "                        instead of walking the input directory; paths are\n"
+            "                        relative to it, one per line or NUL-separated\n"
+            "                        (git ls-files -z). Path rules still apply.\n"
+            "  --sample [<pattern>=]<head>[,<tail>]\n"
+            "                        Keep only the start and end of matching files\n"
+            "                        (every file without a pattern), each <n>[K|M|G]\n"
+            "                        bytes or <n>lines; the middle is never read and\n"
+            "                        a marker says how much was left out. Repeatable,\n"
+            "                        first match wins, e.g. --sample '*.log=64K,16K'.\n"
+            "  --shard-size <size>   Split the output into <output>.part001, .part002,\n"
+            "                        ... each a complete document with its own structure\n"
+            "                        header, holding consecutive files up to <size> of\n"
+            "                        content: <n>[K|M|G] bytes or <n>[K|M]tokens\n"
+            "                        (estimated at 4 bytes per token).\n"
+            "  --shards <n>          Split the output into n shards of about equal size.\n"
+            "  --watch               Stay running and rebuild the output whenever a\n"
+            "                        file under the input changes; plugins and engines\n"
+            "                        are loaded once. Combine with --incremental to\n"
+            "                        reuse unchanged blocks. Ctrl+C stops.\n"
             "\n"
             "Examples:\n"
             "  %s ./src all.txt\n"
-            "  %s ./project result.json --format json --show-size\n"
+            "  %s ./project result.ndjson --format ndjson\n"
             "  %s ./code output.txt --include \"*.c\" \"*.h\" --exclude \"test*\"\n"
             "  %s ./kernel out.txt --exclude \"*.o\" \"*.ko\" --binary-skip\n"
             "  %s ./project out.txt --include \"src/*\" \"*.md\" --exclude \"*.tmp\"\n"
@@ -141,21 +208,15 @@ void print_usage(const char *program_name)
             program_name, program_name, program_name, program_name, program_name, program_name, program_name, program_name, program_name);
 }
 
-// Safe processing with shutdown checks
-static int safe_process_with_shutdown_check(FconcatContext *ctx, const ResolvedConfig *config)
+// Write a walked tree out as one complete document and flush it
+static int render_document(FconcatContext *ctx, FileTree *tree)
 {
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
     int result = 0;
 
-    // Check shutdown before each major operation
-    if (is_shutdown_requested())
-    {
-        printf("🛑 Shutdown requested before processing\n");
-        return -1;
-    }
-
     // Start document
     ctx->log(ctx, LOG_DEBUG, "Starting document");
-    result = format_engine_begin_document(((InternalContextState *)ctx->internal_state)->format_engine, ctx);
+    result = format_engine_begin_document(internal->format_engine, ctx);
     if (result != 0 || is_shutdown_requested())
     {
         if (is_shutdown_requested())
@@ -174,7 +235,7 @@ static int safe_process_with_shutdown_check(FconcatContext *ctx, const ResolvedC
     }
 
     ctx->log(ctx, LOG_DEBUG, "Processing directory structure");
-    result = process_directory_structure(ctx, config->input_directory, "", 0);
+    result = process_tree_structure(ctx, tree);
     if (result != 0 || is_shutdown_requested())
     {
         if (is_shutdown_requested())
@@ -201,7 +262,7 @@ static int safe_process_with_shutdown_check(FconcatContext *ctx, const ResolvedC
     }
 
     ctx->log(ctx, LOG_DEBUG, "Processing file contents");
-    result = process_directory_content(ctx, config->input_directory, "", 0);
+    result = process_tree_content(ctx, tree);
     if (result != 0 || is_shutdown_requested())
     {
         if (is_shutdown_requested())
@@ -227,9 +288,403 @@ static int safe_process_with_shutdown_check(FconcatContext *ctx, const ResolvedC
         return result != 0 ? result : -1;
     }
 
+    result = context_flush_output(ctx);
+    if (result != 0)
+    {
+        ctx->error(ctx, "Failed to write output file: %s", strerror(errno));
+        return result;
+    }
+
     return 0;
 }
 
+// Walk the input, or record just the files --files-from lists
+static int build_run_tree(FconcatContext *ctx, const ResolvedConfig *config, FileTree *tree)
+{
+    if (!config->files_from)
+        return file_tree_build(ctx, tree, config->input_directory, "", 0);
+
+    size_t size = 0;
+    char *list = file_tree_read_list(config->files_from, &size);
+    if (!list)
+    {
+        ctx->error(ctx, "Cannot read file list %s: %s", config->files_from, strerror(errno));
+        return -1;
+    }
+    int result = file_tree_build_from_list(ctx, tree, config->input_directory, list, size);
+    free(list);
+    return result;
+}
+
+// Safe processing with shutdown checks
+static int safe_process_with_shutdown_check(FconcatContext *ctx, const ResolvedConfig *config, FileTree *tree)
+{
+    int result = 0;
+
+    // Check shutdown before each major operation
+    if (is_shutdown_requested())
+    {
+        printf("🛑 Shutdown requested before processing\n");
+        return -1;
+    }
+
+    // Walk the input directory once; both passes below replay this tree
+    ctx->log(ctx, LOG_DEBUG, "Scanning directory tree");
+    result = build_run_tree(ctx, config, tree);
+    if (result != 0 || is_shutdown_requested())
+    {
+        if (is_shutdown_requested())
+            printf("🛑 Shutdown requested during directory scan\n");
+        return result != 0 ? result : -1;
+    }
+
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    if (internal->incremental && incremental_plan(internal->incremental, ctx, tree) != 0)
+    {
+        ctx->error(ctx, "Failed to plan the incremental run");
+        return -1;
+    }
+
+    return render_document(ctx, tree);
+}
+
+// The shards of one run, taken in turn by however many writers render them
+typedef struct
+{
+    const ResolvedConfig *config;
+    FileTree **shards;
+    size_t count;
+    atomic_size_t next;               // Next shard no writer has taken yet
+    atomic_bool failed;               // Set by a failing writer; the others stop after their shard
+    pthread_mutex_t report_mutex;     // Keeps each shard's line and metrics together
+} ShardRun;
+
+typedef struct
+{
+    ShardRun *run;
+    FconcatContext *ctx;
+    ProcessingStats stats;
+    int result;
+} ShardWriter;
+
+// Render shards off the shared cursor through ctx until none are left, each
+// to <output>.partNNN of its own. The context lets go of the last one before
+// it is closed.
+static int render_shards(ShardRun *run, FconcatContext *ctx)
+{
+    const ResolvedConfig *config = run->config;
+    FILE *output = NULL;
+    int result = 0;
+
+    while (!atomic_load(&run->failed))
+    {
+        size_t i = atomic_fetch_add(&run->next, 1);
+        if (i >= run->count)
+            break;
+
+        char *path = shard_output_path(config->output_file, i, run->count);
+        FILE *next_output = path ? fopen(path, "wb") : NULL;
+        if (!next_output)
+        {
+            ctx->error(ctx, "Cannot open output shard: %s", path ? path : config->output_file);
+            free(path);
+            result = -1;
+            break;
+        }
+
+        // The context lets go of the previous shard before it is closed
+        int restarted = context_restart(ctx, next_output);
+        if (output)
+            fclose(output);
+        output = next_output;
+        if (restarted != 0)
+        {
+            ctx->error(ctx, "Failed to write output shard: %s", strerror(errno));
+            free(path);
+            result = -1;
+            break;
+        }
+
+        result = render_document(ctx, run->shards[i]);
+        if (result != 0)
+        {
+            free(path);
+            break;
+        }
+
+        pthread_mutex_lock(&run->report_mutex);
+        printf("🧩 Shard %zu/%zu: %s (%zu files)\n", i + 1, run->count, path, run->shards[i]->file_count);
+        Metrics *metrics = context_metrics(ctx);
+        if (metrics)
+        {
+            fflush(stdout);
+            metrics_report(metrics, stderr, config->stats_report == STATS_REPORT_JSON);
+        }
+        pthread_mutex_unlock(&run->report_mutex);
+        free(path);
+    }
+
+    if (context_restart(ctx, NULL) != 0 && result == 0)
+    {
+        ctx->error(ctx, "Failed to write output shard: %s", strerror(errno));
+        result = -1;
+    }
+    if (output)
+        fclose(output);
+    if (result != 0)
+        atomic_store(&run->failed, true);
+    return result;
+}
+
+static void *shard_writer_main(void *arg)
+{
+    ShardWriter *writer = arg;
+    writer->result = render_shards(writer->run, writer->ctx);
+    return NULL;
+}
+
+static void shard_add_stats(ProcessingStats *total, const ProcessingStats *shard)
+{
+    total->total_files += shard->total_files;
+    total->processed_files += shard->processed_files;
+    total->skipped_files += shard->skipped_files;
+    total->total_bytes += shard->total_bytes;
+    total->processed_bytes += shard->processed_bytes;
+    total->filtered_bytes += shard->filtered_bytes;
+}
+
+// Shards are independent documents, so they are written at the same time,
+// one writer thread per shard up to --jobs, each with a context of its own
+// and an equal share of the content workers. A formatter or plugin loaded
+// from outside may keep state between callbacks that is not per context;
+// with one of those the shards go through ctx one after another.
+static int write_shards(ShardRun *run, FconcatContext *ctx)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    const ResolvedConfig *config = run->config;
+
+    int jobs = pipeline_resolve_jobs(config->jobs);
+    size_t writers = run->count < (size_t)jobs ? run->count : (size_t)jobs;
+    if (writers <= 1 || !format_engine_active_is_builtin(internal->format_engine) ||
+        (internal->plugin_manager && internal->plugin_manager->registry.count > 0))
+        return render_shards(run, ctx);
+
+    ResolvedConfig writer_config = *config;
+    writer_config.jobs = jobs / (int)writers;
+
+    ShardWriter *pool = calloc(writers, sizeof(ShardWriter));
+    pthread_t *threads = calloc(writers, sizeof(pthread_t));
+    bool *started = calloc(writers, sizeof(bool));
+    if (!pool || !threads || !started)
+    {
+        free(pool);
+        free(threads);
+        free(started);
+        return render_shards(run, ctx);
+    }
+
+    for (size_t i = 0; i < writers; i++)
+    {
+        pool[i].run = run;
+        pool[i].result = -1;
+        pool[i].ctx = create_fconcat_context(&writer_config, NULL, &pool[i].stats, internal->error_manager,
+                                             internal->memory_manager, internal->plugin_manager,
+                                             internal->format_engine, internal->filter_engine);
+        started[i] = pool[i].ctx && pthread_create(&threads[i], NULL, shard_writer_main, &pool[i]) == 0;
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < writers; i++)
+    {
+        if (started[i])
+            pthread_join(threads[i], NULL);
+        else if (pool[i].ctx)
+            pool[i].result = render_shards(run, pool[i].ctx); // No thread for it: take its share here
+        else
+            pool[i].result = 0;
+        if (pool[i].result != 0)
+            result = -1;
+        shard_add_stats(internal->stats, &pool[i].stats);
+        destroy_fconcat_context(pool[i].ctx);
+    }
+
+    // Whatever no writer got to, for want of a context, is rendered here
+    if (result == 0)
+        result = render_shards(run, ctx);
+
+    free(pool);
+    free(threads);
+    free(started);
+    return result;
+}
+
+// --shard-size/--shards: walk once, then write each contiguous group of
+// files as a document of its own, with its own structure header, to
+// <output>.partNNN. Each shard reports its own line and metrics once done.
+static int process_shards(FconcatContext *ctx, const ResolvedConfig *config, FileTree *tree)
+{
+    if (is_shutdown_requested())
+    {
+        printf("🛑 Shutdown requested before processing\n");
+        return -1;
+    }
+
+    ctx->log(ctx, LOG_DEBUG, "Scanning directory tree");
+    int result = build_run_tree(ctx, config, tree);
+    if (result != 0 || is_shutdown_requested())
+    {
+        if (is_shutdown_requested())
+            printf("🛑 Shutdown requested during directory scan\n");
+        return result != 0 ? result : -1;
+    }
+
+    ShardRun run = {.config = config};
+    if (config->shards > 0)
+        result = shard_split_evenly(tree, (size_t)config->shards, &run.shards, &run.count);
+    else
+        result = shard_split_by_budget(tree, config->shard_size, config->shard_unit, &run.shards, &run.count);
+    if (result != 0)
+    {
+        ctx->error(ctx, "Failed to split the output into shards");
+        return -1;
+    }
+
+    // What the walk counted, before the shards count their own
+    Metrics *metrics = context_metrics(ctx);
+    if (metrics)
+    {
+        fflush(stdout);
+        metrics_report(metrics, stderr, config->stats_report == STATS_REPORT_JSON);
+    }
+
+    atomic_init(&run.next, 0);
+    atomic_init(&run.failed, false);
+    pthread_mutex_init(&run.report_mutex, NULL);
+    result = write_shards(&run, ctx);
+    pthread_mutex_destroy(&run.report_mutex);
+
+    shard_free(run.shards, run.count);
+    return result;
+}
+
+static bool watch_should_stop(void)
+{
+    return is_shutdown_requested();
+}
+
+// Open the output of one run; incremental runs replace it only once complete
+static FILE *open_run_output(const ResolvedConfig *config, Incremental **incremental)
+{
+    *incremental = NULL;
+    if (!config->incremental_cache)
+        return fopen(config->output_file, "wb");
+
+    *incremental = incremental_open(config, config->incremental_cache, config->output_file);
+    return *incremental ? incremental_create_output(*incremental) : NULL;
+}
+
+// --watch: the context, engines and plugins stay up and the output is
+// rebuilt each time the input settles after a change. A failed rebuild is
+// reported and the next change tries again.
+static int watch_and_rebuild(FconcatContext *ctx, const ResolvedConfig *config, ProcessingStats *stats,
+                             FileTree *tree, FILE **output_file, Incremental **incremental)
+{
+    InternalContextState *internal = (InternalContextState *)ctx->internal_state;
+    const char *ignored[] = {config->output_file, config->incremental_cache};
+    Watcher *watcher = watcher_create(config->input_directory, ignored, 2);
+    if (!watcher || watcher_sync(watcher, tree) != 0)
+    {
+        ctx->error(ctx, "Cannot watch %s: %s", config->input_directory, strerror(errno));
+        watcher_destroy(watcher);
+        return -1;
+    }
+
+    printf("👀 Watching %s for changes (Ctrl+C to stop)\n", config->input_directory);
+    fflush(stdout);
+
+    int result = 0;
+    for (;;)
+    {
+        int changed = watcher_wait(watcher, watch_should_stop);
+        if (changed <= 0)
+        {
+            if (changed < 0)
+            {
+                ctx->error(ctx, "Watching failed: %s", strerror(errno));
+                result = -1;
+            }
+            break;
+        }
+
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        // The previous output is complete; an incremental run copies from it
+        Incremental *next_incremental = NULL;
+        FILE *next_output = open_run_output(config, &next_incremental);
+        if (!next_output)
+        {
+            ctx->error(ctx, "Cannot open output file: %s", config->output_file);
+            incremental_close(next_incremental);
+            continue;
+        }
+
+        int restarted = context_restart(ctx, next_output);
+        format_engine_configure(internal->format_engine, config, next_output);
+        fclose(*output_file);
+        incremental_close(*incremental);
+        *output_file = next_output;
+        *incremental = next_incremental;
+        internal->incremental = next_incremental;
+        if (restarted != 0)
+        {
+            ctx->error(ctx, "Failed to restart the output: %s", strerror(errno));
+            continue;
+        }
+
+        memset(stats, 0, sizeof(*stats));
+        stats->start_time = (double)start.tv_sec + start.tv_nsec / 1000000000.0;
+        file_tree_clear(tree);
+
+        int run = safe_process_with_shutdown_check(ctx, config, tree);
+        if (run == 0 && *incremental && incremental_commit(*incremental, *output_file) != 0)
+            run = -1;
+        if (is_shutdown_requested())
+            break;
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double elapsed = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+        if (run == 0)
+        {
+            printf("🔄 Rebuilt after %zu change(s) in %.1f ms: %zu files", watcher_event_count(watcher), elapsed,
+                   stats->processed_files);
+            if (*incremental)
+                printf(", %zu reused", incremental_reused_count(*incremental));
+            printf("\n");
+        }
+        else
+        {
+            ctx->error(ctx, "Rebuild failed; waiting for the next change");
+        }
+        fflush(stdout);
+
+        Metrics *metrics = context_metrics(ctx);
+        if (metrics && run == 0)
+            metrics_report(metrics, stderr, config->stats_report == STATS_REPORT_JSON);
+
+        // New directories get watched, removed ones have dropped out
+        if (watcher_sync(watcher, tree) != 0)
+        {
+            ctx->error(ctx, "Cannot watch %s: %s", config->input_directory, strerror(errno));
+            result = -1;
+            break;
+        }
+    }
+
+    watcher_destroy(watcher);
+    return result;
+}
+
 int main(int argc, char *argv[])
 {
     struct timespec start_time, end_time;
@@ -292,7 +747,9 @@ int main(int argc, char *argv[])
     FormatEngine *format_engine = NULL;
     FilterEngine *filter_engine = NULL;
     FILE *output_file = NULL;
+    Incremental *incremental = NULL;
     FconcatContext *ctx = NULL;
+    FileTree *tree = NULL;
     int result = -1;
 
     // Check for early shutdown
@@ -352,14 +809,65 @@ int main(int argc, char *argv[])
         goto cleanup;
     }
 
-    // Open output file
-    output_file = fopen(config->output_file, "wb");
-    if (!output_file)
+    if (config->compression != OUTPUT_COMPRESS_NONE && !compress_available(config->compression))
     {
-        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot open output file: %s", config->output_file);
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID, "This build has no %s support",
+                     compress_name(config->compression));
         goto cleanup;
     }
 
+    // Reused blocks are copied out of the previous output, which then is compressed
+    if (config->compression != OUTPUT_COMPRESS_NONE && config->incremental_cache)
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID, "--compress cannot be combined with --incremental");
+        goto cleanup;
+    }
+
+    if (config->watch && !watcher_supported())
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID, "--watch is not supported on this platform");
+        goto cleanup;
+    }
+
+    // Standard input is read once, but every rebuild reads the list again
+    if (config->watch && config->files_from && strcmp(config->files_from, "-") == 0)
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID, "--watch cannot read --files-from from stdin");
+        goto cleanup;
+    }
+
+    // Each shard is a fresh document: nothing to reuse or rebuild in place
+    bool sharded = config->shard_size > 0 || config->shards > 0;
+    if (config->shard_size > 0 && config->shards > 0)
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID, "--shard-size cannot be combined with --shards");
+        goto cleanup;
+    }
+    if (sharded && (config->incremental_cache || config->watch))
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_CONFIG_INVALID,
+                     "--shard-size and --shards cannot be combined with --incremental or --watch");
+        goto cleanup;
+    }
+
+    // Open output file; shards open theirs once the tree is split
+    if (!sharded)
+    {
+        output_file = open_run_output(config, &incremental);
+        if (config->incremental_cache && !incremental)
+        {
+            ERROR_REPORT(g_error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot create incremental manifest: %s",
+                         config->incremental_cache);
+            goto cleanup;
+        }
+        if (!output_file)
+        {
+            ERROR_REPORT(g_error_manager, FCONCAT_ERROR_FILE_NOT_FOUND, "Cannot open output file: %s",
+                         config->output_file);
+            goto cleanup;
+        }
+    }
+
     // Configure engines
     if (format_engine_configure(format_engine, config, output_file) != 0)
     {
@@ -395,6 +903,8 @@ int main(int argc, char *argv[])
         goto cleanup;
     }
 
+    ((InternalContextState *)ctx->internal_state)->incremental = incremental;
+
     // Store context globally for signal handler
     g_context = ctx;
 
@@ -407,6 +917,9 @@ int main(int argc, char *argv[])
 
     plugin_manager_initialize_plugins(g_plugin_manager, ctx);
 
+    // Rules and filter plugins are final from here on; evaluation goes lock-free
+    filter_engine_seal(filter_engine);
+
     // Check shutdown after plugin initialization
     if (is_shutdown_requested())
     {
@@ -418,12 +931,30 @@ int main(int argc, char *argv[])
     ctx->log(ctx, LOG_DEBUG, "Output file: %s\n", config->output_file);
     ctx->log(ctx, LOG_DEBUG, "Format: %s\n", config->output_format);
     ctx->log(ctx, LOG_DEBUG, "Plugins: %d loaded\n", g_plugin_manager->registry.count);
+    ctx->log(ctx, LOG_DEBUG, "Binary scan kernel: %s\n", filter_scan_kernel_name());
 
     // Begin processing with shutdown checks
     ctx->log(ctx, LOG_DEBUG, "Beginning processing");
 
+    tree = file_tree_create();
+    if (!tree)
+    {
+        ERROR_REPORT(g_error_manager, FCONCAT_ERROR_OUT_OF_MEMORY, "Failed to create directory tree");
+        goto cleanup;
+    }
+
     // NO MORE ALARM CALLS - let it run naturally
-    result = safe_process_with_shutdown_check(ctx, config);
+    if (sharded)
+        result = process_shards(ctx, config, tree);
+    else
+        result = safe_process_with_shutdown_check(ctx, config, tree);
+
+    if (result == 0 && incremental && !is_shutdown_requested() &&
+        incremental_commit(incremental, output_file) != 0)
+    {
+        ctx->error(ctx, "Failed to save incremental state: %s", strerror(errno));
+        result = -1;
+    }
 
     if (result == 0 && !is_shutdown_requested())
     {
@@ -436,11 +967,38 @@ int main(int argc, char *argv[])
         printf("⏱️  Processing time: %.3f seconds\n", elapsed);
         printf("📊 Files processed: %zu\n", stats.processed_files);
         printf("📈 Bytes processed: %zu\n", stats.processed_bytes);
+        if (incremental)
+            printf("♻️  Files reused: %zu\n", incremental_reused_count(incremental));
+        if (config->dedup)
+        {
+            DedupStats dedup = dedup_index_stats(((InternalContextState *)ctx->internal_state)->dedup);
+            printf("🔁 Duplicates referenced: %zu (%llu bytes)\n", dedup.duplicates,
+                   (unsigned long long)dedup.bytes_saved);
+        }
+
+        // Each shard had a sink of its own, closed with the shard
+        if (config->compression != OUTPUT_COMPRESS_NONE && !sharded)
+        {
+            OutputSinkStats sink_stats = output_sink_get_stats(((InternalContextState *)ctx->internal_state)->output_sink);
+            printf("🗜️  Compressed: %zu -> %zu bytes (%s)\n", sink_stats.uncompressed, sink_stats.bytes_written,
+                   compress_name(config->compression));
+        }
 
         // Memory statistics
         MemoryStats memory_stats = memory_get_stats(g_memory_manager);
         printf("🧠 Memory usage: %zu bytes peak\n", memory_stats.peak_usage);
 
+        // Each shard has reported its own already
+        Metrics *metrics = context_metrics(ctx);
+        if (metrics && !sharded)
+        {
+            fflush(stdout);
+            metrics_report(metrics, stderr, config->stats_report == STATS_REPORT_JSON);
+        }
+
+        if (config->watch && !is_shutdown_requested())
+            result = watch_and_rebuild(ctx, config, &stats, tree, &output_file, &incremental);
+
         // Interactive mode (only if not shutting down)
         if (config->interactive && !is_shutdown_requested())
         {
@@ -478,6 +1036,12 @@ cleanup:
         g_plugin_manager = NULL;
     }
 
+    if (tree)
+    {
+        file_tree_destroy(tree);
+        tree = NULL;
+    }
+
     if (ctx)
     {
         destroy_fconcat_context(ctx);
@@ -489,6 +1053,9 @@ cleanup:
         fclose(output_file);
     }
 
+    // Removes whatever a failed incremental run left behind
+    incremental_close(incremental);
+
     if (format_engine)
     {
         format_engine_destroy(format_engine);
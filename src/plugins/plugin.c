@@ -1,6 +1,9 @@
 #include "plugin.h"
 #include "../core/error.h"
+#include "../core/context.h"
 #include "../core/memory.h"
+#include "../core/metrics.h"
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -226,12 +229,29 @@ int plugin_manager_load_plugin(PluginManager *manager, const char *path, char **
         }
     }
 
-    // Try filter plugin SECOND
-    void *get_filter_plugin_func = dlsym(handle, "get_filter_plugin");
-    if (get_filter_plugin_func)
+    // Try filter plugin SECOND, through its batched interface if it has one
+    const FilterPluginV2 *plugin_v2 = NULL;
+    void *get_filter_plugin_v2_func = dlsym(handle, "get_filter_plugin_v2");
+    if (get_filter_plugin_v2_func)
     {
-        FilterPlugin *(*get_filter_plugin)(void) = (FilterPlugin * (*)(void)) get_filter_plugin_func;
-        FilterPlugin *plugin = get_filter_plugin();
+        const FilterPluginV2 *(*get_filter_plugin_v2)(void) =
+            (const FilterPluginV2 *(*)(void))get_filter_plugin_v2_func;
+        plugin_v2 = get_filter_plugin_v2();
+        // Too old a build to carry filter_chunks: fall back to the v1 entry point
+        if (plugin_v2 && (plugin_v2->abi_version < FILTER_PLUGIN_ABI_V2 ||
+                          plugin_v2->size < offsetof(FilterPluginV2, filter_chunks) + sizeof(plugin_v2->filter_chunks)))
+            plugin_v2 = NULL;
+    }
+
+    void *get_filter_plugin_func = plugin_v2 ? NULL : dlsym(handle, "get_filter_plugin");
+    if (get_filter_plugin_func || plugin_v2)
+    {
+        FilterPlugin *plugin = plugin_v2 ? (FilterPlugin *)&plugin_v2->base : NULL;
+        if (get_filter_plugin_func)
+        {
+            FilterPlugin *(*get_filter_plugin)(void) = (FilterPlugin * (*)(void)) get_filter_plugin_func;
+            plugin = get_filter_plugin();
+        }
 
         if (plugin)
         {
@@ -251,14 +271,19 @@ int plugin_manager_load_plugin(PluginManager *manager, const char *path, char **
             meta->author = "Unknown";
             meta->type = PLUGIN_TYPE_FILTER;
             meta->initialized = false;
-            meta->plugin_data = malloc(sizeof(FilterPlugin));
+            // A v2 copy starts with its FilterPlugin, so both read it the same way
+            meta->plugin_data = calloc(1, plugin_v2 ? sizeof(FilterPluginV2) : sizeof(FilterPlugin));
             if (!meta->plugin_data)
             {
                 pthread_mutex_unlock(&manager->registry.mutex);
                 dlclose(handle);
                 return -1;
             }
-            memcpy(meta->plugin_data, plugin, sizeof(FilterPlugin));
+            if (plugin_v2)
+                memcpy(meta->plugin_data, plugin_v2,
+                       plugin_v2->size < sizeof(FilterPluginV2) ? plugin_v2->size : sizeof(FilterPluginV2));
+            else
+                memcpy(meta->plugin_data, plugin, sizeof(FilterPlugin));
             meta->handle = handle;
 
             // Store plugin parameters
@@ -301,7 +326,11 @@ int plugin_manager_load_plugin(PluginManager *manager, const char *path, char **
             {
                 printf("Loading filter plugin: %s (will initialize later)\n", plugin->name);
                 extern int filter_engine_register_plugin(struct FilterEngine * engine, FilterPlugin * plugin);
-                filter_engine_register_plugin(manager->filter_engine, plugin);
+                extern int filter_engine_register_plugin_v2(struct FilterEngine * engine, const FilterPluginV2 *plugin);
+                if (plugin_v2)
+                    filter_engine_register_plugin_v2(manager->filter_engine, (const FilterPluginV2 *)meta->plugin_data);
+                else
+                    filter_engine_register_plugin(manager->filter_engine, plugin);
             }
 
             pthread_mutex_unlock(&manager->registry.mutex);
@@ -649,4 +678,213 @@ int plugin_manager_call_plugin_method(PluginManager *manager, const char *plugin
         return -1;
 
     return -1;
-}
\ No newline at end of file
+}
+int plugin_manager_content_plugins(PluginManager *manager, ContentPlugin **plugins, int max)
+{
+    if (!manager || !plugins || max <= 0)
+        return 0;
+
+    pthread_mutex_lock(&manager->registry.mutex);
+
+    int count = 0;
+    for (int i = 0; i < manager->registry.count && count < max; i++)
+    {
+        PluginMetadata *meta = &manager->registry.plugins[i];
+        if (meta->type == PLUGIN_TYPE_CONTENT && meta->initialized && meta->plugin_data)
+            plugins[count++] = (ContentPlugin *)meta->plugin_data;
+    }
+
+    pthread_mutex_unlock(&manager->registry.mutex);
+    return count;
+}
+
+// ============================================================================
+// CONTENT STAGE
+// ============================================================================
+
+int content_chain_begin(ContentChain *chain, ContentPlugin *const *plugins, int count,
+                        FconcatContext *ctx, const char *path, FileInfo *info)
+{
+    chain->count = 0;
+    for (int i = 0; i < count && chain->count < MAX_PLUGINS; i++)
+    {
+        ContentPlugin *plugin = plugins[i];
+        if (!plugin || !plugin->process_chunk)
+            continue;
+        if (info && info->is_binary && !(plugin->capabilities & PLUGIN_CAP_BINARY_SUPPORT))
+            continue;
+
+        PluginFileContext *file_ctx = NULL;
+        if (plugin->file_start)
+        {
+            file_ctx = plugin->file_start(ctx, path, (struct FileInfo *)info);
+            if (!file_ctx)
+                continue; // Not interested in this file
+        }
+
+        int slot = chain->count++;
+        chain->plugins[slot] = plugin;
+        chain->files[slot] = file_ctx;
+        chain->held[slot] = (ContentHeld){NULL, 0, 0};
+    }
+    return chain->count;
+}
+
+static int content_held_append(ContentHeld *held, const char *data, size_t size)
+{
+    if (size > held->capacity - held->size)
+    {
+        size_t capacity = held->capacity ? held->capacity : 4096;
+        while (capacity - held->size < size)
+        {
+            if (capacity > SIZE_MAX / 2)
+                return -1;
+            capacity *= 2;
+        }
+        char *grown = realloc(held->data, capacity);
+        if (!grown)
+            return -1;
+        held->data = grown;
+        held->capacity = capacity;
+    }
+
+    memcpy(held->data + held->size, data, size);
+    held->size += size;
+    return 0;
+}
+
+// Run data through the plugins from stage on. It stops at the first plugin
+// that wants whole files, which holds it, or emits what the last one gives.
+// Buffers a stage returns are released as soon as the next has seen them.
+static int content_chain_run(ContentChain *chain, FconcatContext *ctx, int stage, const char *data, size_t size,
+                             ContentEmitFn emit, void *user_data)
+{
+    const char *current = data;
+    size_t current_size = size;
+    char *owned = NULL;
+    int result = 0;
+
+    for (int i = stage; i < chain->count; i++)
+    {
+        ContentPlugin *plugin = chain->plugins[i];
+        if (!(plugin->capabilities & PLUGIN_CAP_STREAMING))
+        {
+            result = content_held_append(&chain->held[i], current, current_size);
+            context_scratch_release(ctx, owned);
+            return result;
+        }
+
+        // An empty chunk is the end-of-file flush, which only the plugin
+        // that is being flushed gets; later plugins just see nothing
+        if (current_size == 0 && i > stage)
+            break;
+
+        char *output = NULL;
+        size_t output_size = 0;
+        int status = plugin->process_chunk(ctx, chain->files[i], current, current_size, &output, &output_size);
+        if (status == 0 && output && output != current)
+        {
+            context_scratch_release(ctx, owned);
+            owned = output;
+            current = output;
+            current_size = output_size;
+        }
+        else if (current_size == 0)
+        {
+            break; // Nothing was held back
+        }
+    }
+
+    if (current_size > 0)
+        result = emit(ctx, current, current_size, user_data);
+    context_scratch_release(ctx, owned);
+    return result;
+}
+
+int content_chain_write(ContentChain *chain, FconcatContext *ctx, const char *data, size_t size,
+                        ContentEmitFn emit, void *user_data)
+{
+    if (!chain || !emit)
+        return -1;
+    if (size == 0)
+        return 0; // Empty chunks mean end of file to streaming plugins
+
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    int result = content_chain_run(chain, ctx, 0, data, size, emit, user_data);
+    metrics_end(metrics, METRICS_PLUGINS, start, size);
+    return result;
+}
+
+// Give plugin i its end of input: the flush call when it streams, the
+// whole file otherwise, and pass what it returns down the chain
+static int content_chain_finish_stage(ContentChain *chain, FconcatContext *ctx, int i,
+                                      ContentEmitFn emit, void *user_data)
+{
+    ContentPlugin *plugin = chain->plugins[i];
+    if (plugin->capabilities & PLUGIN_CAP_STREAMING)
+        return content_chain_run(chain, ctx, i, "", 0, emit, user_data);
+
+    ContentHeld held = chain->held[i];
+    chain->held[i] = (ContentHeld){NULL, 0, 0};
+
+    char *output = NULL;
+    size_t output_size = 0;
+    const char *input = held.data ? held.data : "";
+    int status = plugin->process_chunk(ctx, chain->files[i], input, held.size, &output, &output_size);
+
+    int result = 0;
+    if (status == 0 && output && output != input)
+    {
+        result = output_size ? content_chain_run(chain, ctx, i + 1, output, output_size, emit, user_data) : 0;
+        context_scratch_release(ctx, output);
+    }
+    else if (held.size > 0)
+    {
+        result = content_chain_run(chain, ctx, i + 1, held.data, held.size, emit, user_data);
+    }
+
+    free(held.data);
+    return result;
+}
+
+int content_chain_end(ContentChain *chain, FconcatContext *ctx, ContentEmitFn emit, void *user_data)
+{
+    if (!chain || !emit)
+        return -1;
+
+    // In chain order, so whatever a stage flushes reaches the later ones
+    // before they are finished themselves
+    Metrics *metrics = context_metrics(ctx);
+    uint64_t start = metrics_begin(metrics);
+    int result = 0;
+    for (int i = 0; i < chain->count && result == 0; i++)
+        result = content_chain_finish_stage(chain, ctx, i, emit, user_data);
+    metrics_end(metrics, METRICS_PLUGINS, start, 0);
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        ContentPlugin *plugin = chain->plugins[i];
+        if (result == 0 && plugin->file_end)
+            plugin->file_end(ctx, chain->files[i]);
+    }
+
+    content_chain_abort(chain, ctx);
+    return result;
+}
+
+void content_chain_abort(ContentChain *chain, FconcatContext *ctx)
+{
+    if (!chain)
+        return;
+
+    for (int i = 0; i < chain->count; i++)
+    {
+        ContentPlugin *plugin = chain->plugins[i];
+        if (plugin->file_cleanup)
+            plugin->file_cleanup(ctx, chain->files[i]);
+        free(chain->held[i].data);
+        chain->held[i] = (ContentHeld){NULL, 0, 0};
+    }
+    chain->count = 0;
+}
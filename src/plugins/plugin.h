@@ -50,6 +50,28 @@ extern "C"
         struct FilterEngine *filter_engine;
     } PluginManager;
 
+    // Output of the content stage, in order; non-zero stops the file
+    typedef int (*ContentEmitFn)(FconcatContext *ctx, const char *data, size_t size, void *user_data);
+
+    // Collected input of a plugin that wants whole files
+    typedef struct
+    {
+        char *data;
+        size_t size;
+        size_t capacity;
+    } ContentHeld;
+
+    // Per-file state of the content plugins (see fconcat_content.h for the
+    // contract). Streaming plugins pass each chunk on as it comes; a plugin
+    // without PLUGIN_CAP_STREAMING holds what reaches it until the end.
+    typedef struct
+    {
+        ContentPlugin *plugins[MAX_PLUGINS];
+        PluginFileContext *files[MAX_PLUGINS];
+        ContentHeld held[MAX_PLUGINS];
+        int count;
+    } ContentChain;
+
     // Plugin functions
     PluginManager *plugin_manager_create(void);
     void plugin_manager_destroy(PluginManager *manager, FconcatContext *ctx);
@@ -62,6 +84,21 @@ extern "C"
     int plugin_manager_set_plugin_data(PluginManager *manager, const char *plugin_name, void *data, size_t size);
     int plugin_manager_call_plugin_method(PluginManager *manager, const char *plugin_name, const char *method, void *args);
 
+    // Initialized content plugins in load order; returns how many
+    int plugin_manager_content_plugins(PluginManager *manager, ContentPlugin **plugins, int max);
+
+    // Start a file through the plugins that take it. Returns how many do;
+    // with 0 the file needs no content stage at all.
+    int content_chain_begin(ContentChain *chain, ContentPlugin *const *plugins, int count,
+                            FconcatContext *ctx, const char *path, FileInfo *info);
+    // Feed the next chunk; whatever comes out of the last plugin is emitted
+    int content_chain_write(ContentChain *chain, FconcatContext *ctx, const char *data, size_t size,
+                            ContentEmitFn emit, void *user_data);
+    // Flush held output, then end and clean up every plugin's file state
+    int content_chain_end(ContentChain *chain, FconcatContext *ctx, ContentEmitFn emit, void *user_data);
+    // Clean up without producing more output (file excluded or failed)
+    void content_chain_abort(ContentChain *chain, FconcatContext *ctx);
+
     // Plugin parameter access
     const char *plugin_manager_get_parameter(PluginManager *manager, const char *plugin_name, const char *param_name);
     int plugin_manager_get_parameter_count(PluginManager *manager, const char *plugin_name);
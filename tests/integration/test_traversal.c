@@ -13,6 +13,8 @@
  */
 
 #include "../unit/test_framework.h"
+#include "../../include/fconcat_library.h"
+#include "../../src/format/format_indexed.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,6 +24,9 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
 
 /* 
  * Disable format-truncation warnings for this file.
@@ -138,6 +143,18 @@ static int read_output_file(const char *filepath, char *buf, size_t bufsize)
     return 0;
 }
 
+/**
+ * Read a file that may hold NUL bytes; returns its size, 0 when unreadable
+ */
+static size_t read_binary_file(const char *filepath, char *buf, size_t bufsize)
+{
+    FILE *f = fopen(filepath, "rb");
+    if (!f) return 0;
+    size_t n = fread(buf, 1, bufsize, f);
+    fclose(f);
+    return n;
+}
+
 /**
  * Get path for test output file
  */
@@ -301,6 +318,729 @@ TEST(integ_multiple_files)
     return 0;
 }
 
+TEST(integ_structure_and_content_agree)
+{
+    create_test_root();
+    create_dir("agree");
+    create_dir("agree/sub");
+    create_file("agree/one.txt", "first");
+    create_file("agree/sub/two.txt", "second");
+    create_file("agree/sub/three.txt", "third");
+    
+    char cmdout[1024];
+    char content[16384];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/agree", test_root);
+    
+    int exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path());
+    
+    ASSERT_EQ(0, exit_code);
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    /* Both passes replay the same walk: one structure entry and one content block per file */
+    ASSERT_EQ(3, count_occurrences(content, "📄 "));
+    ASSERT_EQ(3, count_occurrences(content, "// File: "));
+    ASSERT_EQ(1, count_occurrences(content, "📁 sub"));
+    ASSERT_TRUE(output_contains(content, "// File: sub/two.txt"));
+    
+    return 0;
+}
+
+TEST(integ_jobs_output_matches_serial)
+{
+    create_test_root();
+    create_dir("jobs");
+    create_dir("jobs/a");
+    create_dir("jobs/b");
+    char relpath[64];
+    char body[64];
+    for (int i = 0; i < 12; i++) {
+        snprintf(relpath, sizeof(relpath), "jobs/%s/file_%02d.txt", (i % 2) ? "a" : "b", i);
+        snprintf(body, sizeof(body), "content of file %d", i);
+        create_file(relpath, body);
+    }
+    
+    char cmdout[1024];
+    static char serial[32768];
+    static char parallel[32768];
+    char input_path[TEST_PATH_MAX];
+    char parallel_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/jobs", test_root);
+    snprintf(parallel_path, sizeof(parallel_path), "%s/output_jobs.txt", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path()));
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --jobs 4", input_path, parallel_path));
+    ASSERT_EQ(0, read_output_file(get_output_path(), serial, sizeof(serial)));
+    ASSERT_EQ(0, read_output_file(parallel_path, parallel, sizeof(parallel)));
+    
+    /* Workers may finish in any order but output is committed in tree order */
+    ASSERT_EQ(12, count_occurrences(parallel, "// File: "));
+    ASSERT_STR_EQ(serial, parallel);
+    
+    return 0;
+}
+
+TEST(integ_parallel_walk_matches_serial)
+{
+    create_test_root();
+    create_dir("pwalk");
+    char relpath[128];
+    char body[64];
+    /* Wide at the top and deep down one branch, so workers steal */
+    for (int d = 0; d < 6; d++) {
+        snprintf(relpath, sizeof(relpath), "pwalk/d%d", d);
+        create_dir(relpath);
+        for (int f = 0; f < 3; f++) {
+            snprintf(relpath, sizeof(relpath), "pwalk/d%d/f%d.txt", d, f);
+            snprintf(body, sizeof(body), "dir %d file %d", d, f);
+            create_file(relpath, body);
+        }
+    }
+    create_dir("pwalk/d0/x");
+    create_dir("pwalk/d0/x/y");
+    create_dir("pwalk/d0/x/y/z");
+    create_file("pwalk/d0/x/y/z/deep.txt", "deep");
+    create_dir("pwalk/d3/skipme");
+    create_file("pwalk/d3/skipme/hidden.txt", "hidden");
+    /* A followed link back up must be cut off the same way */
+    create_symlink_file("../..", "pwalk/d0/x/up");
+    
+    char cmdout[1024];
+    static char serial[65536];
+    static char parallel[65536];
+    char input_path[TEST_PATH_MAX];
+    char parallel_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/pwalk", test_root);
+    snprintf(parallel_path, sizeof(parallel_path), "%s/output_pwalk.txt", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks follow --exclude skipme",
+                             input_path, get_output_path()));
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks follow --exclude skipme -j 4",
+                             input_path, parallel_path));
+    ASSERT_EQ(0, read_output_file(get_output_path(), serial, sizeof(serial)));
+    ASSERT_EQ(0, read_output_file(parallel_path, parallel, sizeof(parallel)));
+    
+    /* Listings are collected on any thread but replayed in serial order */
+    ASSERT_NOT_NULL(strstr(parallel, "deep.txt"));
+    ASSERT_NULL(strstr(parallel, "hidden.txt"));
+    ASSERT_STR_EQ(serial, parallel);
+    
+    return 0;
+}
+
+TEST(integ_io_engines_match_sync)
+{
+    create_test_root();
+    create_dir("aio");
+    create_dir("aio/sub");
+    char relpath[64];
+    char body[64];
+    for (int i = 0; i < 40; i++) {
+        snprintf(relpath, sizeof(relpath), "aio/%sfile_%02d.txt", (i % 3) ? "sub/" : "", i);
+        snprintf(body, sizeof(body), "read ahead %d", i);
+        create_file(relpath, body);
+    }
+    create_file("aio/empty.txt", "");
+    
+    char cmdout[1024];
+    static char sync_out[32768];
+    static char engine_out[32768];
+    char input_path[TEST_PATH_MAX];
+    char engine_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/aio", test_root);
+    snprintf(engine_path, sizeof(engine_path), "%s/output_aio.txt", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path()));
+    ASSERT_EQ(0, read_output_file(get_output_path(), sync_out, sizeof(sync_out)));
+    
+    /* A shallow queue forces reads to be issued while others complete */
+    const char *engines[] = {"uring --io-depth 4", "threads --io-depth 4", "auto"};
+    for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++) {
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --io-engine %s",
+                                 input_path, engine_path, engines[i]));
+        ASSERT_EQ(0, read_output_file(engine_path, engine_out, sizeof(engine_out)));
+        ASSERT_EQ(41, count_occurrences(engine_out, "// File: "));
+        ASSERT_STR_EQ(sync_out, engine_out);
+    }
+    
+    return 0;
+}
+
+TEST(integ_large_file_copied_intact)
+{
+    create_test_root();
+    create_dir("large");
+    
+    /* Big enough for the zero-copy path, with a tail that is not chunk aligned */
+    static char big[200 * 1024 + 123];
+    for (size_t i = 0; i < sizeof(big) - 1; i++)
+        big[i] = (i % 64 == 63) ? '\n' : (char)('A' + (i / 64) % 26);
+    big[sizeof(big) - 1] = '\0';
+    create_file("large/a_big.txt", big);
+    create_file("large/b_small.txt", "after the big file");
+    
+    char cmdout[1024];
+    static char content[256 * 1024];
+    static char expected[256 * 1024];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/large", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path()));
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    
+    /* Entries come in directory order, so check each file on its own */
+    snprintf(expected, sizeof(expected), "// File: a_big.txt\n%s\n\n", big);
+    ASSERT_TRUE(output_contains(content, expected));
+    ASSERT_TRUE(output_contains(content, "// File: b_small.txt\nafter the big file\n\n"));
+    
+    return 0;
+}
+
+TEST(integ_multi_megabyte_file_intact)
+{
+    create_test_root();
+    create_dir("huge");
+    
+    /* Small enough for a worker to buffer, large enough that its reads
+     * grow past the first chunk */
+    size_t size = 3 * 1024 * 1024 + 4321;
+    char *big = malloc(size + 1);
+    ASSERT_NOT_NULL(big);
+    for (size_t i = 0; i < size; i++)
+        big[i] = (i % 100 == 99) ? '\n' : (char)('a' + (i / 100) % 26);
+    big[size] = '\0';
+    create_file("huge/log.txt", big);
+    
+    char cmdout[1024];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/huge", test_root);
+    size_t out_size = size + 4096;
+    char *content = malloc(out_size);
+    char *expected = malloc(out_size);
+    ASSERT_NOT_NULL(content);
+    ASSERT_NOT_NULL(expected);
+    snprintf(expected, out_size, "// File: log.txt\n%s\n\n", big);
+    
+    /* Written directly, and buffered by a worker */
+    const char *modes[] = {"", "-j 2"};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' %s", input_path, get_output_path(), modes[i]));
+        ASSERT_EQ(0, read_output_file(get_output_path(), content, out_size));
+        ASSERT_TRUE(output_contains(content, expected));
+    }
+    
+    free(expected);
+    free(content);
+    free(big);
+    return 0;
+}
+
+TEST(integ_sample_keeps_head_and_tail)
+{
+    create_test_root();
+    create_dir("logs");
+    
+    /* 20000 lines of 10 bytes: read with pread, not preloaded */
+    size_t lines = 20000;
+    char *log = malloc(lines * 10 + 1);
+    ASSERT_NOT_NULL(log);
+    for (size_t i = 0; i < lines; i++)
+        snprintf(log + i * 10, 11, "line %04zu\n", i % 10000);
+    create_file("logs/app.log", log);
+    create_file("logs/data.dat", log);
+    create_file("logs/note.txt", "left alone\n");
+    
+    /* Text for longer than the sampled head, binary further in */
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/logs/mixed.dat", test_root);
+    FILE *mixed = fopen(input_path, "wb");
+    ASSERT_NOT_NULL(mixed);
+    log[100] = '\0';
+    fwrite(log, 1, lines * 10, mixed);
+    fclose(mixed);
+    log[100] = 'l';
+    
+    char cmdout[1024];
+    snprintf(input_path, sizeof(input_path), "%s/logs", test_root);
+    size_t out_size = lines * 10 * 3;
+    char *content = malloc(out_size);
+    ASSERT_NOT_NULL(content);
+    
+    const char *modes[] = {"", "-j 2"};
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout),
+                                 "'%s' '%s' --sample '*.log=3lines,2lines' --sample '*.dat=12' %s",
+                                 input_path, get_output_path(), modes[i]));
+        ASSERT_EQ(0, read_output_file(get_output_path(), content, out_size));
+        
+        ASSERT_TRUE(output_contains(content, "// File: app.log\nline 0000\nline 0001\nline 0002\n"
+                                             "[... 199950 bytes omitted ...]\nline 9998\nline 9999\n"));
+        /* A head ending mid-line gets the marker on a line of its own */
+        ASSERT_TRUE(output_contains(content, "// File: data.dat\nline 0000\nli\n"
+                                             "[... 199988 bytes omitted ...]\n"));
+        ASSERT_TRUE(output_contains(content, "// File: note.txt\nleft alone\n"));
+        ASSERT_FALSE(output_contains(content, "line 5000"));
+        /* Classified by the start of the file, not by the head kept of it */
+        ASSERT_FALSE(output_contains(content, "// File: mixed.dat\nline"));
+    }
+    
+    /* Malformed rules are refused */
+    ASSERT_TRUE(run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --sample '*.log=lots'",
+                            input_path, get_output_path()) != 0);
+    
+    free(content);
+    free(log);
+    return 0;
+}
+
+/* =========================================================================
+ * Incremental Tests
+ * ========================================================================= */
+
+/* Let file timestamps fall behind the next run's start */
+static void settle_timestamps(void)
+{
+    struct timespec pause = {0, 50 * 1000 * 1000};
+    nanosleep(&pause, NULL);
+}
+
+/* Run incrementally, then check the result against a full run */
+static int run_incremental_and_compare(const char *dir, char *cmdout, size_t cmdout_size, const char *extra)
+{
+    static char incremental_out[16384];
+    static char full_out[16384];
+    char input_path[TEST_PATH_MAX];
+    char cache_path[TEST_PATH_MAX];
+    char full_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/%s", test_root, dir);
+    snprintf(cache_path, sizeof(cache_path), "%s/manifest_%s", test_root, dir);
+    snprintf(full_path, sizeof(full_path), "%s/output_full.txt", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, cmdout_size, "'%s' '%s' --incremental '%s' %s",
+                             input_path, get_output_path(), cache_path, extra));
+    ASSERT_EQ(0, run_fconcat(NULL, 0, "'%s' '%s'", input_path, full_path));
+    ASSERT_EQ(0, read_output_file(get_output_path(), incremental_out, sizeof(incremental_out)));
+    ASSERT_EQ(0, read_output_file(full_path, full_out, sizeof(full_out)));
+    ASSERT_STR_EQ(full_out, incremental_out);
+    return 0;
+}
+
+TEST(integ_incremental_reuses_unchanged_files)
+{
+    create_test_root();
+    create_dir("inc");
+    create_dir("inc/sub");
+    create_file("inc/a.txt", "alpha");
+    create_file("inc/b.txt", "bravo");
+    create_file("inc/sub/c.txt", "charlie");
+    create_file("inc/d.txt", "delta");
+    settle_timestamps();
+    
+    char cmdout[4096];
+    ASSERT_EQ(0, run_incremental_and_compare("inc", cmdout, sizeof(cmdout), ""));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 0"));
+    
+    /* One edit, one new file, one removed file: the other two are copied */
+    create_file("inc/b.txt", "bravo, now somewhat longer");
+    create_file("inc/e.txt", "echo");
+    char removed[TEST_PATH_MAX];
+    snprintf(removed, sizeof(removed), "%s/inc/d.txt", test_root);
+    ASSERT_EQ(0, unlink(removed));
+    settle_timestamps();
+    
+    ASSERT_EQ(0, run_incremental_and_compare("inc", cmdout, sizeof(cmdout), ""));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 2"));
+    
+    /* Worker threads replay the same blocks */
+    ASSERT_EQ(0, run_incremental_and_compare("inc", cmdout, sizeof(cmdout), "-j 2"));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 4"));
+    
+    /* Different rendering options start over */
+    ASSERT_EQ(0, run_incremental_and_compare("inc", cmdout, sizeof(cmdout), "--binary-placeholder"));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 0"));
+    
+    /* Only temporary files of failed runs would be left next to the output */
+    DIR *dir = opendir(test_root);
+    ASSERT_NOT_NULL(dir);
+    int leftovers = 0;
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "output.txt.", 11) == 0 || strncmp(de->d_name, "manifest_inc.", 13) == 0)
+            leftovers++;
+    }
+    closedir(dir);
+    ASSERT_EQ(0, leftovers);
+    
+    return 0;
+}
+
+TEST(integ_incremental_ignores_edited_output)
+{
+    create_test_root();
+    create_dir("inc_edit");
+    create_file("inc_edit/a.txt", "alpha");
+    create_file("inc_edit/b.txt", "bravo");
+    settle_timestamps();
+    
+    char cmdout[4096];
+    ASSERT_EQ(0, run_incremental_and_compare("inc_edit", cmdout, sizeof(cmdout), ""));
+    
+    /* The recorded offsets no longer describe an output edited by hand */
+    FILE *f = fopen(get_output_path(), "r+");
+    ASSERT_NOT_NULL(f);
+    fputs("edited", f);
+    fclose(f);
+    
+    ASSERT_EQ(0, run_incremental_and_compare("inc_edit", cmdout, sizeof(cmdout), ""));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 0"));
+    ASSERT_EQ(0, run_incremental_and_compare("inc_edit", cmdout, sizeof(cmdout), ""));
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 2"));
+    
+    return 0;
+}
+
+TEST(integ_incremental_output_inside_input)
+{
+    create_test_root();
+    create_dir("inc_inside");
+    create_file("inc_inside/a.txt", "alpha");
+    settle_timestamps();
+    
+    /* Neither file exists yet, and both are written to temporaries first */
+    char cmdout[4096];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/inc_inside", test_root);
+    for (int run = 0; run < 2; run++) {
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s/out.txt' --incremental '%s/cache'",
+                                 input_path, input_path, input_path));
+    }
+    ASSERT_TRUE(output_contains(cmdout, "Files reused: 1"));
+    
+    char content[8192];
+    char output_path[TEST_PATH_MAX];
+    snprintf(output_path, sizeof(output_path), "%s/out.txt", input_path);
+    ASSERT_EQ(0, read_output_file(output_path, content, sizeof(content)));
+    ASSERT_TRUE(output_contains(content, "alpha"));
+    ASSERT_FALSE(output_contains(content, "cache"));
+    ASSERT_FALSE(output_contains(content, "out.txt"));
+    
+    return 0;
+}
+
+/* =========================================================================
+ * Deduplication Tests
+ * ========================================================================= */
+
+TEST(integ_dedup_writes_identical_files_once)
+{
+    create_test_root();
+    create_dir("dedup");
+    create_dir("dedup/a");
+    create_dir("dedup/b");
+    
+    /* One pair through the buffered path, one large enough to be copied in
+     * the kernel, and a pair too small to be worth a reference */
+    static char body[512];
+    memset(body, 'd', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+    static char big[100 * 1024];
+    for (size_t i = 0; i < sizeof(big) - 1; i++)
+        big[i] = (i % 80 == 79) ? '\n' : (char)('a' + (i * 7) % 26);
+    big[sizeof(big) - 1] = '\0';
+    create_file("dedup/a/same.txt", body);
+    create_file("dedup/b/same.txt", body);
+    create_file("dedup/a/big.txt", big);
+    create_file("dedup/b/big.txt", big);
+    create_file("dedup/a/tiny.txt", "tiny and repeated");
+    create_file("dedup/b/tiny.txt", "tiny and repeated");
+    
+    char cmdout[4096];
+    static char serial[256 * 1024];
+    static char parallel[256 * 1024];
+    char input_path[TEST_PATH_MAX];
+    char parallel_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/dedup", test_root);
+    snprintf(parallel_path, sizeof(parallel_path), "%s/output_dedup.txt", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --dedup", input_path, get_output_path()));
+    ASSERT_TRUE(output_contains(cmdout, "Duplicates referenced: 2"));
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --dedup -j 2", input_path, parallel_path));
+    ASSERT_EQ(0, read_output_file(get_output_path(), serial, sizeof(serial)));
+    ASSERT_EQ(0, read_output_file(parallel_path, parallel, sizeof(parallel)));
+    
+    ASSERT_EQ(6, count_occurrences(serial, "// File: "));
+    ASSERT_EQ(2, count_occurrences(serial, "// [Identical to: "));
+    ASSERT_EQ(1, count_occurrences(serial, body));
+    ASSERT_EQ(1, count_occurrences(serial, big));
+    ASSERT_EQ(2, count_occurrences(serial, "tiny and repeated"));
+    ASSERT_STR_EQ(serial, parallel);
+    
+    return 0;
+}
+
+TEST(integ_shard_size_splits_into_complete_documents)
+{
+    create_test_root();
+    create_dir("shards");
+    create_dir("shards/one");
+    create_dir("shards/two");
+    
+    /* Two 3 KB files per directory against a 4 KB budget: one file each */
+    static char body[3 * 1024];
+    memset(body, 's', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+    create_file("shards/one/a.txt", body);
+    create_file("shards/one/b.txt", body);
+    create_file("shards/two/c.txt", body);
+    create_file("shards/two/d.txt", "small");
+    
+    char cmdout[4096];
+    char input_path[TEST_PATH_MAX];
+    char output_path[TEST_PATH_MAX];
+    char shard_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/shards", test_root);
+    snprintf(output_path, sizeof(output_path), "%s/sharded.txt", test_root);
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --shard-size 4K", input_path, output_path));
+    ASSERT_TRUE(output_contains(cmdout, "Shard 3/3"));
+    
+    /* Every part is a document of its own listing only its files; the
+     * small file shares a part with whichever file the walk put next to it */
+    static char part[16 * 1024];
+    size_t files = 0;
+    for (int i = 1; i <= 3; i++) {
+        snprintf(shard_path, sizeof(shard_path), "%s/sharded.part%03d.txt", test_root, i);
+        ASSERT_EQ(0, read_output_file(shard_path, part, sizeof(part)));
+        ASSERT_EQ(1, count_occurrences(part, "Directory Structure:"));
+        size_t here = (size_t)count_occurrences(part, "// File: ");
+        ASSERT_EQ(here == 2, output_contains(part, "two/d.txt"));
+        files += here;
+    }
+    ASSERT_EQ(4, files);
+    snprintf(shard_path, sizeof(shard_path), "%s/sharded.part004.txt", test_root);
+    ASSERT_EQ(-1, read_output_file(shard_path, part, sizeof(part)));
+    
+    /* --shards splits by size too, and never into more parts than files */
+    snprintf(output_path, sizeof(output_path), "%s/halves.txt", test_root);
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --shards 2", input_path, output_path));
+    ASSERT_TRUE(output_contains(cmdout, "Shard 2/2"));
+    snprintf(output_path, sizeof(output_path), "%s/many.txt", test_root);
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --shards 10", input_path, output_path));
+    ASSERT_TRUE(output_contains(cmdout, "Shard 4/4"));
+    
+    /* Shards written side by side come out as they do one at a time, in
+     * a formatter that keeps state across callbacks */
+    static char alone[16 * 1024];
+    const char *formats[] = {"ndjson", "indexed"};
+    for (size_t f = 0; f < 2; f++) {
+        snprintf(output_path, sizeof(output_path), "%s/alone.out", test_root);
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --shards 4 --format %s --jobs 1",
+                                 input_path, output_path, formats[f]));
+        snprintf(output_path, sizeof(output_path), "%s/side.out", test_root);
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --shards 4 --format %s --jobs 4",
+                                 input_path, output_path, formats[f]));
+        for (int i = 1; i <= 4; i++) {
+            snprintf(shard_path, sizeof(shard_path), "%s/alone.part%03d.out", test_root, i);
+            size_t alone_size = read_binary_file(shard_path, alone, sizeof(alone));
+            snprintf(shard_path, sizeof(shard_path), "%s/side.part%03d.out", test_root, i);
+            size_t side_size = read_binary_file(shard_path, part, sizeof(part));
+            ASSERT_TRUE(alone_size > 0);
+            ASSERT_EQ(alone_size, side_size);
+            ASSERT_EQ(0, memcmp(alone, part, alone_size));
+        }
+    }
+    
+    return 0;
+}
+
+/* =========================================================================
+ * Embedding Library Tests
+ * ========================================================================= */
+
+typedef struct {
+    size_t calls;
+    int fail;
+} WriteCounter;
+
+static int count_writes(const void *data, size_t size, void *user_data)
+{
+    (void)data;
+    (void)size;
+    WriteCounter *counter = user_data;
+    counter->calls++;
+    return counter->fail ? -1 : 0;
+}
+
+TEST(integ_library_runs_match_command_line)
+{
+    create_test_root();
+    create_dir("embed");
+    create_dir("embed/one");
+    create_dir("embed/two");
+    create_file("embed/one/a.c", "int a;\n");
+    create_file("embed/one/notes.md", "# skipped\n");
+    create_file("embed/two/b.c", "int b;\n");
+    create_file("embed/two/c.h", "int c(void);\n");
+    
+    const char *options[] = {"--include", "*.c", "*.h"};
+    FconcatLibrary *library = fconcat_library_create(3, options);
+    ASSERT_NOT_NULL(library);
+    
+    /* One handle, two inputs, one buffer reused between them: each run
+     * is the document the command writes for the same input */
+    static char expected[16 * 1024];
+    char cmdout[4096];
+    char input_path[TEST_PATH_MAX];
+    FconcatBuffer buffer = {0};
+    FconcatRunStats stats;
+    const char *inputs[] = {"embed/one", "embed/two"};
+    size_t files[] = {1, 2};
+    for (size_t i = 0; i < 2; i++) {
+        snprintf(input_path, sizeof(input_path), "%s/%s", test_root, inputs[i]);
+        ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --include '*.c' '*.h'",
+                                 input_path, get_output_path()));
+        ASSERT_EQ(0, read_output_file(get_output_path(), expected, sizeof(expected)));
+        
+        ASSERT_EQ(0, fconcat_library_run_buffer(library, input_path, &buffer, &stats));
+        ASSERT_EQ(strlen(expected), buffer.size);
+        ASSERT_EQ(0, memcmp(expected, buffer.data, buffer.size));
+        ASSERT_EQ(files[i], stats.files);
+        ASSERT_EQ(buffer.size, stats.output_bytes);
+    }
+    ASSERT_FALSE(memchr(buffer.data, '#', buffer.size) != NULL);
+    
+    /* A failing writer fails the run, and the handle stays usable */
+    WriteCounter counter = {0, 0};
+    ASSERT_EQ(0, fconcat_library_run(library, input_path, count_writes, &counter, NULL));
+    ASSERT_TRUE(counter.calls > 0);
+    counter.fail = 1;
+    ASSERT_EQ(-1, fconcat_library_run(library, input_path, count_writes, &counter, NULL));
+    ASSERT_NOT_NULL(fconcat_library_error(library));
+    ASSERT_EQ(0, fconcat_library_run_buffer(library, input_path, &buffer, NULL));
+    ASSERT_EQ(0, memcmp(expected, buffer.data, buffer.size));
+    
+    /* A directory that is not there fails the run instead of rendering
+     * an empty document */
+    snprintf(input_path, sizeof(input_path), "%s/embed/missing", test_root);
+    ASSERT_EQ(-1, fconcat_library_run_buffer(library, input_path, &buffer, NULL));
+    ASSERT_TRUE(output_contains(fconcat_library_error(library), "embed/missing"));
+    
+    free(buffer.data);
+    fconcat_library_destroy(library);
+    
+    /* Options that need an output file are refused, option values that
+     * look like them are not */
+    const char *watch[] = {"--watch"};
+    ASSERT_TRUE(fconcat_library_create(1, watch) == NULL);
+    const char *value[] = {"--files-from", "--watch", "--format", "ndjson"};
+    library = fconcat_library_create(4, value);
+    ASSERT_NOT_NULL(library);
+    fconcat_library_destroy(library);
+    
+    return 0;
+}
+
+typedef struct {
+    FconcatLibrary *library;
+    const char *input;
+    FconcatBuffer buffer;
+    int result;
+} LibraryRun;
+
+static void *run_library(void *arg)
+{
+    LibraryRun *run = arg;
+    run->result = 0;
+    for (int i = 0; i < 20 && run->result == 0; i++)
+        run->result = fconcat_library_run_buffer(run->library, run->input, &run->buffer, NULL);
+    return NULL;
+}
+
+TEST(integ_library_stops_at_failed_body_write)
+{
+    create_test_root();
+    create_dir("big");
+    
+    /* Bodies larger than the output buffer reach the writer while the
+     * file is written, so the first failure lands in a body */
+    size_t size = 1024 * 1024;
+    char *body = malloc(size + 1);
+    ASSERT_NOT_NULL(body);
+    for (size_t i = 0; i < size; i++)
+        body[i] = i % 64 == 63 ? '\n' : 'x';
+    body[size] = '\0';
+    for (int i = 0; i < 4; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "big/f%d.txt", i);
+        body[0] = (char)('a' + i);
+        create_file(name, body);
+    }
+    free(body);
+    
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/big", test_root);
+    const char *jobs[][2] = {{"--jobs", "1"}, {"--jobs", "4"}};
+    for (size_t j = 0; j < 2; j++) {
+        FconcatLibrary *library = fconcat_library_create(2, jobs[j]);
+        ASSERT_NOT_NULL(library);
+        
+        /* The file whose body failed is the last one counted */
+        WriteCounter counter = {0, 1};
+        FconcatRunStats stats;
+        ASSERT_EQ(-1, fconcat_library_run(library, input_path, count_writes, &counter, &stats));
+        ASSERT_EQ(1, stats.files);
+        fconcat_library_destroy(library);
+    }
+    
+    return 0;
+}
+
+TEST(integ_library_handles_run_concurrently)
+{
+    create_test_root();
+    create_dir("para");
+    create_dir("para/one");
+    create_dir("para/two");
+    for (int i = 0; i < 8; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "para/one/a%d.txt", i);
+        create_file(name, "first tree\n");
+        snprintf(name, sizeof(name), "para/two/b%d.txt", i);
+        create_file(name, "second tree\n");
+    }
+    
+    /* Each handle's documents come out as if it ran alone, for both the
+     * formatters that keep state between callbacks */
+    const char *formats[] = {"ndjson", "indexed"};
+    char inputs[2][TEST_PATH_MAX];
+    snprintf(inputs[0], sizeof(inputs[0]), "%s/para/one", test_root);
+    snprintf(inputs[1], sizeof(inputs[1]), "%s/para/two", test_root);
+    for (size_t f = 0; f < 2; f++) {
+        const char *options[] = {"--format", formats[f]};
+        LibraryRun runs[2];
+        FconcatBuffer alone[2] = {{0}};
+        pthread_t threads[2];
+        for (size_t i = 0; i < 2; i++) {
+            runs[i] = (LibraryRun){fconcat_library_create(2, options), inputs[i], {0}, -1};
+            ASSERT_NOT_NULL(runs[i].library);
+            ASSERT_EQ(0, fconcat_library_run_buffer(runs[i].library, inputs[i], &alone[i], NULL));
+        }
+        for (size_t i = 0; i < 2; i++)
+            ASSERT_EQ(0, pthread_create(&threads[i], NULL, run_library, &runs[i]));
+        for (size_t i = 0; i < 2; i++)
+            pthread_join(threads[i], NULL);
+        
+        for (size_t i = 0; i < 2; i++) {
+            ASSERT_EQ(0, runs[i].result);
+            ASSERT_EQ(alone[i].size, runs[i].buffer.size);
+            ASSERT_EQ(0, memcmp(alone[i].data, runs[i].buffer.data, alone[i].size));
+            free(alone[i].data);
+            free(runs[i].buffer.data);
+            fconcat_library_destroy(runs[i].library);
+        }
+    }
+    
+    return 0;
+}
+
 /* =========================================================================
  * Symlink Tests
  * ========================================================================= */
@@ -328,6 +1068,27 @@ TEST(integ_symlink_skip_default)
     return 0;
 }
 
+TEST(integ_symlink_placeholder_keeps_regular_files)
+{
+    create_test_root();
+    create_dir("slph");
+    create_file("slph/real.txt", "regular content");
+    create_symlink_file("real.txt", "slph/link.txt");
+    
+    char cmdout[1024];
+    char content[8192];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/slph", test_root);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks placeholder", input_path, get_output_path()));
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    /* The placeholder transform applies to the link only */
+    ASSERT_TRUE(output_contains(content, "// File: real.txt\nregular content"));
+    ASSERT_EQ(1, count_occurrences(content, "// [Symbolic link"));
+    
+    return 0;
+}
+
 TEST(integ_circular_symlink_no_hang)
 {
     create_test_root();
@@ -354,6 +1115,51 @@ TEST(integ_circular_symlink_no_hang)
     return 0;
 }
 
+TEST(integ_unique_inodes_emits_each_file_once)
+{
+    create_test_root();
+    create_dir("uniq");
+    create_dir("uniq/real");
+    create_dir("uniq/real/sub");
+    create_file("uniq/real/a.txt", "shared body");
+    create_file("uniq/real/sub/b.txt", "deeper body");
+    create_symlink_file("real", "uniq/link1");
+    create_symlink_file("real", "uniq/link2");
+    create_symlink_file("../..", "uniq/real/sub/up");
+    
+    char a_path[TEST_PATH_MAX];
+    char hard_path[TEST_PATH_MAX];
+    snprintf(a_path, sizeof(a_path), "%s/uniq/real/a.txt", test_root);
+    snprintf(hard_path, sizeof(hard_path), "%s/uniq/hard.txt", test_root);
+    ASSERT_EQ(0, link(a_path, hard_path));
+    
+    char cmdout[1024];
+    char input_path[TEST_PATH_MAX];
+    char parallel_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/uniq", test_root);
+    snprintf(parallel_path, sizeof(parallel_path), "%s/uniq_parallel.txt", test_root);
+    
+    /* Without the option every path to a file repeats it */
+    static char content[16384];
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks follow", input_path, get_output_path()));
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    ASSERT_TRUE(count_occurrences(content, "shared body") > 2);
+    
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks follow --unique-inodes",
+                             input_path, get_output_path()));
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --symlinks follow --unique-inodes -j 2",
+                             input_path, parallel_path));
+    
+    static char parallel[16384];
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    ASSERT_EQ(0, read_output_file(parallel_path, parallel, sizeof(parallel)));
+    ASSERT_STR_EQ(content, parallel);
+    ASSERT_EQ(1, count_occurrences(content, "shared body"));
+    ASSERT_EQ(1, count_occurrences(content, "deeper body"));
+    
+    return 0;
+}
+
 TEST(integ_broken_symlink)
 {
     create_test_root();
@@ -404,10 +1210,241 @@ TEST(integ_binary_file_detection)
     return 0;
 }
 
+TEST(integ_binary_placeholder_only_binary)
+{
+    create_test_root();
+    create_dir("binph");
+    create_file("binph/text.txt", "Readable text stays");
+    create_binary_file("binph/blob.bin", 256);
+    
+    char cmdout[1024];
+    char content[8192];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/binph", test_root);
+    
+    int exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --binary-placeholder", input_path, get_output_path());
+    
+    ASSERT_EQ(0, exit_code);
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    /* Only the binary file is replaced, and only once */
+    ASSERT_TRUE(output_contains(content, "Readable text stays"));
+    ASSERT_EQ(1, count_occurrences(content, "[Binary file content not displayed]"));
+    
+    return 0;
+}
+
+TEST(integ_ndjson_one_record_per_file)
+{
+    create_test_root();
+    create_dir("ndjson");
+    create_dir("ndjson/sub");
+    create_file("ndjson/quote.txt", "say \"hi\"\n\tback\\slash\n");
+    create_file("ndjson/sub/plain.c", "int x;\n");
+    
+    char cmdout[1024];
+    char content[8192];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/ndjson", test_root);
+    
+    int exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --format ndjson", input_path, get_output_path());
+    
+    ASSERT_EQ(0, exit_code);
+    ASSERT_EQ(0, read_output_file(get_output_path(), content, sizeof(content)));
+    /* No structure section, and newlines only between records */
+    ASSERT_EQ(2, count_occurrences(content, "\n"));
+    ASSERT_TRUE(output_contains(content, "{\"path\":\"sub/plain.c\",\"size\":7,\"content\":\"int x;\\n\"}\n"));
+    ASSERT_TRUE(output_contains(content, "\"content\":\"say \\\"hi\\\"\\n\\tback\\\\slash\\n\"}"));
+    ASSERT_FALSE(output_contains(content, "Directory Structure"));
+    
+    return 0;
+}
+
+TEST(integ_indexed_output_finds_every_file)
+{
+    create_test_root();
+    create_dir("indexed");
+    create_dir("indexed/sub");
+    create_file("indexed/b.txt", "second file\n");
+    create_file("indexed/sub/a.c", "int a;\n");
+    create_file("indexed/z.md", "# last\n");
+    create_binary_file("indexed/blob.bin", 256);
+    
+    char cmdout[1024];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/indexed", test_root);
+    
+    int exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --format indexed", input_path, get_output_path());
+    ASSERT_EQ(0, exit_code);
+    
+    IndexedArchive *archive = indexed_archive_open(get_output_path());
+    ASSERT_NOT_NULL(archive);
+    ASSERT_EQ(4, indexed_archive_count(archive));
+    
+    /* Entries come back in path order, contents without header or footer */
+    IndexedEntry entry;
+    ASSERT_EQ(0, indexed_archive_entry(archive, 0, &entry));
+    ASSERT_STR_EQ("b.txt", entry.path);
+    ASSERT_EQ(0, indexed_archive_find(archive, "sub/a.c", &entry));
+    ASSERT_EQ(7, entry.length);
+    ASSERT_EQ(7, entry.size);
+    ASSERT_EQ(0, entry.flags);
+    ASSERT_MEM_EQ("int a;\n", indexed_archive_content(archive, &entry), 7);
+    ASSERT_EQ(0, indexed_archive_find(archive, "z.md", &entry));
+    ASSERT_MEM_EQ("# last\n", indexed_archive_content(archive, &entry), 7);
+    
+    /* Skipped binary content is marked, unknown paths are not found */
+    ASSERT_EQ(0, indexed_archive_find(archive, "blob.bin", &entry));
+    ASSERT_EQ(FORMAT_INDEXED_INCOMPLETE, entry.flags);
+    ASSERT_EQ(0, entry.length);
+    ASSERT_EQ(-1, indexed_archive_find(archive, "sub", &entry));
+    ASSERT_EQ(-1, indexed_archive_find(archive, "sub/a.cc", &entry));
+    indexed_archive_close(archive);
+    
+    /* Plain text output is not mistaken for an indexed one */
+    exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path());
+    ASSERT_EQ(0, exit_code);
+    errno = 0;
+    ASSERT_NULL(indexed_archive_open(get_output_path()));
+    ASSERT_EQ(EINVAL, errno);
+    
+    return 0;
+}
+
 /* =========================================================================
  * Filter Pattern Tests
  * ========================================================================= */
 
+TEST(integ_files_from_processes_only_listed_files)
+{
+    create_test_root();
+    create_dir("listed");
+    create_dir("listed/src");
+    create_dir("listed/src/deep");
+    create_dir("listed/logs");
+    create_file("listed/src/main.c", "int listed_main;\n");
+    create_file("listed/src/deep/util.c", "int listed_util;\n");
+    create_file("listed/src/unlisted.c", "int unlisted;\n");
+    create_file("listed/logs/run.log", "listed log\n");
+    create_file("listed/top.txt", "listed top\n");
+    create_dir("outside");
+    create_file("outside/secret.txt", "outside the tree\n");
+    create_symlink_file("../outside", "listed/linked");
+    
+    /* NUL-separated as git ls-files -z writes it, in its own order; a
+     * path named twice is recorded once */
+    char list_path[TEST_PATH_MAX];
+    snprintf(list_path, sizeof(list_path), "%s/files.lst", test_root);
+    FILE *list = fopen(list_path, "wb");
+    ASSERT_NOT_NULL(list);
+    static const char entries[] = "top.txt\0./src/deep/util.c\0src/main.c\0logs/run.log\0gone.c\0../escape.c\0"
+                                  "./src/main.c\0src//main.c\0linked/secret.txt\0";
+    fwrite(entries, 1, sizeof(entries) - 1, list);
+    fclose(list);
+    
+    char cmdout[4096];
+    char input_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/listed", test_root);
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --files-from '%s' --exclude '*.log'",
+                             input_path, get_output_path(), list_path));
+    
+    static char output[8192];
+    ASSERT_EQ(0, read_output_file(get_output_path(), output, sizeof(output)));
+    ASSERT_EQ(2, count_occurrences(output, "src/main.c"));
+    ASSERT_TRUE(output_contains(output, "int listed_util;"));
+    ASSERT_TRUE(output_contains(output, "listed top"));
+    ASSERT_FALSE(output_contains(output, "int unlisted;"));
+    ASSERT_FALSE(output_contains(output, "listed log"));
+    ASSERT_TRUE(output_contains(cmdout, "Not inside"));
+    ASSERT_TRUE(output_contains(cmdout, "Listed file not found: gone.c"));
+    ASSERT_FALSE(output_contains(cmdout, "disappeared"));
+    
+    /* A directory that is a symlink is entered only when symlinks are
+     * followed, as in the walk */
+    ASSERT_FALSE(output_contains(output, "outside the tree"));
+    ASSERT_TRUE(output_contains(cmdout, "linked/secret.txt"));
+    ASSERT_EQ(0, run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --files-from '%s' --symlinks follow",
+                             input_path, get_output_path(), list_path));
+    static char followed[8192];
+    ASSERT_EQ(0, read_output_file(get_output_path(), followed, sizeof(followed)));
+    ASSERT_TRUE(output_contains(followed, "// File: linked/secret.txt\noutside the tree"));
+    
+    /* List order is kept, and the directories come ahead of their files */
+    const char *top = strstr(output, "// File: top.txt");
+    const char *util = strstr(output, "// File: src/deep/util.c");
+    const char *main_c = strstr(output, "// File: src/main.c");
+    ASSERT_TRUE(top && util && main_c && top < util && util < main_c);
+    const char *structure_dir = strstr(output, "src/deep/");
+    ASSERT_TRUE(structure_dir && structure_dir < strstr(output, "src/deep/util.c"));
+    
+    /* One path per line from stdin gives the same result */
+    char cmd[TEST_PATH_MAX * 3];
+    char stdin_path[TEST_PATH_MAX];
+    static char from_stdin[8192];
+    snprintf(stdin_path, sizeof(stdin_path), "%s/listed_stdin.txt", test_root);
+    snprintf(cmd, sizeof(cmd),
+             "printf 'top.txt\\nsrc/deep/util.c\\r\\n\\nsrc/main.c\\nlogs/run.log\\n' | "
+             "%s '%s' '%s' --files-from - --exclude '*.log' > /dev/null 2>&1",
+             fconcat_bin, input_path, stdin_path);
+    ASSERT_EQ(0, system(cmd));
+    ASSERT_EQ(0, read_output_file(stdin_path, from_stdin, sizeof(from_stdin)));
+    ASSERT_STR_EQ(output, from_stdin);
+    
+    return 0;
+}
+
+TEST(integ_gitignore_prunes_ignored_directories)
+{
+    create_test_root();
+    create_dir("gitig");
+    create_dir("gitig/.git");
+    create_dir("gitig/build");
+    create_dir("gitig/src");
+    create_dir("gitig/src/gen");
+    create_file("gitig/.gitignore", "build/\n*.log\n!keep.log\n");
+    create_file("gitig/.git/HEAD", "ref: refs/heads/main\n");
+    create_file("gitig/build/out.txt", "built\n");
+    create_file("gitig/app.log", "noise\n");
+    create_file("gitig/keep.log", "kept\n");
+    create_file("gitig/src/main.c", "int main;\n");
+    create_file("gitig/src/gen/.gitignore", "*\n!wanted.c\n");
+    create_file("gitig/src/gen/skipped.c", "int skipped;\n");
+    create_file("gitig/src/gen/wanted.c", "int wanted;\n");
+    
+    char cmdout[1024];
+    char input_path[TEST_PATH_MAX];
+    char parallel_path[TEST_PATH_MAX];
+    snprintf(input_path, sizeof(input_path), "%s/gitig", test_root);
+    snprintf(parallel_path, sizeof(parallel_path), "%s/gitig_parallel.txt", test_root);
+    
+    int exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --gitignore", input_path, get_output_path());
+    ASSERT_EQ(0, exit_code);
+    exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s' --gitignore -j 2", input_path, parallel_path);
+    ASSERT_EQ(0, exit_code);
+    
+    static char serial[8192];
+    static char parallel[8192];
+    ASSERT_EQ(0, read_output_file(get_output_path(), serial, sizeof(serial)));
+    ASSERT_EQ(0, read_output_file(parallel_path, parallel, sizeof(parallel)));
+    ASSERT_STR_EQ(serial, parallel);
+    
+    ASSERT_TRUE(output_contains(serial, "int main;"));
+    ASSERT_TRUE(output_contains(serial, "kept"));
+    ASSERT_TRUE(output_contains(serial, "int wanted;"));
+    ASSERT_FALSE(output_contains(serial, "built"));
+    ASSERT_FALSE(output_contains(serial, "noise"));
+    ASSERT_FALSE(output_contains(serial, "int skipped;"));
+    ASSERT_FALSE(output_contains(serial, "refs/heads"));
+    
+    /* Without the option the ignore files are just files */
+    exit_code = run_fconcat(cmdout, sizeof(cmdout), "'%s' '%s'", input_path, get_output_path());
+    ASSERT_EQ(0, exit_code);
+    ASSERT_EQ(0, read_output_file(get_output_path(), serial, sizeof(serial)));
+    ASSERT_TRUE(output_contains(serial, "built"));
+    ASSERT_TRUE(output_contains(serial, "int skipped;"));
+    
+    return 0;
+}
+
 TEST(integ_include_pattern)
 {
     create_test_root();
@@ -618,18 +1655,48 @@ int test_traversal_main(void)
     RUN_TEST(integ_empty_directory);
     RUN_TEST(integ_nested_directories);
     RUN_TEST(integ_multiple_files);
+    RUN_TEST(integ_structure_and_content_agree);
+    RUN_TEST(integ_jobs_output_matches_serial);
+    RUN_TEST(integ_parallel_walk_matches_serial);
+    RUN_TEST(integ_io_engines_match_sync);
+    RUN_TEST(integ_large_file_copied_intact);
+    RUN_TEST(integ_multi_megabyte_file_intact);
+    RUN_TEST(integ_sample_keeps_head_and_tail);
+    
+    TEST_SUITE_BEGIN("Incremental Runs");
+    RUN_TEST(integ_incremental_reuses_unchanged_files);
+    RUN_TEST(integ_incremental_ignores_edited_output);
+    RUN_TEST(integ_incremental_output_inside_input);
+    
+    TEST_SUITE_BEGIN("Deduplication");
+    RUN_TEST(integ_dedup_writes_identical_files_once);
+    
+    TEST_SUITE_BEGIN("Sharded Output");
+    RUN_TEST(integ_shard_size_splits_into_complete_documents);
+    
+    TEST_SUITE_BEGIN("Embedding Library");
+    RUN_TEST(integ_library_runs_match_command_line);
+    RUN_TEST(integ_library_handles_run_concurrently);
+    RUN_TEST(integ_library_stops_at_failed_body_write);
     
     TEST_SUITE_BEGIN("Symlink Handling");
     RUN_TEST(integ_symlink_skip_default);
+    RUN_TEST(integ_symlink_placeholder_keeps_regular_files);
     RUN_TEST(integ_circular_symlink_no_hang);
+    RUN_TEST(integ_unique_inodes_emits_each_file_once);
     RUN_TEST(integ_broken_symlink);
     
     TEST_SUITE_BEGIN("Binary File Detection");
     RUN_TEST(integ_binary_file_detection);
+    RUN_TEST(integ_binary_placeholder_only_binary);
+    RUN_TEST(integ_ndjson_one_record_per_file);
+    RUN_TEST(integ_indexed_output_finds_every_file);
     
     TEST_SUITE_BEGIN("Filter Patterns");
     RUN_TEST(integ_include_pattern);
     RUN_TEST(integ_exclude_pattern);
+    RUN_TEST(integ_gitignore_prunes_ignored_directories);
+    RUN_TEST(integ_files_from_processes_only_listed_files);
     
     TEST_SUITE_BEGIN("Permission Handling");
     RUN_TEST(integ_permission_denied);
@@ -15,6 +15,17 @@
 extern int test_memory_main(void);
 extern int test_filter_main(void);
 extern int test_config_main(void);
+extern int test_tree_main(void);
+extern int test_zerocopy_main(void);
+extern int test_arena_main(void);
+extern int test_output_main(void);
+extern int test_aio_main(void);
+extern int test_dedup_main(void);
+extern int test_content_main(void);
+extern int test_metrics_main(void);
+extern int test_format_main(void);
+extern int test_log_main(void);
+extern int test_progress_main(void);
 extern int test_traversal_main(void);
 
 static int run_unit_tests(void)
@@ -37,6 +48,50 @@ static int run_unit_tests(void)
     fprintf(stderr, "\n>>> Running config tests...\n");
     failed += test_config_main();
     
+    /* Directory tree tests */
+    fprintf(stderr, "\n>>> Running tree tests...\n");
+    failed += test_tree_main();
+    
+    /* Zero-copy output tests */
+    fprintf(stderr, "\n>>> Running zero-copy tests...\n");
+    failed += test_zerocopy_main();
+    
+    /* Scratch arena tests */
+    fprintf(stderr, "\n>>> Running arena tests...\n");
+    failed += test_arena_main();
+    
+    /* Output sink tests */
+    fprintf(stderr, "\n>>> Running output sink tests...\n");
+    failed += test_output_main();
+    
+    /* Read-ahead engine tests */
+    fprintf(stderr, "\n>>> Running I/O engine tests...\n");
+    failed += test_aio_main();
+    
+    /* Content hash and dedup index tests */
+    fprintf(stderr, "\n>>> Running dedup tests...\n");
+    failed += test_dedup_main();
+    
+    /* Content plugin stage tests */
+    fprintf(stderr, "\n>>> Running content plugin tests...\n");
+    failed += test_content_main();
+    
+    /* --stats counter tests */
+    fprintf(stderr, "\n>>> Running performance counter tests...\n");
+    failed += test_metrics_main();
+    
+    /* JSON escaping tests */
+    fprintf(stderr, "\n>>> Running formatter tests...\n");
+    failed += test_format_main();
+    
+    /* --log-async ring tests */
+    fprintf(stderr, "\n>>> Running async log tests...\n");
+    failed += test_log_main();
+    
+    /* Progress reporter tests */
+    fprintf(stderr, "\n>>> Running progress tests...\n");
+    failed += test_progress_main();
+    
     return failed;
 }
 
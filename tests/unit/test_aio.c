@@ -0,0 +1,174 @@
+/**
+ * @file test_aio.c
+ * @brief Unit tests for the read-ahead I/O engine
+ *
+ * Tests cover:
+ * - Whole-file reads through each backend, completing in any order
+ * - Open errors and files larger than the buffer
+ * - The in-flight limit
+ */
+
+#include "test_framework.h"
+#include "../../src/core/aio.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* =========================================================================
+ * Test Helpers
+ * ========================================================================= */
+
+#define AIO_TEST_FILES 8
+
+static int make_temp_file(char *path, size_t path_size, const char *data)
+{
+    snprintf(path, path_size, "/tmp/fconcat_aio_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    size_t size = strlen(data);
+    int result = write(fd, data, size) == (ssize_t)size ? 0 : -1;
+    close(fd);
+    return result;
+}
+
+/* Read AIO_TEST_FILES files through one backend and check every result */
+static int check_backend(IoEngineKind kind)
+{
+    IoEngine *engine = io_engine_create(kind, 4);
+    ASSERT_NOT_NULL(engine);
+
+    char paths[AIO_TEST_FILES][64];
+    char expected[AIO_TEST_FILES][32];
+    char buffers[AIO_TEST_FILES][64];
+    IoRequest requests[AIO_TEST_FILES];
+    memset(requests, 0, sizeof(requests));
+
+    for (int i = 0; i < AIO_TEST_FILES; i++) {
+        snprintf(expected[i], sizeof(expected[i]), "file %d says hello", i);
+        ASSERT_EQ(0, make_temp_file(paths[i], sizeof(paths[i]), expected[i]));
+        requests[i].path = paths[i];
+        requests[i].buffer = buffers[i];
+        requests[i].capacity = sizeof(buffers[i]);
+        requests[i].user_data = &expected[i];
+    }
+
+    /* Keep the queue full: submit until refused, then reap one */
+    int submitted = 0, reaped = 0;
+    while (reaped < AIO_TEST_FILES) {
+        while (submitted < AIO_TEST_FILES && io_engine_submit(engine, &requests[submitted]) == 0)
+            submitted++;
+        ASSERT_TRUE(io_engine_in_flight(engine) <= 4);
+
+        IoRequest *done = io_engine_reap(engine, true);
+        ASSERT_NOT_NULL(done);
+        const char *want = (const char *)done->user_data;
+        ASSERT_EQ(0, done->error);
+        ASSERT_FALSE(done->truncated);
+        ASSERT_EQ(strlen(want), done->size);
+        ASSERT_MEM_EQ(want, done->buffer, done->size);
+        reaped++;
+    }
+
+    ASSERT_EQ(0, io_engine_in_flight(engine));
+    ASSERT_NULL(io_engine_reap(engine, true));
+
+    for (int i = 0; i < AIO_TEST_FILES; i++)
+        unlink(paths[i]);
+    io_engine_destroy(engine);
+    return 0;
+}
+
+/* =========================================================================
+ * Backend Tests
+ * ========================================================================= */
+
+TEST(aio_thread_backend_reads_files)
+{
+    return check_backend(IO_ENGINE_THREADS);
+}
+
+TEST(aio_auto_backend_reads_files)
+{
+    /* io_uring where the kernel allows it, reader threads otherwise */
+    IoEngine *engine = io_engine_create(IO_ENGINE_AUTO, 0);
+    ASSERT_NOT_NULL(engine);
+    IoEngineKind kind = io_engine_kind(engine);
+    ASSERT_TRUE(kind == IO_ENGINE_URING || kind == IO_ENGINE_THREADS);
+    io_engine_destroy(engine);
+
+    return check_backend(IO_ENGINE_AUTO);
+}
+
+TEST(aio_reports_errors_and_truncation)
+{
+    IoEngineKind kinds[] = {IO_ENGINE_AUTO, IO_ENGINE_THREADS};
+    for (size_t k = 0; k < sizeof(kinds) / sizeof(kinds[0]); k++) {
+        IoEngine *engine = io_engine_create(kinds[k], 2);
+        ASSERT_NOT_NULL(engine);
+
+        char path[64];
+        ASSERT_EQ(0, make_temp_file(path, sizeof(path), "0123456789"));
+
+        char small[4];
+        IoRequest grown = {0};
+        grown.path = path;
+        grown.buffer = small;
+        grown.capacity = sizeof(small);
+
+        char buf[16];
+        IoRequest missing = {0};
+        missing.path = "/nonexistent/fconcat_aio_missing";
+        missing.buffer = buf;
+        missing.capacity = sizeof(buf);
+
+        ASSERT_EQ(0, io_engine_submit(engine, &grown));
+        ASSERT_EQ(0, io_engine_submit(engine, &missing));
+
+        /* Depth 2: a third request is refused until one is reaped */
+        char extra_buf[16];
+        IoRequest extra = {0};
+        extra.path = path;
+        extra.buffer = extra_buf;
+        extra.capacity = sizeof(extra_buf);
+        ASSERT_EQ(-1, io_engine_submit(engine, &extra));
+
+        for (int i = 0; i < 2; i++)
+            ASSERT_NOT_NULL(io_engine_reap(engine, true));
+
+        ASSERT_EQ(0, grown.error);
+        ASSERT_TRUE(grown.truncated);
+        ASSERT_EQ(4, grown.size);
+        ASSERT_MEM_EQ("0123", small, 4);
+        ASSERT_EQ(ENOENT, missing.error);
+
+        unlink(path);
+        io_engine_destroy(engine);
+    }
+
+    ASSERT_NULL(io_engine_create(IO_ENGINE_SYNC, 8));
+    ASSERT_STR_EQ("threads", io_engine_name(IO_ENGINE_THREADS));
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_aio_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Read-ahead I/O Engine");
+    RUN_TEST(aio_thread_backend_reads_files);
+    RUN_TEST(aio_auto_backend_reads_files);
+    RUN_TEST(aio_reports_errors_and_truncation);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
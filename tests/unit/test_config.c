@@ -8,10 +8,13 @@
  * - ConfigLayer operations (add/get values)
  * - Default configuration loading
  * - Configuration resolution
+ * - Settings resolved once for plugins, against the per-key lookups
  */
 
 #include "test_framework.h"
 #include "../../src/config/config.h"
+#include "../../src/core/context.h"
+#include <stdio.h>
 #include <string.h>
 
 /* =========================================================================
@@ -253,6 +256,49 @@ TEST(config_get_bool_null_manager)
     return 0;
 }
 
+/* =========================================================================
+ * Resolved Settings Tests
+ * ========================================================================= */
+
+TEST(context_settings_match_config_lookups)
+{
+    ResolvedConfig config = {0};
+    config.output_format = "ndjson";
+    config.input_directory = "in";
+    config.output_file = "out";
+    config.show_size = true;
+    config.drop_cache = true;
+    config.binary_handling = BINARY_PLACEHOLDER;
+    config.symlink_handling = SYMLINK_FOLLOW;
+    config.log_level = LOG_DEBUG;
+    
+    ProcessingStats stats = {0};
+    FconcatContext *ctx = create_fconcat_context(&config, NULL, &stats, NULL, NULL, NULL, NULL, NULL);
+    ASSERT_NOT_NULL(ctx);
+    ASSERT_NOT_NULL(ctx->settings);
+    
+    const FconcatSettings *settings = ctx->settings;
+    ASSERT_EQ(sizeof(FconcatSettings), settings->size);
+    ASSERT_EQ(ctx->get_config_bool(ctx, "show_size"), settings->show_size);
+    ASSERT_EQ(ctx->get_config_bool(ctx, "verbose"), settings->verbose);
+    ASSERT_EQ(ctx->get_config_bool(ctx, "drop_cache"), settings->drop_cache);
+    ASSERT_EQ(ctx->get_config_int(ctx, "binary_handling"), settings->binary_handling);
+    ASSERT_EQ(ctx->get_config_int(ctx, "symlink_handling"), settings->symlink_handling);
+    ASSERT_EQ(ctx->get_config_int(ctx, "log_level"), (int)settings->log_level);
+    ASSERT_STR_EQ(ctx->get_config_string(ctx, "output_format"), settings->output_format);
+    ASSERT_STR_EQ(ctx->get_config_string(ctx, "output_file"), settings->output_file);
+    
+    /* The inline check and the callback agree at every level */
+    for (int level = LOG_ERROR; level <= LOG_TRACE; level++)
+        ASSERT_EQ(ctx->is_log_enabled(ctx, (LogLevel)level), fconcat_log_enabled(ctx, (LogLevel)level));
+    ASSERT_TRUE(fconcat_log_enabled(ctx, LOG_DEBUG));
+    ASSERT_FALSE(fconcat_log_enabled(ctx, LOG_TRACE));
+    ASSERT_TRUE(fconcat_log_enabled(NULL, LOG_INFO));
+    
+    destroy_fconcat_context(ctx);
+    return 0;
+}
+
 /* =========================================================================
  * Main Entry Point
  * ========================================================================= */
@@ -296,6 +342,9 @@ int test_config_main(void)
     RUN_TEST(config_get_int_null_manager);
     RUN_TEST(config_get_bool_null_manager);
     
+    TEST_SUITE_BEGIN("Resolved Settings");
+    RUN_TEST(context_settings_match_config_lookups);
+    
     TEST_SUMMARY();
     
     return TEST_EXIT_CODE();
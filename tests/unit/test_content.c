@@ -0,0 +1,266 @@
+/**
+ * @file test_content.c
+ * @brief Unit tests for the content plugin stage
+ *
+ * Tests cover:
+ * - Unchanged chunks passing through without a copy
+ * - Streaming plugins chained chunk by chunk, with the end-of-file flush
+ * - Whole-file plugins holding their input until the file ends
+ * - Plugins that decline a file or its binary content
+ */
+
+#include "test_framework.h"
+#include "../../src/core/arena.h"
+#include "../../src/core/context.h"
+#include "../../src/plugins/plugin.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================================================================
+ * Test Helpers
+ * ========================================================================= */
+
+/* Everything emitted, and whether each piece was the caller's own chunk */
+typedef struct {
+    char data[256];
+    size_t size;
+    int pieces;
+    int passed_through;
+    const char *source;
+} Collected;
+
+static int collect(FconcatContext *ctx, const char *data, size_t size, void *user_data)
+{
+    (void)ctx;
+    Collected *c = (Collected *)user_data;
+    if (c->size + size > sizeof(c->data))
+        return -1;
+    memcpy(c->data + c->size, data, size);
+    c->size += size;
+    c->pieces++;
+    if (data == c->source)
+        c->passed_through++;
+    return 0;
+}
+
+static int passthrough_chunk(FconcatContext *ctx, PluginFileContext *file_ctx, const char *input,
+                             size_t input_size, char **output, size_t *output_size)
+{
+    (void)ctx; (void)file_ctx; (void)input; (void)input_size; (void)output; (void)output_size;
+    return 0;
+}
+
+static int upper_chunk(FconcatContext *ctx, PluginFileContext *file_ctx, const char *input,
+                       size_t input_size, char **output, size_t *output_size)
+{
+    (void)file_ctx;
+    if (input_size == 0)
+        return 0;
+    char *upper = ctx->arena_alloc(ctx, input_size);
+    if (!upper)
+        return -1;
+    for (size_t i = 0; i < input_size; i++)
+        upper[i] = (char)toupper((unsigned char)input[i]);
+    *output = upper;
+    *output_size = input_size;
+    return 0;
+}
+
+/* Holds back the last byte of every chunk, as a tokenizer would hold a
+ * token split across chunks, and releases it on the flush */
+typedef struct {
+    char pending;
+    int has_pending;
+    int ended;
+} HoldState;
+
+static HoldState hold_state;
+
+static PluginFileContext *hold_start(FconcatContext *ctx, const char *path, struct FileInfo *info)
+{
+    (void)ctx; (void)path; (void)info;
+    memset(&hold_state, 0, sizeof(hold_state));
+    return (PluginFileContext *)&hold_state;
+}
+
+static int hold_chunk(FconcatContext *ctx, PluginFileContext *file_ctx, const char *input,
+                      size_t input_size, char **output, size_t *output_size)
+{
+    HoldState *state = (HoldState *)file_ctx;
+    char *out = ctx->arena_alloc(ctx, input_size + 1);
+    if (!out)
+        return -1;
+    size_t n = 0;
+    if (state->has_pending)
+        out[n++] = state->pending;
+    state->has_pending = 0;
+    if (input_size > 0) {
+        memcpy(out + n, input, input_size - 1);
+        n += input_size - 1;
+        state->pending = input[input_size - 1];
+        state->has_pending = 1;
+    }
+    *output = out;
+    *output_size = n;
+    return 0;
+}
+
+static int hold_end(FconcatContext *ctx, PluginFileContext *file_ctx)
+{
+    (void)ctx;
+    ((HoldState *)file_ctx)->ended = 1;
+    return 0;
+}
+
+/* Wraps the whole file in brackets; only correct if it sees all of it */
+static int whole_calls;
+
+static int whole_chunk(FconcatContext *ctx, PluginFileContext *file_ctx, const char *input,
+                       size_t input_size, char **output, size_t *output_size)
+{
+    (void)ctx; (void)file_ctx;
+    whole_calls++;
+    char *out = malloc(input_size + 2);
+    if (!out)
+        return -1;
+    out[0] = '[';
+    memcpy(out + 1, input, input_size);
+    out[input_size + 1] = ']';
+    *output = out;
+    *output_size = input_size + 2;
+    return 0;
+}
+
+static PluginFileContext *decline_start(FconcatContext *ctx, const char *path, struct FileInfo *info)
+{
+    (void)ctx; (void)path; (void)info;
+    return NULL;
+}
+
+static ContentPlugin passthrough_plugin = {.name = "pass", .process_chunk = passthrough_chunk,
+                                           .capabilities = PLUGIN_CAP_STREAMING};
+static ContentPlugin upper_plugin = {.name = "upper", .process_chunk = upper_chunk,
+                                     .capabilities = PLUGIN_CAP_STREAMING | PLUGIN_CAP_CONTENT_TRANSFORM};
+static ContentPlugin hold_plugin = {.name = "hold", .file_start = hold_start, .process_chunk = hold_chunk,
+                                    .file_end = hold_end, .capabilities = PLUGIN_CAP_STREAMING};
+static ContentPlugin whole_plugin = {.name = "whole", .process_chunk = whole_chunk,
+                                     .capabilities = PLUGIN_CAP_CONTENT_TRANSFORM};
+static ContentPlugin decline_plugin = {.name = "decline", .file_start = decline_start,
+                                       .process_chunk = upper_chunk, .capabilities = PLUGIN_CAP_STREAMING};
+
+static void init_context(FconcatContext *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->arena = arena_create(0);
+    ctx->arena_alloc = context_arena_alloc;
+}
+
+/* Feed "abc", "def", "gh" through a chain and collect the result */
+static int run_chain(ContentPlugin **plugins, int count, FileInfo *info, Collected *c)
+{
+    FconcatContext ctx;
+    init_context(&ctx);
+    ContentChain chain;
+    memset(c, 0, sizeof(*c));
+
+    static const char *chunks[] = {"abc", "def", "gh"};
+    int active = content_chain_begin(&chain, plugins, count, &ctx, "file.txt", info);
+    for (int i = 0; i < 3 && active > 0; i++) {
+        c->source = chunks[i];
+        if (content_chain_write(&chain, &ctx, chunks[i], strlen(chunks[i]), collect, c) != 0)
+            return -1;
+    }
+    c->source = NULL;
+    int result = active > 0 ? content_chain_end(&chain, &ctx, collect, c) : 0;
+    arena_destroy((Arena *)ctx.arena);
+    return result < 0 ? -1 : active;
+}
+
+/* =========================================================================
+ * Streaming Tests
+ * ========================================================================= */
+
+TEST(content_unchanged_chunks_are_not_copied)
+{
+    ContentPlugin *plugins[] = {&passthrough_plugin, &passthrough_plugin};
+    FileInfo info = {0};
+    Collected c;
+
+    ASSERT_EQ(2, run_chain(plugins, 2, &info, &c));
+    ASSERT_EQ(8, c.size);
+    ASSERT_MEM_EQ("abcdefgh", c.data, 8);
+    ASSERT_EQ(3, c.pieces);
+    ASSERT_EQ(3, c.passed_through);
+    return 0;
+}
+
+TEST(content_streaming_plugins_chain_and_flush)
+{
+    ContentPlugin *plugins[] = {&hold_plugin, &upper_plugin};
+    FileInfo info = {0};
+    Collected c;
+
+    /* The held-back byte reaches the next plugin through the flush */
+    ASSERT_EQ(2, run_chain(plugins, 2, &info, &c));
+    ASSERT_EQ(8, c.size);
+    ASSERT_MEM_EQ("ABCDEFGH", c.data, 8);
+    ASSERT_EQ(4, c.pieces);
+    ASSERT_EQ(0, c.passed_through);
+    ASSERT_EQ(1, hold_state.ended);
+    return 0;
+}
+
+TEST(content_whole_file_plugin_sees_everything_once)
+{
+    ContentPlugin *plugins[] = {&upper_plugin, &whole_plugin, &hold_plugin};
+    FileInfo info = {0};
+    Collected c;
+
+    whole_calls = 0;
+    ASSERT_EQ(3, run_chain(plugins, 3, &info, &c));
+    ASSERT_EQ(1, whole_calls);
+    ASSERT_EQ(10, c.size);
+    ASSERT_MEM_EQ("[ABCDEFGH]", c.data, 10);
+    return 0;
+}
+
+TEST(content_plugins_can_decline_files)
+{
+    ContentPlugin *plugins[] = {&decline_plugin, &upper_plugin};
+    FileInfo info = {0};
+    Collected c;
+
+    ASSERT_EQ(1, run_chain(plugins, 2, &info, &c));
+    ASSERT_MEM_EQ("ABCDEFGH", c.data, 8);
+
+    /* Binary files only go to plugins that declare support */
+    info.is_binary = true;
+    ASSERT_EQ(0, run_chain(plugins, 2, &info, &c));
+    upper_plugin.capabilities |= PLUGIN_CAP_BINARY_SUPPORT;
+    ASSERT_EQ(1, run_chain(plugins, 2, &info, &c));
+    upper_plugin.capabilities &= ~PLUGIN_CAP_BINARY_SUPPORT;
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_content_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Content Plugin Stage");
+    RUN_TEST(content_unchanged_chunks_are_not_copied);
+    RUN_TEST(content_streaming_plugins_chain_and_flush);
+    RUN_TEST(content_whole_file_plugin_sees_everything_once);
+    RUN_TEST(content_plugins_can_decline_files);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,265 @@
+/**
+ * @file test_dedup.c
+ * @brief Unit tests for content hashing and the dedup index
+ *
+ * Tests cover:
+ * - XXH64 against the reference vectors, fed whole and in pieces
+ * - Lookups by size and hash, and counting of duplicates
+ * - Byte comparison of matches, and files changed since they were indexed
+ * - Lazy hashing of bodies added without a hash
+ */
+
+#include "test_framework.h"
+#include "../../src/core/dedup.h"
+#include "../../src/core/hash.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* =========================================================================
+ * Hash Tests
+ * ========================================================================= */
+
+TEST(xxh64_matches_reference_vectors)
+{
+    const char *sentence = "Nobody inspects the spammish repetition";
+
+    ASSERT_EQ(0xEF46DB3751D8E999ULL, xxh64("", 0, 0));
+    ASSERT_EQ(0xD24EC4F1A98C6E5BULL, xxh64("a", 1, 0));
+    ASSERT_EQ(0x44BC2CF5AD770999ULL, xxh64("abc", 3, 0));
+    ASSERT_EQ(0xFBCEA83C8A378BF1ULL, xxh64(sentence, strlen(sentence), 0));
+    return 0;
+}
+
+TEST(xxh64_streaming_matches_one_shot)
+{
+    char data[1000];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (char)(i * 31 + 7);
+
+    /* Piece sizes that straddle the 32-byte stripe in every way */
+    static const size_t pieces[] = {1, 7, 31, 32, 33, 100};
+    for (size_t p = 0; p < sizeof(pieces) / sizeof(pieces[0]); p++) {
+        Xxh64State state;
+        xxh64_reset(&state, 42);
+        for (size_t off = 0; off < sizeof(data); off += pieces[p]) {
+            size_t n = sizeof(data) - off < pieces[p] ? sizeof(data) - off : pieces[p];
+            xxh64_update(&state, data + off, n);
+        }
+        ASSERT_EQ(xxh64(data, sizeof(data), 42), xxh64_digest(&state));
+    }
+
+    ASSERT_NE(xxh64(data, sizeof(data), 0), xxh64(data, sizeof(data), 1));
+    return 0;
+}
+
+/* =========================================================================
+ * Index Tests
+ * ========================================================================= */
+
+/* Write size bytes of fill to dir/name and return its FileInfo */
+static FileInfo write_body(const char *dir, const char *name, char fill, size_t size)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    char *body = malloc(size);
+    memset(body, fill, size);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write(fd, body, size) != (ssize_t)size)
+            size = 0;
+        close(fd);
+    }
+    free(body);
+
+    FileInfo info;
+    memset(&info, 0, sizeof(info));
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        info.size = (uint64_t)st.st_size;
+        info.changed_nsec = (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+    }
+    return info;
+}
+
+static void remove_body(const char *dir, const char *name)
+{
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+TEST(dedup_index_finds_matching_size_and_hash)
+{
+    char dir[] = "/tmp/fconcat_dedup_XXXXXX";
+    ASSERT_NOT_NULL(mkdtemp(dir));
+    char a[500], b[500], c[700];
+    memset(a, 'a', sizeof(a));
+    memset(b, 'b', sizeof(b));
+    memset(c, 'a', sizeof(c));
+    FileInfo a_info = write_body(dir, "a.txt", 'a', sizeof(a));
+    FileInfo b_info = write_body(dir, "b.txt", 'b', sizeof(b));
+    FileInfo c_info = write_body(dir, "c.txt", 'a', sizeof(c));
+    uint64_t a_hash = xxh64(a, sizeof(a), 0);
+    uint64_t b_hash = xxh64(b, sizeof(b), 0);
+    uint64_t c_hash = xxh64(c, sizeof(c), 0);
+
+    DedupIndex *index = dedup_index_create(dir);
+    ASSERT_NOT_NULL(index);
+
+    ASSERT_FALSE(dedup_index_has_size(index, 500));
+    ASSERT_EQ(0, dedup_index_add(index, "a.txt", &a_info, a_hash, true));
+    ASSERT_EQ(0, dedup_index_add(index, "b.txt", &b_info, b_hash, true));
+    ASSERT_EQ(0, dedup_index_add(index, "c.txt", &c_info, c_hash, true));
+
+    DedupBody a_body = {a, -1};
+    DedupBody b_body = {b, -1};
+    DedupBody c_body = {c, -1};
+    ASSERT_TRUE(dedup_index_has_size(index, 500));
+    ASSERT_FALSE(dedup_index_has_size(index, 600));
+    ASSERT_STR_EQ("a.txt", dedup_index_find(index, 500, a_hash, &a_body));
+    ASSERT_STR_EQ("b.txt", dedup_index_find(index, 500, b_hash, &b_body));
+    ASSERT_STR_EQ("c.txt", dedup_index_find(index, 700, c_hash, &c_body));
+    ASSERT_NULL(dedup_index_find(index, 500, 0x3333, &a_body));
+    ASSERT_NULL(dedup_index_find(index, 600, a_hash, &a_body));
+
+    /* The body may also be read from a file */
+    char path[128];
+    snprintf(path, sizeof(path), "%s/b.txt", dir);
+    int fd = open(path, O_RDONLY);
+    ASSERT_TRUE(fd >= 0);
+    DedupBody b_file = {NULL, fd};
+    ASSERT_STR_EQ("b.txt", dedup_index_find(index, 500, b_hash, &b_file));
+    close(fd);
+
+    /* Enough bodies to grow the table; all stay reachable */
+    FileInfo many = {0};
+    for (int i = 0; i < 2000; i++) {
+        snprintf(path, sizeof(path), "many/%d", i);
+        many.size = 1000 + (uint64_t)i;
+        ASSERT_EQ(0, dedup_index_add(index, path, &many, (uint64_t)i, true));
+    }
+    ASSERT_TRUE(dedup_index_has_size(index, 2234));
+    ASSERT_STR_EQ("a.txt", dedup_index_find(index, 500, a_hash, &a_body));
+
+    dedup_index_note_duplicate(index, 500);
+    dedup_index_note_duplicate(index, 700);
+    DedupStats stats = dedup_index_stats(index);
+    ASSERT_EQ(2003, stats.files);
+    ASSERT_EQ(2, stats.duplicates);
+    ASSERT_EQ(1200, stats.bytes_saved);
+
+    dedup_index_destroy(index);
+    remove_body(dir, "a.txt");
+    remove_body(dir, "b.txt");
+    remove_body(dir, "c.txt");
+    rmdir(dir);
+    return 0;
+}
+
+TEST(dedup_index_compares_bytes_before_matching)
+{
+    char dir[] = "/tmp/fconcat_dedup_XXXXXX";
+    ASSERT_NOT_NULL(mkdtemp(dir));
+    char body[300];
+    memset(body, 'x', sizeof(body));
+    FileInfo x_info = write_body(dir, "x.txt", 'x', sizeof(body));
+    FileInfo y_info = write_body(dir, "y.txt", 'y', sizeof(body));
+
+    DedupIndex *index = dedup_index_create(dir);
+    ASSERT_NOT_NULL(index);
+
+    /* Same size and hash but other bytes, as in a hash collision */
+    ASSERT_EQ(0, dedup_index_add(index, "y.txt", &y_info, 0x1234, true));
+    DedupBody x_body = {body, -1};
+    ASSERT_NULL(dedup_index_find(index, sizeof(body), 0x1234, &x_body));
+
+    /* A body that matched once stops matching when its file is rewritten,
+       even with the same bytes, since they are not the ones written */
+    ASSERT_EQ(0, dedup_index_add(index, "x.txt", &x_info, 0x1234, true));
+    ASSERT_STR_EQ("x.txt", dedup_index_find(index, sizeof(body), 0x1234, &x_body));
+    x_info.changed_nsec--;
+    ASSERT_EQ(0, dedup_index_add(index, "x.txt", &x_info, 0x5678, true));
+    ASSERT_NULL(dedup_index_find(index, sizeof(body), 0x5678, &x_body));
+
+    dedup_index_destroy(index);
+    remove_body(dir, "x.txt");
+    remove_body(dir, "y.txt");
+    rmdir(dir);
+    return 0;
+}
+
+TEST(dedup_index_hashes_unhashed_bodies_from_disk)
+{
+    char dir[] = "/tmp/fconcat_dedup_XXXXXX";
+    ASSERT_NOT_NULL(mkdtemp(dir));
+
+    char body[300];
+    memset(body, 'q', sizeof(body));
+    char path[64];
+    snprintf(path, sizeof(path), "%s/copied.txt", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    ASSERT_TRUE(fd >= 0);
+    ASSERT_EQ((ssize_t)sizeof(body), write(fd, body, sizeof(body)));
+    close(fd);
+
+    struct stat st;
+    ASSERT_EQ(0, stat(path, &st));
+    FileInfo info = {0};
+    info.size = sizeof(body);
+    info.changed_nsec = (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+
+    DedupIndex *index = dedup_index_create(dir);
+    ASSERT_NOT_NULL(index);
+    ASSERT_EQ(0, dedup_index_add(index, "copied.txt", &info, 0, false));
+    ASSERT_EQ(0, dedup_index_add(index, "gone.txt", &info, 0, false));
+
+    /* A file that cannot be read never matches, the readable one does */
+    DedupBody same = {body, -1};
+    ASSERT_STR_EQ("copied.txt", dedup_index_find(index, sizeof(body), xxh64(body, sizeof(body), 0), &same));
+    body[0] = 'r';
+    ASSERT_NULL(dedup_index_find(index, sizeof(body), xxh64(body, sizeof(body), 0), &same));
+
+    /* dedup_hash_range leaves the file offset alone and stops at EOF */
+    fd = open(path, O_RDONLY);
+    ASSERT_TRUE(fd >= 0);
+    Xxh64State state;
+    xxh64_reset(&state, 0);
+    ASSERT_EQ(200, dedup_hash_range(fd, 100, 500, &state));
+    ASSERT_EQ(0, lseek(fd, 0, SEEK_CUR));
+    close(fd);
+    body[0] = 'q';
+    ASSERT_EQ(xxh64(body + 100, 200, 0), xxh64_digest(&state));
+
+    dedup_index_destroy(index);
+    unlink(path);
+    rmdir(dir);
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_dedup_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Content Hash");
+    RUN_TEST(xxh64_matches_reference_vectors);
+    RUN_TEST(xxh64_streaming_matches_one_shot);
+
+    TEST_SUITE_BEGIN("Dedup Index");
+    RUN_TEST(dedup_index_finds_matching_size_and_hash);
+    RUN_TEST(dedup_index_compares_bytes_before_matching);
+    RUN_TEST(dedup_index_hashes_unhashed_bodies_from_disk);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
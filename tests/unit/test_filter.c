@@ -8,11 +8,24 @@
  * - Path utility functions
  * - Exclude pattern matching
  * - Include pattern matching
+ * - Compiled pattern sets against the reference matchers
+ * - Hierarchical .gitignore rule layers
+ * - Sealed (lock-free) rule evaluation
+ * - Per-file transform plans
+ * - Batched (v2) filter plugins beside per-chunk (v1) ones
+ * - The content pass handing batched plugins several chunks per call
  */
 
 #include "test_framework.h"
 #include "../../src/filter/filter.h"
+#include "../../src/filter/filter_pattern.h"
+#include "../../src/filter/filter_scan.h"
+#include "../../src/filter/filter_ignore.h"
+#include "../../src/core/arena.h"
 #include "../../src/config/config.h"
+#include "../../src/core/context.h"
+#include "../../src/core/pipeline.h"
+#include "../../src/format/format.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -187,6 +200,67 @@ TEST(filter_is_binary_unicode_text)
     return 0;
 }
 
+TEST(filter_scan_kernels_agree)
+{
+    static const char *kernels[] = {"avx2", "sse2", "neon", "scalar"};
+    static char sample[4096 + 64];
+    
+    /* Mostly text with sprinkled control bytes; a NUL lands at various offsets */
+    unsigned int seed = 12345;
+    for (size_t i = 0; i < sizeof(sample); i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int r = (seed >> 16) % 100;
+        sample[i] = (r < 3) ? (char)((seed >> 8) % 0x20 + 1) : (r < 4) ? 0x7F : (char)('a' + r % 26);
+    }
+    
+    ASSERT_EQ(0, filter_scan_force_kernel("scalar"));
+    for (int round = 0; round < 2; round++) {
+        if (round == 1) sample[3001] = '\0';
+        for (size_t offset = 0; offset < 40; offset += 7) {
+            for (size_t size = 0; size < 4096; size += 131) {
+                ASSERT_EQ(0, filter_scan_force_kernel("scalar"));
+                ByteScanResult expected = filter_scan_bytes(sample + offset, size);
+                for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                    if (filter_scan_force_kernel(kernels[k]) != 0) continue; /* not on this CPU */
+                    ByteScanResult actual = filter_scan_bytes(sample + offset, size);
+                    ASSERT_EQ(expected.has_nul, actual.has_nul);
+                    ASSERT_EQ(expected.control_count, actual.control_count);
+                    ASSERT_EQ(expected.scanned, actual.scanned);
+                }
+            }
+        }
+    }
+    
+    ASSERT_EQ(-1, filter_scan_force_kernel("mmx"));
+    ASSERT_EQ(0, filter_scan_force_kernel(NULL));
+    ASSERT_NOT_NULL(filter_scan_kernel_name());
+    return 0;
+}
+
+TEST(filter_detect_binary_heuristics)
+{
+    /* UTF-16 without any NUL (CJK text) is caught by its BOM */
+    const char utf16le[] = {(char)0xFF, (char)0xFE, (char)0x2D, (char)0x4E, (char)0x87, (char)0x65};
+    ASSERT_EQ(1, filter_detect_binary(utf16le, sizeof(utf16le)));
+    const char utf16be[] = {(char)0xFE, (char)0xFF, (char)0x4E, (char)0x2D};
+    ASSERT_EQ(1, filter_detect_binary(utf16be, sizeof(utf16be)));
+    
+    /* UTF-8 BOM and ordinary whitespace/ANSI escapes are text */
+    const char utf8[] = "\xEF\xBB\xBFhello\n";
+    ASSERT_EQ(0, filter_detect_binary(utf8, sizeof(utf8) - 1));
+    const char ansi[] = "col1\tcol2\r\n\x1b[1mbold\x1b[0m\f\n";
+    ASSERT_EQ(0, filter_detect_binary(ansi, sizeof(ansi) - 1));
+    
+    /* A high share of other control bytes marks binary even without NUL */
+    char noisy[100];
+    memset(noisy, 'x', sizeof(noisy));
+    for (int i = 0; i < 20; i++) noisy[i * 5] = 0x01;
+    ASSERT_EQ(1, filter_detect_binary(noisy, sizeof(noisy)));
+    for (int i = 0; i < 20; i++) noisy[i * 5] = (i < 5) ? 0x01 : 'x';
+    ASSERT_EQ(0, filter_detect_binary(noisy, sizeof(noisy)));
+    return 0;
+}
+
 /* =========================================================================
  * Exclude Pattern Tests
  * Note: exclude_match_path returns:
@@ -283,6 +357,314 @@ TEST(include_match_path_empty_patterns)
     return 0;
 }
 
+/* =========================================================================
+ * Compiled Pattern Tests
+ * The compiled PatternSet must agree with the reference loop in
+ * exclude_match_path for every path, file or directory.
+ * ========================================================================= */
+
+TEST(pattern_set_classifies_patterns)
+{
+    char *patterns[] = {"node_modules", "*.log", "*.LOG", "*_test.go", "build*",
+                        "*.tar.gz", "src/*.c", "[ab].txt", "", NULL};
+    PatternSet *set = pattern_set_create(patterns, 10);
+    ASSERT_NOT_NULL(set);
+    
+    PatternSetStats stats = pattern_set_get_stats(set);
+    ASSERT_EQ(1, stats.literal_count);
+    ASSERT_EQ(2, stats.extension_count);
+    ASSERT_EQ(2, stats.suffix_count);   // *_test.go and *.tar.gz
+    ASSERT_EQ(1, stats.prefix_count);
+    ASSERT_EQ(2, stats.fallback_count); // src/*.c and [ab].txt
+    
+    pattern_set_destroy(set);
+    return 0;
+}
+
+TEST(pattern_set_matches_reference)
+{
+    char *patterns[] = {"node_modules", ".git", "*.log", "*.Tmp", "*_test.go", "build*",
+                        "*.tar.gz", "docs/internal", "src/*.c", "cache?", "[xy].md",
+                        "*", "README"};
+    const char *paths[] = {"node_modules", "a/node_modules", "a/node_modules/b.js",
+                           "NODE_MODULES/x", ".git", ".git/config", "x/.gitignore",
+                           "debug.log", "logs/DEBUG.LOG", "a.log/b", "file.tmp",
+                           "pkg/io_test.go", "pkg/io.go", "build", "buildfile",
+                           "out/build/x", "release.tar.gz", "a.gz", "docs/internal/a.md",
+                           "docs/internal", "docs/internals", "src/main.c", "src/sub/x.c",
+                           "lib/main.c", "cache1", "a/cacheX", "cache12", "x.md", "z.md",
+                           "readme", "src/readme", "plain.txt", "", "dir/", "a\\b.log"};
+    size_t pattern_total = sizeof(patterns) / sizeof(patterns[0]);
+    size_t path_total = sizeof(paths) / sizeof(paths[0]);
+    
+    /* Every prefix of the pattern list, so each class is checked on its own and combined */
+    for (size_t n = 0; n <= pattern_total; n++) {
+        ExcludeContext ctx;
+        ctx.patterns = patterns;
+        ctx.pattern_count = (int)n;
+        PatternSet *set = pattern_set_create(patterns, (int)n);
+        ASSERT_NOT_NULL(set);
+        
+        for (size_t i = 0; i < path_total; i++) {
+            for (int dir = 0; dir <= 1; dir++) {
+                FileInfo info = {0};
+                info.is_directory = dir;
+                int expected = exclude_match_path(paths[i], &info, &ctx);
+                int actual = exclude_match_compiled(paths[i], &info, set);
+                if (expected != actual) {
+                    printf("\n    mismatch: %zu patterns, path '%s', dir=%d: expected %d got %d\n",
+                           n, paths[i], dir, expected, actual);
+                }
+                ASSERT_EQ(expected, actual);
+            }
+        }
+        pattern_set_destroy(set);
+    }
+    return 0;
+}
+
+TEST(pattern_set_directory_prefixes)
+{
+    char *patterns[] = {"vendor", "*.egg-info"};
+    PatternSet *set = pattern_set_create(patterns, 2);
+    ASSERT_NOT_NULL(set);
+    
+    /* The "<pattern>/..." form only applies to directory entries */
+    ASSERT_EQ(1, pattern_set_match(set, "vendor/lib", true));
+    ASSERT_EQ(0, pattern_set_match(set, "vendor/lib", false));
+    ASSERT_EQ(1, pattern_set_match(set, "pkg.egg-info/sub", true));
+    ASSERT_EQ(0, pattern_set_match(set, "vendors/lib", true));
+    
+    pattern_set_destroy(set);
+    return 0;
+}
+
+TEST(include_match_compiled_matches_reference)
+{
+    char *patterns[] = {"*.c", "core/*.h", "Makefile"};
+    IncludeContext ctx;
+    ctx.patterns = patterns;
+    ctx.pattern_count = 3;
+    PatternSet *set = pattern_set_create(patterns, 3);
+    ASSERT_NOT_NULL(set);
+    
+    const char *paths[] = {"main.c", "src/core/types.h", "core/types.h", "lib/core/x.h",
+                           "makefile", "docs/readme.md"};
+    for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); i++) {
+        FileInfo info = {0};
+        ASSERT_EQ(include_match_path(paths[i], &info, &ctx), include_match_compiled(paths[i], &info, set));
+    }
+    
+    FileInfo dir = {0};
+    dir.is_directory = true;
+    ASSERT_EQ(1, include_match_compiled("anything", &dir, set));
+    ASSERT_EQ(0, include_match_compiled("main.c", NULL, NULL));
+    
+    pattern_set_destroy(set);
+    return 0;
+}
+
+/* =========================================================================
+ * Ignore File Tests
+ * ========================================================================= */
+
+static IgnoreLayer *ignore_layer_from(const char *rules, const char *directory, const IgnoreLayer *parent)
+{
+    IgnoreLayer *layer = NULL;
+    if (ignore_layer_create(rules, strlen(rules), directory, strlen(directory), parent, &layer) != 0)
+        return NULL;
+    return layer;
+}
+
+TEST(ignore_layer_gitignore_syntax)
+{
+    IgnoreLayer *root = ignore_layer_from("# comment\n"
+                                          "\n"
+                                          "*.o\n"
+                                          "build/\n"
+                                          "/TODO\n"
+                                          "docs/*.pdf\n"
+                                          "**/generated\n"
+                                          "logs/**\n"
+                                          "a/**/z\n"
+                                          "file[0-9].txt\n"
+                                          "trailing   \n"
+                                          "\\#hash\r\n",
+                                          "", NULL);
+    ASSERT_NOT_NULL(root);
+    
+    /* Names without a slash match at any depth, anchored ones from the root */
+    ASSERT_TRUE(ignore_layer_match(root, "main.o", false));
+    ASSERT_TRUE(ignore_layer_match(root, "src/deep/main.o", false));
+    ASSERT_FALSE(ignore_layer_match(root, "main.c", false));
+    ASSERT_TRUE(ignore_layer_match(root, "TODO", false));
+    ASSERT_FALSE(ignore_layer_match(root, "src/TODO", false));
+    ASSERT_TRUE(ignore_layer_match(root, "docs/a.pdf", false));
+    ASSERT_FALSE(ignore_layer_match(root, "docs/sub/a.pdf", false));
+    ASSERT_FALSE(ignore_layer_match(root, "src/docs/a.pdf", false));
+    
+    /* A trailing slash only matches directories */
+    ASSERT_TRUE(ignore_layer_match(root, "build", true));
+    ASSERT_TRUE(ignore_layer_match(root, "src/build", true));
+    ASSERT_FALSE(ignore_layer_match(root, "build", false));
+    
+    /* "**" spans any number of directories, including none */
+    ASSERT_TRUE(ignore_layer_match(root, "generated", true));
+    ASSERT_TRUE(ignore_layer_match(root, "x/y/generated", false));
+    ASSERT_TRUE(ignore_layer_match(root, "logs/2024/app.txt", false));
+    ASSERT_FALSE(ignore_layer_match(root, "logs", true));
+    ASSERT_TRUE(ignore_layer_match(root, "a/z", false));
+    ASSERT_TRUE(ignore_layer_match(root, "a/b/c/z", false));
+    ASSERT_FALSE(ignore_layer_match(root, "a/bz", false));
+    
+    /* Classes, trailing spaces, escapes, CRLF and the built-in .git rule */
+    ASSERT_TRUE(ignore_layer_match(root, "file7.txt", false));
+    ASSERT_FALSE(ignore_layer_match(root, "fileX.txt", false));
+    ASSERT_TRUE(ignore_layer_match(root, "trailing", false));
+    ASSERT_TRUE(ignore_layer_match(root, "#hash", false));
+    ASSERT_FALSE(ignore_layer_match(root, "comment", false));
+    ASSERT_TRUE(ignore_layer_match(root, ".git", true));
+    ASSERT_TRUE(ignore_layer_match(root, "sub/.git", false));
+    
+    ignore_layer_destroy(root);
+    return 0;
+}
+
+TEST(ignore_layer_deeper_rules_win)
+{
+    IgnoreLayer *root = ignore_layer_from("*.log\n!keep.log\n", "", NULL);
+    ASSERT_NOT_NULL(root);
+    IgnoreLayer *sub = ignore_layer_from("!debug.log\n/local\nkeep.log\n", "src/sub", root);
+    ASSERT_NOT_NULL(sub);
+    
+    /* The last matching line decides within a file */
+    ASSERT_TRUE(ignore_layer_match(root, "a.log", false));
+    ASSERT_FALSE(ignore_layer_match(root, "keep.log", false));
+    
+    /* A deeper file wins; its anchored rules are relative to its directory */
+    ASSERT_FALSE(ignore_layer_match(sub, "src/sub/debug.log", false));
+    ASSERT_TRUE(ignore_layer_match(sub, "src/sub/deep/keep.log", false));
+    ASSERT_TRUE(ignore_layer_match(sub, "src/sub/other.log", false));
+    ASSERT_TRUE(ignore_layer_match(sub, "src/sub/local", false));
+    ASSERT_FALSE(ignore_layer_match(sub, "src/sub/deep/local", false));
+    
+    /* A directory without rules adds no layer; no scope ignores nothing */
+    IgnoreLayer *empty = root;
+    ASSERT_EQ(0, ignore_layer_create("# nothing\n", 10, "src", 3, root, &empty));
+    ASSERT_NULL(empty);
+    ASSERT_FALSE(ignore_layer_match(NULL, "a.log", false));
+    
+    ignore_layer_destroy(sub);
+    ignore_layer_destroy(root);
+    return 0;
+}
+
+/* =========================================================================
+ * File-level Rule Tests
+ * Binary rules are decided once per file from info->is_binary.
+ * ========================================================================= */
+
+TEST(filter_detect_binary_sample)
+{
+    ASSERT_EQ(0, filter_detect_binary("plain text\n", 11));
+    ASSERT_EQ(1, filter_detect_binary("ab\0cd", 5));
+    ASSERT_EQ(0, filter_detect_binary("", 0));
+    ASSERT_EQ(0, filter_detect_binary(NULL, 4));
+    return 0;
+}
+
+TEST(filter_engine_binary_skip_is_file_level)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    ResolvedConfig config = {0};
+    config.binary_handling = BINARY_SKIP;
+    ASSERT_EQ(0, filter_binary_detection_init_internal(engine, &config));
+    
+    FileInfo info = {0};
+    info.binary_checked = true;
+    info.is_binary = true;
+    ASSERT_EQ(0, filter_engine_should_include_file(engine, NULL, "a.bin", &info));
+    info.is_binary = false;
+    ASSERT_EQ(1, filter_engine_should_include_file(engine, NULL, "a.txt", &info));
+    
+    /* Chunk-level checks no longer rescan for NULs */
+    ASSERT_EQ(1, filter_engine_should_include_content(engine, NULL, "a.bin", "x\0y", 3));
+    
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_binary_placeholder_replaces_binary_only)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    ResolvedConfig config = {0};
+    config.binary_handling = BINARY_PLACEHOLDER;
+    ASSERT_EQ(0, filter_binary_detection_init_internal(engine, &config));
+    
+    FileInfo info = {0};
+    info.binary_checked = true;
+    info.is_binary = true;
+    char *output = NULL;
+    size_t output_size = 0;
+    ASSERT_EQ(0, filter_engine_replace_file(engine, NULL, "a.bin", &info, &output, &output_size));
+    ASSERT_NOT_NULL(output);
+    ASSERT_TRUE(output_size > 0);
+    ASSERT_TRUE(strncmp(output, "// [Binary file", 15) == 0);
+    free(output);
+    
+    info.is_binary = false;
+    ASSERT_EQ(1, filter_engine_replace_file(engine, NULL, "a.txt", &info, &output, &output_size));
+    ASSERT_NULL(output);
+    ASSERT_EQ(1, filter_engine_should_include_file(engine, NULL, "a.txt", &info));
+    
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_sample_policy_first_match_wins)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    SampleRule rules[] = {
+        {"*.log", {64 * 1024, 16 * 1024, false, false}},
+        {"*.csv", {100, 0, true, false}},
+        {NULL, {1024, 0, false, false}},
+    };
+    ResolvedConfig config = {0};
+    config.samples = rules;
+    config.sample_count = 3;
+    ASSERT_EQ(0, filter_sample_rules_init_internal(engine, &config));
+
+    FileInfo info = {0};
+    info.size = 10 * 1024 * 1024;
+    const SamplePolicy *policy = filter_engine_sample_policy(engine, "logs/app.log", &info);
+    ASSERT_NOT_NULL(policy);
+    ASSERT_EQ(64 * 1024, policy->head);
+    ASSERT_EQ(16 * 1024, policy->tail);
+
+    policy = filter_engine_sample_policy(engine, "data.csv", &info);
+    ASSERT_NOT_NULL(policy);
+    ASSERT_TRUE(policy->head_lines);
+
+    /* The catch-all rule takes whatever the others do not */
+    policy = filter_engine_sample_policy(engine, "main.c", &info);
+    ASSERT_NOT_NULL(policy);
+    ASSERT_EQ(1024, policy->head);
+
+    /* A file no larger than what its rule keeps is read whole */
+    info.size = 80 * 1024;
+    ASSERT_NULL(filter_engine_sample_policy(engine, "logs/app.log", &info));
+    info.size = 100;
+    ASSERT_NULL(filter_engine_sample_policy(engine, "data.csv", &info));
+    info.size = 101;
+    ASSERT_NOT_NULL(filter_engine_sample_policy(engine, "data.csv", &info));
+
+    filter_engine_destroy(engine);
+    return 0;
+}
+
 /* =========================================================================
  * Filter Rule Tests
  * ========================================================================= */
@@ -324,6 +706,483 @@ TEST(filter_engine_add_multiple_rules)
     return 0;
 }
 
+static int match_large_files(const char *path, FileInfo *info, void *context)
+{
+    (void)path;
+    (void)context;
+    return info && info->size > 100;
+}
+
+TEST(filter_engine_path_needs_stat_for_stat_rules)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    ResolvedConfig config = {0};
+    config.symlink_handling = SYMLINK_SKIP;
+    config.binary_handling = BINARY_SKIP;
+    
+    /* Symlink and binary rules decide from the entry type or not at all */
+    ASSERT_FALSE(filter_engine_path_needs_stat(engine));
+    ASSERT_EQ(0, filter_symlink_handling_init_internal(engine, &config));
+    ASSERT_EQ(0, filter_binary_detection_init_internal(engine, &config));
+    ASSERT_FALSE(filter_engine_path_needs_stat(engine));
+    
+    /* A rule that reads the size cannot be decided before a stat */
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_EXCLUDE;
+    rule.match_path = match_large_files;
+    ASSERT_EQ(0, filter_engine_add_rule_internal(engine, &rule));
+    ASSERT_TRUE(filter_engine_path_needs_stat(engine));
+    
+    ASSERT_FALSE(filter_engine_path_needs_stat(NULL));
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+/* =========================================================================
+ * Sealed Engine Tests
+ * ========================================================================= */
+
+static int match_secret_path(const char *path, FileInfo *info, void *context)
+{
+    (void)info;
+    (void)context;
+    return strstr(path, "secret") != NULL;
+}
+
+static void *sealed_reader_thread(void *arg)
+{
+    FilterEngine *engine = (FilterEngine *)arg;
+    long mismatches = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (filter_engine_should_include_path(engine, NULL, "a/secret.txt", NULL) != 0) mismatches++;
+        if (filter_engine_should_include_path(engine, NULL, "a/public.txt", NULL) != 1) mismatches++;
+    }
+    return (void *)mismatches;
+}
+
+TEST(filter_engine_seal_rejects_mutation)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    ASSERT_FALSE(filter_engine_is_sealed(engine));
+    
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_EXCLUDE;
+    rule.match_path = match_secret_path;
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    
+    ASSERT_EQ(0, filter_engine_seal(engine));
+    ASSERT_TRUE(filter_engine_is_sealed(engine));
+    
+    /* Every mutation path is refused once sealed */
+    ASSERT_EQ(-1, filter_engine_add_rule(engine, &rule));
+    ASSERT_EQ(-1, filter_engine_add_rule_internal(engine, &rule));
+    FilterPlugin plugin = {0};
+    ASSERT_EQ(-1, filter_engine_register_plugin(engine, &plugin));
+    ResolvedConfig config = {0};
+    ASSERT_EQ(-1, filter_engine_configure(engine, &config));
+    ASSERT_EQ(1, engine->rule_count);
+    ASSERT_EQ(0, engine->plugin_count);
+    
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_sealed_concurrent_reads)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_EXCLUDE;
+    rule.match_path = match_secret_path;
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    ASSERT_EQ(0, filter_engine_seal(engine));
+    
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, sealed_reader_thread, engine));
+    }
+    long mismatches = 0;
+    for (int i = 0; i < 4; i++) {
+        void *ret = NULL;
+        pthread_join(threads[i], &ret);
+        mismatches += (long)ret;
+    }
+    ASSERT_EQ(0, mismatches);
+    
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_seal_null_safe)
+{
+    ASSERT_EQ(-1, filter_engine_seal(NULL));
+    ASSERT_FALSE(filter_engine_is_sealed(NULL));
+    return 0;
+}
+
+/* =========================================================================
+ * Transform Plan Tests
+ * ========================================================================= */
+
+static int match_upper_path(const char *path, FileInfo *info, void *context)
+{
+    (void)info;
+    (void)context;
+    return strstr(path, "upper") != NULL;
+}
+
+static int upper_transform(FconcatContext *ctx, const char *path, const char *input, size_t input_size,
+                           char **output, size_t *output_size, void *context)
+{
+    (void)path;
+    (void)context;
+    *output = context_arena_alloc(ctx, input_size);
+    if (!*output) return -1;
+    for (size_t i = 0; i < input_size; i++)
+        (*output)[i] = (input[i] >= 'a' && input[i] <= 'z') ? (char)(input[i] - 32) : input[i];
+    *output_size = input_size;
+    return 0;
+}
+
+TEST(filter_engine_plan_without_transforms)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_EXCLUDE;
+    rule.match_path = match_secret_path;
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    ASSERT_EQ(0, filter_engine_seal(engine));
+    ASSERT_EQ(0, engine->stages.chunk_transform_count);
+    
+    FileInfo info = {0};
+    FilterFilePlan plan;
+    filter_engine_plan_file(engine, NULL, "a.txt", &info, &plan);
+    ASSERT_FALSE(plan.inspect_content);
+    ASSERT_FALSE(plan.transform_content);
+    
+    /* Nothing to do: the caller keeps its own buffer, no copy is made */
+    char *output = NULL;
+    size_t output_size = 0;
+    ASSERT_EQ(1, filter_engine_transform_chunk(engine, NULL, "a.txt", &plan, "abc", 3, &output, &output_size));
+    ASSERT_NULL(output);
+    ASSERT_EQ(1, filter_engine_transform_content(engine, NULL, "a.txt", "abc", 3, &output, &output_size));
+    ASSERT_NULL(output);
+    
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_plan_honours_transform_paths)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    MemoryManager *memory = memory_manager_create();
+    ASSERT_NOT_NULL(memory);
+    InternalContextState internal = {0};
+    internal.memory_manager = memory;
+    FconcatContext ctx = {0};
+    ctx.internal_state = &internal;
+    
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_TRANSFORM;
+    rule.match_path = match_upper_path;
+    rule.transform = upper_transform;
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    ASSERT_EQ(0, filter_engine_seal(engine));
+    ASSERT_EQ(1, engine->stages.chunk_transform_count);
+    
+    FileInfo info = {0};
+    FilterFilePlan plan;
+    char *output = NULL;
+    size_t output_size = 0;
+    
+    filter_engine_plan_file(engine, &ctx, "keep.txt", &info, &plan);
+    ASSERT_FALSE(plan.transform_content);
+    ASSERT_EQ(1, filter_engine_transform_chunk(engine, &ctx, "keep.txt", &plan, "abc", 3, &output, &output_size));
+    
+    filter_engine_plan_file(engine, &ctx, "upper.txt", &info, &plan);
+    ASSERT_TRUE(plan.transform_content);
+    ASSERT_EQ(0, filter_engine_transform_chunk(engine, &ctx, "upper.txt", &plan, "abc", 3, &output, &output_size));
+    ASSERT_EQ(3, output_size);
+    ASSERT_MEM_EQ("ABC", output, 3);
+    context_scratch_release(&ctx, output);
+    
+    memory_manager_destroy(memory);
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+TEST(filter_engine_chained_transforms_use_context_arena)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    InternalContextState internal = {0};
+    FconcatContext ctx = {0};
+    ctx.internal_state = &internal;
+    ctx.arena = arena_create(0);
+    ASSERT_NOT_NULL(ctx.arena);
+    
+    FilterRule rule = {0};
+    rule.type = FILTER_TYPE_TRANSFORM;
+    rule.transform = upper_transform;
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    ASSERT_EQ(0, filter_engine_add_rule(engine, &rule));
+    
+    /* The intermediate buffer is arena memory and must not be freed */
+    char *output = NULL;
+    size_t output_size = 0;
+    ASSERT_EQ(0, filter_engine_transform_content(engine, &ctx, "a.txt", "abc", 3, &output, &output_size));
+    ASSERT_MEM_EQ("ABC", output, 3);
+    ASSERT_TRUE(arena_owns(ctx.arena, output));
+    context_scratch_release(&ctx, output);
+    
+    arena_destroy(ctx.arena);
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+/* =========================================================================
+ * Batched Plugin Tests
+ * ========================================================================= */
+
+static int batch_calls;
+static size_t batch_chunks;
+
+/* Uppercases every chunk and drops the ones that mention a secret */
+static int upper_filter_chunks(FconcatContext *ctx, FilterChunk *chunks, size_t count)
+{
+    batch_calls++;
+    batch_chunks += count;
+    for (size_t i = 0; i < count; i++) {
+        FilterChunk *chunk = &chunks[i];
+        char *output = context_arena_alloc(ctx, chunk->size);
+        if (!output) return -1;
+        size_t used = 0;
+        for (size_t s = 0; s < chunk->segment_count; s++) {
+            for (size_t j = 0; j < chunk->segments[s].size; j++) {
+                char c = chunk->segments[s].data[j];
+                output[used++] = (c >= 'a' && c <= 'z') ? (char)(c - 32) : c;
+            }
+        }
+        if (used >= 6 && memmem(output, used, "SECRET", 6)) {
+            chunk->exclude = true;
+            continue;
+        }
+        chunk->output = output;
+        chunk->output_size = used;
+    }
+    return 0;
+}
+
+static int v1_content_calls;
+
+static int reject_bang(FconcatContext *ctx, const char *path, const char *content, size_t size)
+{
+    (void)ctx;
+    (void)path;
+    v1_content_calls++;
+    return memchr(content, '!', size) == NULL;
+}
+
+TEST(filter_engine_batches_v2_plugins)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    InternalContextState internal = {0};
+    FconcatContext ctx = {0};
+    ctx.internal_state = &internal;
+    ctx.arena = arena_create(0);
+    ASSERT_NOT_NULL(ctx.arena);
+    
+    /* A per-chunk plugin runs through the adapter beside the batched one */
+    FilterPlugin v1 = {0};
+    v1.name = "bang";
+    v1.should_include_content = reject_bang;
+    ASSERT_EQ(0, filter_engine_register_plugin(engine, &v1));
+    
+    FilterPluginV2 v2 = {0};
+    v2.base.name = "upper";
+    v2.base.should_include_content = reject_bang; /* Ignored once batched */
+    v2.size = sizeof(v2);
+    v2.abi_version = FILTER_PLUGIN_ABI_V2;
+    v2.capabilities = FILTER_CAP_BATCH_CHUNKS;
+    v2.filter_chunks = upper_filter_chunks;
+    ASSERT_EQ(0, filter_engine_register_plugin_v2(engine, &v2));
+    ASSERT_EQ(0, filter_engine_seal(engine));
+    ASSERT_EQ(1, engine->stages.content_plugin_count);
+    ASSERT_EQ(1, engine->stages.batch_plugin_count);
+    
+    FileInfo info = {0};
+    FilterFilePlan plan;
+    filter_engine_plan_file(engine, &ctx, "a.txt", &info, &plan);
+    ASSERT_TRUE(plan.inspect_content);
+    ASSERT_TRUE(plan.transform_content);
+    
+    /* More chunks than one batch holds; one of them scattered over two segments */
+    enum { CHUNKS = FILTER_BATCH_MAX + 2 };
+    FilterSegment segments[CHUNKS + 1];
+    FilterChunk chunks[CHUNKS];
+    memset(chunks, 0, sizeof(chunks));
+    for (int i = 0; i < CHUNKS; i++) {
+        const char *text = i == 1 ? "a secret" : i == 2 ? "bang!" : "abc";
+        segments[i] = (FilterSegment){text, strlen(text)};
+        chunks[i].path = "a.txt";
+        chunks[i].segments = &segments[i];
+        chunks[i].segment_count = 1;
+        chunks[i].size = strlen(text);
+        chunks[i].flags = FILTER_CHUNK_FIRST | FILTER_CHUNK_LAST;
+    }
+    segments[0] = (FilterSegment){"ab", 2};
+    segments[CHUNKS] = (FilterSegment){"c", 1};
+    FilterSegment scattered[2] = {segments[0], segments[CHUNKS]};
+    chunks[0].segments = scattered;
+    chunks[0].segment_count = 2;
+    
+    batch_calls = 0;
+    batch_chunks = 0;
+    v1_content_calls = 0;
+    ASSERT_EQ(0, filter_engine_filter_chunks(engine, &ctx, &plan, chunks, CHUNKS));
+    
+    /* One call per batch, without the chunk the v1 plugin already dropped */
+    ASSERT_EQ(2, batch_calls);
+    ASSERT_EQ(CHUNKS - 1, batch_chunks);
+    ASSERT_EQ(CHUNKS, v1_content_calls);
+    
+    ASSERT_FALSE(chunks[0].exclude);
+    ASSERT_EQ(3, chunks[0].output_size);
+    ASSERT_MEM_EQ("ABC", chunks[0].output, 3);
+    ASSERT_TRUE(chunks[1].exclude);
+    ASSERT_NULL(chunks[1].output);
+    ASSERT_TRUE(chunks[2].exclude);
+    for (int i = 3; i < CHUNKS; i++) {
+        ASSERT_FALSE(chunks[i].exclude);
+        ASSERT_MEM_EQ("ABC", chunks[i].output, 3);
+    }
+    
+    /* The single-chunk transform path applies it too, but cannot exclude */
+    char *output = NULL;
+    size_t output_size = 0;
+    ASSERT_EQ(0, filter_engine_transform_chunk(engine, &ctx, "a.txt", &plan, "xyz", 3, &output, &output_size));
+    ASSERT_MEM_EQ("XYZ", output, 3);
+    
+    arena_destroy(ctx.arena);
+    filter_engine_destroy(engine);
+    return 0;
+}
+
+typedef struct {
+    char *data;
+    size_t size;
+} Collected;
+
+static int collect_output(void *opaque, const void *data, size_t size)
+{
+    Collected *collected = opaque;
+    char *grown = realloc(collected->data, collected->size + size);
+    if (!grown) return -1;
+    memcpy(grown + collected->size, data, size);
+    collected->data = grown;
+    collected->size += size;
+    return 0;
+}
+
+TEST(pipeline_batches_chunks_for_v2_plugins)
+{
+    create_test_temp_dir();
+    ASSERT_TRUE(temp_dir_created);
+
+    /* Six chunks: the whole-file chunk size five times, and a short one */
+    size_t size = 5 * PIPELINE_WHOLE_FILE_CHUNK + 10;
+    char *body = malloc(size);
+    ASSERT_NOT_NULL(body);
+    memset(body, 'q', size);
+    char path[512];
+    snprintf(path, sizeof(path), "%s/batched.txt", test_temp_dir);
+    FILE *file = fopen(path, "wb");
+    ASSERT_NOT_NULL(file);
+    ASSERT_EQ(size, fwrite(body, 1, size, file));
+    fclose(file);
+
+    ResolvedConfig config = {0};
+    config.input_directory = test_temp_dir;
+    FilterEngine *engine = filter_engine_create();
+    FormatEngine *format = format_engine_create();
+    ASSERT_NOT_NULL(engine);
+    ASSERT_NOT_NULL(format);
+    ASSERT_EQ(0, format_engine_configure(format, &config, NULL));
+    FilterPluginV2 v2 = {0};
+    v2.base.name = "upper";
+    v2.size = sizeof(v2);
+    v2.abi_version = FILTER_PLUGIN_ABI_V2;
+    v2.capabilities = FILTER_CAP_BATCH_CHUNKS;
+    v2.filter_chunks = upper_filter_chunks;
+    ASSERT_EQ(0, filter_engine_register_plugin_v2(engine, &v2));
+    ASSERT_EQ(0, filter_engine_seal(engine));
+
+    ProcessingStats stats = {0};
+    FconcatContext *ctx = create_fconcat_context(&config, NULL, &stats, NULL, NULL, NULL, format, engine);
+    ASSERT_NOT_NULL(ctx);
+    Collected collected = {NULL, 0};
+    ASSERT_EQ(0, context_restart_writer(ctx, collect_output, &collected));
+
+    FileInfo info = {0};
+    info.size = size;
+    batch_calls = 0;
+    batch_chunks = 0;
+    ASSERT_EQ(0, pipeline_process_file(ctx, "batched.txt", &info, NULL));
+    ASSERT_EQ(0, context_flush_output(ctx));
+
+    /* The chunks reach the plugin PIPELINE_FILTER_BATCH_BYTES at a time */
+    size_t per_call = PIPELINE_FILTER_BATCH_BYTES / PIPELINE_WHOLE_FILE_CHUNK;
+    ASSERT_EQ((int)((6 + per_call - 1) / per_call), batch_calls);
+    ASSERT_EQ(6, batch_chunks);
+
+    /* All of it transformed, in order, between header and footer */
+    const char *header = "// File: batched.txt\n";
+    ASSERT_EQ(strlen(header) + size + 2, collected.size);
+    ASSERT_MEM_EQ(header, collected.data, strlen(header));
+    memset(body, 'Q', size);
+    ASSERT_MEM_EQ(body, collected.data + strlen(header), size);
+
+    free(collected.data);
+    free(body);
+    destroy_fconcat_context(ctx);
+    format_engine_destroy(format);
+    filter_engine_destroy(engine);
+    unlink(path);
+    return 0;
+}
+
+TEST(filter_engine_v2_without_batch_capability_is_v1)
+{
+    FilterEngine *engine = filter_engine_create();
+    ASSERT_NOT_NULL(engine);
+    
+    FilterPluginV2 v2 = {0};
+    v2.base.name = "plain";
+    v2.base.should_include_content = reject_bang;
+    v2.size = sizeof(v2);
+    v2.abi_version = FILTER_PLUGIN_ABI_V2;
+    v2.filter_chunks = upper_filter_chunks;
+    ASSERT_EQ(0, filter_engine_register_plugin_v2(engine, &v2));
+    ASSERT_EQ(1, engine->stages.content_plugin_count);
+    ASSERT_EQ(0, engine->stages.batch_plugin_count);
+    
+    batch_calls = 0;
+    ASSERT_EQ(0, filter_engine_should_include_content(engine, NULL, "a.txt", "hi!", 3));
+    ASSERT_EQ(1, filter_engine_should_include_content(engine, NULL, "a.txt", "hi", 2));
+    ASSERT_EQ(0, batch_calls);
+    
+    ASSERT_EQ(-1, filter_engine_register_plugin_v2(engine, NULL));
+    filter_engine_destroy(engine);
+    return 0;
+}
+
 /* =========================================================================
  * Main Entry Point
  * ========================================================================= */
@@ -354,6 +1213,8 @@ int test_filter_main(void)
     RUN_TEST(filter_is_binary_binary_file);
     RUN_TEST(filter_is_binary_empty_file);
     RUN_TEST(filter_is_binary_unicode_text);
+    RUN_TEST(filter_scan_kernels_agree);
+    RUN_TEST(filter_detect_binary_heuristics);
     
     TEST_SUITE_BEGIN("Exclude Patterns");
     RUN_TEST(exclude_match_path_basic_pattern);
@@ -365,9 +1226,41 @@ int test_filter_main(void)
     RUN_TEST(include_match_path_null_context);
     RUN_TEST(include_match_path_empty_patterns);
     
+    TEST_SUITE_BEGIN("Compiled Patterns");
+    RUN_TEST(pattern_set_classifies_patterns);
+    RUN_TEST(pattern_set_matches_reference);
+    RUN_TEST(pattern_set_directory_prefixes);
+    RUN_TEST(include_match_compiled_matches_reference);
+    
+    TEST_SUITE_BEGIN("Ignore Files");
+    RUN_TEST(ignore_layer_gitignore_syntax);
+    RUN_TEST(ignore_layer_deeper_rules_win);
+    
+    TEST_SUITE_BEGIN("File-level Rules");
+    RUN_TEST(filter_detect_binary_sample);
+    RUN_TEST(filter_engine_binary_skip_is_file_level);
+    RUN_TEST(filter_engine_binary_placeholder_replaces_binary_only);
+    RUN_TEST(filter_engine_sample_policy_first_match_wins);
+    
     TEST_SUITE_BEGIN("Filter Rules");
     RUN_TEST(filter_engine_add_rule);
     RUN_TEST(filter_engine_add_multiple_rules);
+    RUN_TEST(filter_engine_path_needs_stat_for_stat_rules);
+    
+    TEST_SUITE_BEGIN("Sealed Engine");
+    RUN_TEST(filter_engine_seal_rejects_mutation);
+    RUN_TEST(filter_engine_sealed_concurrent_reads);
+    RUN_TEST(filter_engine_seal_null_safe);
+    
+    TEST_SUITE_BEGIN("Transform Plans");
+    RUN_TEST(filter_engine_plan_without_transforms);
+    RUN_TEST(filter_engine_plan_honours_transform_paths);
+    RUN_TEST(filter_engine_chained_transforms_use_context_arena);
+    
+    TEST_SUITE_BEGIN("Batched Plugins");
+    RUN_TEST(filter_engine_batches_v2_plugins);
+    RUN_TEST(pipeline_batches_chunks_for_v2_plugins);
+    RUN_TEST(filter_engine_v2_without_batch_capability_is_v1);
     
     TEST_SUMMARY();
     
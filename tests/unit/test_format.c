@@ -0,0 +1,385 @@
+/**
+ * @file test_format.c
+ * @brief Unit tests for the JSON string escaping behind --format ndjson
+ *
+ * Tests cover:
+ * - Every escape kernel finding the same first byte as the scalar loop
+ * - The escape of each byte value, and bytes from 0x80 up checked as UTF-8
+ * - Ill-formed UTF-8 replaced by U+FFFD, well-formed sequences kept whole
+ * - Escaping into small windows never splitting an escape
+ * - Formatter state kept per context, so interleaved documents stay intact
+ *   (ndjson records, indexed blocks and index)
+ * - Empty chunks written as nothing
+ */
+
+#include "test_framework.h"
+#include "../../src/format/format_escape.h"
+#include "../../src/format/format.h"
+#include "../../src/format/format_indexed.h"
+#include "../../src/core/context.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* =========================================================================
+ * Kernel Tests
+ * ========================================================================= */
+
+TEST(format_escape_kernels_agree)
+{
+    static const char *kernels[] = {"avx2", "sse2", "neon", "scalar"};
+    static char sample[4096 + 64];
+
+    /* Mostly text; quotes, backslashes and control bytes are sparse */
+    unsigned int seed = 4242;
+    for (size_t i = 0; i < sizeof(sample); i++) {
+        seed = seed * 1103515245u + 12345u;
+        unsigned int r = (seed >> 16) % 400;
+        sample[i] = (r == 0) ? '"' : (r == 1) ? '\\' : (r == 2) ? (char)((seed >> 8) % 0x20)
+                  : (r < 6) ? (char)(0x80 + r) : (char)('a' + r % 26);
+    }
+
+    for (size_t offset = 0; offset < 40; offset += 7) {
+        for (size_t size = 0; size < 4096; size += 67) {
+            ASSERT_EQ(0, format_escape_force_kernel("scalar"));
+            size_t expected = format_json_plain_prefix(sample + offset, size);
+            for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+                if (format_escape_force_kernel(kernels[k]) != 0) continue; /* not on this CPU */
+                ASSERT_EQ(expected, format_json_plain_prefix(sample + offset, size));
+            }
+        }
+    }
+
+    ASSERT_EQ(-1, format_escape_force_kernel("mmx"));
+    ASSERT_EQ(0, format_escape_force_kernel(NULL));
+    ASSERT_NOT_NULL(format_escape_kernel_name());
+    return 0;
+}
+
+/* =========================================================================
+ * Escape Tests
+ * ========================================================================= */
+
+TEST(format_json_escape_covers_every_byte)
+{
+    char out[16];
+    size_t consumed = 0;
+
+    for (int c = 0; c < 256; c++) {
+        char in = (char)c;
+        size_t n = format_json_escape(&in, 1, true, &consumed, out, sizeof(out));
+        ASSERT_EQ(1, consumed);
+
+        char expected[16];
+        switch (c) {
+        case '"':  strcpy(expected, "\\\""); break;
+        case '\\': strcpy(expected, "\\\\"); break;
+        case '\b': strcpy(expected, "\\b"); break;
+        case '\f': strcpy(expected, "\\f"); break;
+        case '\n': strcpy(expected, "\\n"); break;
+        case '\r': strcpy(expected, "\\r"); break;
+        case '\t': strcpy(expected, "\\t"); break;
+        default:
+            if (c < 0x20)
+                snprintf(expected, sizeof(expected), "\\u%04x", c);
+            else if (c >= 0x80)
+                strcpy(expected, "\\ufffd"); /* no byte from 0x80 up is UTF-8 alone */
+            else
+                snprintf(expected, sizeof(expected), "%c", c);
+        }
+        ASSERT_EQ(strlen(expected), n);
+        ASSERT_MEM_EQ(expected, out, n);
+
+        /* With more input to come, a lead byte waits for the rest */
+        n = format_json_escape(&in, 1, false, &consumed, out, sizeof(out));
+        ASSERT_EQ(c >= 0xc2 && c <= 0xf4 ? 0 : 1, consumed);
+    }
+    return 0;
+}
+
+TEST(format_json_escape_replaces_ill_formed_utf8)
+{
+    static const struct {
+        const char *in;
+        const char *expected;
+    } cases[] = {
+        {"caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80", "caf\xc3\xa9 \xe2\x82\xac \xf0\x9f\x98\x80"},
+        {"\xff\xfe", "\\ufffd\\ufffd"},
+        {"a\xc3(b", "a\\ufffd(b"},                           /* lead without continuation */
+        {"\xa9x", "\\ufffdx"},                               /* stray continuation */
+        {"\xc0\xaf", "\\ufffd\\ufffd"},                     /* overlong */
+        {"\xe0\x80\xaf", "\\ufffd\\ufffd\\ufffd"},         /* overlong */
+        {"\xed\xa0\x80", "\\ufffd\\ufffd\\ufffd"},         /* surrogate */
+        {"\xf4\x90\x80\x80", "\\ufffd\\ufffd\\ufffd\\ufffd"}, /* beyond U+10FFFF */
+        {"\xe2\x82x", "\\ufffdx"},                          /* one replacement per broken start */
+        {"\xf0\x9f\x98", "\\ufffd"},                         /* cut short by the end */
+        {"\"\xe9\"", "\\\"\\ufffd\\\""},
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        char out[128];
+        size_t size = strlen(cases[i].in);
+        size_t consumed = 0;
+        size_t n = format_json_escape(cases[i].in, size, true, &consumed, out, sizeof(out));
+        ASSERT_EQ(size, consumed);
+        ASSERT_EQ(strlen(cases[i].expected), n);
+        ASSERT_MEM_EQ(cases[i].expected, out, n);
+    }
+
+    /* Not final: the unfinished sequence at the end is left for later */
+    char out[16];
+    size_t consumed = 0;
+    ASSERT_EQ(2, format_json_escape("ab\xf0\x9f\x98", 5, false, &consumed, out, sizeof(out)));
+    ASSERT_EQ(2, consumed);
+    ASSERT_MEM_EQ("ab", out, 2);
+    return 0;
+}
+
+TEST(format_json_escape_never_splits_an_escape)
+{
+    const char input[] = "say \"hi\"\n\x01\tpath\\to \xc3\xa9t\xc3\xa9 and a long plain tail";
+    const size_t size = sizeof(input) - 1;
+    const char expected[] = "say \\\"hi\\\"\\n\\u0001\\tpath\\\\to \xc3\xa9t\xc3\xa9 and a long plain tail";
+
+    /* Whole in one go */
+    char whole[256];
+    size_t consumed = 0;
+    size_t n = format_json_escape(input, size, true, &consumed, whole, sizeof(whole));
+    ASSERT_EQ(size, consumed);
+    ASSERT_EQ(sizeof(expected) - 1, n);
+    ASSERT_MEM_EQ(expected, whole, n);
+
+    /* Through every window size an escape fits in */
+    for (size_t room = 6; room < 24; room++) {
+        char joined[256];
+        size_t length = 0;
+        size_t read = 0;
+        while (read < size) {
+            size_t step = format_json_escape(input + read, size - read, true, &consumed, joined + length, room);
+            ASSERT_TRUE(consumed > 0);
+            ASSERT_TRUE(step <= room);
+            read += consumed;
+            length += step;
+        }
+        ASSERT_EQ(n, length);
+        ASSERT_MEM_EQ(expected, joined, n);
+    }
+
+    /* A window too small for the next escape takes nothing */
+    ASSERT_EQ(0, format_json_escape("\x02", 1, true, &consumed, whole, 5));
+    ASSERT_EQ(0, consumed);
+    return 0;
+}
+
+/* =========================================================================
+ * Formatter State Tests
+ * ========================================================================= */
+
+typedef struct {
+    char data[4096];
+    size_t size;
+} Document;
+
+static int collect_document(void *opaque, const void *data, size_t size)
+{
+    Document *document = opaque;
+    if (document->size + size >= sizeof(document->data))
+        return -1;
+    memcpy(document->data + document->size, data, size);
+    document->size += size;
+    document->data[document->size] = '\0';
+    return 0;
+}
+
+static FconcatContext *create_document_context(const ResolvedConfig *config, ProcessingStats *stats,
+                                               Document *document)
+{
+    FconcatContext *ctx = create_fconcat_context(config, NULL, stats, NULL, NULL, NULL, NULL, NULL);
+    if (ctx && context_restart_writer(ctx, collect_document, document) != 0) {
+        destroy_fconcat_context(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+TEST(format_ndjson_state_is_per_context)
+{
+    ResolvedConfig config = {0};
+    config.output_format = "ndjson";
+    config.input_directory = "in";
+    ProcessingStats stats_a = {0}, stats_b = {0};
+    Document a = {{0}, 0}, b = {{0}, 0};
+    FconcatContext *ctx_a = create_document_context(&config, &stats_a, &a);
+    FconcatContext *ctx_b = create_document_context(&config, &stats_b, &b);
+    ASSERT_NOT_NULL(ctx_a);
+    ASSERT_NOT_NULL(ctx_b);
+
+    /* Two documents written at once, each record left open by one while
+     * the other starts; a shared flag loses the close of the first */
+    FormatPlugin *ndjson = format_ndjson_plugin();
+    ASSERT_EQ(0, ndjson->begin_document(ctx_a));
+    ASSERT_EQ(0, ndjson->write_file_header(ctx_a, "a.txt"));
+    ASSERT_EQ(0, ndjson->begin_document(ctx_b));
+    ASSERT_EQ(0, ndjson->write_file_header(ctx_b, "b.txt"));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx_a, "one", 3));
+    ASSERT_EQ(0, ndjson->write_file_footer(ctx_a));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx_b, "two", 3));
+    ASSERT_EQ(0, ndjson->end_document(ctx_b));
+    ASSERT_EQ(0, ndjson->end_document(ctx_a));
+    ASSERT_EQ(0, context_flush_output(ctx_a));
+    ASSERT_EQ(0, context_flush_output(ctx_b));
+
+    ASSERT_STR_EQ("{\"path\":\"a.txt\",\"content\":\"one\"}\n", a.data);
+    ASSERT_STR_EQ("{\"path\":\"b.txt\",\"content\":\"two\"}\n", b.data);
+
+    destroy_fconcat_context(ctx_a);
+    destroy_fconcat_context(ctx_b);
+    return 0;
+}
+
+TEST(format_ndjson_keeps_utf8_across_chunks)
+{
+    ResolvedConfig config = {0};
+    config.output_format = "ndjson";
+    config.input_directory = "in";
+    ProcessingStats stats = {0};
+    Document document = {{0}, 0};
+    FconcatContext *ctx = create_document_context(&config, &stats, &document);
+    ASSERT_NOT_NULL(ctx);
+
+    /* Sequences split between chunks come out whole; one the file ends
+     * in the middle of, and bytes that are not UTF-8, are replaced */
+    FormatPlugin *ndjson = format_ndjson_plugin();
+    ASSERT_EQ(0, ndjson->begin_document(ctx));
+    ASSERT_EQ(0, ndjson->write_file_header(ctx, "caf\xc3\xa9\xff.txt"));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "caf\xc3", 4));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "\xa9 \xf0", 3));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "\x9f", 1));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "\x98", 1));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "\x80!\xe2\x82", 4));
+    ASSERT_EQ(0, ndjson->write_file_footer(ctx));
+    ASSERT_EQ(0, ndjson->write_file_header(ctx, "bin"));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "\xc3", 1));
+    ASSERT_EQ(0, ndjson->write_file_chunk(ctx, "(\xfe\xff", 3));
+    ASSERT_EQ(0, ndjson->end_document(ctx));
+    ASSERT_EQ(0, context_flush_output(ctx));
+
+    ASSERT_STR_EQ("{\"path\":\"caf\xc3\xa9\\ufffd.txt\",\"content\":\"caf\xc3\xa9 \xf0\x9f\x98\x80!\\ufffd\"}\n"
+                  "{\"path\":\"bin\",\"content\":\"\\ufffd(\\ufffd\\ufffd\"}\n",
+                  document.data);
+
+    destroy_fconcat_context(ctx);
+    return 0;
+}
+
+TEST(format_text_writes_empty_chunks_as_nothing)
+{
+    ResolvedConfig config = {0};
+    config.input_directory = "in";
+    ProcessingStats stats = {0};
+    Document document = {{0}, 0};
+    FconcatContext *ctx = create_document_context(&config, &stats, &document);
+    ASSERT_NOT_NULL(ctx);
+
+    /* A chunk a transform emptied is not terminated; size 0 must not
+     * send the writer looking for the end of it */
+    char body[64];
+    memset(body, 'x', sizeof(body));
+    FormatPlugin *text = format_text_plugin();
+    ASSERT_EQ(0, text->write_file_header(ctx, "a.txt"));
+    ASSERT_EQ(0, text->write_file_chunk(ctx, body, 0));
+    ASSERT_EQ(0, ctx->write_output(ctx, body, 0));
+    ASSERT_EQ(0, text->write_file_chunk(ctx, body, 2));
+    ASSERT_EQ(0, context_flush_output(ctx));
+
+    ASSERT_STR_EQ("// File: a.txt\nxx", document.data);
+
+    destroy_fconcat_context(ctx);
+    return 0;
+}
+
+/* Write a document out and look path up in its index */
+static int find_in_document(const Document *document, const char *path, size_t *count)
+{
+    char file[] = "/tmp/fconcat_format_XXXXXX";
+    int fd = mkstemp(file);
+    if (fd < 0)
+        return -1;
+    int ok = write(fd, document->data, document->size) == (ssize_t)document->size;
+    close(fd);
+
+    IndexedArchive *archive = ok ? indexed_archive_open(file) : NULL;
+    unlink(file);
+    if (!archive)
+        return -1;
+    IndexedEntry entry;
+    int found = indexed_archive_find(archive, path, &entry);
+    *count = indexed_archive_count(archive);
+    indexed_archive_close(archive);
+    return found;
+}
+
+TEST(format_indexed_state_is_per_context)
+{
+    ResolvedConfig config = {0};
+    config.output_format = "indexed";
+    config.input_directory = "in";
+    ProcessingStats stats_a = {0}, stats_b = {0};
+    static Document a, b;
+    FconcatContext *ctx_a = create_document_context(&config, &stats_a, &a);
+    FconcatContext *ctx_b = create_document_context(&config, &stats_b, &b);
+    ASSERT_NOT_NULL(ctx_a);
+    ASSERT_NOT_NULL(ctx_b);
+
+    /* The second document starts while the first has a block open */
+    FormatPlugin *indexed = format_indexed_plugin();
+    ASSERT_EQ(0, indexed->begin_document(ctx_a));
+    ASSERT_EQ(0, indexed->write_file_header(ctx_a, "a.txt"));
+    ASSERT_EQ(0, indexed->write_file_chunk(ctx_a, "one\n", 4));
+    ASSERT_EQ(0, indexed->begin_document(ctx_b));
+    ASSERT_EQ(0, indexed->write_file_header(ctx_b, "b.txt"));
+    ASSERT_EQ(0, indexed->write_file_chunk(ctx_b, "two\n", 4));
+    ASSERT_EQ(0, indexed->write_file_footer(ctx_b));
+    ASSERT_EQ(0, indexed->write_file_footer(ctx_a));
+    ASSERT_EQ(0, indexed->end_document(ctx_b));
+    ASSERT_EQ(0, indexed->end_document(ctx_a));
+    ASSERT_EQ(0, context_flush_output(ctx_a));
+    ASSERT_EQ(0, context_flush_output(ctx_b));
+
+    size_t count = 0;
+    ASSERT_EQ(0, find_in_document(&a, "a.txt", &count));
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(0, find_in_document(&b, "b.txt", &count));
+    ASSERT_EQ(1, count);
+
+    destroy_fconcat_context(ctx_a);
+    destroy_fconcat_context(ctx_b);
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_format_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Formatters");
+    RUN_TEST(format_escape_kernels_agree);
+    RUN_TEST(format_json_escape_covers_every_byte);
+    RUN_TEST(format_json_escape_replaces_ill_formed_utf8);
+    RUN_TEST(format_json_escape_never_splits_an_escape);
+    RUN_TEST(format_ndjson_state_is_per_context);
+    RUN_TEST(format_ndjson_keeps_utf8_across_chunks);
+    RUN_TEST(format_text_writes_empty_chunks_as_nothing);
+    RUN_TEST(format_indexed_state_is_per_context);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,193 @@
+/**
+ * @file test_log.c
+ * @brief Unit tests for the --log-async log ring
+ *
+ * Tests cover:
+ * - Lines written in order, prefixed and newline terminated
+ * - Long lines cut short instead of overflowing their slot
+ * - Every line from concurrent producers either written or counted as dropped
+ */
+
+#include "test_framework.h"
+#include "../../src/core/log_ring.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* =========================================================================
+ * Helpers
+ * ========================================================================= */
+
+static int push(LogRing *ring, const char *prefix, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int result = log_ring_vpush(ring, prefix, format, args);
+    va_end(args);
+    return result;
+}
+
+/* Everything written to a temporary file so far */
+static char *read_back(FILE *file, size_t *size)
+{
+    fflush(file);
+    long end = lseek(fileno(file), 0, SEEK_END);
+    char *data = calloc(1, end > 0 ? (size_t)end + 1 : 1);
+    if (data && end > 0 && pread(fileno(file), data, (size_t)end, 0) != end) {
+        free(data);
+        return NULL;
+    }
+    *size = end > 0 ? (size_t)end : 0;
+    return data;
+}
+
+static size_t count_lines(const char *data, size_t size)
+{
+    size_t lines = 0;
+    for (size_t i = 0; i < size; i++)
+        lines += data[i] == '\n';
+    return lines;
+}
+
+/* =========================================================================
+ * Ring Tests
+ * ========================================================================= */
+
+TEST(log_ring_writes_lines_in_order)
+{
+    FILE *file = tmpfile();
+    ASSERT_NOT_NULL(file);
+    LogRing *ring = log_ring_create(fileno(file), 16);
+    ASSERT_NOT_NULL(ring);
+
+    ASSERT_EQ(0, push(ring, "[DEBUG] ", "Processing: %s (%d)", "a.txt", 1));
+    ASSERT_EQ(0, push(ring, NULL, "second"));
+    log_ring_flush(ring);
+
+    size_t size = 0;
+    char *data = read_back(file, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_STR_EQ("[DEBUG] Processing: a.txt (1)\nsecond\n", data);
+    free(data);
+
+    /* Nothing dropped, so destroying adds no report line */
+    ASSERT_EQ(0, log_ring_dropped(ring));
+    log_ring_destroy(ring);
+    data = read_back(file, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_EQ(2, count_lines(data, size));
+    free(data);
+
+    fclose(file);
+    return 0;
+}
+
+TEST(log_ring_truncates_long_lines)
+{
+    FILE *file = tmpfile();
+    ASSERT_NOT_NULL(file);
+    LogRing *ring = log_ring_create(fileno(file), 4);
+    ASSERT_NOT_NULL(ring);
+
+    char long_path[LOG_RING_LINE_MAX * 2];
+    memset(long_path, 'x', sizeof(long_path) - 1);
+    long_path[sizeof(long_path) - 1] = '\0';
+    ASSERT_EQ(0, push(ring, "[INFO] ", "%s", long_path));
+    log_ring_destroy(ring);
+
+    size_t size = 0;
+    char *data = read_back(file, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_EQ(LOG_RING_LINE_MAX, size);
+    ASSERT_EQ(0, strncmp(data, "[INFO] xxx", 10));
+    ASSERT_EQ(0, memcmp(data + size - 4, "...\n", 4));
+    free(data);
+
+    fclose(file);
+    return 0;
+}
+
+typedef struct {
+    LogRing *ring;
+    int id;
+    int lines;
+    int queued;
+} Producer;
+
+static void *produce(void *arg)
+{
+    Producer *producer = arg;
+    for (int i = 0; i < producer->lines; i++) {
+        if (push(producer->ring, "[TRACE] ", "producer %d line %d", producer->id, i) == 0)
+            producer->queued++;
+    }
+    return NULL;
+}
+
+TEST(log_ring_counts_what_it_drops)
+{
+    FILE *file = tmpfile();
+    ASSERT_NOT_NULL(file);
+    /* A tiny ring so producers outrun the drain thread */
+    LogRing *ring = log_ring_create(fileno(file), 8);
+    ASSERT_NOT_NULL(ring);
+
+    enum { PRODUCERS = 4, LINES = 5000 };
+    Producer producers[PRODUCERS];
+    pthread_t threads[PRODUCERS];
+    for (int i = 0; i < PRODUCERS; i++) {
+        producers[i] = (Producer){ring, i, LINES, 0};
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, produce, &producers[i]));
+    }
+    int queued = 0;
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+        queued += producers[i].queued;
+    }
+
+    size_t dropped = log_ring_dropped(ring);
+    ASSERT_EQ((size_t)PRODUCERS * LINES, (size_t)queued + dropped);
+    log_ring_flush(ring);
+
+    size_t size = 0;
+    char *data = read_back(file, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_EQ((size_t)queued, count_lines(data, size));
+    free(data);
+
+    /* The drop count is the last line once the ring goes away */
+    log_ring_destroy(ring);
+    data = read_back(file, &size);
+    ASSERT_NOT_NULL(data);
+    ASSERT_EQ((size_t)queued + (dropped > 0), count_lines(data, size));
+    if (dropped > 0)
+        ASSERT_NOT_NULL(strstr(data, "log messages dropped"));
+    free(data);
+
+    fclose(file);
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_log_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Async Log Ring");
+    RUN_TEST(log_ring_writes_lines_in_order);
+    RUN_TEST(log_ring_truncates_long_lines);
+    RUN_TEST(log_ring_counts_what_it_drops);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
@@ -8,13 +8,18 @@
  * - Reallocation with tracking
  * - Double-free detection
  * - Buffer pool allocation and release
+ * - Buffer pool size classes, growth and concurrent use
  * - StreamBuffer creation, writing, overflow protection
+ * - StreamBuffer segment chains drained without flattening
  */
 
 #include "test_framework.h"
 #include "../../src/core/memory.h"
 #include "../../src/core/types.h"
+#include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
 
 /* =========================================================================
  * MemoryManager Lifecycle Tests
@@ -300,6 +305,132 @@ TEST(buffer_pool_fallback_to_malloc_when_exhausted)
     return 0;
 }
 
+TEST(buffer_pool_grows_instead_of_falling_back)
+{
+    BufferPool *pool = buffer_pool_create();
+    ASSERT_NOT_NULL(pool);
+    
+    /* Far more than the old fixed pool held; every buffer must be distinct */
+    enum { COUNT = 600 };
+    static char *buffers[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        buffers[i] = buffer_pool_get(pool, 4096);
+        ASSERT_NOT_NULL(buffers[i]);
+        memset(buffers[i], i & 0xFF, 4096);
+    }
+    for (int i = 0; i < COUNT; i++) {
+        ASSERT_EQ((unsigned char)(i & 0xFF), (unsigned char)buffers[i][4095]);
+    }
+    
+    BufferPoolStats stats = buffer_pool_get_stats(pool);
+    ASSERT_EQ(0, stats.fallback_count);
+    ASSERT_EQ(0, stats.oversize_count);
+    ASSERT_TRUE(stats.slab_count >= 2);
+    ASSERT_TRUE(stats.grow_count >= 2);
+    
+    for (int i = 0; i < COUNT; i++) {
+        buffer_pool_release(pool, buffers[i]);
+    }
+    buffer_pool_destroy(pool);
+    return 0;
+}
+
+TEST(buffer_pool_size_classes_and_foreign_pointers)
+{
+    BufferPool *pool = buffer_pool_create();
+    ASSERT_NOT_NULL(pool);
+    
+    /* Each size is served from a class at least that large */
+    size_t sizes[] = {1, 4096, 4097, 20000, 65536, 300000, 1048576};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *buf = buffer_pool_get(pool, sizes[i]);
+        ASSERT_NOT_NULL(buf);
+        memset(buf, 'x', sizes[i]);
+        buffer_pool_release(pool, buf);
+    }
+    
+    /* Oversize requests and plain malloc'd pointers are freed on release */
+    char *big = buffer_pool_get(pool, 4 * 1024 * 1024);
+    ASSERT_NOT_NULL(big);
+    /* Large chunk buffers start on a huge page boundary */
+    ASSERT_EQ(0, (uintptr_t)big % (2 * 1024 * 1024));
+    memset(big, 'y', 4 * 1024 * 1024);
+    buffer_pool_release(pool, big);
+    buffer_pool_release(pool, malloc(100));
+    buffer_pool_release(pool, NULL);
+    
+    BufferPoolStats stats = buffer_pool_get_stats(pool);
+    ASSERT_EQ(1, stats.oversize_count);
+    ASSERT_EQ(0, stats.fallback_count);
+    
+    buffer_pool_destroy(pool);
+    return 0;
+}
+
+typedef struct {
+    BufferPool *pool;
+    int id;
+    int corruptions;
+} PoolWorker;
+
+static void *pool_worker_thread(void *arg)
+{
+    PoolWorker *worker = (PoolWorker *)arg;
+    static const size_t sizes[] = {100, 4096, 16384, 65536};
+    char *held[16] = {0};
+    
+    for (int i = 0; i < 20000; i++) {
+        int slot = i % 16;
+        if (held[slot]) {
+            if (held[slot][0] != (char)worker->id || held[slot][99] != (char)worker->id)
+                worker->corruptions++;
+            buffer_pool_release(worker->pool, held[slot]);
+        }
+        held[slot] = buffer_pool_get(worker->pool, sizes[(i / 16) % 4]);
+        if (!held[slot]) {
+            worker->corruptions++;
+            continue;
+        }
+        memset(held[slot], worker->id, 100);
+    }
+    for (int i = 0; i < 16; i++) {
+        buffer_pool_release(worker->pool, held[i]);
+    }
+    return NULL;
+}
+
+TEST(buffer_pool_concurrent_get_release)
+{
+    BufferPool *pool = buffer_pool_create();
+    ASSERT_NOT_NULL(pool);
+    
+    pthread_t threads[4];
+    PoolWorker workers[4];
+    for (int i = 0; i < 4; i++) {
+        workers[i].pool = pool;
+        workers[i].id = i + 1;
+        workers[i].corruptions = 0;
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, pool_worker_thread, &workers[i]));
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+        ASSERT_EQ(0, workers[i].corruptions);
+    }
+    
+    /* Exiting threads hand their cached buffers back to the shared lists */
+    BufferPoolStats before = buffer_pool_get_stats(pool);
+    ASSERT_EQ(0, before.fallback_count);
+    char *buf = buffer_pool_get(pool, 4096);
+    ASSERT_NOT_NULL(buf);
+    BufferPoolStats after = buffer_pool_get_stats(pool);
+    ASSERT_EQ(before.shared_hits + 1, after.shared_hits);
+    ASSERT_EQ(before.slab_count, after.slab_count);
+    
+    buffer_pool_release(pool, buf);
+    buffer_pool_destroy(pool);
+    return 0;
+}
+
 /* =========================================================================
  * StreamBuffer Tests
  * ========================================================================= */
@@ -311,7 +442,7 @@ TEST(stream_buffer_create_returns_valid_pointer)
     
     StreamBuffer *buf = stream_buffer_create(mgr, 1024);
     ASSERT_NOT_NULL(buf);
-    ASSERT_NOT_NULL(buf->data);
+    ASSERT_NOT_NULL(buf->head);
     ASSERT_EQ(1024, buf->capacity);
     ASSERT_EQ(0, buf->size);
     
@@ -335,7 +466,8 @@ TEST(stream_buffer_write_appends_data)
     ASSERT_EQ(0, stream_buffer_write(buf, msg2, strlen(msg2)));
     
     ASSERT_EQ(strlen("Hello, World!"), buf->size);
-    ASSERT_MEM_EQ("Hello, World!", buf->data, buf->size);
+    ASSERT_EQ(1, buf->segment_count);
+    ASSERT_MEM_EQ("Hello, World!", buf->head->data, buf->size);
     
     stream_buffer_destroy(buf);
     memory_manager_destroy(mgr);
@@ -386,6 +518,85 @@ TEST(stream_buffer_rejects_null_inputs)
     return 0;
 }
 
+typedef struct {
+    char *data;
+    size_t size;
+    int calls;
+} DrainTarget;
+
+static int collect_segments(void *target, const struct iovec *iov, int count)
+{
+    DrainTarget *out = target;
+    out->calls++;
+    for (int i = 0; i < count; i++) {
+        memcpy(out->data + out->size, iov[i].iov_base, iov[i].iov_len);
+        out->size += iov[i].iov_len;
+    }
+    return 0;
+}
+
+static int refuse_segments(void *target, const struct iovec *iov, int count)
+{
+    (void)target;
+    (void)iov;
+    (void)count;
+    return -1;
+}
+
+TEST(stream_buffer_appends_segments_and_drains_in_order)
+{
+    MemoryManager *mgr = memory_manager_create();
+    ASSERT_NOT_NULL(mgr);
+    
+    StreamBuffer *buf = stream_buffer_create(mgr, 16);
+    ASSERT_NOT_NULL(buf);
+    StreamSegment *first = buf->head;
+    
+    /* Enough for more segments than one drain call takes */
+    size_t total = (size_t)STREAM_SEGMENT_SIZE * (STREAM_BUFFER_IOV_MAX + 2);
+    char piece[1000];
+    size_t written = 0;
+    while (written < total) {
+        size_t n = total - written < sizeof(piece) ? total - written : sizeof(piece);
+        for (size_t i = 0; i < n; i++)
+            piece[i] = (char)('a' + (written + i) % 26);
+        ASSERT_EQ(0, stream_buffer_write(buf, piece, n));
+        written += n;
+    }
+    ASSERT_EQ(total, buf->size);
+    ASSERT_TRUE(buf->segment_count > STREAM_BUFFER_IOV_MAX);
+    
+    /* Earlier segments were never moved by later appends */
+    ASSERT_TRUE(buf->head == first);
+    ASSERT_EQ(16, buf->head->capacity);
+    ASSERT_MEM_EQ("abcdefghijklmnop", buf->head->data, 16);
+    
+    /* A failed drain keeps everything */
+    ASSERT_EQ(-1, stream_buffer_drain(buf, refuse_segments, NULL));
+    ASSERT_EQ(total, buf->size);
+    
+    DrainTarget out = {malloc(total), 0, 0};
+    ASSERT_NOT_NULL(out.data);
+    ASSERT_EQ(0, stream_buffer_drain(buf, collect_segments, &out));
+    ASSERT_EQ(total, out.size);
+    ASSERT_EQ(2, out.calls);
+    for (size_t i = 0; i < total; i++) {
+        if (out.data[i] != (char)('a' + i % 26))
+            ASSERT_EQ((char)('a' + i % 26), out.data[i]);
+    }
+    free(out.data);
+    
+    /* Emptied down to the first segment, and usable again */
+    ASSERT_EQ(0, buf->size);
+    ASSERT_EQ(1, buf->segment_count);
+    ASSERT_EQ(0, stream_buffer_write(buf, "again", 5));
+    ASSERT_MEM_EQ("again", buf->head->data, 5);
+    
+    stream_buffer_destroy(buf);
+    memory_manager_destroy(mgr);
+    return 0;
+}
+
 TEST(stream_buffer_destroy_null_is_safe)
 {
     stream_buffer_destroy(NULL);
@@ -457,12 +668,16 @@ int test_memory_main(void)
     RUN_TEST(buffer_pool_get_returns_buffer);
     RUN_TEST(buffer_pool_reuses_released_buffer);
     RUN_TEST(buffer_pool_fallback_to_malloc_when_exhausted);
+    RUN_TEST(buffer_pool_grows_instead_of_falling_back);
+    RUN_TEST(buffer_pool_size_classes_and_foreign_pointers);
+    RUN_TEST(buffer_pool_concurrent_get_release);
     
     TEST_SUITE_BEGIN("StreamBuffer");
     RUN_TEST(stream_buffer_create_returns_valid_pointer);
     RUN_TEST(stream_buffer_write_appends_data);
     RUN_TEST(stream_buffer_grows_automatically);
     RUN_TEST(stream_buffer_rejects_null_inputs);
+    RUN_TEST(stream_buffer_appends_segments_and_drains_in_order);
     RUN_TEST(stream_buffer_destroy_null_is_safe);
     
     TEST_SUITE_BEGIN("Memory Tracking Toggle");
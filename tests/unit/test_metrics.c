@@ -0,0 +1,181 @@
+/**
+ * @file test_metrics.c
+ * @brief Unit tests for the --stats performance counters
+ *
+ * Tests cover:
+ * - Accumulation of per-stage time, calls and bytes
+ * - The slowest-files list keeping the N slowest, slowest first
+ * - The JSON report and parsing of --stats with and without a format
+ */
+
+#include "test_framework.h"
+#include "../../src/core/metrics.h"
+#include "../../src/config/config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================================================================
+ * Counter Tests
+ * ========================================================================= */
+
+TEST(metrics_accumulate_per_stage)
+{
+    Metrics *metrics = metrics_create();
+    ASSERT_NOT_NULL(metrics);
+
+    metrics_record(metrics, METRICS_READ, 100, 1, 4096);
+    metrics_record(metrics, METRICS_READ, 50, 2, 10);
+    metrics_record(metrics, METRICS_STAT, 7, 1, 0);
+
+    MetricsCounter read = metrics_get(metrics, METRICS_READ);
+    ASSERT_EQ(150, read.ns);
+    ASSERT_EQ(3, read.calls);
+    ASSERT_EQ(4106, read.bytes);
+
+    MetricsCounter write = metrics_get(metrics, METRICS_WRITE);
+    ASSERT_EQ(0, write.calls);
+
+    /* Out-of-range stages are ignored */
+    metrics_record(metrics, METRICS_STAGE_COUNT, 1, 1, 1);
+    ASSERT_STR_EQ("unknown", metrics_stage_name(METRICS_STAGE_COUNT));
+    ASSERT_STR_EQ("binary_scan", metrics_stage_name(METRICS_BINARY_SCAN));
+
+    /* Without metrics the helpers do nothing */
+    ASSERT_EQ(0, metrics_begin(NULL));
+    metrics_end(NULL, METRICS_READ, 0, 1);
+    metrics_record_file(NULL, "x", 1, 1);
+
+    metrics_destroy(metrics);
+    return 0;
+}
+
+TEST(metrics_keep_slowest_files_in_order)
+{
+    Metrics *metrics = metrics_create();
+    ASSERT_NOT_NULL(metrics);
+
+    /* Twice as many files as the list holds, in scrambled order */
+    char path[32];
+    for (int i = 0; i < METRICS_SLOWEST_FILES * 2; i++) {
+        int n = (i * 7) % (METRICS_SLOWEST_FILES * 2);
+        snprintf(path, sizeof(path), "file%02d", n);
+        metrics_record_file(metrics, path, (uint64_t)(n + 1) * 1000, (uint64_t)n);
+    }
+
+    char *report = NULL;
+    size_t report_size = 0;
+    FILE *stream = open_memstream(&report, &report_size);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_EQ(0, metrics_report(metrics, stream, true));
+    fclose(stream);
+
+    /* Only the slowest half is listed, slowest first */
+    const char *slowest = strstr(report, "\"slowest_files\"");
+    ASSERT_NOT_NULL(slowest);
+    ASSERT_NULL(strstr(slowest, "file09"));
+    const char *previous = slowest;
+    for (int n = METRICS_SLOWEST_FILES * 2 - 1; n >= METRICS_SLOWEST_FILES; n--) {
+        snprintf(path, sizeof(path), "\"file%02d\"", n);
+        const char *at = strstr(slowest, path);
+        ASSERT_NOT_NULL(at);
+        ASSERT_TRUE(at > previous);
+        previous = at;
+    }
+
+    free(report);
+    metrics_destroy(metrics);
+    return 0;
+}
+
+/* =========================================================================
+ * Report Tests
+ * ========================================================================= */
+
+TEST(metrics_report_lists_every_stage)
+{
+    Metrics *metrics = metrics_create();
+    ASSERT_NOT_NULL(metrics);
+    metrics_record(metrics, METRICS_FORMAT, 2000, 4, 123);
+    metrics_record_file(metrics, "dir/\"quoted\"\n.c", 5000, 42);
+
+    char *report = NULL;
+    size_t report_size = 0;
+    FILE *stream = open_memstream(&report, &report_size);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_EQ(0, metrics_report(metrics, stream, true));
+    fclose(stream);
+
+    for (int s = 0; s < METRICS_STAGE_COUNT; s++) {
+        char key[64];
+        snprintf(key, sizeof(key), "\"stage\": \"%s\"", metrics_stage_name((MetricsStage)s));
+        ASSERT_NOT_NULL(strstr(report, key));
+    }
+    ASSERT_NOT_NULL(strstr(report, "\"stage\": \"format\", \"calls\": 4, \"ns\": 2000, \"bytes\": 123"));
+    ASSERT_NOT_NULL(strstr(report, "\"path\": \"dir/\\\"quoted\\\"\\u000a.c\""));
+    free(report);
+
+    /* The table names the same stages */
+    report = NULL;
+    stream = open_memstream(&report, &report_size);
+    ASSERT_NOT_NULL(stream);
+    ASSERT_EQ(0, metrics_report(metrics, stream, false));
+    fclose(stream);
+    ASSERT_NOT_NULL(strstr(report, "path_filter"));
+    ASSERT_NOT_NULL(strstr(report, "Slowest files"));
+    free(report);
+
+    metrics_destroy(metrics);
+    return 0;
+}
+
+static StatsReport parse_stats_option(int argc, char **argv)
+{
+    ConfigManager *manager = config_manager_create();
+    StatsReport report = (StatsReport)-1;
+    if (manager && config_load_defaults(manager) == 0 && config_load_cli(manager, argc, argv) == 0) {
+        ResolvedConfig *config = config_resolve(manager);
+        if (config)
+            report = config->stats_report;
+    }
+    config_manager_destroy(manager);
+    return report;
+}
+
+TEST(stats_option_takes_an_optional_format)
+{
+    char *none[] = {"fconcat", "in", "out"};
+    ASSERT_EQ(STATS_REPORT_NONE, parse_stats_option(3, none));
+
+    char *bare[] = {"fconcat", "in", "out", "--stats", "--dedup"};
+    ASSERT_EQ(STATS_REPORT_TABLE, parse_stats_option(5, bare));
+
+    char *json[] = {"fconcat", "in", "out", "--stats", "json"};
+    ASSERT_EQ(STATS_REPORT_JSON, parse_stats_option(5, json));
+
+    char *table[] = {"fconcat", "in", "out", "--stats", "table"};
+    ASSERT_EQ(STATS_REPORT_TABLE, parse_stats_option(5, table));
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_metrics_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Performance Counters");
+    RUN_TEST(metrics_accumulate_per_stage);
+    RUN_TEST(metrics_keep_slowest_files_in_order);
+    RUN_TEST(metrics_report_lists_every_stage);
+    RUN_TEST(stats_option_takes_an_optional_format);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
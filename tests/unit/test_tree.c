@@ -0,0 +1,394 @@
+/**
+ * @file test_tree.c
+ * @brief Unit tests for the cached directory tree
+ *
+ * Tests cover:
+ * - FileTree lifecycle (create/clear/destroy)
+ * - Entry recording and path interning
+ * - Replay order and context bookkeeping
+ * - The inode set behind cycle detection and --unique-inodes
+ * - Splitting a tree into shards for --shard-size and --shards
+ */
+
+#include "test_framework.h"
+#include "../../src/core/tree.h"
+#include "../../src/core/inode_set.h"
+#include "../../src/core/shard.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* =========================================================================
+ * Test Helpers
+ * ========================================================================= */
+
+typedef struct {
+    const char *paths[16];
+    int levels[16];
+    int count;
+    int stop_after;
+    int saw_current_info;
+} ReplayLog;
+
+static int record_entry(FconcatContext *ctx, const char *path, EntryType type,
+                        FileInfo *info, int level, void *user_data)
+{
+    (void)type;
+    ReplayLog *log = (ReplayLog *)user_data;
+    if (ctx->current_file_info == info && ctx->current_file_path == path &&
+        ctx->current_directory_level == level) {
+        log->saw_current_info++;
+    }
+    log->paths[log->count] = path;
+    log->levels[log->count] = level;
+    log->count++;
+    return (log->stop_after > 0 && log->count >= log->stop_after) ? 7 : 0;
+}
+
+static FileInfo make_info(bool is_directory, size_t size)
+{
+    FileInfo info = {0};
+    info.is_directory = is_directory;
+    info.size = size;
+    return info;
+}
+
+/* =========================================================================
+ * Lifecycle Tests
+ * ========================================================================= */
+
+TEST(file_tree_create_returns_empty_tree)
+{
+    FileTree *tree = file_tree_create();
+    ASSERT_NOT_NULL(tree);
+    ASSERT_EQ(0, tree->count);
+    ASSERT_EQ(0, tree->file_count);
+    ASSERT_EQ(0, tree->directory_count);
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(file_tree_destroy_null_is_safe)
+{
+    file_tree_destroy(NULL);
+    file_tree_clear(NULL);
+    return 0;
+}
+
+/* =========================================================================
+ * Entry Recording Tests
+ * ========================================================================= */
+
+TEST(file_tree_add_interns_path)
+{
+    FileTree *tree = file_tree_create();
+    ASSERT_NOT_NULL(tree);
+
+    char path[32];
+    strcpy(path, "src/main.c");
+    FileInfo info = make_info(false, 42);
+    info.path = path;
+
+    ASSERT_EQ(0, file_tree_add(tree, path, ENTRY_TYPE_FILE, &info, 1));
+
+    /* Mutating the caller's buffer must not affect the stored entry */
+    strcpy(path, "clobbered");
+    ASSERT_STR_EQ("src/main.c", tree->entries[0].path);
+    ASSERT_TRUE(tree->entries[0].info.path == tree->entries[0].path);
+    ASSERT_EQ(42, tree->entries[0].info.size);
+    ASSERT_EQ(1, tree->entries[0].level);
+    ASSERT_EQ(1, tree->file_count);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(file_tree_add_grows_past_initial_capacity)
+{
+    FileTree *tree = file_tree_create();
+    ASSERT_NOT_NULL(tree);
+
+    char path[32];
+    FileInfo info = make_info(false, 1);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(path, sizeof(path), "file_%d.txt", i);
+        ASSERT_EQ(0, file_tree_add(tree, path, ENTRY_TYPE_FILE, &info, 0));
+    }
+
+    ASSERT_EQ(5000, tree->count);
+    ASSERT_STR_EQ("file_0.txt", tree->entries[0].path);
+    ASSERT_STR_EQ("file_4999.txt", tree->entries[4999].path);
+
+    file_tree_clear(tree);
+    ASSERT_EQ(0, tree->count);
+    ASSERT_EQ(0, tree->file_count);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(file_tree_add_null_params)
+{
+    FileTree *tree = file_tree_create();
+    FileInfo info = make_info(false, 0);
+    ASSERT_EQ(-1, file_tree_add(NULL, "a", ENTRY_TYPE_FILE, &info, 0));
+    ASSERT_EQ(-1, file_tree_add(tree, NULL, ENTRY_TYPE_FILE, &info, 0));
+    ASSERT_EQ(-1, file_tree_add(tree, "a", ENTRY_TYPE_FILE, NULL, 0));
+    file_tree_destroy(tree);
+    return 0;
+}
+
+/* =========================================================================
+ * Replay Tests
+ * ========================================================================= */
+
+TEST(file_tree_replay_preserves_order_and_context)
+{
+    FileTree *tree = file_tree_create();
+    ASSERT_NOT_NULL(tree);
+
+    FileInfo dir = make_info(true, 0);
+    FileInfo file = make_info(false, 10);
+    ASSERT_EQ(0, file_tree_add(tree, "lib", ENTRY_TYPE_DIRECTORY, &dir, 0));
+    ASSERT_EQ(0, file_tree_add(tree, "lib/a.c", ENTRY_TYPE_FILE, &file, 1));
+    ASSERT_EQ(0, file_tree_add(tree, "README", ENTRY_TYPE_FILE, &file, 0));
+    ASSERT_EQ(1, tree->directory_count);
+    ASSERT_EQ(2, tree->file_count);
+
+    FconcatContext ctx = {0};
+    ReplayLog log = {0};
+    DirectoryCallback callback = {.handle_entry = record_entry, .user_data = &log};
+
+    ASSERT_EQ(0, file_tree_replay(&ctx, tree, &callback));
+    ASSERT_EQ(3, log.count);
+    ASSERT_EQ(3, log.saw_current_info);
+    ASSERT_STR_EQ("lib", log.paths[0]);
+    ASSERT_STR_EQ("lib/a.c", log.paths[1]);
+    ASSERT_STR_EQ("README", log.paths[2]);
+    ASSERT_EQ(1, log.levels[1]);
+    ASSERT_NULL(ctx.current_file_info);
+
+    /* A second replay sees exactly the same entries */
+    ReplayLog second = {0};
+    callback.user_data = &second;
+    ASSERT_EQ(0, file_tree_replay(&ctx, tree, &callback));
+    ASSERT_EQ(3, second.count);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(file_tree_replay_stops_on_callback_error)
+{
+    FileTree *tree = file_tree_create();
+    FileInfo file = make_info(false, 1);
+    file_tree_add(tree, "a", ENTRY_TYPE_FILE, &file, 0);
+    file_tree_add(tree, "b", ENTRY_TYPE_FILE, &file, 0);
+    file_tree_add(tree, "c", ENTRY_TYPE_FILE, &file, 0);
+
+    FconcatContext ctx = {0};
+    ReplayLog log = {0};
+    log.stop_after = 2;
+    DirectoryCallback callback = {.handle_entry = record_entry, .user_data = &log};
+
+    ASSERT_EQ(7, file_tree_replay(&ctx, tree, &callback));
+    ASSERT_EQ(2, log.count);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+/* =========================================================================
+ * Inode Set Tests
+ * ========================================================================= */
+
+TEST(inode_set_insert_and_contains)
+{
+    InodeSet *set = inode_set_create();
+    ASSERT_NOT_NULL(set);
+
+    /* Grows well past its initial table; the device is part of the key */
+    for (uint64_t ino = 1; ino <= 5000; ino++)
+        ASSERT_EQ(1, inode_set_insert(set, 7, ino));
+    ASSERT_EQ(0, inode_set_insert(set, 7, 42));
+    ASSERT_EQ(1, inode_set_insert(set, 8, 42));
+    ASSERT_EQ(5001, inode_set_count(set));
+    ASSERT_TRUE(inode_set_contains(set, 7, 5000));
+    ASSERT_FALSE(inode_set_contains(set, 7, 5001));
+    ASSERT_FALSE(inode_set_contains(set, 9, 1));
+
+    inode_set_destroy(set);
+    inode_set_destroy(NULL);
+    return 0;
+}
+
+TEST(inode_set_remove_keeps_probe_runs)
+{
+    InodeSet *set = inode_set_create();
+    ASSERT_NOT_NULL(set);
+
+    /* Removing every other entry must not hide the ones probed past it */
+    for (uint64_t ino = 0; ino < 2000; ino++)
+        ASSERT_EQ(1, inode_set_insert(set, 1, ino));
+    for (uint64_t ino = 0; ino < 2000; ino += 2)
+        inode_set_remove(set, 1, ino);
+    inode_set_remove(set, 1, 999999);
+
+    ASSERT_EQ(1000, inode_set_count(set));
+    for (uint64_t ino = 0; ino < 2000; ino++)
+        ASSERT_EQ(ino % 2 == 1, inode_set_contains(set, 1, ino));
+
+    /* Removed pairs can come back */
+    ASSERT_EQ(1, inode_set_insert(set, 1, 0));
+    ASSERT_TRUE(inode_set_contains(set, 1, 0));
+
+    inode_set_destroy(set);
+    return 0;
+}
+
+/* =========================================================================
+ * Shard Tests
+ * ========================================================================= */
+
+/* src/ holds two files and an empty directory, then a top-level file */
+static FileTree *make_shard_tree(void)
+{
+    FileTree *tree = file_tree_create();
+    if (!tree)
+        return NULL;
+    FileInfo dir = make_info(true, 0);
+    FileInfo big = make_info(false, 400);
+    FileInfo small = make_info(false, 100);
+    file_tree_add(tree, "src", ENTRY_TYPE_DIRECTORY, &dir, 0);
+    file_tree_add(tree, "src/a.c", ENTRY_TYPE_FILE, &big, 1);
+    file_tree_add(tree, "src/empty", ENTRY_TYPE_DIRECTORY, &dir, 1);
+    file_tree_add(tree, "src/b.c", ENTRY_TYPE_FILE, &big, 1);
+    file_tree_add(tree, "README", ENTRY_TYPE_FILE, &small, 0);
+    return tree;
+}
+
+TEST(shard_split_by_budget_repeats_parent_directories)
+{
+    FileTree *tree = make_shard_tree();
+    ASSERT_NOT_NULL(tree);
+
+    FileTree **shards = NULL;
+    size_t count = 0;
+    ASSERT_EQ(0, shard_split_by_budget(tree, 500, SHARD_UNIT_BYTES, &shards, &count));
+    ASSERT_EQ(2, count);
+
+    /* The empty directory stays where the walk met it */
+    ASSERT_EQ(3, shards[0]->count);
+    ASSERT_STR_EQ("src", shards[0]->entries[0].path);
+    ASSERT_STR_EQ("src/a.c", shards[0]->entries[1].path);
+    ASSERT_STR_EQ("src/empty", shards[0]->entries[2].path);
+
+    /* The next part opens src/ again before b.c */
+    ASSERT_EQ(3, shards[1]->count);
+    ASSERT_STR_EQ("src", shards[1]->entries[0].path);
+    ASSERT_STR_EQ("src/b.c", shards[1]->entries[1].path);
+    ASSERT_EQ(1, shards[1]->entries[1].level);
+    ASSERT_STR_EQ("README", shards[1]->entries[2].path);
+    ASSERT_EQ(2, shards[1]->file_count);
+    shard_free(shards, count);
+
+    /* 400 bytes estimate to 100 tokens: everything fits in 300 */
+    ASSERT_EQ(100, shard_entry_weight(&tree->entries[1], SHARD_UNIT_TOKENS));
+    ASSERT_EQ(0, shard_split_by_budget(tree, 300, SHARD_UNIT_TOKENS, &shards, &count));
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(tree->count, shards[0]->count);
+    shard_free(shards, count);
+
+    /* A file over budget still gets a part of its own */
+    ASSERT_EQ(0, shard_split_by_budget(tree, 10, SHARD_UNIT_BYTES, &shards, &count));
+    ASSERT_EQ(3, count);
+    shard_free(shards, count);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(shard_split_evenly_balances_by_size)
+{
+    FileTree *tree = make_shard_tree();
+    ASSERT_NOT_NULL(tree);
+
+    FileTree **shards = NULL;
+    size_t count = 0;
+    ASSERT_EQ(0, shard_split_evenly(tree, 2, &shards, &count));
+    ASSERT_EQ(2, count);
+    ASSERT_EQ(1, shards[0]->file_count);
+    ASSERT_EQ(2, shards[1]->file_count);
+    shard_free(shards, count);
+
+    /* More parts than files leaves none of them empty */
+    ASSERT_EQ(0, shard_split_evenly(tree, 10, &shards, &count));
+    ASSERT_EQ(3, count);
+    for (size_t i = 0; i < count; i++)
+        ASSERT_EQ(1, shards[i]->file_count);
+    shard_free(shards, count);
+
+    /* An empty tree still makes one (empty) document */
+    FileTree *empty = file_tree_create();
+    ASSERT_NOT_NULL(empty);
+    ASSERT_EQ(0, shard_split_evenly(empty, 4, &shards, &count));
+    ASSERT_EQ(1, count);
+    ASSERT_EQ(0, shards[0]->count);
+    shard_free(shards, count);
+    file_tree_destroy(empty);
+
+    file_tree_destroy(tree);
+    return 0;
+}
+
+TEST(shard_output_path_keeps_extension)
+{
+    char *path = shard_output_path("out/all.txt", 0, 3);
+    ASSERT_STR_EQ("out/all.part001.txt", path);
+    free(path);
+    path = shard_output_path("out.d/all", 11, 12);
+    ASSERT_STR_EQ("out.d/all.part012", path);
+    free(path);
+    path = shard_output_path(".hidden", 1234, 2000);
+    ASSERT_STR_EQ(".hidden.part1235", path);
+    free(path);
+    ASSERT_NULL(shard_output_path("all.txt", 3, 3));
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_tree_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("FileTree Lifecycle");
+    RUN_TEST(file_tree_create_returns_empty_tree);
+    RUN_TEST(file_tree_destroy_null_is_safe);
+
+    TEST_SUITE_BEGIN("FileTree Entries");
+    RUN_TEST(file_tree_add_interns_path);
+    RUN_TEST(file_tree_add_grows_past_initial_capacity);
+    RUN_TEST(file_tree_add_null_params);
+
+    TEST_SUITE_BEGIN("FileTree Replay");
+    RUN_TEST(file_tree_replay_preserves_order_and_context);
+    RUN_TEST(file_tree_replay_stops_on_callback_error);
+
+    TEST_SUITE_BEGIN("Inode Set");
+    RUN_TEST(inode_set_insert_and_contains);
+    RUN_TEST(inode_set_remove_keeps_probe_runs);
+
+    TEST_SUITE_BEGIN("Shards");
+    RUN_TEST(shard_split_by_budget_repeats_parent_directories);
+    RUN_TEST(shard_split_evenly_balances_by_size);
+    RUN_TEST(shard_output_path_keeps_extension);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,175 @@
+/**
+ * @file test_zerocopy.c
+ * @brief Unit tests for the kernel-side file copy helpers
+ *
+ * Tests cover:
+ * - File-to-file copies from an offset, appended at the output position
+ * - File-to-pipe copies
+ * - Inputs shorter than the requested range
+ * - Invalid descriptors
+ */
+
+#include "test_framework.h"
+#include "../../src/core/zerocopy.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* =========================================================================
+ * Test Helpers
+ * ========================================================================= */
+
+#define ZC_INPUT_SIZE (300 * 1024)
+
+static int make_temp_file(char *path, size_t path_size, const char *data, size_t size)
+{
+    snprintf(path, path_size, "/tmp/fconcat_zc_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0)
+        return -1;
+    if (size > 0 && write(fd, data, size) != (ssize_t)size) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static char *make_pattern(size_t size)
+{
+    char *data = malloc(size);
+    if (!data)
+        return NULL;
+    for (size_t i = 0; i < size; i++)
+        data[i] = (char)('a' + (i * 7 + i / 4096) % 26);
+    return data;
+}
+
+static size_t read_back(int fd, char *buf, size_t size)
+{
+    size_t total = 0;
+    ssize_t n;
+    while (total < size && (n = pread(fd, buf + total, size - total, (off_t)total)) > 0)
+        total += (size_t)n;
+    return total;
+}
+
+/* =========================================================================
+ * Copy Tests
+ * ========================================================================= */
+
+TEST(zerocopy_file_to_file_from_offset)
+{
+    char *data = make_pattern(ZC_INPUT_SIZE);
+    ASSERT_NOT_NULL(data);
+
+    char in_path[64], out_path[64];
+    int in_fd = make_temp_file(in_path, sizeof(in_path), data, ZC_INPUT_SIZE);
+    int out_fd = make_temp_file(out_path, sizeof(out_path), "head:", 5);
+    ASSERT_TRUE(in_fd >= 0);
+    ASSERT_TRUE(out_fd >= 0);
+
+    ZeroCopyMethod method = ZEROCOPY_NONE;
+    ssize_t copied = zerocopy_fd_range(out_fd, in_fd, 1000, ZC_INPUT_SIZE - 1000, &method);
+    ASSERT_EQ(ZC_INPUT_SIZE - 1000, copied);
+    ASSERT_NE(ZEROCOPY_NONE, method);
+
+    /* The copy lands at the output position and leaves it after the bytes */
+    ASSERT_EQ(5 + ZC_INPUT_SIZE - 1000, lseek(out_fd, 0, SEEK_CUR));
+
+    char *result = malloc(ZC_INPUT_SIZE);
+    ASSERT_NOT_NULL(result);
+    ASSERT_EQ(5 + ZC_INPUT_SIZE - 1000, read_back(out_fd, result, ZC_INPUT_SIZE));
+    ASSERT_MEM_EQ("head:", result, 5);
+    ASSERT_MEM_EQ(data + 1000, result + 5, ZC_INPUT_SIZE - 1000);
+
+    /* The input position is never used */
+    ASSERT_EQ(ZC_INPUT_SIZE, lseek(in_fd, 0, SEEK_CUR));
+
+    free(result);
+    free(data);
+    close(in_fd);
+    close(out_fd);
+    unlink(in_path);
+    unlink(out_path);
+    return 0;
+}
+
+TEST(zerocopy_file_to_pipe)
+{
+    const char *data = "zero-copy through a pipe";
+    size_t size = strlen(data);
+
+    char in_path[64];
+    int in_fd = make_temp_file(in_path, sizeof(in_path), data, size);
+    ASSERT_TRUE(in_fd >= 0);
+
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+
+    ssize_t copied = zerocopy_fd_range(fds[1], in_fd, 5, size - 5, NULL);
+    ASSERT_EQ((ssize_t)(size - 5), copied);
+    close(fds[1]);
+
+    char buf[64] = {0};
+    ASSERT_EQ((ssize_t)(size - 5), read(fds[0], buf, sizeof(buf)));
+    ASSERT_STR_EQ(data + 5, buf);
+
+    close(fds[0]);
+    close(in_fd);
+    unlink(in_path);
+    return 0;
+}
+
+TEST(zerocopy_stops_at_end_of_input)
+{
+    char in_path[64], out_path[64];
+    int in_fd = make_temp_file(in_path, sizeof(in_path), "short", 5);
+    int out_fd = make_temp_file(out_path, sizeof(out_path), NULL, 0);
+    ASSERT_TRUE(in_fd >= 0);
+    ASSERT_TRUE(out_fd >= 0);
+
+    ASSERT_EQ(3, zerocopy_fd_range(out_fd, in_fd, 2, 4096, NULL));
+    ASSERT_EQ(0, zerocopy_fd_range(out_fd, in_fd, 10, 4096, NULL));
+
+    char buf[16] = {0};
+    ASSERT_EQ(3, read_back(out_fd, buf, sizeof(buf)));
+    ASSERT_STR_EQ("ort", buf);
+
+    close(in_fd);
+    close(out_fd);
+    unlink(in_path);
+    unlink(out_path);
+    return 0;
+}
+
+TEST(zerocopy_rejects_bad_descriptors)
+{
+    ZeroCopyMethod method = ZEROCOPY_SENDFILE;
+    ASSERT_EQ(-1, zerocopy_fd_range(-1, 0, 0, 10, &method));
+    ASSERT_EQ(ZEROCOPY_NONE, method);
+    ASSERT_EQ(-1, zerocopy_fd_range(1, -1, 0, 10, NULL));
+    ASSERT_STR_EQ("none", zerocopy_method_name(ZEROCOPY_NONE));
+    return 0;
+}
+
+/* =========================================================================
+ * Main Entry Point (renamed for test harness integration)
+ * ========================================================================= */
+
+int test_zerocopy_main(void)
+{
+    /* Reset counters for this test suite */
+    tests_run = 0;
+    tests_passed = 0;
+    tests_failed = 0;
+
+    TEST_SUITE_BEGIN("Zero-copy Ranges");
+    RUN_TEST(zerocopy_file_to_file_from_offset);
+    RUN_TEST(zerocopy_file_to_pipe);
+    RUN_TEST(zerocopy_stops_at_end_of_input);
+    RUN_TEST(zerocopy_rejects_bad_descriptors);
+
+    TEST_SUMMARY();
+
+    return TEST_EXIT_CODE();
+}